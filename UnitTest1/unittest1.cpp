@@ -48,6 +48,41 @@ namespace UnitTest1
             Assert::AreEqual(ret, 0);
         }
 
+        TEST_METHOD(picohash_grow)
+        {
+            int ret = picohash_grow_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(picohash_duplicate)
+        {
+            int ret = picohash_duplicate_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(picohash_churn)
+        {
+            int ret = picohash_churn_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(crypto_pool)
+        {
+            int ret = crypto_pool_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(path_cache)
+        {
+            int ret = path_cache_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
         TEST_METHOD(picolog_basic)
         {
             int ret = picolog_basic_test();
@@ -188,6 +223,55 @@ namespace UnitTest1
             Assert::AreEqual(ret, 0);
         }
 
+        TEST_METHOD(sockloop_batch_recv)
+        {
+            int ret = sockloop_batch_recv_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(sockloop_uring)
+        {
+            int ret = sockloop_uring_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(sockloop_uring_backend)
+        {
+            int ret = sockloop_uring_backend_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(sockloop_batch_send)
+        {
+            int ret = sockloop_batch_send_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(sockloop_txtime)
+        {
+            int ret = sockloop_txtime_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(sockloop_select)
+        {
+            int ret = sockloop_select_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(shard_steering)
+        {
+            int ret = shard_steering_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
         TEST_METHOD(splay)
         {
             int ret = splay_test();
@@ -202,6 +286,48 @@ namespace UnitTest1
             Assert::AreEqual(ret, 0);
         }
 
+        TEST_METHOD(incoming_batch)
+        {
+            int ret = incoming_batch_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(wake_wheel)
+        {
+            int ret = wake_wheel_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(packet_pool)
+        {
+            int ret = packet_pool_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(packet_pool_wait)
+        {
+            int ret = packet_pool_wait_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(sent_ring)
+        {
+            int ret = sent_ring_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(cnx_hibernation)
+        {
+            int ret = cnx_hibernation_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
         TEST_METHOD(create_quic)
         {
             int ret = create_quic_test();
@@ -300,6 +426,13 @@ namespace UnitTest1
             Assert::AreEqual(ret, 0);
         }
 
+        TEST_METHOD(frame_fast_parse)
+        {
+            int ret = frame_fast_parse_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
         TEST_METHOD(test_logger)
         {
             int ret = logger_test();
@@ -335,6 +468,41 @@ namespace UnitTest1
             Assert::AreEqual(ret, 0);
         }
 
+        TEST_METHOD(stream_ring)
+        {
+            int ret = stream_ring_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(stream_ring_sparse)
+        {
+            int ret = stream_ring_sparse_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(stream_views)
+        {
+            int ret = stream_views_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(rwnd_tuning)
+        {
+            int ret = rwnd_tuning_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(path_scheduler)
+        {
+            int ret = path_scheduler_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
         TEST_METHOD(stream_splay)
         {
             int ret = stream_splay_test();
@@ -348,6 +516,13 @@ namespace UnitTest1
 
             Assert::AreEqual(ret, 0);
         }
+
+        TEST_METHOD(stream_scheduler)
+        {
+            int ret = stream_scheduler_test();
+
+            Assert::AreEqual(ret, 0);
+        }
         TEST_METHOD(stream_retransmit_copy)
         {
             int ret = test_copy_for_retransmit();
@@ -417,6 +592,20 @@ namespace UnitTest1
             Assert::AreEqual(ret, 0);
         }
 
+        TEST_METHOD(ack_sack_array)
+        {
+            int ret = ack_sack_array_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(ack_reorder_bounded)
+        {
+            int ret = ack_reorder_bounded_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
         TEST_METHOD(ackfrq_basic)
         {
             int ret = ackfrq_basic_test();
@@ -445,6 +634,20 @@ namespace UnitTest1
             Assert::AreEqual(ret, 0);
         }
 
+        TEST_METHOD(pn_enc_batch)
+        {
+            int ret = pn_enc_batch_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(pn_dec_batch)
+        {
+            int ret = pn_dec_batch_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
         TEST_METHOD(cid_for_lb)
         {
             int ret = cid_for_lb_test();
@@ -505,6 +708,13 @@ namespace UnitTest1
         {
             int ret = pacing_repeat_test();
 
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(pacing_offload)
+        {
+            int ret = pacing_offload_test();
+
             Assert::AreEqual(ret, 0);
         }
 
@@ -998,6 +1208,13 @@ namespace UnitTest1
 
             Assert::AreEqual(ret, 0);
         }
+
+        TEST_METHOD(test_sockets_sendmmsg)
+        {
+            int ret = socket_sendmmsg_test();
+
+            Assert::AreEqual(ret, 0);
+        }
         
         TEST_METHOD(ticket_store)
         {
@@ -1806,6 +2023,20 @@ namespace UnitTest1
 
             Assert::AreEqual(ret, 0);
         }
+
+        TEST_METHOD(crypto_workers)
+        {
+            int ret = crypto_workers_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(key_rotation_train)
+        {
+            int ret = key_rotation_train_test();
+
+            Assert::AreEqual(ret, 0);
+        }
         TEST_METHOD(nat_rebinding_stress)
         {
             int ret = rebinding_stress_test();
@@ -2264,6 +2495,12 @@ namespace UnitTest1
             Assert::AreEqual(ret, 0);
         }
 
+        TEST_METHOD(stream_zero_copy) {
+            int ret = stream_zero_copy_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
         TEST_METHOD(queue_network_input) {
             int ret = queue_network_input_test();
 
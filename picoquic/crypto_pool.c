@@ -0,0 +1,386 @@
+/*
+* Copyright (c) 2026, the picoquic contributors.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Crypto worker pool.
+ *
+ * The protocol thread posts AEAD jobs to the workers through one single
+ * producer, single consumer ring per worker. The ring positions only
+ * grow: the protocol thread advances the tail after writing a job, the
+ * worker advances the head after completing it, so the protocol thread
+ * knows that a worker is idle when the head reaches the tail.
+ *
+ * Workers spin for a while after their last job, then sleep on an event.
+ * Before sleeping, a worker raises its "is_sleeping" flag and checks the
+ * ring again; the protocol thread checks that flag after posting a job,
+ * and signals the event if it is set. The event may still be signalled
+ * just before the worker starts waiting, so the protocol thread signals
+ * it again while waiting for the completion of a job, and the wait of
+ * the worker is bounded.
+ *
+ * A batch of jobs is split between the workers and the protocol thread,
+ * which processes its share with the primary AEAD context while the
+ * workers process theirs with their clones. Jobs that do not fit in a
+ * ring are also processed by the protocol thread.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "picoquic.h"
+#include "picoquic_internal.h"
+#include "picoquic_utils.h"
+#include "tls_api.h"
+
+void picoquic_crypto_job_run(picoquic_crypto_job_t* job)
+{
+    if (job->is_encrypt) {
+        if (job->is_multipath) {
+            job->result = picoquic_aead_encrypt_mp(job->output, job->input, job->input_length,
+                job->path_id, job->sequence_number, job->aad, job->aad_length, job->aead_context);
+        }
+        else {
+            job->result = picoquic_aead_encrypt_generic(job->output, job->input, job->input_length,
+                job->sequence_number, job->aad, job->aad_length, job->aead_context);
+        }
+    }
+    else {
+        if (job->is_multipath) {
+            job->result = picoquic_aead_decrypt_mp(job->output, job->input, job->input_length,
+                job->path_id, job->sequence_number, job->aad, job->aad_length, job->aead_context);
+        }
+        else {
+            job->result = picoquic_aead_decrypt_generic(job->output, job->input, job->input_length,
+                job->sequence_number, job->aad, job->aad_length, job->aead_context);
+        }
+    }
+}
+
+#ifndef _WINDOWS
+#define PICOQUIC_CRYPTO_WORKER_SPIN 20000
+#define PICOQUIC_CRYPTO_WORKER_SLEEP 1000
+#define PICOQUIC_CRYPTO_WAKE_INTERVAL 1024
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PICOQUIC_CPU_RELAX() __builtin_ia32_pause()
+#else
+#define PICOQUIC_CPU_RELAX() do {} while (0)
+#endif
+
+typedef struct st_picoquic_crypto_worker_t {
+    struct st_picoquic_crypto_pool_t* pool;
+    picoquic_thread_t thread;
+    picoquic_event_t event;
+    int is_thread_started;
+    int is_sleeping;
+    /* Ring positions. The tail is only written by the protocol thread,
+     * the head only by the worker. */
+    uint64_t tail;
+    uint64_t head;
+    picoquic_crypto_job_t* ring[PICOQUIC_CRYPTO_RING_SIZE];
+} picoquic_crypto_worker_t;
+
+struct st_picoquic_crypto_pool_t {
+    int nb_workers;
+    int should_stop;
+    picoquic_crypto_job_fn job_fn;
+    uint64_t nb_jobs_posted;
+    uint64_t nb_jobs_local;
+    picoquic_crypto_worker_t* workers;
+};
+
+static picoquic_thread_return_t picoquic_crypto_worker_thread(void* arg)
+{
+    picoquic_crypto_worker_t* worker = (picoquic_crypto_worker_t*)arg;
+    picoquic_crypto_pool_t* pool = worker->pool;
+    int nb_idle = 0;
+
+    while (!__atomic_load_n(&pool->should_stop, __ATOMIC_ACQUIRE)) {
+        uint64_t head = worker->head;
+
+        if (head != __atomic_load_n(&worker->tail, __ATOMIC_ACQUIRE)) {
+            picoquic_crypto_job_t* job = worker->ring[head % PICOQUIC_CRYPTO_RING_SIZE];
+
+            pool->job_fn(job);
+            __atomic_store_n(&job->is_done, 1, __ATOMIC_RELEASE);
+            __atomic_store_n(&worker->head, head + 1, __ATOMIC_RELEASE);
+            nb_idle = 0;
+        }
+        else if (nb_idle < PICOQUIC_CRYPTO_WORKER_SPIN) {
+            nb_idle++;
+            PICOQUIC_CPU_RELAX();
+        }
+        else {
+            __atomic_store_n(&worker->is_sleeping, 1, __ATOMIC_SEQ_CST);
+            if (__atomic_load_n(&worker->tail, __ATOMIC_SEQ_CST) == head &&
+                !__atomic_load_n(&pool->should_stop, __ATOMIC_SEQ_CST)) {
+                (void)picoquic_wait_for_event(&worker->event, PICOQUIC_CRYPTO_WORKER_SLEEP);
+            }
+            __atomic_store_n(&worker->is_sleeping, 0, __ATOMIC_SEQ_CST);
+            nb_idle = 0;
+        }
+    }
+
+    picoquic_thread_do_return;
+}
+
+picoquic_crypto_pool_t* picoquic_crypto_pool_create(int nb_workers, picoquic_crypto_job_fn job_fn)
+{
+    picoquic_crypto_pool_t* pool = NULL;
+
+    if (nb_workers > 0 && nb_workers <= PICOQUIC_CRYPTO_WORKERS_MAX &&
+        (pool = (picoquic_crypto_pool_t*)malloc(sizeof(picoquic_crypto_pool_t))) != NULL) {
+        memset(pool, 0, sizeof(picoquic_crypto_pool_t));
+        pool->job_fn = (job_fn == NULL) ? picoquic_crypto_job_run : job_fn;
+        pool->workers = (picoquic_crypto_worker_t*)malloc(sizeof(picoquic_crypto_worker_t) * (size_t)nb_workers);
+
+        if (pool->workers == NULL) {
+            free(pool);
+            pool = NULL;
+        }
+        else {
+            int ret = 0;
+
+            memset(pool->workers, 0, sizeof(picoquic_crypto_worker_t) * (size_t)nb_workers);
+            while (ret == 0 && pool->nb_workers < nb_workers) {
+                picoquic_crypto_worker_t* worker = &pool->workers[pool->nb_workers];
+
+                worker->pool = pool;
+                if ((ret = picoquic_create_event(&worker->event)) == 0) {
+                    if ((ret = picoquic_create_thread(&worker->thread, picoquic_crypto_worker_thread, worker)) == 0) {
+                        worker->is_thread_started = 1;
+                        pool->nb_workers++;
+                    }
+                    else {
+                        picoquic_delete_event(&worker->event);
+                    }
+                }
+            }
+            if (ret != 0) {
+                picoquic_crypto_pool_delete(pool);
+                pool = NULL;
+            }
+        }
+    }
+
+    return pool;
+}
+
+void picoquic_crypto_pool_delete(picoquic_crypto_pool_t* pool)
+{
+    __atomic_store_n(&pool->should_stop, 1, __ATOMIC_SEQ_CST);
+    for (int i = 0; i < pool->nb_workers; i++) {
+        picoquic_crypto_worker_t* worker = &pool->workers[i];
+
+        if (worker->is_thread_started) {
+            (void)picoquic_signal_event(&worker->event);
+            picoquic_delete_thread(&worker->thread);
+            worker->is_thread_started = 0;
+        }
+        picoquic_delete_event(&worker->event);
+    }
+    free(pool->workers);
+    free(pool);
+}
+
+int picoquic_crypto_pool_nb_workers(picoquic_crypto_pool_t* pool)
+{
+    return pool->nb_workers;
+}
+
+void picoquic_crypto_pool_get_stats(picoquic_crypto_pool_t* pool, uint64_t* nb_jobs_posted, uint64_t* nb_jobs_local)
+{
+    *nb_jobs_posted = pool->nb_jobs_posted;
+    *nb_jobs_local = pool->nb_jobs_local;
+}
+
+static int picoquic_crypto_pool_post(picoquic_crypto_worker_t* worker, picoquic_crypto_job_t* job)
+{
+    uint64_t tail = worker->tail;
+
+    if (tail - __atomic_load_n(&worker->head, __ATOMIC_ACQUIRE) >= PICOQUIC_CRYPTO_RING_SIZE) {
+        return -1;
+    }
+    worker->ring[tail % PICOQUIC_CRYPTO_RING_SIZE] = job;
+    __atomic_store_n(&worker->tail, tail + 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&worker->is_sleeping, __ATOMIC_SEQ_CST)) {
+        (void)picoquic_signal_event(&worker->event);
+    }
+
+    return 0;
+}
+
+void picoquic_crypto_pool_dispatch(picoquic_crypto_pool_t* pool, picoquic_crypto_job_t** jobs, size_t nb_jobs,
+    void* aead_context, picoquic_aead_clones_t* clones)
+{
+    int nb_shares = 1;
+    size_t nb_local = 0;
+
+    if (clones != NULL) {
+        nb_shares += (clones->nb_clones < pool->nb_workers) ? clones->nb_clones : pool->nb_workers;
+    }
+
+    /* Post the jobs of the workers first, so they start while the
+     * protocol thread processes its own share. */
+    for (size_t i = 0; i < nb_jobs; i++) {
+        int share = (int)(i % (size_t)nb_shares);
+
+        jobs[i]->is_done = 0;
+        jobs[i]->worker_id = -1;
+        if (share > 0) {
+            jobs[i]->aead_context = clones->aead[share - 1];
+            if (picoquic_crypto_pool_post(&pool->workers[share - 1], jobs[i]) == 0) {
+                jobs[i]->worker_id = share - 1;
+                pool->nb_jobs_posted++;
+            }
+        }
+        if (jobs[i]->worker_id < 0) {
+            jobs[i]->aead_context = aead_context;
+            jobs[nb_local++] = jobs[i];
+        }
+    }
+    for (size_t i = 0; i < nb_local; i++) {
+        pool->job_fn(jobs[i]);
+        jobs[i]->is_done = 1;
+    }
+    pool->nb_jobs_local += nb_local;
+}
+
+void picoquic_crypto_pool_wait(picoquic_crypto_pool_t* pool, picoquic_crypto_job_t* job)
+{
+    int nb_spins = 0;
+
+    while (!__atomic_load_n(&job->is_done, __ATOMIC_ACQUIRE)) {
+        picoquic_crypto_worker_t* worker = &pool->workers[job->worker_id];
+
+        if (++nb_spins % PICOQUIC_CRYPTO_WAKE_INTERVAL == 0 && __atomic_load_n(&worker->is_sleeping, __ATOMIC_SEQ_CST)) {
+            (void)picoquic_signal_event(&worker->event);
+        }
+        PICOQUIC_CPU_RELAX();
+    }
+}
+
+void picoquic_crypto_pool_drain(picoquic_crypto_pool_t* pool)
+{
+    for (int i = 0; i < pool->nb_workers; i++) {
+        picoquic_crypto_worker_t* worker = &pool->workers[i];
+        int nb_spins = 0;
+
+        while (__atomic_load_n(&worker->head, __ATOMIC_ACQUIRE) != worker->tail) {
+            if (++nb_spins % PICOQUIC_CRYPTO_WAKE_INTERVAL == 0 && __atomic_load_n(&worker->is_sleeping, __ATOMIC_SEQ_CST)) {
+                (void)picoquic_signal_event(&worker->event);
+            }
+            PICOQUIC_CPU_RELAX();
+        }
+    }
+}
+#else
+/* The pool relies on the GCC atomic builtins. */
+picoquic_crypto_pool_t* picoquic_crypto_pool_create(int nb_workers, picoquic_crypto_job_fn job_fn)
+{
+    UNREFERENCED_PARAMETER(nb_workers);
+    UNREFERENCED_PARAMETER(job_fn);
+    return NULL;
+}
+
+void picoquic_crypto_pool_delete(picoquic_crypto_pool_t* pool)
+{
+    UNREFERENCED_PARAMETER(pool);
+}
+
+int picoquic_crypto_pool_nb_workers(picoquic_crypto_pool_t* pool)
+{
+    UNREFERENCED_PARAMETER(pool);
+    return 0;
+}
+
+void picoquic_crypto_pool_get_stats(picoquic_crypto_pool_t* pool, uint64_t* nb_jobs_posted, uint64_t* nb_jobs_local)
+{
+    UNREFERENCED_PARAMETER(pool);
+    *nb_jobs_posted = 0;
+    *nb_jobs_local = 0;
+}
+
+void picoquic_crypto_pool_dispatch(picoquic_crypto_pool_t* pool, picoquic_crypto_job_t** jobs, size_t nb_jobs,
+    void* aead_context, picoquic_aead_clones_t* clones)
+{
+    UNREFERENCED_PARAMETER(pool);
+    UNREFERENCED_PARAMETER(clones);
+    for (size_t i = 0; i < nb_jobs; i++) {
+        jobs[i]->aead_context = aead_context;
+        jobs[i]->worker_id = -1;
+        picoquic_crypto_job_run(jobs[i]);
+        jobs[i]->is_done = 1;
+    }
+}
+
+void picoquic_crypto_pool_wait(picoquic_crypto_pool_t* pool, picoquic_crypto_job_t* job)
+{
+    UNREFERENCED_PARAMETER(pool);
+    UNREFERENCED_PARAMETER(job);
+}
+
+void picoquic_crypto_pool_drain(picoquic_crypto_pool_t* pool)
+{
+    UNREFERENCED_PARAMETER(pool);
+}
+#endif
+
+int picoquic_set_crypto_workers(picoquic_quic_t* quic, int nb_workers)
+{
+    int ret = 0;
+
+    if (nb_workers < 0 || nb_workers > PICOQUIC_CRYPTO_WORKERS_MAX) {
+        ret = -1;
+    }
+    else {
+        if (quic->crypto_pool != NULL) {
+            picoquic_crypto_pool_delete(quic->crypto_pool);
+            quic->crypto_pool = NULL;
+            quic->hp_batch.crypto_pool = NULL;
+        }
+        if (quic->decrypt_batch != NULL) {
+            free(quic->decrypt_batch->buffers);
+            free(quic->decrypt_batch);
+            quic->decrypt_batch = NULL;
+        }
+        if (nb_workers > 0) {
+            quic->crypto_pool = picoquic_crypto_pool_create(nb_workers, NULL);
+            if (quic->crypto_pool == NULL ||
+                (quic->decrypt_batch = (picoquic_decrypt_batch_t*)malloc(sizeof(picoquic_decrypt_batch_t))) == NULL) {
+                ret = -1;
+            }
+            else {
+                memset(quic->decrypt_batch, 0, sizeof(picoquic_decrypt_batch_t));
+                quic->decrypt_batch->buffers = (uint8_t*)malloc((size_t)PICOQUIC_HP_BATCH_MAX * PICOQUIC_MAX_PACKET_SIZE);
+                if (quic->decrypt_batch->buffers == NULL) {
+                    ret = -1;
+                }
+            }
+            if (ret == 0) {
+                quic->hp_batch.crypto_pool = quic->crypto_pool;
+            }
+            else {
+                (void)picoquic_set_crypto_workers(quic, 0);
+            }
+        }
+    }
+
+    return ret;
+}
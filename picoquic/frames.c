@@ -170,6 +170,7 @@ void picoquic_update_stream_initial_remote(picoquic_cnx_t* cnx)
                 stream->maxdata_remote = cnx->remote_parameters.initial_max_stream_data_bidi_local;
             }
         }
+        picoquic_update_ready_stream(cnx, stream);
         stream = picoquic_next_stream(stream);
     };
 }
@@ -210,6 +211,10 @@ int picoquic_flow_control_check_stream_offset(picoquic_cnx_t* cnx, picoquic_stre
         } else {
             cnx->data_received += new_bytes;
             stream->fin_offset = new_fin_offset;
+            if (stream->direct_receive_fn != NULL) {
+                /* Data passed to the direct receive function is not held by the stack */
+                picoquic_rwnd_consume(cnx, stream, new_fin_offset);
+            }
         }
     }
 
@@ -240,15 +245,7 @@ uint8_t * picoquic_format_stream_reset_frame(picoquic_cnx_t* cnx, picoquic_strea
             picoquic_update_max_stream_ID_local(cnx, stream);
 
             /* Free the queued data */
-            while (stream->send_queue != NULL) {
-                picoquic_stream_queue_node_t* next = stream->send_queue->next_stream_data;
-
-                if (stream->send_queue->bytes != NULL) {
-                    free(stream->send_queue->bytes);
-                }
-                free(stream->send_queue);
-                stream->send_queue = next;
-            }
+            picoquic_stream_queue_free(stream);
             (void)picoquic_delete_stream_if_closed(cnx, stream);
         }
         else {
@@ -297,6 +294,8 @@ const uint8_t* picoquic_decode_stream_reset_frame(picoquic_cnx_t* cnx, const uin
     } else if (!stream->reset_received) {
         stream->reset_received = 1;
         stream->remote_error  = error_code_64;
+        /* Data not yet consumed will never be delivered */
+        picoquic_rwnd_consume(cnx, stream, stream->fin_offset);
 
         picoquic_update_max_stream_ID_local(cnx, stream);
 
@@ -983,6 +982,14 @@ int picoquic_is_stream_frame_unlimited(const uint8_t* bytes)
     return PICOQUIC_BITS_CLEAR_IN_RANGE(bytes[0], picoquic_frame_type_stream_range_min, picoquic_frame_type_stream_range_max, 0x02);
 }
 
+/* Fast path for the STREAM and ACK frames, which are the bulk of the frames
+ * received during data transfers. When enough bytes remain in the packet,
+ * each field of the frame header is loaded as a 64 bit word and decoded
+ * with PICOPARSE_VARINT_8, without checking the bounds field by field.
+ */
+#define PICOQUIC_STREAM_HEADER_FAST_MIN (1 + 3 * PICOPARSE_VARINT_MIN)
+#define PICOQUIC_ACK_HEADER_FAST_MIN (4 * PICOPARSE_VARINT_MIN)
+
 int picoquic_parse_stream_header(const uint8_t* bytes, size_t bytes_max,
     uint64_t* stream_id, uint64_t* offset, size_t* data_length, int* fin,
     size_t* consumed)
@@ -998,6 +1005,36 @@ int picoquic_parse_stream_header(const uint8_t* bytes, size_t bytes_max,
 
     *fin = bytes[0] & 1;
 
+    if (bytes_max >= PICOQUIC_STREAM_HEADER_FAST_MIN) {
+        const uint8_t* field = bytes + 1;
+
+        *stream_id = PICOPARSE_VARINT_8(field);
+        field += VARINT_LEN_T(field, size_t);
+        if (off == 0) {
+            *offset = 0;
+        }
+        else {
+            *offset = PICOPARSE_VARINT_8(field);
+            field += VARINT_LEN_T(field, size_t);
+        }
+        byte_index = field - bytes;
+        if (len == 0) {
+            *data_length = bytes_max - byte_index;
+        }
+        else {
+            length = PICOPARSE_VARINT_8(field);
+            byte_index += VARINT_LEN_T(field, size_t);
+            *data_length = (size_t)length;
+            if (byte_index + length > bytes_max) {
+                DBG_PRINTF("stream data past the end of the packet: first_byte=0x%02x, data_length=%" PRIst ", max_bytes=%" PRIst,
+                    bytes[0], *data_length, bytes_max);
+                ret = -1;
+            }
+        }
+        *consumed = byte_index;
+        return ret;
+    }
+
     if (bytes_max > byte_index) {
         l_stream = picoquic_varint_decode(bytes + byte_index, bytes_max - byte_index, stream_id);
         byte_index += l_stream;
@@ -1048,6 +1085,7 @@ static void picoquic_stream_data_chunk_callback(picoquic_cnx_t* cnx, picoquic_st
     int call_back_needed = data_length > 0;
 
     stream->consumed_offset += data_length;
+    picoquic_rwnd_consume(cnx, stream, stream->consumed_offset);
 
     if (stream->consumed_offset >= stream->fin_offset && stream->fin_received && !stream->fin_signalled) {
         fin_now = picoquic_callback_stream_fin;
@@ -1066,15 +1104,40 @@ static void picoquic_stream_data_chunk_callback(picoquic_cnx_t* cnx, picoquic_st
 
 void picoquic_stream_data_callback(picoquic_cnx_t* cnx, picoquic_stream_head_t* stream)
 {
+    picoquic_sack_item_t* range;
     picoquic_stream_data_node_t* data;
+    int is_delivering = 1;
+
+    /* Deliver the first range of the reassembly ring if it starts at or before
+     * the consumed offset. Ranges are merged on arrival, so filling a gap
+     * delivers all the data received after it in one or two callbacks.
+     * Sparse segments that the ring did not accept are in the data tree. */
+    while (is_delivering) {
+        if (stream->reassembly_ring != NULL &&
+            (range = picoquic_sack_first_item(&stream->reassembly_ring->ranges)) != NULL &&
+            range->start_of_sack_range <= stream->consumed_offset) {
+            uint64_t end_offset = range->end_of_sack_range + 1;
+
+            picoquic_sack_delete_item(&stream->reassembly_ring->ranges, range);
+            while (stream->reassembly_ring != NULL && stream->consumed_offset < end_offset) {
+                size_t data_length = (size_t)(end_offset - stream->consumed_offset);
+                const uint8_t* bytes = picoquic_stream_ring_read(stream->reassembly_ring, stream->consumed_offset, &data_length);
 
-    while ((data = (picoquic_stream_data_node_t*)picosplay_first(&stream->stream_data_tree)) != NULL && data->offset <= stream->consumed_offset) {
-        size_t start = (size_t)(stream->consumed_offset - data->offset);
-        if (data->length >= start) {
-            size_t data_length = data->length - start;
-            picoquic_stream_data_chunk_callback(cnx, stream, data->bytes + start, data_length);
+                /* Ugly cast, but the callback requires a non-const pointer */
+                picoquic_stream_data_chunk_callback(cnx, stream, (uint8_t*)bytes, data_length);
+            }
+        }
+        else if ((data = (picoquic_stream_data_node_t*)picosplay_first(&stream->stream_data_tree)) != NULL &&
+            data->offset <= stream->consumed_offset) {
+            size_t start = (size_t)(stream->consumed_offset - data->offset);
+            if (data->length > start) {
+                picoquic_stream_data_chunk_callback(cnx, stream, data->bytes + start, data->length - start);
+            }
+            picosplay_delete_hint(&stream->stream_data_tree, &data->stream_data_node);
+        }
+        else {
+            is_delivering = 0;
         }
-        picosplay_delete_hint(&stream->stream_data_tree, &data->stream_data_node);
     }
 
     /* handle the case where the fin frame does not carry any data */
@@ -1180,9 +1243,64 @@ int picoquic_queue_network_input(picoquic_quic_t * quic, picosplay_tree_t* tree,
     return ret;
 }
 
+/* Copy out of order data of application streams in the reassembly ring,
+ * or in the data tree if the ring does not accept it */
+static int picoquic_stream_ring_input(picoquic_quic_t* quic, picoquic_stream_head_t* stream, uint64_t offset,
+    const uint8_t* bytes, size_t length, int* new_data_available, uint64_t current_time)
+{
+    int ret = 0;
+    uint64_t end_offset = offset + length;
+
+    /* Remove data that is already consumed */
+    if (offset < stream->consumed_offset) {
+        bytes += stream->consumed_offset - offset;
+        offset = stream->consumed_offset;
+    }
+
+    if (offset >= end_offset) {
+        /* Nothing left to store */
+    }
+    else if (!picoquic_stream_ring_accepts(stream, end_offset, (size_t)(end_offset - offset))) {
+        ret = picoquic_queue_network_input(quic, &stream->stream_data_tree, stream->consumed_offset,
+            offset, bytes, (size_t)(end_offset - offset), 0, NULL, new_data_available);
+    }
+    else if ((ret = picoquic_stream_ring_reserve(stream, end_offset)) == 0) {
+        picoquic_sack_list_t* ranges = &stream->reassembly_ring->ranges;
+        picoquic_sack_item_t* range = picoquic_sack_find_range_below_number(ranges, NULL, offset);
+        uint64_t gap_start = offset;
+
+        if (range == NULL) {
+            range = picoquic_sack_first_item(ranges);
+        }
+        /* Only copy the bytes that were not already received */
+        while (gap_start < end_offset) {
+            if (range != NULL && range->end_of_sack_range < gap_start) {
+                range = picoquic_sack_next_item(range);
+            }
+            else if (range != NULL && range->start_of_sack_range <= gap_start) {
+                gap_start = range->end_of_sack_range + 1;
+                range = picoquic_sack_next_item(range);
+            }
+            else {
+                uint64_t gap_end = (range != NULL && range->start_of_sack_range < end_offset) ?
+                    range->start_of_sack_range : end_offset;
+
+                picoquic_stream_ring_write(stream->reassembly_ring, gap_start, bytes + (gap_start - offset),
+                    (size_t)(gap_end - gap_start));
+                gap_start = gap_end;
+            }
+        }
+        if (picoquic_update_sack_list(ranges, offset, end_offset - 1, current_time) == 0) {
+            *new_data_available = 1;
+        }
+    }
+
+    return ret;
+}
+
 static int picoquic_stream_network_input(picoquic_cnx_t* cnx, uint64_t stream_id,
     uint64_t offset, int fin, const uint8_t* bytes, size_t length,
-    picoquic_stream_data_node_t* received_data, int is_last_frame, uint64_t current_time)
+    picoquic_stream_data_node_t* received_data, uint64_t current_time)
 {
     int ret = 0;
     uint64_t should_notify = 0;
@@ -1216,13 +1334,24 @@ static int picoquic_stream_network_input(picoquic_cnx_t* cnx, uint64_t stream_id
         }
     }
 
-    /* If the application provided a direct receive callback, it wil receive the data as they
-     * arrive. If not, the data segments are organized in a splay and passed to the
-     * application in strict order.
+    /* If the application asked for zero copy receive, the data is kept in views of
+     * the received packets. If the application provided a direct receive callback, it wil
+     * receive the data as they arrive. If not, the data segments are organized in a splay
+     * and passed to the application in strict order.
      */
 
     if (ret == 0) {
-        if (stream->direct_receive_fn != NULL) {
+        if (stream->zero_copy_fn != NULL) {
+            ret = picoquic_stream_views_input(cnx, stream, offset, fin, bytes, length, received_data);
+            if (ret != 0) {
+                uint64_t err = (ret >= PICOQUIC_ERROR_CLASS) ? PICOQUIC_TRANSPORT_INTERNAL_ERROR : (uint64_t)ret;
+                ret = picoquic_connection_error(cnx, err, 0);
+            }
+            else {
+                cnx->latest_receive_time = current_time;
+            }
+        }
+        else if (stream->direct_receive_fn != NULL) {
             ret = stream->direct_receive_fn(cnx, stream_id, fin, bytes, offset, length, stream->direct_receive_ctx);
             if (ret == PICOQUIC_STREAM_RECEIVE_COMPLETE && stream->fin_received) {
                 stream->fin_signalled = 1;
@@ -1249,8 +1378,7 @@ static int picoquic_stream_network_input(picoquic_cnx_t* cnx, uint64_t stream_id
         } else {
             int new_data_available = 0;
 
-            ret = picoquic_queue_network_input(cnx->quic, &stream->stream_data_tree, stream->consumed_offset,
-                offset, bytes, length, is_last_frame, received_data, &new_data_available);
+            ret = picoquic_stream_ring_input(cnx->quic, stream, offset, bytes, length, &new_data_available, current_time);
             if (ret != 0) {
                 ret = picoquic_connection_error(cnx, (int64_t)ret, 0);
             }
@@ -1278,7 +1406,7 @@ static int picoquic_stream_network_input(picoquic_cnx_t* cnx, uint64_t stream_id
 
         if (!is_deleted) {
             if (!stream->fin_signalled) {
-                if (!stream->fin_received && !stream->reset_received && 2 * stream->consumed_offset > stream->maxdata_local) {
+                if (!stream->fin_received && !stream->reset_received && picoquic_is_max_stream_data_needed(cnx, stream)) {
                     cnx->max_stream_data_needed = 1;
                 }
             }
@@ -1308,6 +1436,7 @@ const uint8_t* picoquic_decode_stream_frame(picoquic_cnx_t* cnx, const uint8_t*
     uint64_t offset;
     int      fin;
     size_t   consumed;
+
     if (picoquic_parse_stream_header(bytes, bytes_max - bytes, &stream_id, &offset, &data_length, &fin, &consumed) != 0) {
         bytes = NULL;
     }else if (offset + data_length >= (1ull<<62)){
@@ -1316,14 +1445,12 @@ const uint8_t* picoquic_decode_stream_frame(picoquic_cnx_t* cnx, const uint8_t*
     }
     else {
         /* Skip the header bytes, and try to deliver the content of the frame.
-        * The "is last" indication is set when we are certain that no other data
-        * follows. It is used to manage the queue of stream chunks awaiting delivery.
+         * Out of order data is copied in the reassembly ring of the stream,
+         * so the received packet is only retained by zero copy receive streams.
          */
         bytes += consumed;
         if (picoquic_stream_network_input(cnx, stream_id, offset,
-            fin, bytes, data_length, received_data,
-            picoquic_is_last_stream_frame(bytes + data_length, bytes_max),
-            current_time) != 0) {
+            fin, bytes, data_length, received_data, current_time) != 0) {
             bytes = NULL;
         }
         else {
@@ -1336,73 +1463,57 @@ const uint8_t* picoquic_decode_stream_frame(picoquic_cnx_t* cnx, const uint8_t*
 
 picoquic_stream_head_t* picoquic_find_ready_stream_path(picoquic_cnx_t* cnx, picoquic_path_t * path_x)
 {
-    picoquic_stream_head_t* first_stream = cnx->first_output_stream;
-    picoquic_stream_head_t* stream = first_stream;
+    picoquic_stream_bucket_t* bucket = cnx->first_stream_bucket;
     picoquic_stream_head_t* found_stream = NULL;
+    int is_flow_blocked = (cnx->maxdata_remote <= cnx->data_sent);
 
+    /* Look for a ready stream, in priority order. The head of the ready queue
+     * is the next stream to serve, in FIFO or round robin order. Streams that
+     * cannot send are removed from the queue, until the next update. */
+    while (bucket != NULL && found_stream == NULL) {
+        picoquic_stream_head_t* stream = bucket->first_ready_stream;
 
-    /* Look for a ready stream */
-    while (stream != NULL) {
-        int has_data = 0;
-        picoquic_stream_head_t* next_stream = stream->next_output_stream;
+        while (stream != NULL) {
+            picoquic_stream_head_t* next_stream = stream->next_ready_stream;
 
-        if (found_stream != NULL && stream->stream_priority > found_stream->stream_priority) {
-            /* All the streams at that priority level have been examined,
-             * the current selection is validated */
-            break;
-        }
-        has_data = (cnx->maxdata_remote > cnx->data_sent && stream->sent_offset < stream->maxdata_remote && (stream->is_active ||
-                (stream->send_queue != NULL && stream->send_queue->length > stream->send_queue->offset) ||
-                (stream->fin_requested && !stream->fin_sent)));
-        if (has_data && path_x != NULL && stream->affinity_path != path_x && stream->affinity_path != NULL) {
-            /* Only consider the streams that meet path affinity requirements */
-            has_data = 0;
-        }
-        if ((stream->reset_requested && !stream->reset_sent) ||
-            (stream->stop_sending_requested && !stream->stop_sending_sent)) {
-            /* urgent action is needed, this takes precedence over FIFO vs round-robin processing */
-            found_stream = stream;
-            break;
-        } else if (has_data) {
-            /* Check that this stream is actually available for sending data */
-            if (stream->sent_offset == 0) {
-                if (IS_CLIENT_STREAM_ID(stream->stream_id) == cnx->client_mode) {
-                    if (stream->stream_id > ((IS_BIDIR_STREAM_ID(stream->stream_id)) ? cnx->max_stream_id_bidir_remote : cnx->max_stream_id_unidir_remote)) {
-                        has_data = 0;
-                    }
-                }
-            }
-            if (has_data) {
-                /* Something can be sent */
-                if ((stream->stream_priority & 1) != 0) {
-                    /* This priority level requests FIFO processing, so we return the first available stream */
-                    found_stream = stream;
-                    break;
-                }
-                else if (found_stream == NULL || stream->last_time_data_sent < found_stream->last_time_data_sent) {
-                    /* Select this stream, but need to check if another stream should go before in round robin order */
-                    found_stream = stream;
-                }
+            if (picoquic_is_stream_urgent(stream)) {
+                /* urgent action is needed, this takes precedence over FIFO vs round-robin processing */
+                found_stream = stream;
+                break;
             }
-        }
-        else if (((stream->fin_requested && stream->fin_sent) || (stream->reset_requested && stream->reset_sent)) && (!stream->stop_sending_requested || stream->stop_sending_sent)) {
-            /* If stream is exhausted, remove from output list */
-            picoquic_remove_output_stream(cnx, stream);
+            else if (!picoquic_stream_has_data_to_send(stream)) {
+                picoquic_remove_ready_stream(cnx, stream);
+                if (((stream->fin_requested && stream->fin_sent) || (stream->reset_requested && stream->reset_sent)) &&
+                    (!stream->stop_sending_requested || stream->stop_sending_sent)) {
+                    /* If stream is exhausted, remove from output list */
+                    picoquic_remove_output_stream(cnx, stream);
 
-            picoquic_delete_stream_if_closed(cnx, stream);
-        }
-        else {
-            if (stream->is_active ||
-                (stream->send_queue != NULL && stream->send_queue->length > stream->send_queue->offset)) {
-                if (stream->sent_offset >= stream->maxdata_remote) {
-                    cnx->stream_blocked = 1;
-                }
-                else if (cnx->maxdata_remote <= cnx->data_sent) {
-                    cnx->flow_blocked = 1;
+                    picoquic_delete_stream_if_closed(cnx, stream);
                 }
             }
+            else if (is_flow_blocked) {
+                /* Urgent streams are queued first, so no other stream in this bucket can send */
+                cnx->flow_blocked = 1;
+                break;
+            }
+            else if (stream->sent_offset >= stream->maxdata_remote) {
+                /* Wait until the peer sends MAX_STREAM_DATA */
+                cnx->stream_blocked = 1;
+                picoquic_remove_ready_stream(cnx, stream);
+            }
+            else if (stream->sent_offset == 0 && IS_CLIENT_STREAM_ID(stream->stream_id) == cnx->client_mode &&
+                stream->stream_id > ((IS_BIDIR_STREAM_ID(stream->stream_id)) ? cnx->max_stream_id_bidir_remote : cnx->max_stream_id_unidir_remote)) {
+                /* Wait until the peer sends MAX_STREAMS */
+                picoquic_remove_ready_stream(cnx, stream);
+            }
+            else if (path_x == NULL || stream->affinity_path == path_x || stream->affinity_path == NULL) {
+                /* Only consider the streams that meet path affinity requirements */
+                found_stream = stream;
+                break;
+            }
+            stream = next_stream;
         }
-        stream = next_stream;
+        bucket = bucket->next_bucket;
     }
 
     return found_stream;
@@ -1706,6 +1817,7 @@ uint8_t * picoquic_format_stream_frame(picoquic_cnx_t* cnx, picoquic_stream_head
                     stream->sent_offset += stream_data_context.length;
                     stream->last_time_data_sent = picoquic_get_quic_time(cnx->quic);
                     cnx->data_sent += stream_data_context.length;
+                    picoquic_requeue_ready_stream(cnx, stream);
 
                     if (stream_data_context.length > 0) {
                         if (stream_data_context.app_buffer == NULL ||
@@ -1765,15 +1877,13 @@ uint8_t * picoquic_format_stream_frame(picoquic_cnx_t* cnx, picoquic_stream_head
 
                     stream->send_queue->offset += length;
                     if (stream->send_queue->offset >= stream->send_queue->length) {
-                        picoquic_stream_queue_node_t* next = stream->send_queue->next_stream_data;
-                        free(stream->send_queue->bytes);
-                        free(stream->send_queue);
-                        stream->send_queue = next;
+                        picoquic_stream_queue_pop(stream);
                     }
 
                     stream->sent_offset += length;
                     stream->last_time_data_sent = picoquic_get_quic_time(cnx->quic);
                     cnx->data_sent += length;
+                    picoquic_requeue_ready_stream(cnx, stream);
                 }
 
                 bytes = bytes0 + byte_index;
@@ -2412,10 +2522,7 @@ uint8_t* picoquic_format_crypto_hs_frame(picoquic_stream_head_t* stream, uint8_t
 
                     stream->send_queue->offset += length;
                     if (stream->send_queue->offset >= stream->send_queue->length) {
-                        picoquic_stream_queue_node_t* next = stream->send_queue->next_stream_data;
-                        free(stream->send_queue->bytes);
-                        free(stream->send_queue);
-                        stream->send_queue = next;
+                        picoquic_stream_queue_pop(stream);
                     }
 
                     stream->sent_offset += length;
@@ -2448,6 +2555,23 @@ int picoquic_parse_ack_header(uint8_t const* bytes, size_t bytes_max,
     size_t l_blocks = 0;
     size_t l_path_id = 0;
 
+    if (bytes_max >= byte_index + PICOQUIC_ACK_HEADER_FAST_MIN) {
+        const uint8_t* field = bytes + byte_index;
+
+        if (path_id != NULL) {
+            *path_id = PICOPARSE_VARINT_8(field);
+            field += VARINT_LEN_T(field, size_t);
+        }
+        *largest = PICOPARSE_VARINT_8(field);
+        field += VARINT_LEN_T(field, size_t);
+        *ack_delay = PICOPARSE_VARINT_8(field) << ack_delay_exponent;
+        field += VARINT_LEN_T(field, size_t);
+        *num_block = PICOPARSE_VARINT_8(field);
+        field += VARINT_LEN_T(field, size_t);
+        *consumed = field - bytes;
+        return ret;
+    }
+
     if (path_id != NULL && bytes_max > byte_index) {
         l_path_id = picoquic_varint_decode(bytes + byte_index, bytes_max - byte_index, path_id);
         byte_index += l_path_id;
@@ -2956,6 +3080,10 @@ void process_decoded_packet_data(picoquic_cnx_t* cnx, picoquic_path_t * path_x,
     }
 }
 
+/* Find the first pending packet whose sequence number is at least "largest",
+ * or the last pending packet if there is none. The ack ranges are then
+ * processed by walking the pending list backwards from that packet.
+ */
 static picoquic_packet_t* picoquic_find_acked_packet(picoquic_cnx_t* cnx, picoquic_packet_context_t* pkt_ctx,
     uint64_t largest, uint64_t current_time, int* is_new_ack)
 {
@@ -2968,9 +3096,24 @@ static picoquic_packet_t* picoquic_find_acked_packet(picoquic_cnx_t* cnx, picoqu
         pkt_ctx->highest_acknowledged_time = current_time;
         pkt_ctx->ack_of_ack_requested = 0;
         *is_new_ack = 1;
+    }
+
+    if (packet != NULL && packet->sequence_number < largest) {
+        if (pkt_ctx->pending_last->sequence_number <= largest) {
+            packet = pkt_ctx->pending_last;
+        }
+        else if (pkt_ctx->sent_ring != NULL) {
+            /* The last pending packet is past "largest", so the search ends */
+            uint64_t sequence_number = largest;
 
-        while (packet != NULL && packet->packet_next != NULL && packet->sequence_number < largest) {
-            packet = packet->packet_next;
+            while ((packet = picoquic_sent_ring_find(pkt_ctx, sequence_number)) == NULL) {
+                sequence_number++;
+            }
+        }
+        else {
+            while (packet->packet_next != NULL && packet->sequence_number < largest) {
+                packet = packet->packet_next;
+            }
         }
     }
 
@@ -3171,7 +3314,8 @@ int picoquic_check_frame_needs_repeat(picoquic_cnx_t* cnx, const uint8_t* bytes,
                     *no_need_to_repeat = picoquic_check_sack_list(&stream->sack_list, offset, offset + data_length - ((fin) ? 0 : 1));
                 }
 
-                if (is_preemptive_needed != NULL && stream->fin_sent) {
+                if (is_preemptive_needed != NULL &&
+                    (stream->fin_sent || picoquic_is_stream_redundant(cnx, stream))) {
                     *is_preemptive_needed |= 1;
                 }
             }
@@ -3416,6 +3560,7 @@ int picoquic_process_ack_of_stream_frame(picoquic_cnx_t* cnx, uint8_t* bytes,
             (void)picoquic_update_sack_list(&stream->sack_list,
                 offset, offset + data_length - ((fin) ? 0 : 1), 0);
 
+            picoquic_stream_release_acked(stream);
             picoquic_delete_stream_if_closed(cnx, stream);
         }
     }
@@ -3577,6 +3722,15 @@ static int picoquic_process_ack_range(
     while (p != NULL && range > 0) {
         if (p->sequence_number > highest) {
             p = p->packet_previous;
+        } else if (p->sequence_number < highest) {
+            /* Skip the acknowledged numbers that are not pending */
+            uint64_t skipped = highest - p->sequence_number;
+
+            if (skipped > range) {
+                skipped = range;
+            }
+            range -= skipped;
+            highest -= skipped;
         } else {
             if (p->sequence_number == highest) {
                 picoquic_packet_t* next = p->packet_previous;
@@ -4160,6 +4314,151 @@ const uint8_t* picoquic_decode_application_close_frame(picoquic_cnx_t* cnx, cons
 
 
 
+/*
+ * Receive window tuning.
+ *
+ * When tuning is enabled by picoquic_set_receive_window_tuning, the flow
+ * control credit is advertised as a window beyond the data consumed by the
+ * application, on the connection or on a stream, instead of growing by
+ * fixed increments. Data is counted as consumed on the connection when it
+ * is delivered to the application, passed to a direct receive function,
+ * or discarded because the stream is reset or deleted. Once per RTT, the window is
+ * compared to twice the amount of data consumed during the last RTT. If
+ * flow control limits the throughput, the peer sends a full window per RTT
+ * and the window doubles. If the application reads slowly, the window is
+ * halved, but never below its initial value. The sum of the connection
+ * windows is bounded by the memory budget of the QUIC context, and the
+ * stream windows are bounded by the connection window.
+ */
+
+static void picoquic_rwnd_update(picoquic_cnx_t* cnx, picoquic_rwnd_tuning_t* rwnd, uint64_t offset,
+    uint64_t window_max, uint64_t current_time)
+{
+    uint64_t rtt = cnx->path[0]->smoothed_rtt;
+
+    if (current_time >= rwnd->epoch_start + rtt && current_time > rwnd->epoch_start) {
+        if (offset > rwnd->epoch_offset) {
+            uint64_t target = (2 * (offset - rwnd->epoch_offset) * rtt) / (current_time - rwnd->epoch_start);
+
+            if (target > rwnd->window) {
+                uint64_t window = (target > 2 * rwnd->window) ? 2 * rwnd->window : target;
+                if (window > window_max) {
+                    window = window_max;
+                }
+                if (window > rwnd->window) {
+                    rwnd->window = window;
+                }
+            }
+            else if (2 * target < rwnd->window) {
+                rwnd->window /= 2;
+                if (rwnd->window < rwnd->window_min) {
+                    rwnd->window = rwnd->window_min;
+                }
+            }
+        }
+        rwnd->epoch_start = current_time;
+        rwnd->epoch_offset = offset;
+    }
+}
+
+static void picoquic_rwnd_start(picoquic_rwnd_tuning_t* rwnd, uint64_t window, uint64_t offset, uint64_t current_time)
+{
+    rwnd->window = window;
+    rwnd->window_min = window;
+    rwnd->epoch_start = current_time;
+    rwnd->epoch_offset = offset;
+}
+
+/* Count the stream data up to offset as consumed on the connection */
+void picoquic_rwnd_consume(picoquic_cnx_t* cnx, picoquic_stream_head_t* stream, uint64_t offset)
+{
+    if (offset > stream->rwnd_consumed_offset) {
+        cnx->data_consumed += offset - stream->rwnd_consumed_offset;
+        stream->rwnd_consumed_offset = offset;
+    }
+}
+
+/* Return the increase of the connection flow control limit, or 0 if the
+ * remaining credit is still larger than half the window.
+ */
+uint64_t picoquic_rwnd_max_data_increase(picoquic_cnx_t* cnx, uint64_t current_time)
+{
+    picoquic_quic_t* quic = cnx->quic;
+    uint64_t increase = 0;
+
+    if (cnx->rwnd.window == 0) {
+        uint64_t window = cnx->local_parameters.initial_max_data;
+        if (window < PICOQUIC_CWIN_INITIAL) {
+            window = PICOQUIC_CWIN_INITIAL;
+        }
+        picoquic_rwnd_start(&cnx->rwnd, window, cnx->data_consumed, current_time);
+        quic->rwnd_committed += window;
+    }
+
+    if (cnx->data_consumed + cnx->rwnd.window / 2 > cnx->maxdata_local) {
+        uint64_t old_window = cnx->rwnd.window;
+        uint64_t window_max = old_window;
+
+        if (quic->rwnd_committed < quic->rwnd_budget) {
+            window_max += quic->rwnd_budget - quic->rwnd_committed;
+        }
+        picoquic_rwnd_update(cnx, &cnx->rwnd, cnx->data_consumed, window_max, current_time);
+        quic->rwnd_committed -= old_window;
+        quic->rwnd_committed += cnx->rwnd.window;
+
+        if (cnx->data_consumed + cnx->rwnd.window > cnx->maxdata_local) {
+            increase = cnx->data_consumed + cnx->rwnd.window - cnx->maxdata_local;
+        }
+    }
+
+    return increase;
+}
+
+void picoquic_rwnd_release(picoquic_cnx_t* cnx)
+{
+    if (cnx->quic->rwnd_committed > cnx->rwnd.window) {
+        cnx->quic->rwnd_committed -= cnx->rwnd.window;
+    }
+    else {
+        cnx->quic->rwnd_committed = 0;
+    }
+    cnx->rwnd.window = 0;
+}
+
+int picoquic_is_max_stream_data_needed(picoquic_cnx_t* cnx, picoquic_stream_head_t* stream)
+{
+    int is_needed;
+
+    if (cnx->quic->rwnd_budget != 0 && stream->rwnd.window != 0) {
+        is_needed = stream->consumed_offset + stream->rwnd.window / 2 > stream->maxdata_local;
+    }
+    else {
+        is_needed = 2 * stream->consumed_offset > stream->maxdata_local;
+    }
+    return is_needed;
+}
+
+/* Return the new stream flow control limit, computed from the tuned window */
+static uint64_t picoquic_rwnd_stream_max_data(picoquic_cnx_t* cnx, picoquic_stream_head_t* stream, uint64_t current_time)
+{
+    uint64_t window_max = (cnx->rwnd.window != 0) ? cnx->rwnd.window : cnx->quic->max_data_limit;
+
+    if (window_max == 0) {
+        window_max = UINT64_MAX;
+    }
+    else if (window_max < stream->rwnd.window_min) {
+        window_max = stream->rwnd.window_min;
+    }
+
+    if (stream->rwnd.window == 0) {
+        picoquic_rwnd_start(&stream->rwnd, stream->maxdata_local, stream->consumed_offset, current_time);
+    }
+    else {
+        picoquic_rwnd_update(cnx, &stream->rwnd, stream->consumed_offset, window_max, current_time);
+    }
+    return stream->consumed_offset + stream->rwnd.window;
+}
+
 /*
  * Max data frame
  */
@@ -4268,8 +4567,8 @@ const uint8_t* picoquic_decode_max_stream_data_frame(picoquic_cnx_t* cnx, const
     }
     
     if (stream != NULL && maxdata > stream->maxdata_remote) {
-        /* TODO: call back if the stream was blocked? */
         stream->maxdata_remote = maxdata;
+        picoquic_update_ready_stream(cnx, stream);
         if (maxdata > cnx->max_stream_data_remote) {
             cnx->max_stream_data_remote = maxdata;
         }
@@ -4313,17 +4612,23 @@ uint8_t * picoquic_format_required_max_stream_data_frames(picoquic_cnx_t* cnx,
 {
     uint8_t* bytes0;
     picoquic_stream_head_t* stream = picoquic_first_stream(cnx);
+    int is_tuned = (cnx->quic->rwnd_budget != 0);
+    uint64_t current_time = (is_tuned) ? picoquic_get_quic_time(cnx->quic) : 0;
 
     while (stream != NULL) {
         if (!stream->fin_received) {
-            uint64_t new_window = picoquic_cc_increased_window(cnx, stream->maxdata_local);
+            if (!stream->reset_received && picoquic_is_max_stream_data_needed(cnx, stream)) {
+                uint64_t new_max_data = (is_tuned && stream->maxdata_local > 0) ?
+                    picoquic_rwnd_stream_max_data(cnx, stream, current_time) :
+                    stream->maxdata_local + picoquic_cc_increased_window(cnx, stream->maxdata_local);
 
-            if (!stream->reset_received && 2 * stream->consumed_offset > stream->maxdata_local) {
-                bytes0 = bytes;
+                if (new_max_data > stream->maxdata_local) {
+                    bytes0 = bytes;
 
-                if ((bytes = picoquic_format_max_stream_data_frame(cnx, stream, bytes, bytes_max, more_data, is_pure_ack, stream->maxdata_local + new_window)) == bytes0) {
-                    /* not enough space for this frame. */
-                    break;
+                    if ((bytes = picoquic_format_max_stream_data_frame(cnx, stream, bytes, bytes_max, more_data, is_pure_ack, new_max_data)) == bytes0) {
+                        /* not enough space for this frame. */
+                        break;
+                    }
                 }
             }
         }
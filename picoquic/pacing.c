@@ -32,14 +32,17 @@ void picoquic_pacing_init(picoquic_pacing_t* pacing, uint64_t current_time)
     pacing->bucket_max = 16;
     pacing->packet_time_nanosec = 1;
     pacing->packet_time_microsec = 1;
+    pacing->departure_time = current_time;
 }
 
 /* Update the leaky bucket used for pacing.
+* If pacing is offloaded, the bucket may run a debt of up to the
+* offload horizon, the kernel delaying packets until the debt is paid.
 */
 static void picoquic_update_pacing_bucket(picoquic_pacing_t* pacing, uint64_t current_time)
 {
-    if (pacing->bucket_nanosec < -pacing->packet_time_nanosec) {
-        pacing->bucket_nanosec = -pacing->packet_time_nanosec;
+    if (pacing->bucket_nanosec < -pacing->packet_time_nanosec - pacing->horizon_nanosec) {
+        pacing->bucket_nanosec = -pacing->packet_time_nanosec - pacing->horizon_nanosec;
     }
 
     if (current_time > pacing->evaluation_time) {
@@ -65,15 +68,23 @@ int picoquic_is_pacing_blocked(picoquic_pacing_t* pacing)
 * 
 * In packet train mode, the wait will last until the bucket is completely full, or
 * if at least N packets are received.
+* 
+* If pacing is offloaded, transmission is authorized if the packet can
+* depart within the offload horizon, and the wait is shortened by
+* that horizon.
 */
 int picoquic_is_authorized_by_pacing(picoquic_pacing_t * pacing, uint64_t current_time, uint64_t * next_time,
     unsigned int packet_train_mode, picoquic_quic_t * quic)
 {
     int ret = 1;
 
+    if (quic != NULL) {
+        pacing->horizon_nanosec = (int64_t)quic->pacing_offload_horizon * 1000;
+    }
+
     picoquic_update_pacing_bucket(pacing, current_time);
 
-    if (pacing->bucket_nanosec < pacing->packet_time_nanosec) {
+    if (pacing->bucket_nanosec + pacing->horizon_nanosec < pacing->packet_time_nanosec) {
         uint64_t next_pacing_time;
         int64_t bucket_required;
 
@@ -89,6 +100,12 @@ int picoquic_is_authorized_by_pacing(picoquic_pacing_t * pacing, uint64_t curren
         else {
             bucket_required = pacing->packet_time_nanosec - pacing->bucket_nanosec;
         }
+        if (bucket_required > pacing->horizon_nanosec) {
+            bucket_required -= pacing->horizon_nanosec;
+        }
+        else {
+            bucket_required = 0;
+        }
 
         next_pacing_time = current_time + 1 + bucket_required / 1000;
         if (next_pacing_time < *next_time) {
@@ -234,16 +251,37 @@ void picoquic_update_pacing_window(picoquic_pacing_t * pacing, int slow_start, u
 
 /* 
 * Update the pacing data after sending a packet.
+* The packet departs when the bucket would have refilled enough to
+* authorize it, which is later than the current time if the bucket
+* is in debt.
 */
 void picoquic_update_pacing_data_after_send(picoquic_pacing_t * pacing, size_t length, size_t send_mtu, uint64_t current_time)
 {
     uint64_t packet_time_nanosec;
 
     picoquic_update_pacing_bucket(pacing, current_time);
+    pacing->departure_time = current_time;
+    if (pacing->bucket_nanosec < pacing->packet_time_nanosec && pacing->horizon_nanosec > 0) {
+        pacing->departure_time += (pacing->packet_time_nanosec - pacing->bucket_nanosec) / 1000;
+    }
     packet_time_nanosec = ((pacing->packet_time_nanosec * (uint64_t)length) + (send_mtu - 1)) / send_mtu;
     pacing->bucket_nanosec -= packet_time_nanosec;
 }
 
+/*
+* Departure time of the next full size packet, if it were sent at current time.
+* This is later than current time if pacing is offloaded and the bucket is in debt.
+*/
+uint64_t picoquic_pacing_next_departure_time(picoquic_pacing_t* pacing, uint64_t current_time)
+{
+    uint64_t departure_time = current_time;
+
+    if (pacing->horizon_nanosec > 0 && pacing->bucket_nanosec < pacing->packet_time_nanosec) {
+        departure_time += (pacing->packet_time_nanosec - pacing->bucket_nanosec) / 1000;
+    }
+    return departure_time;
+}
+
 /* Interface functions for compatibility with old implementation */
 void picoquic_update_pacing_after_send(picoquic_path_t* path_x, size_t length, uint64_t current_time)
 {
@@ -118,7 +118,7 @@ int picoquic_screen_initial_packet(
         if (picoquic_get_initial_aead_context(quic, ph->version_index, &ph->dest_cnx_id,
             0 /* is_client=0 */, 0 /* is_enc = 0 */, &aead_ctx, &pn_dec_ctx) == 0) {
             ret = picoquic_remove_header_protection_inner((uint8_t *)bytes, ph->offset + ph->payload_length,
-                decrypted_bytes, &dph, pn_dec_ctx, 0 /* is_loss_bit_enabled_incoming */, 0 /* sack_list_last*/);
+                decrypted_bytes, &dph, pn_dec_ctx, NULL, 0 /* is_loss_bit_enabled_incoming */, 0 /* sack_list_last*/);
             if (ret == 0) {
                 size_t decrypted_length = picoquic_aead_decrypt_generic(decrypted_bytes + dph.offset,
                     bytes + dph.offset, dph.payload_length, dph.pn64, decrypted_bytes, dph.offset, 
@@ -408,7 +408,15 @@ int picoquic_parse_short_packet_header(
         if (*pcnx == NULL)
         {
             if (quic->local_cnxid_length > 0) {
-                *pcnx = picoquic_cnx_by_id(quic, ph->dest_cnx_id, &ph->l_cid);
+                if (quic->batch_l_cid != NULL &&
+                    picoquic_compare_connection_id(&quic->batch_l_cid->cnx_id, &ph->dest_cnx_id) == 0) {
+                    /* Same CID as the previous packet in the batch, no need for a new lookup */
+                    ph->l_cid = quic->batch_l_cid;
+                    *pcnx = ph->l_cid->registered_cnx;
+                }
+                else {
+                    *pcnx = picoquic_cnx_by_id(quic, ph->dest_cnx_id, &ph->l_cid);
+                }
             }
             else {
                 *pcnx = picoquic_cnx_by_net(quic, addr_from);
@@ -515,6 +523,173 @@ uint64_t picoquic_get_packet_number64(uint64_t highest, uint64_t mask, uint32_t
     return pn64;
 }
 
+/*
+ * Header protection masks of a batch of incoming packets.
+ * The samples are encrypted in a single ECB call. If the key has no ECB
+ * context, the cache is left empty and the masks are computed one packet
+ * at a time when the headers are decoded.
+ */
+void picoquic_hp_mask_cache_compute(picoquic_hp_mask_cache_t* cache, void* pn_dec, void* pn_dec_ecb,
+    const uint8_t** samples, size_t nb_samples)
+{
+    cache->pn_dec = pn_dec;
+    cache->nb_entries = 0;
+    cache->next_entry = 0;
+
+    if (pn_dec != NULL && pn_dec_ecb != NULL && nb_samples > 0) {
+        uint8_t blocks[PICOQUIC_HP_BATCH_MAX * 16];
+        uint8_t masks[PICOQUIC_HP_BATCH_MAX * 16];
+
+        if (nb_samples > PICOQUIC_HP_BATCH_MAX) {
+            nb_samples = PICOQUIC_HP_BATCH_MAX;
+        }
+        for (size_t i = 0; i < nb_samples; i++) {
+            memcpy(blocks + 16 * i, samples[i], 16);
+        }
+        picoquic_aes128_ecb_encrypt(pn_dec_ecb, masks, blocks, 16 * nb_samples);
+        for (size_t i = 0; i < nb_samples; i++) {
+            memcpy(cache->entries[i].sample, blocks + 16 * i, 16);
+            memcpy(cache->entries[i].mask, masks + 16 * i, 5);
+        }
+        cache->nb_entries = nb_samples;
+    }
+}
+
+/* Packets are usually decoded in the order in which their masks were
+ * computed, so the search starts after the last entry found. */
+const uint8_t* picoquic_hp_mask_cache_find(picoquic_hp_mask_cache_t* cache, void* pn_dec, const uint8_t* sample)
+{
+    if (cache->nb_entries > 0 && pn_dec == cache->pn_dec) {
+        for (size_t i = 0; i < cache->nb_entries; i++) {
+            size_t index = (cache->next_entry + i) % cache->nb_entries;
+
+            if (memcmp(cache->entries[index].sample, sample, 16) == 0) {
+                cache->next_entry = index + 1;
+                return cache->entries[index].mask;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Decryption of a batch of incoming packets by the crypto workers.
+ * The header protection is removed as it would be when processing the
+ * packet, using the masks already computed for the batch, and the packets
+ * encrypted with the current key are handed to the workers.
+ */
+static void picoquic_decrypt_batch_submit(picoquic_quic_t* quic, picoquic_local_cnxid_t* l_cid,
+    const uint8_t** packets, const size_t* lengths, size_t nb_packets)
+{
+    picoquic_decrypt_batch_t* batch = quic->decrypt_batch;
+    picoquic_cnx_t* cnx = l_cid->registered_cnx;
+    picoquic_crypto_context_t* crypto_context = &cnx->crypto_context[picoquic_epoch_1rtt];
+    picoquic_sack_list_t* sack_list = picoquic_sack_list_from_cnx_context(cnx, picoquic_packet_context_application, l_cid);
+    picoquic_crypto_job_t* jobs[PICOQUIC_HP_BATCH_MAX];
+
+    batch->nb_entries = 0;
+    if (crypto_context->aead_decrypt == NULL || crypto_context->aead_decrypt_clones == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < nb_packets && batch->nb_entries < PICOQUIC_HP_BATCH_MAX; i++) {
+        picoquic_decrypt_batch_entry_t* entry = &batch->entries[batch->nb_entries];
+        picoquic_packet_header ph;
+
+        memset(&ph, 0, sizeof(picoquic_packet_header));
+        ph.ptype = picoquic_packet_1rtt_protected;
+        ph.pn_offset = (size_t)1 + quic->local_cnxid_length;
+        ph.offset = ph.pn_offset;
+        ph.payload_length = lengths[i] - ph.pn_offset;
+        entry->decrypted = batch->buffers + batch->nb_entries * PICOQUIC_MAX_PACKET_SIZE;
+
+        if (lengths[i] > PICOQUIC_MAX_PACKET_SIZE ||
+            picoquic_remove_header_protection_inner((uint8_t*)packets[i], lengths[i], entry->decrypted, &ph,
+                crypto_context->pn_dec, picoquic_hp_mask_cache_find(&quic->hp_mask_cache, crypto_context->pn_dec, packets[i] + ph.pn_offset + 4),
+                cnx->is_loss_bit_enabled_incoming, picoquic_sack_list_last(sack_list)) != 0 ||
+            ph.key_phase != cnx->key_phase_dec) {
+            continue;
+        }
+        entry->job.output = entry->decrypted + ph.offset;
+        entry->job.input = packets[i] + ph.offset;
+        entry->job.input_length = ph.payload_length;
+        entry->job.aad = entry->decrypted;
+        entry->job.aad_length = ph.offset;
+        entry->job.sequence_number = ph.pn64;
+        entry->job.path_id = l_cid->path_id;
+        entry->job.is_encrypt = 0;
+        entry->job.is_multipath = cnx->is_multipath_enabled;
+        entry->cnx = cnx;
+        entry->bytes = packets[i];
+        entry->aead_decrypt = crypto_context->aead_decrypt;
+        entry->pn64 = ph.pn64;
+        entry->offset = ph.offset;
+        entry->payload_length = ph.payload_length;
+        jobs[batch->nb_entries++] = &entry->job;
+    }
+    /* Masks are searched again when the packets are processed */
+    quic->hp_mask_cache.next_entry = 0;
+
+    if (batch->nb_entries > 1) {
+        picoquic_crypto_pool_dispatch(quic->crypto_pool, jobs, batch->nb_entries,
+            crypto_context->aead_decrypt, crypto_context->aead_decrypt_clones);
+    }
+    else {
+        batch->nb_entries = 0;
+    }
+}
+
+/* Returns 1 and sets the decoded length if the packet was decrypted ahead
+ * with the same key and packet number. */
+static int picoquic_decrypt_batch_get(picoquic_cnx_t* cnx, const uint8_t* bytes, uint8_t* decoded_bytes,
+    picoquic_packet_header* ph, void* aead_decrypt, size_t* decoded)
+{
+    picoquic_decrypt_batch_t* batch = cnx->quic->decrypt_batch;
+
+    if (batch != NULL) {
+        for (size_t i = 0; i < batch->nb_entries; i++) {
+            picoquic_decrypt_batch_entry_t* entry = &batch->entries[i];
+
+            if (entry->bytes == bytes && entry->cnx == cnx) {
+                if (entry->aead_decrypt != aead_decrypt || entry->pn64 != ph->pn64 ||
+                    entry->offset != ph->offset || entry->payload_length != ph->payload_length) {
+                    return 0;
+                }
+                picoquic_crypto_pool_wait(cnx->quic->crypto_pool, &entry->job);
+                *decoded = entry->job.result;
+                if (*decoded <= ph->payload_length) {
+                    memcpy(decoded_bytes + ph->offset, entry->decrypted + ph->offset, *decoded);
+                }
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/* Wait for the workers, and forget the packets decrypted ahead for the
+ * connection, or for all connections if cnx is NULL. */
+void picoquic_decrypt_batch_clear(picoquic_quic_t* quic, picoquic_cnx_t* cnx)
+{
+    picoquic_decrypt_batch_t* batch = quic->decrypt_batch;
+
+    if (batch != NULL && batch->nb_entries > 0) {
+        picoquic_crypto_pool_drain(quic->crypto_pool);
+        if (cnx == NULL) {
+            batch->nb_entries = 0;
+        }
+        else {
+            for (size_t i = 0; i < batch->nb_entries; i++) {
+                if (batch->entries[i].cnx == cnx) {
+                    batch->entries[i].cnx = NULL;
+                }
+            }
+        }
+    }
+}
+
 /*
  * Remove header protection 
  */
@@ -524,6 +699,7 @@ int picoquic_remove_header_protection_inner(
     uint8_t* decrypted_bytes,
     picoquic_packet_header* ph,
     void * pn_enc,
+    const uint8_t * precomputed_mask,
     unsigned int is_loss_bit_enabled_incoming,
     uint64_t sack_list_last)
 {
@@ -556,7 +732,12 @@ int picoquic_remove_header_protection_inner(
             uint32_t pn_val = 0;
 
             memcpy(decrypted_bytes, bytes, ph->pn_offset);
-            picoquic_pn_encrypt(pn_enc, bytes + sample_offset, mask_bytes, mask_bytes, mask_length);
+            if (precomputed_mask != NULL) {
+                memcpy(mask_bytes, precomputed_mask, mask_length);
+            }
+            else {
+                picoquic_pn_encrypt(pn_enc, bytes + sample_offset, mask_bytes, mask_bytes, mask_length);
+            }
             /* Decode the first byte */
             first_byte ^= (mask_bytes[0] & first_mask);
             pn_l = (first_byte & 3) + 1;
@@ -614,10 +795,14 @@ int picoquic_remove_header_protection(picoquic_cnx_t* cnx,
     int ret = 0;
     size_t length = ph->offset + ph->payload_length; /* this may change after decrypting the PN */
     void * pn_enc = cnx->crypto_context[ph->epoch].pn_dec;
-
+    const uint8_t* precomputed_mask = NULL;
     picoquic_sack_list_t* sack_list = picoquic_sack_list_from_cnx_context(cnx, ph->pc, ph->l_cid);
+
+    if (cnx->quic->hp_mask_cache.nb_entries > 0 && ph->pn_offset + 4 + 16 <= length) {
+        precomputed_mask = picoquic_hp_mask_cache_find(&cnx->quic->hp_mask_cache, pn_enc, bytes + ph->pn_offset + 4);
+    }
     ret = picoquic_remove_header_protection_inner(bytes, length, decrypted_bytes, ph,
-        pn_enc, cnx->is_loss_bit_enabled_incoming, picoquic_sack_list_last(sack_list));
+        pn_enc, precomputed_mask, cnx->is_loss_bit_enabled_incoming, picoquic_sack_list_last(sack_list));
 
     return ret;
 }
@@ -652,7 +837,11 @@ size_t picoquic_remove_packet_protection(picoquic_cnx_t* cnx,
         /* Manage key rotation */
         if (ph->key_phase == cnx->key_phase_dec) {
             /* AEAD Decrypt */
-            if (cnx->is_multipath_enabled && ph->ptype) {
+            if (picoquic_decrypt_batch_get(cnx, bytes, decoded_bytes, ph,
+                cnx->crypto_context[picoquic_epoch_1rtt].aead_decrypt, &decoded)) {
+                /* Decrypted ahead by the crypto workers */
+            }
+            else if (cnx->is_multipath_enabled && ph->ptype) {
                 decoded = picoquic_aead_decrypt_mp(decoded_bytes + ph->offset,
                     bytes + ph->offset,
                     ph->payload_length, 
@@ -676,7 +865,11 @@ size_t picoquic_remove_packet_protection(picoquic_cnx_t* cnx,
                 need_integrity_check = 0;
             }
             else if (cnx->crypto_context_old.aead_decrypt != NULL) {
-                if (cnx->is_multipath_enabled) {
+                if (picoquic_decrypt_batch_get(cnx, bytes, decoded_bytes, ph,
+                    cnx->crypto_context_old.aead_decrypt, &decoded)) {
+                    /* Decrypted ahead, before the key rotation */
+                }
+                else if (cnx->is_multipath_enabled) {
                     decoded = picoquic_aead_decrypt_mp(decoded_bytes + ph->offset, bytes + ph->offset, ph->payload_length,
                         ph->l_cid->path_id, ph->pn64, decoded_bytes, ph->offset, cnx->crypto_context_old.aead_decrypt);
                 }
@@ -2329,6 +2522,26 @@ int  picoquic_incoming_not_decrypted(
 * Processing of the packet that was just received from the network.
 */
 
+/* After processing an incoming packet, the connection is rescheduled
+ * immediately. When processing a batch, this is deferred until the
+ * end of the batch, see picoquic_incoming_packets_batch.
+ */
+static void picoquic_incoming_reinsert_by_wake_time(picoquic_cnx_t* cnx, uint64_t current_time)
+{
+    picoquic_quic_t* quic = cnx->quic;
+
+    if (quic->is_incoming_batch) {
+        if (!cnx->is_wake_deferred) {
+            cnx->is_wake_deferred = 1;
+            cnx->next_wake_deferred = quic->wake_deferred_first;
+            quic->wake_deferred_first = cnx;
+        }
+    }
+    else {
+        picoquic_reinsert_by_wake_time(quic, cnx, current_time);
+    }
+}
+
 int picoquic_incoming_segment(
     picoquic_quic_t* quic,
     uint8_t* raw_bytes,
@@ -2358,6 +2571,8 @@ int picoquic_incoming_segment(
     if (decrypted_data == NULL) {
         return -1;
     }
+    /* Zero copy views consumed during decoding must not recycle the packet */
+    decrypted_data->is_decoding = 1;
     /* Parse the header and decrypt the segment */
     ret = picoquic_parse_header_and_decrypt(quic, raw_bytes, length, packet_length, addr_from,
         current_time, decrypted_data, &ph, &cnx, consumed, &new_context_created);
@@ -2461,6 +2676,9 @@ int picoquic_incoming_segment(
             ret = PICOQUIC_ERROR_DETECTED;
         }
         else {
+            if (cnx->is_hibernating) {
+                picoquic_wake_cnx_from_hibernation(cnx, current_time);
+            }
             cnx->quic_bit_received_0 |= ph.quic_bit_is_zero;
             switch (ph.ptype) {
             case picoquic_packet_version_negotiation:
@@ -2586,7 +2804,7 @@ int picoquic_incoming_segment(
             picoquic_ecn_accounting(cnx, received_ecn, ph.pc, ph.l_cid);
         }
         if (cnx != NULL) {
-            picoquic_reinsert_by_wake_time(cnx->quic, cnx, current_time);
+            picoquic_incoming_reinsert_by_wake_time(cnx, current_time);
         }
     } else if (ret == PICOQUIC_ERROR_AEAD_CHECK || ret == PICOQUIC_ERROR_INITIAL_TOO_SHORT ||
         ret == PICOQUIC_ERROR_PACKET_WRONG_VERSION ||
@@ -2616,7 +2834,7 @@ int picoquic_incoming_segment(
             ret = -1;
         }
         if (cnx != NULL) {
-            picoquic_reinsert_by_wake_time(cnx->quic, cnx, current_time);
+            picoquic_incoming_reinsert_by_wake_time(cnx, current_time);
         }
     } else if (ret == 1) {
         /* wonder what happened ! */
@@ -2630,8 +2848,11 @@ int picoquic_incoming_segment(
         ret = -1;
     }
 
-    if (decrypted_data != NULL && decrypted_data->bytes == NULL) {
-        picoquic_stream_data_node_recycle(decrypted_data);
+    if (decrypted_data != NULL) {
+        decrypted_data->is_decoding = 0;
+        if (decrypted_data->bytes == NULL) {
+            picoquic_stream_data_node_recycle(decrypted_data);
+        }
     }
 
     return ret;
@@ -2696,6 +2917,196 @@ int picoquic_incoming_packet(
     return ret;
 }
 
+/* Batch processing of incoming datagrams.
+ * The destination CID is extracted without full header parsing. It is only
+ * used to group datagrams, so invalid headers simply yield a null CID.
+ */
+void picoquic_parse_incoming_dcid(picoquic_quic_t* quic, const uint8_t* bytes, size_t length,
+    picoquic_connection_id_t* dcid)
+{
+    *dcid = picoquic_null_connection_id;
+
+    if (length > 0) {
+        if ((bytes[0] & 0x80) == 0) {
+            if (length >= (size_t)1 + quic->local_cnxid_length) {
+                (void)picoquic_parse_connection_id(bytes + 1, quic->local_cnxid_length, dcid);
+            }
+        }
+        else if (length >= 6 && bytes[5] <= PICOQUIC_CONNECTION_ID_MAX_SIZE &&
+            length >= (size_t)6 + bytes[5]) {
+            (void)picoquic_parse_connection_id(bytes + 6, bytes[5], dcid);
+        }
+    }
+}
+
+int picoquic_incoming_packets_batch(
+    picoquic_quic_t* quic,
+    picoquic_incoming_datagram_t* datagrams,
+    size_t nb_datagrams,
+    picoquic_cnx_t** last_cnx,
+    uint64_t current_time)
+{
+    int ret = 0;
+    size_t batch_start = 0;
+    picoquic_cnx_t* cnx;
+    picoquic_cnx_t* reversed = NULL;
+
+    quic->is_incoming_batch = 1;
+
+    while (ret == 0 && batch_start < nb_datagrams) {
+        picoquic_connection_id_t dcid[PICOQUIC_INCOMING_BATCH_MAX];
+        picoquic_cnx_t* group_cnx[PICOQUIC_INCOMING_BATCH_MAX];
+        int next_in_group[PICOQUIC_INCOMING_BATCH_MAX];
+        int group_first[PICOQUIC_INCOMING_BATCH_MAX];
+        int group_last[PICOQUIC_INCOMING_BATCH_MAX];
+        int nb_groups = 0;
+        int group_floor = 0;
+        int nb_batch = (nb_datagrams - batch_start > PICOQUIC_INCOMING_BATCH_MAX) ?
+            PICOQUIC_INCOMING_BATCH_MAX : (int)(nb_datagrams - batch_start);
+
+        /* Group the datagrams by connection, preserving arrival order within each group.
+         * A connection may receive packets with several CIDs, e.g., after the peer
+         * switched to a new CID, so the grouping key is the connection context.
+         * Long header datagrams that cannot be attributed to a connection by CID,
+         * e.g., Initial packets, and datagrams without CID act as a barrier: later
+         * datagrams are not grouped with earlier ones, since the barrier datagram
+         * might belong to the same connection. */
+        for (int i = 0; i < nb_batch; i++) {
+            picoquic_cnx_t* cnx_i = NULL;
+            int g = nb_groups;
+            int is_barrier = 0;
+
+            picoquic_parse_incoming_dcid(quic, datagrams[batch_start + i].bytes,
+                datagrams[batch_start + i].length, &dcid[i]);
+            next_in_group[i] = -1;
+            if (quic->local_cnxid_length > 0 && !picoquic_is_connection_id_null(&dcid[i])) {
+                /* Reuse the lookup of a previous datagram with the same CID */
+                int k = group_floor;
+                while (k < nb_groups && (group_cnx[k] == NULL ||
+                    picoquic_compare_connection_id(&dcid[group_first[k]], &dcid[i]) != 0)) {
+                    k++;
+                }
+                if (k < nb_groups) {
+                    cnx_i = group_cnx[k];
+                }
+                else {
+                    picoquic_local_cnxid_t* l_cid = NULL;
+                    cnx_i = picoquic_cnx_by_id(quic, dcid[i], &l_cid);
+                }
+            }
+            if (cnx_i == NULL) {
+                is_barrier = quic->local_cnxid_length == 0 || datagrams[batch_start + i].length == 0 ||
+                    (datagrams[batch_start + i].bytes[0] & 0x80) != 0;
+            }
+            if (cnx_i != NULL) {
+                g = group_floor;
+                while (g < nb_groups && group_cnx[g] != cnx_i) {
+                    g++;
+                }
+            }
+            else if (is_barrier) {
+                /* Consecutive barrier datagrams with the same CID are grouped */
+                if (group_floor > 0 && group_floor == nb_groups &&
+                    picoquic_compare_connection_id(&dcid[group_first[nb_groups - 1]], &dcid[i]) == 0) {
+                    g = nb_groups - 1;
+                }
+            }
+            else {
+                /* Short header packets with an unknown CID, grouped by CID */
+                g = group_floor;
+                while (g < nb_groups && (group_cnx[g] != NULL ||
+                    picoquic_compare_connection_id(&dcid[group_first[g]], &dcid[i]) != 0)) {
+                    g++;
+                }
+            }
+            if (g < nb_groups) {
+                next_in_group[group_last[g]] = i;
+                group_last[g] = i;
+            }
+            else {
+                group_cnx[nb_groups] = cnx_i;
+                group_first[nb_groups] = i;
+                group_last[nb_groups] = i;
+                nb_groups++;
+                if (is_barrier) {
+                    group_floor = nb_groups;
+                }
+            }
+        }
+
+        for (int g = 0; ret == 0 && g < nb_groups; g++) {
+            /* Resolve the CID once for the whole group. The cached value is
+             * cleared if the CID is retired while processing the group. */
+            if (quic->local_cnxid_length > 0 && !picoquic_is_connection_id_null(&dcid[group_first[g]])) {
+                (void)picoquic_cnx_by_id(quic, dcid[group_first[g]], &quic->batch_l_cid);
+            }
+            /* Compute the header protection masks of the short header packets of the group */
+            if (quic->batch_l_cid != NULL && quic->batch_l_cid->registered_cnx != NULL &&
+                group_first[g] != group_last[g]) {
+                picoquic_crypto_context_t* crypto_context = &quic->batch_l_cid->registered_cnx->crypto_context[picoquic_epoch_1rtt];
+                const uint8_t* samples[PICOQUIC_INCOMING_BATCH_MAX];
+                const uint8_t* packets[PICOQUIC_INCOMING_BATCH_MAX];
+                size_t lengths[PICOQUIC_INCOMING_BATCH_MAX];
+                size_t nb_samples = 0;
+                size_t nb_packets = 0;
+                size_t sample_offset = (size_t)1 + quic->local_cnxid_length + 4;
+
+                for (int i = group_first[g]; i >= 0; i = next_in_group[i]) {
+                    picoquic_incoming_datagram_t* datagram = &datagrams[batch_start + i];
+
+                    if (datagram->length >= sample_offset + 16 && (datagram->bytes[0] & 0x80) == 0) {
+                        samples[nb_samples++] = datagram->bytes + sample_offset;
+                        /* Decryption ahead of time uses the path of the CID */
+                        if (picoquic_compare_connection_id(&dcid[i], &quic->batch_l_cid->cnx_id) == 0) {
+                            packets[nb_packets] = datagram->bytes;
+                            lengths[nb_packets++] = datagram->length;
+                        }
+                    }
+                }
+                picoquic_hp_mask_cache_compute(&quic->hp_mask_cache, crypto_context->pn_dec, crypto_context->pn_dec_ecb,
+                    samples, nb_samples);
+                /* With crypto workers, decrypt the packets ahead of their processing */
+                if (quic->crypto_pool != NULL) {
+                    picoquic_decrypt_batch_submit(quic, quic->batch_l_cid, packets, lengths, nb_packets);
+                }
+            }
+
+            for (int i = group_first[g]; ret == 0 && i >= 0; i = next_in_group[i]) {
+                picoquic_incoming_datagram_t* datagram = &datagrams[batch_start + i];
+                picoquic_cnx_t* first_cnx = NULL;
+
+                ret = picoquic_incoming_packet_ex(quic, datagram->bytes, datagram->length,
+                    datagram->addr_from, datagram->addr_to, datagram->if_index_to,
+                    datagram->received_ecn, &first_cnx, current_time);
+                if (first_cnx != NULL && last_cnx != NULL) {
+                    *last_cnx = first_cnx;
+                }
+            }
+            quic->batch_l_cid = NULL;
+            quic->hp_mask_cache.nb_entries = 0;
+            picoquic_decrypt_batch_clear(quic, NULL);
+        }
+        batch_start += nb_batch;
+    }
+
+    quic->is_incoming_batch = 0;
+
+    /* Reschedule the connections that received packets, in arrival order */
+    while ((cnx = quic->wake_deferred_first) != NULL) {
+        quic->wake_deferred_first = cnx->next_wake_deferred;
+        cnx->next_wake_deferred = reversed;
+        reversed = cnx;
+    }
+    while ((cnx = reversed) != NULL) {
+        reversed = cnx->next_wake_deferred;
+        cnx->next_wake_deferred = NULL;
+        cnx->is_wake_deferred = 0;
+        picoquic_reinsert_by_wake_time(quic, cnx, current_time);
+    }
+
+    return ret;
+}
+
 /* Processing of stashed packets after acquiring encryption context */
 void picoquic_process_sooner_packets(picoquic_cnx_t* cnx, uint64_t current_time)
 {
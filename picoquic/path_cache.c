@@ -0,0 +1,322 @@
+/*
+* Copyright (c) 2026, the picoquic contributors.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Path metrics cache.
+ *
+ * Servers see many connections from the same client networks. When a
+ * server connection is deleted, the metrics of its default path are
+ * recorded in a cache keyed by the prefix of the peer address: /24 for
+ * IPv4, /48 for IPv6. When a new server connection is created, the
+ * cache entry for the peer prefix, if any, is used to set the initial
+ * RTT of the path, and to seed the congestion window through the same
+ * mechanism as the BDP carried in session tickets. The seed is only
+ * applied if the first RTT sample matches the cached min RTT, see
+ * picoquic_validate_bdp_seed.
+ *
+ * Successive samples for the same prefix are merged as moving averages.
+ * The entries are kept in a hash table, and in a list ordered by time
+ * of last update. The number of entries is bounded; when the cache is
+ * full, the least recently updated entry is removed. Entries that have
+ * not been updated for the lifetime of the cache are ignored and removed.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "picoquic_internal.h"
+
+static void picoquic_path_metrics_key(const struct sockaddr* addr, picoquic_path_metrics_t* key)
+{
+    memset(key, 0, sizeof(picoquic_path_metrics_t));
+    key->addr_family = addr->sa_family;
+    if (addr->sa_family == AF_INET) {
+        memcpy(key->prefix, &((struct sockaddr_in*)addr)->sin_addr, PICOQUIC_PATH_METRICS_PREFIX_V4);
+        key->prefix_length = PICOQUIC_PATH_METRICS_PREFIX_V4;
+    }
+    else if (addr->sa_family == AF_INET6) {
+        memcpy(key->prefix, &((struct sockaddr_in6*)addr)->sin6_addr, PICOQUIC_PATH_METRICS_PREFIX_V6);
+        key->prefix_length = PICOQUIC_PATH_METRICS_PREFIX_V6;
+    }
+}
+
+static uint64_t picoquic_path_metrics_hash(const void* key)
+{
+    const picoquic_path_metrics_t* metrics = (const picoquic_path_metrics_t*)key;
+
+    return picohash_hash_mix(picohash_bytes(metrics->prefix, metrics->prefix_length), metrics->addr_family);
+}
+
+static int picoquic_path_metrics_compare(const void* key1, const void* key2)
+{
+    const picoquic_path_metrics_t* metrics1 = (const picoquic_path_metrics_t*)key1;
+    const picoquic_path_metrics_t* metrics2 = (const picoquic_path_metrics_t*)key2;
+    int ret = -1;
+
+    if (metrics1->addr_family == metrics2->addr_family &&
+        metrics1->prefix_length == metrics2->prefix_length &&
+        memcmp(metrics1->prefix, metrics2->prefix, metrics1->prefix_length) == 0) {
+        ret = 0;
+    }
+    return ret;
+}
+
+static picohash_item* picoquic_path_metrics_to_item(const void* key)
+{
+    picoquic_path_metrics_t* metrics = (picoquic_path_metrics_t*)key;
+
+    return &metrics->hash_item;
+}
+
+static void picoquic_path_metrics_unlink(picoquic_quic_t* quic, picoquic_path_metrics_t* metrics)
+{
+    if (metrics->next_metrics == NULL) {
+        quic->path_metrics_last = metrics->previous_metrics;
+    }
+    else {
+        metrics->next_metrics->previous_metrics = metrics->previous_metrics;
+    }
+
+    if (metrics->previous_metrics == NULL) {
+        quic->path_metrics_first = metrics->next_metrics;
+    }
+    else {
+        metrics->previous_metrics->next_metrics = metrics->next_metrics;
+    }
+    metrics->next_metrics = NULL;
+    metrics->previous_metrics = NULL;
+}
+
+static void picoquic_path_metrics_link_first(picoquic_quic_t* quic, picoquic_path_metrics_t* metrics)
+{
+    metrics->previous_metrics = NULL;
+    metrics->next_metrics = quic->path_metrics_first;
+    if (metrics->next_metrics == NULL) {
+        quic->path_metrics_last = metrics;
+    }
+    else {
+        metrics->next_metrics->previous_metrics = metrics;
+    }
+    quic->path_metrics_first = metrics;
+}
+
+static void picoquic_delete_path_metrics(picoquic_quic_t* quic, picoquic_path_metrics_t* metrics)
+{
+    picoquic_path_metrics_unlink(quic, metrics);
+    picohash_delete_key(quic->table_path_metrics, metrics, 1);
+    if (quic->path_metrics_nb > 0) {
+        quic->path_metrics_nb--;
+    }
+}
+
+static int picoquic_path_metrics_is_stale(picoquic_quic_t* quic, picoquic_path_metrics_t* metrics, uint64_t current_time)
+{
+    return (current_time > metrics->last_update_time + quic->path_metrics_lifetime);
+}
+
+static void picoquic_path_metrics_prune(picoquic_quic_t* quic, uint64_t current_time)
+{
+    /* The list is ordered by update time, so stale entries are at the end */
+    while (quic->path_metrics_last != NULL &&
+        picoquic_path_metrics_is_stale(quic, quic->path_metrics_last, current_time)) {
+        picoquic_delete_path_metrics(quic, quic->path_metrics_last);
+    }
+}
+
+void picoquic_path_metrics_cache_free(picoquic_quic_t* quic)
+{
+    if (quic->table_path_metrics != NULL) {
+        picohash_delete(quic->table_path_metrics, 1);
+        quic->table_path_metrics = NULL;
+    }
+    quic->path_metrics_first = NULL;
+    quic->path_metrics_last = NULL;
+    quic->path_metrics_nb = 0;
+    quic->path_metrics_max = 0;
+}
+
+int picoquic_set_path_metrics_cache(picoquic_quic_t* quic, size_t max_entries, uint64_t lifetime_usec)
+{
+    int ret = 0;
+
+    if (max_entries == 0) {
+        picoquic_path_metrics_cache_free(quic);
+    }
+    else {
+        if (quic->table_path_metrics == NULL) {
+            quic->table_path_metrics = picohash_create_ex(max_entries, picoquic_path_metrics_hash,
+                picoquic_path_metrics_compare, picoquic_path_metrics_to_item);
+            if (quic->table_path_metrics == NULL) {
+                ret = PICOQUIC_ERROR_MEMORY;
+            }
+        }
+        if (ret == 0) {
+            quic->path_metrics_max = max_entries;
+            quic->path_metrics_lifetime = (lifetime_usec == 0) ? PICOQUIC_PATH_METRICS_LIFETIME_DEFAULT : lifetime_usec;
+            while (quic->path_metrics_nb > quic->path_metrics_max) {
+                picoquic_delete_path_metrics(quic, quic->path_metrics_last);
+            }
+        }
+    }
+
+    return ret;
+}
+
+picoquic_path_metrics_t* picoquic_retrieve_path_metrics(picoquic_quic_t* quic,
+    const struct sockaddr* addr, uint64_t current_time)
+{
+    picoquic_path_metrics_t* ret = NULL;
+
+    if (quic->table_path_metrics != NULL) {
+        picoquic_path_metrics_t key;
+        picohash_item* item;
+
+        picoquic_path_metrics_key(addr, &key);
+        if (key.prefix_length > 0 &&
+            (item = picohash_retrieve(quic->table_path_metrics, &key)) != NULL) {
+            ret = (picoquic_path_metrics_t*)item->key;
+            if (picoquic_path_metrics_is_stale(quic, ret, current_time)) {
+                picoquic_delete_path_metrics(quic, ret);
+                ret = NULL;
+            }
+        }
+    }
+    return ret;
+}
+
+int picoquic_remember_path_metrics(picoquic_quic_t* quic, const struct sockaddr* addr,
+    uint64_t rtt_min, uint64_t smoothed_rtt, uint64_t bandwidth, uint64_t loss_ppm, uint64_t current_time)
+{
+    int ret = 0;
+    picoquic_path_metrics_t* metrics;
+
+    if (quic->table_path_metrics == NULL) {
+        return 0;
+    }
+
+    picoquic_path_metrics_prune(quic, current_time);
+    metrics = picoquic_retrieve_path_metrics(quic, addr, current_time);
+    if (metrics != NULL) {
+        /* Merge the new sample in the moving averages */
+        metrics->rtt_min = (3 * metrics->rtt_min + rtt_min) / 4;
+        metrics->smoothed_rtt = (3 * metrics->smoothed_rtt + smoothed_rtt) / 4;
+        metrics->bandwidth = (3 * metrics->bandwidth + bandwidth) / 4;
+        metrics->loss_ppm = (3 * metrics->loss_ppm + loss_ppm) / 4;
+        metrics->nb_samples++;
+        metrics->last_update_time = current_time;
+        picoquic_path_metrics_unlink(quic, metrics);
+        picoquic_path_metrics_link_first(quic, metrics);
+    }
+    else {
+        picoquic_path_metrics_t key;
+
+        picoquic_path_metrics_key(addr, &key);
+        if (key.prefix_length == 0) {
+            return 0;
+        }
+        while (quic->path_metrics_nb >= quic->path_metrics_max && quic->path_metrics_last != NULL) {
+            picoquic_delete_path_metrics(quic, quic->path_metrics_last);
+        }
+        metrics = (picoquic_path_metrics_t*)malloc(sizeof(picoquic_path_metrics_t));
+        if (metrics == NULL) {
+            ret = PICOQUIC_ERROR_MEMORY;
+        }
+        else {
+            memcpy(metrics, &key, sizeof(picoquic_path_metrics_t));
+            metrics->rtt_min = rtt_min;
+            metrics->smoothed_rtt = smoothed_rtt;
+            metrics->bandwidth = bandwidth;
+            metrics->loss_ppm = loss_ppm;
+            metrics->nb_samples = 1;
+            metrics->last_update_time = current_time;
+            if (picohash_insert(quic->table_path_metrics, metrics) != 0) {
+                free(metrics);
+                ret = PICOQUIC_ERROR_MEMORY;
+            }
+            else {
+                picoquic_path_metrics_link_first(quic, metrics);
+                quic->path_metrics_nb++;
+            }
+        }
+    }
+
+    return ret;
+}
+
+/* Record the metrics of the default path when a server connection is deleted.
+ * Connections that never measured the RTT have nothing useful to report.
+ */
+void picoquic_record_path_metrics(picoquic_cnx_t* cnx, uint64_t current_time)
+{
+    picoquic_path_t* path_x = cnx->path[0];
+
+    if (!cnx->client_mode && cnx->quic->table_path_metrics != NULL &&
+        path_x != NULL && path_x->rtt_is_initialized && path_x->rtt_min > 0) {
+        uint64_t bandwidth = (path_x->bandwidth_estimate_max > 0) ?
+            path_x->bandwidth_estimate_max : path_x->bandwidth_estimate;
+        uint64_t loss_ppm = 0;
+
+        if (path_x->bytes_sent > 0) {
+            loss_ppm = (path_x->total_bytes_lost * 1000000ull) / path_x->bytes_sent;
+            if (loss_ppm > 1000000ull) {
+                loss_ppm = 1000000ull;
+            }
+        }
+        (void)picoquic_remember_path_metrics(cnx->quic, (struct sockaddr*)&path_x->peer_addr,
+            path_x->rtt_min, path_x->smoothed_rtt, bandwidth, loss_ppm, current_time);
+    }
+}
+
+/* Seed a new server connection with the metrics cached for the peer prefix.
+ * The initial RTT is applied immediately, and will be replaced by the first
+ * sample. The congestion window is seeded as the cached bandwidth delay
+ * product, unless the prefix experienced heavy losses.
+ */
+void picoquic_seed_path_from_metrics(picoquic_cnx_t* cnx, uint64_t current_time)
+{
+    picoquic_path_t* path_x = cnx->path[0];
+    picoquic_path_metrics_t* metrics;
+
+    if (cnx->client_mode || path_x == NULL || path_x->rtt_is_initialized ||
+        (metrics = picoquic_retrieve_path_metrics(cnx->quic,
+            (struct sockaddr*)&path_x->peer_addr, current_time)) == NULL) {
+        return;
+    }
+
+    if (metrics->smoothed_rtt > 0) {
+        path_x->smoothed_rtt = metrics->smoothed_rtt;
+        path_x->rtt_variant = metrics->smoothed_rtt / 2;
+        path_x->retransmit_timer = path_x->smoothed_rtt + 3 * path_x->rtt_variant;
+        if (path_x->retransmit_timer > PICOQUIC_INITIAL_MAX_RETRANSMIT_TIMER) {
+            path_x->retransmit_timer = PICOQUIC_INITIAL_MAX_RETRANSMIT_TIMER;
+        }
+    }
+
+    if (metrics->bandwidth > 0 && metrics->rtt_min > 0 &&
+        metrics->loss_ppm < PICOQUIC_PATH_METRICS_MAX_LOSS_PPM && cnx->seed_cwin == 0) {
+        uint64_t seed_cwin = (metrics->bandwidth * metrics->rtt_min) / 1000000ull;
+
+        if (seed_cwin > PICOQUIC_CWIN_INITIAL) {
+            uint8_t* ip_addr;
+            uint8_t ip_addr_length;
+
+            picoquic_get_ip_addr((struct sockaddr*)&path_x->peer_addr, &ip_addr, &ip_addr_length);
+            picoquic_seed_bandwidth(cnx, metrics->rtt_min, seed_cwin, ip_addr, ip_addr_length);
+        }
+    }
+}
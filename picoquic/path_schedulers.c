@@ -0,0 +1,265 @@
+/*
+* Copyright (c) 2026, the picoquic contributors.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Multipath path schedulers.
+ *
+ * The sender calls the scheduler of the connection with the list of
+ * candidate paths, see picoquic_select_next_path_mp in sender.c. The
+ * scheduler returns the path on which the next packet will be prepared.
+ * If no candidate has congestion window available, the schedulers fall
+ * back to the least recently used path that pacing allows, so that
+ * acknowledgements and control frames can still be sent.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "picoquic_internal.h"
+
+/* Select the least recently used candidate allowed by pacing, preferring
+ * candidates that also have congestion window available. This is the
+ * historic behavior of picoquic. */
+static int picoquic_path_select_least_recent(picoquic_cnx_t* cnx,
+    picoquic_path_candidate_t const* candidates, int nb_candidates)
+{
+    int path_cwin = -1;
+    int path_pacing = -1;
+    uint64_t last_sent_cwin = UINT64_MAX;
+    uint64_t last_sent_pacing = UINT64_MAX;
+
+    for (int i = 0; i < nb_candidates; i++) {
+        if (candidates[i].is_pacing_ok) {
+            uint64_t last_sent_time = cnx->path[candidates[i].path_id]->last_sent_time;
+
+            if (last_sent_time < last_sent_pacing) {
+                last_sent_pacing = last_sent_time;
+                path_pacing = candidates[i].path_id;
+            }
+            if (candidates[i].is_cwin_ok && last_sent_time < last_sent_cwin) {
+                last_sent_cwin = last_sent_time;
+                path_cwin = candidates[i].path_id;
+            }
+        }
+    }
+    return (path_cwin >= 0) ? path_cwin : path_pacing;
+}
+
+static int picoquic_default_path_select(picoquic_cnx_t* cnx,
+    picoquic_path_candidate_t const* candidates, int nb_candidates, uint64_t current_time)
+{
+    (void)current_time;
+    return picoquic_path_select_least_recent(cnx, candidates, nb_candidates);
+}
+
+/* Min RTT: send on the lowest RTT path that has congestion window available */
+static int picoquic_minrtt_path_select(picoquic_cnx_t* cnx,
+    picoquic_path_candidate_t const* candidates, int nb_candidates, uint64_t current_time)
+{
+    int path_id = -1;
+    uint64_t rtt_min = UINT64_MAX;
+    (void)current_time;
+
+    for (int i = 0; i < nb_candidates; i++) {
+        if (candidates[i].is_pacing_ok && candidates[i].is_cwin_ok &&
+            cnx->path[candidates[i].path_id]->smoothed_rtt < rtt_min) {
+            rtt_min = cnx->path[candidates[i].path_id]->smoothed_rtt;
+            path_id = candidates[i].path_id;
+        }
+    }
+    if (path_id < 0) {
+        path_id = picoquic_path_select_least_recent(cnx, candidates, nb_candidates);
+    }
+    return path_id;
+}
+
+/* Weighted round robin: start time fair queuing over the paths, with weights
+ * set to the bandwidth estimates. Each path has a virtual finish time, which
+ * is advanced by the duration of a full size packet at the path rate every
+ * time the path is selected. The path with the lowest virtual time is chosen.
+ * Paths that were idle do not accumulate credit: their virtual time is
+ * brought up to the virtual time of the last selection.
+ */
+static uint64_t picoquic_wrr_path_rate(picoquic_path_t* path_x)
+{
+    uint64_t rate = path_x->bandwidth_estimate;
+
+    if (rate == 0) {
+        uint64_t rtt = (path_x->smoothed_rtt > 0) ? path_x->smoothed_rtt : PICOQUIC_INITIAL_RTT;
+        rate = (path_x->cwin * 1000000) / rtt;
+    }
+    return (rate > 0) ? rate : 1;
+}
+
+static int picoquic_wrr_path_select(picoquic_cnx_t* cnx,
+    picoquic_path_candidate_t const* candidates, int nb_candidates, uint64_t current_time)
+{
+    int path_id = -1;
+    uint64_t virtual_time_min = UINT64_MAX;
+    (void)current_time;
+
+    for (int i = 0; i < nb_candidates; i++) {
+        picoquic_path_t* path_x = cnx->path[candidates[i].path_id];
+
+        if (path_x->sched_virtual_time < cnx->sched_virtual_time) {
+            path_x->sched_virtual_time = cnx->sched_virtual_time;
+        }
+        if (candidates[i].is_pacing_ok && candidates[i].is_cwin_ok &&
+            path_x->sched_virtual_time < virtual_time_min) {
+            virtual_time_min = path_x->sched_virtual_time;
+            path_id = candidates[i].path_id;
+        }
+    }
+    if (path_id >= 0) {
+        picoquic_path_t* path_x = cnx->path[path_id];
+
+        cnx->sched_virtual_time = path_x->sched_virtual_time;
+        path_x->sched_virtual_time += (path_x->send_mtu * 1000000) / picoquic_wrr_path_rate(path_x);
+    }
+    else {
+        path_id = picoquic_path_select_least_recent(cnx, candidates, nb_candidates);
+    }
+    return path_id;
+}
+
+/* BLEST: prefer the fastest path. If it is blocked by congestion control,
+ * only use a slower path if the receiver would not have to wait for data
+ * sent on that path. During one RTT of the slower path, the fastest path
+ * can send about cwin_fast * rtt_slow / rtt_fast bytes. If that does not
+ * fit in the flow control window that remains after the data in flight on
+ * the slow path and the next packet, sending on the slow path would cause
+ * head of line blocking: the scheduler waits for the fastest path instead.
+ * The original BLEST adapts a scaling factor for the estimate; this version
+ * uses a fixed factor of 1.
+ */
+static int picoquic_blest_path_select(picoquic_cnx_t* cnx,
+    picoquic_path_candidate_t const* candidates, int nb_candidates, uint64_t current_time)
+{
+    int fast_id = -1;
+    int slow_id = -1;
+    uint64_t fast_rtt = UINT64_MAX;
+    uint64_t slow_rtt = UINT64_MAX;
+    (void)current_time;
+
+    for (int i = 0; i < nb_candidates; i++) {
+        uint64_t rtt = cnx->path[candidates[i].path_id]->smoothed_rtt;
+
+        if (rtt < fast_rtt) {
+            fast_rtt = rtt;
+            fast_id = i;
+        }
+    }
+    if (fast_id < 0) {
+        return -1;
+    }
+    if (candidates[fast_id].is_pacing_ok && candidates[fast_id].is_cwin_ok) {
+        return candidates[fast_id].path_id;
+    }
+    for (int i = 0; i < nb_candidates; i++) {
+        if (i != fast_id && candidates[i].is_pacing_ok && candidates[i].is_cwin_ok &&
+            cnx->path[candidates[i].path_id]->smoothed_rtt < slow_rtt) {
+            slow_rtt = cnx->path[candidates[i].path_id]->smoothed_rtt;
+            slow_id = i;
+        }
+    }
+    if (slow_id >= 0) {
+        picoquic_path_t* fast_path = cnx->path[candidates[fast_id].path_id];
+        picoquic_path_t* slow_path = cnx->path[candidates[slow_id].path_id];
+        uint64_t fast_bytes = (fast_rtt > 0) ? (fast_path->cwin * slow_rtt) / fast_rtt : fast_path->cwin;
+        uint64_t window = (cnx->maxdata_remote > cnx->data_sent) ? cnx->maxdata_remote - cnx->data_sent : 0;
+        uint64_t slow_bytes = slow_path->bytes_in_transit + slow_path->send_mtu;
+
+        if (window > slow_bytes && fast_bytes <= window - slow_bytes) {
+            return candidates[slow_id].path_id;
+        }
+    }
+    /* Wait for the fastest path. Acknowledgements can still be sent on it if pacing allows. */
+    return (candidates[fast_id].is_pacing_ok) ? candidates[fast_id].path_id : -1;
+}
+
+#define PICOQUIC_DEFAULT_PATH_SCHEDULER_ID "default"
+#define PICOQUIC_MINRTT_PATH_SCHEDULER_ID "minrtt"
+#define PICOQUIC_WRR_PATH_SCHEDULER_ID "wrr"
+#define PICOQUIC_BLEST_PATH_SCHEDULER_ID "blest"
+#define PICOQUIC_REDUNDANT_PATH_SCHEDULER_ID "redundant"
+
+picoquic_path_scheduler_t picoquic_default_path_scheduler_struct = {
+    PICOQUIC_DEFAULT_PATH_SCHEDULER_ID, picoquic_default_path_select, 0
+};
+
+picoquic_path_scheduler_t picoquic_minrtt_path_scheduler_struct = {
+    PICOQUIC_MINRTT_PATH_SCHEDULER_ID, picoquic_minrtt_path_select, 0
+};
+
+picoquic_path_scheduler_t picoquic_wrr_path_scheduler_struct = {
+    PICOQUIC_WRR_PATH_SCHEDULER_ID, picoquic_wrr_path_select, 0
+};
+
+picoquic_path_scheduler_t picoquic_blest_path_scheduler_struct = {
+    PICOQUIC_BLEST_PATH_SCHEDULER_ID, picoquic_blest_path_select, 0
+};
+
+picoquic_path_scheduler_t picoquic_redundant_path_scheduler_struct = {
+    PICOQUIC_REDUNDANT_PATH_SCHEDULER_ID, picoquic_default_path_select, 1
+};
+
+picoquic_path_scheduler_t* picoquic_default_path_scheduler = &picoquic_default_path_scheduler_struct;
+picoquic_path_scheduler_t* picoquic_minrtt_path_scheduler = &picoquic_minrtt_path_scheduler_struct;
+picoquic_path_scheduler_t* picoquic_wrr_path_scheduler = &picoquic_wrr_path_scheduler_struct;
+picoquic_path_scheduler_t* picoquic_blest_path_scheduler = &picoquic_blest_path_scheduler_struct;
+picoquic_path_scheduler_t* picoquic_redundant_path_scheduler = &picoquic_redundant_path_scheduler_struct;
+
+picoquic_path_scheduler_t const* picoquic_get_path_scheduler(char const* scheduler_name)
+{
+    picoquic_path_scheduler_t const* schedulers[] = {
+        picoquic_default_path_scheduler,
+        picoquic_minrtt_path_scheduler,
+        picoquic_wrr_path_scheduler,
+        picoquic_blest_path_scheduler,
+        picoquic_redundant_path_scheduler
+    };
+    picoquic_path_scheduler_t const* scheduler = NULL;
+
+    if (scheduler_name != NULL) {
+        for (size_t i = 0; i < sizeof(schedulers) / sizeof(schedulers[0]); i++) {
+            if (strcmp(scheduler_name, schedulers[i]->path_scheduler_id) == 0) {
+                scheduler = schedulers[i];
+                break;
+            }
+        }
+    }
+    return scheduler;
+}
+
+void picoquic_set_default_path_scheduler(picoquic_quic_t* quic, picoquic_path_scheduler_t const* scheduler)
+{
+    quic->default_path_scheduler = (scheduler == NULL) ? picoquic_default_path_scheduler : scheduler;
+}
+
+void picoquic_set_path_scheduler(picoquic_cnx_t* cnx, picoquic_path_scheduler_t const* scheduler)
+{
+    cnx->path_scheduler = (scheduler == NULL) ? picoquic_default_path_scheduler : scheduler;
+}
+
+/* Packets carrying data of latency critical streams are repeated on another
+ * path by the redundant scheduler */
+int picoquic_is_stream_redundant(picoquic_cnx_t* cnx, picoquic_stream_head_t* stream)
+{
+    return cnx->is_multipath_enabled && cnx->path_scheduler->is_redundant &&
+        stream->stream_priority < cnx->quic->default_stream_priority;
+}
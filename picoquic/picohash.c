@@ -26,28 +26,185 @@
 #include <stdlib.h>
 #include <string.h>
 
+#define PICOHASH_SLOTS_MIN 8
+#define PICOHASH_MOVE_STEP 8
+
+/* Marks the slots of the previous table whose item was moved or deleted.
+ * The slot keeps its hash, so searches in the previous table remain valid. */
+static picohash_item picohash_moved_item;
+
+/* The slots hold the hash multiplied by the golden ratio, and the home slot
+ * is given by the high bits of that product, so that hashes differing only
+ * in their high bits spread well. */
+static uint64_t picohash_slot_hash(uint64_t hash)
+{
+    return hash * 0x9E3779B97F4A7C15ull;
+}
+
+static size_t picohash_distance(picohash_slot* slots, size_t nb_slots, int slot_shift, size_t index)
+{
+    return (index - (size_t)(slots[index].hash >> slot_shift)) & (nb_slots - 1);
+}
+
+static picohash_slot* picohash_find_slot(picohash_table* hash_table, picohash_slot* slots, size_t nb_slots,
+    int slot_shift, uint64_t slot_hash, const void* key, const picohash_item* item)
+{
+    size_t index = (size_t)(slot_hash >> slot_shift);
+    size_t distance = 0;
+
+    while (slots[index].item != NULL &&
+        picohash_distance(slots, nb_slots, slot_shift, index) >= distance) {
+        if (slots[index].hash == slot_hash && slots[index].item != &picohash_moved_item) {
+            if ((item != NULL) ? (slots[index].item == item) :
+                (hash_table->picohash_compare(key, slots[index].item->key) == 0)) {
+                return &slots[index];
+            }
+        }
+        index = (index + 1) & (nb_slots - 1);
+        distance++;
+    }
+
+    return NULL;
+}
+
+/* Place an item in the current table. Items with the same hash are kept from
+ * newest to oldest, so that retrieving a duplicate key returns the last
+ * inserted item. The item being inserted is the newest of its hash, and so
+ * is any item that it displaces, since that item was the first of its hash
+ * in the probe sequence. Items moved from the previous table are older than
+ * those of the current table with the same hash. */
+static void picohash_place(picohash_table* hash_table, uint64_t slot_hash, picohash_item* item, int is_newest)
+{
+    picohash_slot* slots = hash_table->slots;
+    size_t index = (size_t)(slot_hash >> hash_table->slot_shift);
+    size_t distance = 0;
+    picohash_slot placed;
+
+    placed.hash = slot_hash;
+    placed.item = item;
+    while (slots[index].item != NULL) {
+        size_t slot_distance = picohash_distance(slots, hash_table->nb_slots, hash_table->slot_shift, index);
+
+        if (slot_distance < distance ||
+            (is_newest && slot_distance == distance && slots[index].hash == placed.hash)) {
+            picohash_slot displaced = slots[index];
+            slots[index] = placed;
+            placed = displaced;
+            distance = slot_distance;
+            is_newest = 1;
+        }
+        index = (index + 1) & (hash_table->nb_slots - 1);
+        distance++;
+    }
+    slots[index] = placed;
+}
+
+/* Remove a slot of the current table, and shift back the following items */
+static void picohash_remove_slot(picohash_table* hash_table, size_t index)
+{
+    picohash_slot* slots = hash_table->slots;
+    size_t next = (index + 1) & (hash_table->nb_slots - 1);
+
+    while (slots[next].item != NULL &&
+        (size_t)(slots[next].hash >> hash_table->slot_shift) != next) {
+        slots[index] = slots[next];
+        index = next;
+        next = (next + 1) & (hash_table->nb_slots - 1);
+    }
+    slots[index].hash = 0;
+    slots[index].item = NULL;
+}
+
+/* Move up to nb_steps slots of the previous table to the current one.
+ * The scan starts after an empty slot, so that the items of a cluster
+ * wrapping around the end of the table are moved in probe order. */
+static void picohash_move_old_items(picohash_table* hash_table, size_t nb_steps)
+{
+    while (hash_table->old_slots != NULL && nb_steps > 0) {
+        if (hash_table->nb_old_items == 0 || hash_table->old_index >= hash_table->nb_old_slots) {
+            free(hash_table->old_slots);
+            hash_table->old_slots = NULL;
+            hash_table->nb_old_slots = 0;
+            hash_table->old_start = 0;
+            hash_table->old_index = 0;
+            hash_table->nb_old_items = 0;
+        }
+        else {
+            picohash_slot* slot = &hash_table->old_slots[(hash_table->old_start + hash_table->old_index++) &
+                (hash_table->nb_old_slots - 1)];
+
+            if (slot->item != NULL && slot->item != &picohash_moved_item) {
+                picohash_place(hash_table, slot->hash, slot->item, 0);
+                slot->item = &picohash_moved_item;
+                hash_table->nb_old_items--;
+            }
+            nb_steps--;
+        }
+    }
+}
+
+static int picohash_grow(picohash_table* hash_table)
+{
+    int ret = 0;
+    picohash_slot* slots;
+    size_t nb_slots = 2 * hash_table->nb_slots;
+
+    /* Complete the previous resize before starting a new one */
+    picohash_move_old_items(hash_table, SIZE_MAX);
+
+    if (nb_slots < hash_table->nb_slots || nb_slots > SIZE_MAX / sizeof(picohash_slot) ||
+        (slots = (picohash_slot*)malloc(nb_slots * sizeof(picohash_slot))) == NULL) {
+        ret = -1;
+    }
+    else {
+        memset(slots, 0, nb_slots * sizeof(picohash_slot));
+        hash_table->old_slots = hash_table->slots;
+        hash_table->nb_old_slots = hash_table->nb_slots;
+        hash_table->old_slot_shift = hash_table->slot_shift;
+        hash_table->old_start = 0;
+        hash_table->old_index = 0;
+        hash_table->nb_old_items = hash_table->count;
+        while (hash_table->old_start < hash_table->nb_old_slots &&
+            hash_table->old_slots[hash_table->old_start].item != NULL) {
+            hash_table->old_start++;
+        }
+        hash_table->slots = slots;
+        hash_table->nb_slots = nb_slots;
+        hash_table->slot_shift--;
+    }
+
+    return ret;
+}
+
 picohash_table* picohash_create_ex(size_t nb_bin,
     uint64_t (*picohash_hash)(const void*),
     int (*picohash_compare)(const void*, const void*),
     picohash_item * (*picohash_key_to_item)(const void*))
 {
     picohash_table* t = (picohash_table*)malloc(sizeof(picohash_table));
-    size_t items_length = sizeof(picohash_item*) * nb_bin;
-    t->hash_bin = NULL;
-    if (t != NULL && (items_length / sizeof(picohash_item*)) == nb_bin) {
-        t->hash_bin = (picohash_item**)malloc(sizeof(picohash_item*) * nb_bin);
+    size_t nb_slots = PICOHASH_SLOTS_MIN;
+    int slot_shift = 61;
+
+    while (nb_slots < nb_bin && nb_slots <= (SIZE_MAX / sizeof(picohash_slot)) / 2) {
+        nb_slots *= 2;
+        slot_shift--;
     }
 
-    if (t->hash_bin == NULL) {
-        free(t);
-        t = NULL;
-    } else {
-        (void)memset(t->hash_bin, 0, sizeof(picohash_item*) * nb_bin);
-        t->nb_bin = nb_bin;
-        t->count = 0;
-        t->picohash_hash = picohash_hash;
-        t->picohash_compare = picohash_compare;
-        t->picohash_key_to_item = picohash_key_to_item;
+    if (t != NULL) {
+        memset(t, 0, sizeof(picohash_table));
+        t->slots = (picohash_slot*)malloc(sizeof(picohash_slot) * nb_slots);
+        if (t->slots == NULL) {
+            free(t);
+            t = NULL;
+        }
+        else {
+            (void)memset(t->slots, 0, sizeof(picohash_slot) * nb_slots);
+            t->nb_slots = nb_slots;
+            t->slot_shift = slot_shift;
+            t->picohash_hash = picohash_hash;
+            t->picohash_compare = picohash_compare;
+            t->picohash_key_to_item = picohash_key_to_item;
+        }
     }
 
     return t;
@@ -62,29 +219,32 @@ picohash_table* picohash_create(size_t nb_bin,
 
 picohash_item* picohash_retrieve(picohash_table* hash_table, const void* key)
 {
-    uint64_t hash = hash_table->picohash_hash(key);
-    uint32_t bin = (uint32_t)(hash % hash_table->nb_bin);
-    picohash_item* item = hash_table->hash_bin[bin];
-
-    while (item != NULL) {
-        if (hash_table->picohash_compare(key, item->key) == 0) {
-            break;
-        } else {
-            item = item->next_in_bin;
-        }
+    uint64_t slot_hash = picohash_slot_hash(hash_table->picohash_hash(key));
+    picohash_slot* slot = picohash_find_slot(hash_table, hash_table->slots, hash_table->nb_slots,
+        hash_table->slot_shift, slot_hash, key, NULL);
+
+    if (slot == NULL && hash_table->old_slots != NULL) {
+        slot = picohash_find_slot(hash_table, hash_table->old_slots, hash_table->nb_old_slots,
+            hash_table->old_slot_shift, slot_hash, key, NULL);
     }
 
-    return item;
+    return (slot == NULL) ? NULL : slot->item;
 }
 
 int picohash_insert(picohash_table* hash_table, const void* key)
 {
     uint64_t hash = hash_table->picohash_hash(key);
-    uint32_t bin = (uint32_t)(hash % hash_table->nb_bin);
     int ret = 0;
-    picohash_item* item;
-    
-    if (hash_table->picohash_key_to_item == NULL) {
+    picohash_item* item = NULL;
+
+    picohash_move_old_items(hash_table, PICOHASH_MOVE_STEP);
+
+    if (2 * (hash_table->count + 1) > hash_table->nb_slots &&
+        picohash_grow(hash_table) != 0 && hash_table->count + 1 >= hash_table->nb_slots) {
+        /* Cannot grow, and no room left */
+        ret = -1;
+    }
+    else if (hash_table->picohash_key_to_item == NULL) {
         item = (picohash_item*)malloc(sizeof(picohash_item));
     }
     else {
@@ -96,8 +256,7 @@ int picohash_insert(picohash_table* hash_table, const void* key)
     } else {
         item->hash = hash;
         item->key = key;
-        item->next_in_bin = hash_table->hash_bin[bin];
-        hash_table->hash_bin[bin] = item;
+        picohash_place(hash_table, picohash_slot_hash(hash), item, 1);
         hash_table->count++;
     }
 
@@ -106,23 +265,34 @@ int picohash_insert(picohash_table* hash_table, const void* key)
 
 void picohash_delete_item(picohash_table* hash_table, picohash_item* item, int delete_key_too)
 {
-    uint32_t bin = (uint32_t)(item->hash % hash_table->nb_bin);
-    picohash_item* previous = hash_table->hash_bin[bin];
     const void* shall_delete = NULL;
+    uint64_t slot_hash = picohash_slot_hash(item->hash);
+    picohash_slot* slot;
 
-    if (previous == item) {
-        hash_table->hash_bin[bin] = item->next_in_bin;
-        hash_table->count--;
-    } else {
-        while (previous != NULL) {
-            if (previous->next_in_bin == item) {
-                previous->next_in_bin = item->next_in_bin;
-                hash_table->count--;
-                break;
-            } else {
-                previous = previous->next_in_bin;
-            }
+    picohash_move_old_items(hash_table, PICOHASH_MOVE_STEP);
+
+    if (hash_table->old_slots == NULL) {
+        /* The item can only be in the current table */
+        size_t index = (size_t)(slot_hash >> hash_table->slot_shift);
+
+        while (hash_table->slots[index].item != item && hash_table->slots[index].item != NULL) {
+            index = (index + 1) & (hash_table->nb_slots - 1);
         }
+        slot = (hash_table->slots[index].item == item) ? &hash_table->slots[index] : NULL;
+    }
+    else {
+        slot = picohash_find_slot(hash_table, hash_table->slots, hash_table->nb_slots,
+            hash_table->slot_shift, slot_hash, NULL, item);
+    }
+    if (slot != NULL) {
+        picohash_remove_slot(hash_table, (size_t)(slot - hash_table->slots));
+        hash_table->count--;
+    }
+    else if (hash_table->old_slots != NULL && (slot = picohash_find_slot(hash_table, hash_table->old_slots,
+        hash_table->nb_old_slots, hash_table->old_slot_shift, slot_hash, NULL, item)) != NULL) {
+        slot->item = &picohash_moved_item;
+        hash_table->nb_old_items--;
+        hash_table->count--;
     }
 
     shall_delete = item->key;
@@ -148,26 +318,44 @@ void picohash_delete_key(picohash_table* hash_table, void* key, int delete_key_t
     }
 }
 
+picohash_item* picohash_next_item(const picohash_table* hash_table, size_t* position)
+{
+    picohash_item* item = NULL;
+
+    while (item == NULL && *position < hash_table->nb_old_slots + hash_table->nb_slots) {
+        if (*position < hash_table->nb_old_slots) {
+            item = hash_table->old_slots[*position].item;
+            if (item == &picohash_moved_item) {
+                item = NULL;
+            }
+        }
+        else {
+            item = hash_table->slots[*position - hash_table->nb_old_slots].item;
+        }
+        (*position)++;
+    }
+
+    return item;
+}
+
 void picohash_delete(picohash_table* hash_table, int delete_key_too)
 {
-    for (uint32_t i = 0; i < hash_table->nb_bin; i++) {
-        picohash_item* item = hash_table->hash_bin[i];
-        while (item != NULL) {
-            picohash_item* tmp = item;
-            const void* key_to_delete = tmp->key;
+    size_t position = 0;
+    picohash_item* item;
 
-            item = item->next_in_bin;
+    while ((item = picohash_next_item(hash_table, &position)) != NULL) {
+        const void* key_to_delete = item->key;
 
-            if (hash_table->picohash_key_to_item == NULL) {
-                free(tmp);
-            }
-            if (delete_key_too) {
-                free((void*)key_to_delete);
-            }
+        if (hash_table->picohash_key_to_item == NULL) {
+            free(item);
+        }
+        if (delete_key_too) {
+            free((void*)key_to_delete);
         }
     }
 
-    free(hash_table->hash_bin);
+    free(hash_table->old_slots);
+    free(hash_table->slots);
     free(hash_table);
 }
 
@@ -33,16 +33,45 @@
 extern "C" {
 #endif
 
+/*
+ * The table uses open addressing with linear probing, in "Robin Hood" order:
+ * items that are further from their home slot take precedence over those
+ * closer to it, and a search stops as soon as it meets an item closer to its
+ * home than the searched key would be. Each slot holds the hash of its item,
+ * so the compare function is only called when the hashes match. If several
+ * items have the same key, the last inserted one is retrieved first.
+ *
+ * Deleted items are removed by shifting back the following items of their
+ * cluster, so the table holds no tombstones and its load is the number of
+ * live items.
+ *
+ * When the table is more than half full, a table twice larger is allocated.
+ * New items are inserted in the new table, and a few items of the previous
+ * table are moved at each insertion or deletion, so that the cost of
+ * resizing is spread over many operations. Until all items are moved,
+ * searches look at both tables.
+ */
 typedef struct _picohash_item {
     uint64_t hash;
-    struct _picohash_item* next_in_bin;
     const void* key;
 } picohash_item;
 
+typedef struct _picohash_slot {
+    uint64_t hash;
+    picohash_item* item;
+} picohash_slot;
+
 typedef struct picohash_table {
     /* TODO: lock ! */
-    picohash_item** hash_bin;
-    size_t nb_bin;
+    picohash_slot* slots;
+    size_t nb_slots; /* power of 2 */
+    int slot_shift; /* 64 - log2(nb_slots) */
+    picohash_slot* old_slots; /* previous slots, while items are moved */
+    size_t nb_old_slots;
+    int old_slot_shift;
+    size_t old_start; /* first previous slot to move, after an empty one */
+    size_t old_index; /* number of previous slots already scanned */
+    size_t nb_old_items;
     size_t count;
     uint64_t (*picohash_hash)(const void*);
     int (*picohash_compare)(const void*, const void*);
@@ -68,6 +97,10 @@ void picohash_delete_key(picohash_table* hash_table, void* key, int delete_key_t
 
 void picohash_delete(picohash_table* hash_table, int delete_key_too);
 
+/* Enumerate the items in the table, starting with *position = 0, until NULL is
+ * returned. The table shall not be modified during the enumeration. */
+picohash_item* picohash_next_item(const picohash_table* hash_table, size_t* position);
+
 uint64_t picohash_hash_mix(uint64_t hash, uint64_t h2);
 
 uint64_t picohash_bytes(const uint8_t* key, uint32_t length);
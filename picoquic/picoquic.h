@@ -480,6 +480,18 @@ void picoquic_set_random_initial(picoquic_quic_t* quic, int random_initial);
 /* Set the "packet train" mode for pacing */
 void picoquic_set_packet_train_mode(picoquic_quic_t* quic, int train_mode);
 
+/* Offload pacing to the kernel, e.g., using SO_TXTIME and the fq qdisc.
+ * If horizon_usec > 0, pacing authorizes sending packets up to horizon_usec
+ * microseconds before their scheduled departure time. The departure
+ * time of the last train prepared by picoquic_prepare_next_packet_ex
+ * is then returned by picoquic_get_train_departure_time, and the
+ * application must pass it to the socket. Trains are cut short so that
+ * no packet is paced more than a packet interval after that time. Set horizon_usec to 0 to
+ * pace in user space, which is the default.
+ */
+void picoquic_set_pacing_offload(picoquic_quic_t* quic, uint64_t horizon_usec);
+uint64_t picoquic_get_train_departure_time(picoquic_quic_t* quic);
+
 /* set the padding policy.
  * The padding policy is parameterized by two variables:
  * - packets shorter than padding_min_size will be padded to that size.
@@ -656,6 +668,43 @@ void picoquic_set_default_multipath_option(picoquic_quic_t* quic, int multipath_
 /* Set the Address Discovery mode for the context */
 void picoquic_set_default_address_discovery_mode(picoquic_quic_t* quic, int mode);
 
+/* Select the structure used to order connections by wake time.
+ * The default splay tree costs O(log n) per update. The timing wheel
+ * reinserts connections in O(1), which helps servers handling large
+ * numbers of mostly idle connections. The scheduler should be set
+ * right after picoquic_create. If connections already exist, they are
+ * moved to the new structure. Returns -1 if memory allocation fails.
+ */
+typedef enum {
+    picoquic_wake_scheduler_splay = 0,
+    picoquic_wake_scheduler_wheel = 1
+} picoquic_wake_scheduler_enum;
+
+int picoquic_set_wake_scheduler(picoquic_quic_t* quic, picoquic_wake_scheduler_enum wake_scheduler);
+
+/* Packet pool management.
+ * Packets are preallocated in slabs. The pool size can be capped for low
+ * memory deployments: when max_packets is reached, packet allocation fails
+ * and transmission is delayed until packets are acknowledged and recycled.
+ * The default value 0 means no limit.
+ * The statistics give the number of allocation requests, the number of
+ * requests served from preallocated packets, the current and maximum
+ * number of packets allocated, and the number of failed requests.
+ */
+typedef struct st_picoquic_packet_pool_stats_t {
+    uint64_t nb_requests;
+    uint64_t nb_pool_hits;
+    size_t nb_slabs;
+    size_t nb_allocated;
+    size_t nb_in_pool;
+    size_t nb_allocated_max;
+    size_t max_packets;
+    uint64_t nb_exhausted;
+} picoquic_packet_pool_stats_t;
+
+void picoquic_set_packet_pool_max(picoquic_quic_t* quic, size_t max_packets);
+void picoquic_get_packet_pool_stats(picoquic_quic_t* quic, picoquic_packet_pool_stats_t* stats);
+
 /** picoquic_set_cwin_max:
  * Set a maximum value for the congestion window (default: UINT64_MAX)
  * This option can be used to limit the amount of memory that the sender
@@ -678,6 +727,20 @@ void picoquic_set_default_address_discovery_mode(picoquic_quic_t* quic, int mode
  */
 void picoquic_set_cwin_max(picoquic_quic_t* quic, uint64_t cwin_max);
 
+/* picoquic_set_path_metrics_cache:
+ * Enable a server side cache of path metrics, keyed by the prefix of the
+ * peer address (/24 for IPv4, /48 for IPv6). The min RTT, smoothed RTT,
+ * bandwidth and loss rate of server connections are recorded when the
+ * connections are deleted, and used to set the initial RTT and to seed
+ * the congestion window of new connections from the same prefix.
+ * The cache holds at most max_entries, and entries that were not updated
+ * for lifetime_usec are ignored. If lifetime_usec is 0, a default of
+ * 10 minutes is used. Setting max_entries to 0 disables the cache.
+ * Returns 0 on success, PICOQUIC_ERROR_MEMORY if the table cannot be
+ * allocated.
+ */
+int picoquic_set_path_metrics_cache(picoquic_quic_t* quic, size_t max_entries, uint64_t lifetime_usec);
+
 /* picoquic_set_max_data_limit: 
 * set a maximum value for the "max data" option, thus limiting the
 * amount of data that the peer will be able to send before data is
@@ -692,6 +755,20 @@ void picoquic_set_cwin_max(picoquic_quic_t* quic, uint64_t cwin_max);
 */
 void picoquic_set_max_data_control(picoquic_quic_t* quic, uint64_t max_data);
 
+/* picoquic_set_receive_window_tuning:
+* enable dynamic tuning of the receive windows, for connection and
+* stream flow control. Once per RTT, the window is set from the rate
+* at which the application consumes data: it grows when flow control
+* limits the throughput, and shrinks when the application reads slowly,
+* but never below the initial value from the transport parameters.
+* The sum of the connection windows is bounded by memory_budget, in
+* bytes, shared by all connections in the context. Setting the budget
+* to 0 (default) disables tuning. A static limit set with
+* picoquic_set_max_data_control takes precedence for the connection
+* window.
+*/
+void picoquic_set_receive_window_tuning(picoquic_quic_t* quic, uint64_t memory_budget);
+
 /*
 * Idle timeout and handshake timeout
 * 
@@ -725,6 +802,38 @@ void picoquic_set_default_crypto_epoch_length(picoquic_quic_t* quic, uint64_t cr
 
 uint64_t picoquic_get_default_crypto_epoch_length(picoquic_quic_t* quic);
 
+/* Hibernation of idle connections.
+ * A connection that has no data in flight and nothing queued for sending
+ * during the hibernation delay releases the state that can be recreated
+ * on demand: congestion control state, index of packets in flight, copies
+ * of packets kept for spurious loss detection, unused reassembly buffers.
+ * The keys, connection IDs, flow control limits and RTT estimates are
+ * kept. The connection is woken up when the next packet arrives, or when
+ * the application schedules data, and congestion control restarts from
+ * the initial window, as recommended after an idle period.
+ *
+ * The delay is set per QUIC context before creating connections, in
+ * microseconds, with `0` (the default) meaning that connections never
+ * hibernate.
+ */
+void picoquic_set_default_hibernation_delay(picoquic_quic_t* quic, uint64_t hibernation_delay_us);
+void picoquic_set_hibernation_delay(picoquic_cnx_t* cnx, uint64_t hibernation_delay_us);
+int picoquic_is_cnx_hibernating(picoquic_cnx_t* cnx);
+
+/* Crypto workers.
+ * Spread the AEAD encryption of the 1-RTT packets in a packet train, and
+ * the decryption of 1-RTT packets received in a batch, between the
+ * thread that runs the QUIC context and `nb_workers` worker threads, up
+ * to 16. Packets are still sent and processed in order. The workers use
+ * their own copies of the keys, created when the 1-RTT keys are set,
+ * so the function should be called before creating connections. Setting
+ * `0` stops the workers. Returns -1 if the workers cannot be created,
+ * which is always the case on Windows.
+ * The gain depends on the cost of the AEAD relative to the rest of the
+ * processing, and has not been measured: this option is experimental.
+ */
+int picoquic_set_crypto_workers(picoquic_quic_t* quic, int nb_workers);
+
 /* Get the local CID length */
 uint8_t picoquic_get_local_cid_length(picoquic_quic_t* quic);
 
@@ -1085,6 +1194,37 @@ int picoquic_incoming_packet_ex(
     picoquic_cnx_t** first_cnx,
     uint64_t current_time);
 
+/* The batch API processes an array of datagrams, typically obtained from
+ * a single batched socket receive call. The datagrams are grouped by
+ * connection, and the datagrams in a group are processed in arrival
+ * order, reusing the connection context resolved for the first one.
+ * The reinsertion of connections in the wake up list is deferred until
+ * the end of the batch, so that each connection is rescheduled once
+ * instead of once per packet. Receiving packets only marks ACKs as
+ * needed; whether to send an ACK is decided when the connection is
+ * next scheduled for sending, so that decision is also made once per
+ * batch, with all the packets of the batch accounted for.
+ * On return, *last_cnx is set to the context of the last datagram
+ * processed, if any.
+ */
+#define PICOQUIC_INCOMING_BATCH_MAX 64
+
+typedef struct st_picoquic_incoming_datagram_t {
+    uint8_t* bytes;
+    size_t length;
+    struct sockaddr* addr_from;
+    struct sockaddr* addr_to;
+    int if_index_to;
+    unsigned char received_ecn;
+} picoquic_incoming_datagram_t;
+
+int picoquic_incoming_packets_batch(
+    picoquic_quic_t* quic,
+    picoquic_incoming_datagram_t* datagrams,
+    size_t nb_datagrams,
+    picoquic_cnx_t** last_cnx,
+    uint64_t current_time);
+
 /* Applications must regularly poll the "next packet" API to obtain the
  * next packet that will be set over the network. The API for that is
  * picoquic_prepare_next_packet", which operates on a "quic context".
@@ -1173,6 +1313,47 @@ typedef int (*picoquic_stream_direct_receive_fn)(picoquic_cnx_t* cnx,
 int picoquic_mark_direct_receive_stream(picoquic_cnx_t* cnx,
     uint64_t stream_id, picoquic_stream_direct_receive_fn direct_receive_fn, void* direct_receive_ctx);
 
+/* Zero copy receive.
+ *
+ * Applications that forward stream data, such as proxies, can avoid copying
+ * it by marking a stream as "zero copy receive". Picoquic then keeps the
+ * decrypted packets that carry the stream data, and the application accesses
+ * the data through "views" of these packets, each describing a pointer,
+ * a length, and the stream offset of the first byte.
+ *
+ * The notification function is called when more data is available in
+ * sequence, with the number of bytes available past the consumed offset,
+ * and with is_fin set if all the data up to the fin offset is available.
+ * The application obtains the views by calling picoquic_get_stream_views,
+ * which returns the number of views copied in the array. The first view
+ * starts at the consumed offset. The application calls
+ * picoquic_consume_stream_views when it is done with some number of
+ * bytes. The packets are released when all the views that refer to them
+ * are consumed, and the flow control window is updated. The views remain
+ * valid until consumed, or until the stream is deleted. Consuming all the
+ * data up to the fin offset completes the reception on the stream.
+ *
+ * If stream data was queued at the time picoquic_mark_zero_copy_receive_stream
+ * is called, it is copied in new views, and the notification function is
+ * called immediately. The zero copy mode takes precedence over the direct
+ * receive mode. The notification function returns 0, or an error code that
+ * is handled as for the direct receive callback.
+ */
+typedef int (*picoquic_stream_zero_copy_fn)(picoquic_cnx_t* cnx,
+    uint64_t stream_id, size_t nb_bytes_available, int is_fin, void* zero_copy_ctx);
+
+typedef struct st_picoquic_stream_view_t {
+    const uint8_t* bytes;
+    size_t length;
+    uint64_t offset;
+} picoquic_stream_view_t;
+
+int picoquic_mark_zero_copy_receive_stream(picoquic_cnx_t* cnx,
+    uint64_t stream_id, picoquic_stream_zero_copy_fn zero_copy_fn, void* zero_copy_ctx);
+size_t picoquic_get_stream_views(picoquic_cnx_t* cnx, uint64_t stream_id,
+    picoquic_stream_view_t* views, size_t nb_views_max);
+int picoquic_consume_stream_views(picoquic_cnx_t* cnx, uint64_t stream_id, size_t nb_bytes);
+
 /* Associate stream with app context */
 int picoquic_set_app_stream_ctx(picoquic_cnx_t* cnx,
     uint64_t stream_id, void* app_stream_ctx);
@@ -1299,6 +1480,33 @@ void picoquic_reset_stream_ctx(picoquic_cnx_t* cnx, uint64_t stream_id);
  */
 int picoquic_add_to_stream_with_ctx(picoquic_cnx_t * cnx, uint64_t stream_id, const uint8_t * data, size_t length, int set_fin, void * app_stream_ctx);
 
+/* Queue data on a stream by reference, without copying it. The buffer is
+ * owned by the application, and must remain valid and unchanged until the
+ * release function is called. The release function is called once, either
+ * with is_acknowledged = 1 when all the data up to the end of the buffer
+ * has been acknowledged by the peer, or with is_acknowledged = 0 if the
+ * stream is reset or deleted before that. The release function may be NULL,
+ * in which case the application must keep the buffer until the stream
+ * is closed. If the call returns an error, the release function is not
+ * called, the buffer is not referenced by the stack, and the FIN is not set.
+ * The iovec variant queues the buffers in order, as a single segment for
+ * the purpose of the release callback, which is called after the last
+ * buffer of the list is acknowledged.
+ */
+typedef void (*picoquic_stream_data_release_fn)(void* release_ctx, int is_acknowledged);
+
+typedef struct st_picoquic_iovec_t {
+    const uint8_t* base;
+    size_t len;
+} picoquic_iovec_t;
+
+int picoquic_add_to_stream_by_reference(picoquic_cnx_t* cnx, uint64_t stream_id,
+    const uint8_t* data, size_t length, int set_fin,
+    picoquic_stream_data_release_fn release_fn, void* release_ctx);
+int picoquic_add_iovec_to_stream_by_reference(picoquic_cnx_t* cnx, uint64_t stream_id,
+    const picoquic_iovec_t* iov, size_t nb_iov, int set_fin,
+    picoquic_stream_data_release_fn release_fn, void* release_ctx);
+
 /* Reset a stream, indicating that no more data will be sent on 
  * that stream and that any data currently queued can be abandoned. */
 int picoquic_reset_stream(picoquic_cnx_t* cnx,
@@ -1512,12 +1720,67 @@ extern picoquic_congestion_algorithm_t* picoquic_bbr1_algorithm;
 
 picoquic_congestion_algorithm_t const* picoquic_get_congestion_algorithm(char const* alg_name);
 
+/* Enumerate the names accepted by picoquic_get_congestion_algorithm.
+ * Returns the name at rank index, or NULL if index is past the last one. */
+char const* picoquic_get_congestion_algorithm_name(size_t index);
+
 void picoquic_set_default_congestion_algorithm(picoquic_quic_t* quic, picoquic_congestion_algorithm_t const* algo);
 
 void picoquic_set_default_congestion_algorithm_by_name(picoquic_quic_t* quic, char const* alg_name);
 
 void picoquic_set_congestion_algorithm(picoquic_cnx_t* cnx, picoquic_congestion_algorithm_t const* algo);
 
+/* Multipath path scheduler definition.
+ * When multipath is enabled, the sender first serves the path challenges
+ * and the pending acknowledgements. It then lists as candidates the
+ * validated paths of highest priority, i.e., paths that are not standby
+ * and have the fewest pending retransmissions. If the next stream or a
+ * datagram has affinity to a path with congestion window available, that
+ * path is selected. Otherwise, the path scheduler of the connection selects
+ * one of the candidates. The scheduler may select a candidate that is
+ * allowed by pacing but blocked by congestion control, in order to wait
+ * for that path, or return -1 to wait until pacing allows sending.
+ *
+ * The built in schedulers are:
+ * - "default": least recently used path with congestion window available,
+ * - "minrtt": lowest RTT path with congestion window available,
+ * - "wrr": weighted round robin, in proportion of the bandwidth estimates,
+ * - "blest": lowest RTT path, but only use a slower path if the data sent
+ *   on it would not cause head of line blocking at the receiver,
+ * - "redundant": same as "default", but packets carrying data of latency
+ *   critical streams, i.e., streams with a priority value lower than the
+ *   default, are repeated on another path when that path has spare capacity.
+ * Only the selection logic of these schedulers is tested. Their effect on
+ * goodput and latency has not been measured.
+ */
+typedef struct st_picoquic_path_candidate_t {
+    int path_id;
+    unsigned int is_pacing_ok : 1; /* Pacing allows sending on this path now */
+    unsigned int is_cwin_ok : 1; /* Congestion window of the path is not full */
+} picoquic_path_candidate_t;
+
+typedef int (*picoquic_path_scheduler_select)(picoquic_cnx_t* cnx,
+    picoquic_path_candidate_t const* candidates, int nb_candidates, uint64_t current_time);
+
+typedef struct st_picoquic_path_scheduler_t {
+    char const* path_scheduler_id;
+    picoquic_path_scheduler_select select_path;
+    int is_redundant;
+} picoquic_path_scheduler_t;
+
+extern picoquic_path_scheduler_t* picoquic_default_path_scheduler;
+extern picoquic_path_scheduler_t* picoquic_minrtt_path_scheduler;
+extern picoquic_path_scheduler_t* picoquic_wrr_path_scheduler;
+extern picoquic_path_scheduler_t* picoquic_blest_path_scheduler;
+extern picoquic_path_scheduler_t* picoquic_redundant_path_scheduler;
+
+picoquic_path_scheduler_t const* picoquic_get_path_scheduler(char const* scheduler_name);
+
+void picoquic_set_default_path_scheduler(picoquic_quic_t* quic, picoquic_path_scheduler_t const* scheduler);
+
+/* Set the path scheduler of a connection. Setting NULL selects the default scheduler. */
+void picoquic_set_path_scheduler(picoquic_cnx_t* cnx, picoquic_path_scheduler_t const* scheduler);
+
 /* Special code for Wi-Fi network. These networks are subject to occasional
  * "suspension", for power saving reasons. If the suspension is too long,
  * it causes transmission to stop after cngestion control credits are
@@ -47,7 +47,10 @@ extern "C" {
 #define PICOQUIC_DEFAULT_0RTT_WINDOW (10*PICOQUIC_ENFORCED_INITIAL_MTU)
 #define PICOQUIC_NB_PATH_TARGET 8
 #define PICOQUIC_NB_PATH_DEFAULT 2
+#define PICOQUIC_NB_PATH_CANDIDATES_MAX 32
 #define PICOQUIC_MAX_PACKETS_IN_POOL 0x2000
+#define PICOQUIC_SENT_RING_MIN 0x100
+#define PICOQUIC_SENT_RING_MAX 0x100000
 #define PICOQUIC_STORED_IP_MAX 16
 
 #define PICOQUIC_INITIAL_RTT 250000ull /* 250 ms */
@@ -362,16 +365,39 @@ typedef struct st_picoquic_stream_data_node_t {
     uint64_t offset;  /* Stream offset of the first octet in "bytes" */
     size_t length;    /* Number of octets in "bytes" */
     const uint8_t* bytes;
+    int nb_views; /* Number of zero copy views referring to "data" */
+    int is_decoding; /* The packet in "data" is being decoded, recycling is left to the decoder */
     uint8_t data[PICOQUIC_MAX_PACKET_SIZE];
 } picoquic_stream_data_node_t;
 
-/* Data structure used to hold chunk of stream data queued by application */
+/* View of received stream data, for the zero copy receive API. The view
+ * holds a reference to the data node containing the bytes, which is
+ * either the decrypted packet or a copy.
+ */
+typedef struct st_picoquic_stream_view_node_t {
+    struct st_picoquic_stream_view_node_t* next_view;
+    picoquic_stream_data_node_t* data_node;
+    const uint8_t* bytes;
+    uint64_t offset;
+    size_t length;
+} picoquic_stream_view_node_t;
+
+/* Data structure used to hold chunk of stream data queued by application.
+ * If "is_reference" is set, "bytes" points to a buffer owned by the application,
+ * which is not freed by the stack. Once the chunk is sent, the node moves to
+ * the stream's release queue, and "release_fn" is called when all the bytes
+ * up to "stream_offset_end" are acknowledged, or when the stream is abandoned.
+ */
 typedef struct st_picoquic_stream_queue_node_t {
     picoquic_quic_t* quic;
     struct st_picoquic_stream_queue_node_t* next_stream_data;
     uint64_t offset;  /* Stream offset of the first octet in "bytes" */
     size_t length;    /* Number of octets in "bytes" */
     uint8_t* bytes;
+    uint64_t stream_offset_end; /* Stream offset of the byte after the last octet in "bytes" */
+    picoquic_stream_data_release_fn release_fn;
+    void* release_ctx;
+    unsigned int is_reference : 1;
 } picoquic_stream_queue_node_t;
 
 /*
@@ -422,12 +448,36 @@ typedef struct st_picoquic_packet_t {
     unsigned int is_queued_for_retransmit : 1;
     unsigned int is_queued_for_spurious_detection : 1;
     unsigned int is_queued_for_data_repeat : 1;
+    /* Slab from which the packet was allocated, preserved across reuse */
+    struct st_picoquic_packet_slab_t* slab;
 
     uint8_t bytes[PICOQUIC_MAX_PACKET_SIZE];
 } picoquic_packet_t;
 
+/* Packets are allocated in slabs of up to PICOQUIC_PACKET_SLAB_SIZE
+ * packets. Each slab keeps its own list of free packets, and slabs
+ * with free packets are chained in the "partial" list of the quic
+ * context. A slab is released when all its packets are free and the
+ * pool holds more than PICOQUIC_MAX_PACKETS_IN_POOL free packets.
+ * Only the metadata of a packet is cleared when it is allocated.
+ */
+#define PICOQUIC_PACKET_SLAB_SIZE 32
+
+typedef struct st_picoquic_packet_slab_t {
+    struct st_picoquic_packet_slab_t* next_partial;
+    struct st_picoquic_packet_slab_t* previous_partial;
+    picoquic_packet_t* first_free;
+    picoquic_packet_t* packets;
+    int nb_packets;
+    int nb_free;
+    int is_partial;
+} picoquic_packet_slab_t;
+
 picoquic_packet_t* picoquic_create_packet(picoquic_quic_t* quic);
 void picoquic_recycle_packet(picoquic_quic_t* quic, picoquic_packet_t* packet);
+void picoquic_free_packet_pool(picoquic_quic_t* quic);
+void picoquic_packet_pool_wait(picoquic_quic_t* quic, struct st_picoquic_cnx_t* cnx);
+void picoquic_packet_pool_unwait(picoquic_quic_t* quic, struct st_picoquic_cnx_t* cnx);
 
 /* Definition of the token register used to prevent repeated usage of
  * the same new token, retry token, or session ticket.
@@ -553,6 +603,38 @@ int picoquic_remember_issued_ticket(picoquic_quic_t* quic,
 picoquic_issued_ticket_t* picoquic_retrieve_issued_ticket(picoquic_quic_t* quic,
     uint64_t ticket_id);
 
+/* Server side cache of path metrics, keyed by the prefix of the peer
+ * address, used to seed the RTT and the congestion window of new
+ * connections from the same network. See path_cache.c.
+ */
+#define PICOQUIC_PATH_METRICS_PREFIX_V4 3 /* /24 */
+#define PICOQUIC_PATH_METRICS_PREFIX_V6 6 /* /48 */
+#define PICOQUIC_PATH_METRICS_LIFETIME_DEFAULT 600000000ull /* 10 minutes */
+#define PICOQUIC_PATH_METRICS_MAX_LOSS_PPM 100000ull /* 10% */
+
+typedef struct st_picoquic_path_metrics_t {
+    struct st_picoquic_path_metrics_t* next_metrics;
+    struct st_picoquic_path_metrics_t* previous_metrics;
+    picohash_item hash_item;
+    uint8_t prefix[16];
+    uint8_t prefix_length;
+    uint16_t addr_family;
+    uint64_t last_update_time;
+    uint64_t nb_samples;
+    uint64_t rtt_min;
+    uint64_t smoothed_rtt;
+    uint64_t bandwidth; /* bytes per second */
+    uint64_t loss_ppm; /* bytes lost per million bytes sent */
+} picoquic_path_metrics_t;
+
+int picoquic_remember_path_metrics(picoquic_quic_t* quic, const struct sockaddr* addr,
+    uint64_t rtt_min, uint64_t smoothed_rtt, uint64_t bandwidth, uint64_t loss_ppm, uint64_t current_time);
+picoquic_path_metrics_t* picoquic_retrieve_path_metrics(picoquic_quic_t* quic,
+    const struct sockaddr* addr, uint64_t current_time);
+void picoquic_record_path_metrics(picoquic_cnx_t* cnx, uint64_t current_time);
+void picoquic_seed_path_from_metrics(picoquic_cnx_t* cnx, uint64_t current_time);
+void picoquic_path_metrics_cache_free(picoquic_quic_t* quic);
+
 /*
  * Transport parameters, as defined by the QUIC transport specification.
  * The initial code defined the type as an enum, but the binary representation
@@ -600,6 +682,165 @@ typedef int (*picoquic_autoqlog_fn)(picoquic_cnx_t * cnx);
  */
 typedef int (*picoquic_performance_log_fn)(picoquic_quic_t* quic, picoquic_cnx_t* cnx, int should_delete);
 
+/* Hierarchical timing wheel, an alternative to the splay tree for
+ * ordering connections by wake time. Each level has 64 slots and covers
+ * 6 bits of the wake time in microseconds, relative to the wheel time.
+ * Insertion and removal are O(1). Slots of higher levels are cascaded
+ * to lower levels as the wheel time advances. Connections due before the
+ * wheel time are kept in a splay tree. See wake_wheel.c.
+ */
+#define PICOQUIC_WAKE_WHEEL_SLOT_BITS 6
+#define PICOQUIC_WAKE_WHEEL_SLOTS 64
+#define PICOQUIC_WAKE_WHEEL_LEVELS 11
+#define PICOQUIC_WAKE_WHEEL_LATE PICOQUIC_WAKE_WHEEL_LEVELS /* level of the late connections */
+
+typedef struct st_picoquic_wake_wheel_node_t {
+    struct st_picoquic_cnx_t* next;
+    struct st_picoquic_cnx_t* previous;
+    uint8_t level;
+    uint8_t slot;
+    uint8_t is_in_wheel;
+} picoquic_wake_wheel_node_t;
+
+typedef struct st_picoquic_wake_wheel_t {
+    uint64_t wheel_time;
+    size_t nb_cnx;
+    uint64_t occupied[PICOQUIC_WAKE_WHEEL_LEVELS];
+    struct st_picoquic_cnx_t* slots[PICOQUIC_WAKE_WHEEL_LEVELS][PICOQUIC_WAKE_WHEEL_SLOTS];
+    picosplay_tree_t late_tree; /* connections due before the wheel time */
+} picoquic_wake_wheel_t;
+
+picoquic_wake_wheel_t* picoquic_wake_wheel_create(uint64_t wheel_time);
+void picoquic_wake_wheel_delete(picoquic_wake_wheel_t* wheel);
+void picoquic_wake_wheel_insert(picoquic_wake_wheel_t* wheel, struct st_picoquic_cnx_t* cnx);
+void picoquic_wake_wheel_remove(picoquic_wake_wheel_t* wheel, struct st_picoquic_cnx_t* cnx);
+struct st_picoquic_cnx_t* picoquic_wake_wheel_first(picoquic_wake_wheel_t* wheel);
+
+/* Crypto worker pool, enabled with "picoquic_set_crypto_workers". The
+ * AEAD encryption of the 1-RTT packets in a train, and the decryption of
+ * the short header packets received in a batch for a connection, are
+ * split between the protocol thread and worker threads. AEAD contexts
+ * are not thread safe, so each worker uses its own clone of the 1-RTT
+ * keys. The protocol thread waits for the completion of the jobs before
+ * sending the train, or before using the decrypted packet, which keeps
+ * the packets of each connection in order. See crypto_pool.c.
+ */
+#define PICOQUIC_CRYPTO_WORKERS_MAX 16
+#define PICOQUIC_CRYPTO_RING_SIZE 256
+
+typedef struct st_picoquic_crypto_job_t {
+    uint8_t* output;
+    const uint8_t* input;
+    size_t input_length;
+    const uint8_t* aad;
+    size_t aad_length;
+    uint64_t sequence_number;
+    uint64_t path_id;
+    void* aead_context; /* Set when the job is dispatched */
+    size_t result;
+    int worker_id; /* -1 if processed by the protocol thread */
+    int is_done;
+    unsigned int is_encrypt : 1;
+    unsigned int is_multipath : 1;
+} picoquic_crypto_job_t;
+
+typedef void (*picoquic_crypto_job_fn)(picoquic_crypto_job_t* job);
+
+typedef struct st_picoquic_aead_clones_t {
+    int nb_clones;
+    void* aead[PICOQUIC_CRYPTO_WORKERS_MAX];
+} picoquic_aead_clones_t;
+
+typedef struct st_picoquic_crypto_pool_t picoquic_crypto_pool_t;
+
+picoquic_crypto_pool_t* picoquic_crypto_pool_create(int nb_workers, picoquic_crypto_job_fn job_fn);
+void picoquic_crypto_pool_delete(picoquic_crypto_pool_t* pool);
+int picoquic_crypto_pool_nb_workers(picoquic_crypto_pool_t* pool);
+void picoquic_crypto_pool_get_stats(picoquic_crypto_pool_t* pool, uint64_t* nb_jobs_posted, uint64_t* nb_jobs_local);
+void picoquic_crypto_job_run(picoquic_crypto_job_t* job);
+/* Split the jobs between the workers, using their clones, and the protocol thread,
+ * using the primary context. The protocol thread share is processed before
+ * returning. The jobs array is reordered. */
+void picoquic_crypto_pool_dispatch(picoquic_crypto_pool_t* pool, picoquic_crypto_job_t** jobs, size_t nb_jobs,
+    void* aead_context, picoquic_aead_clones_t* clones);
+void picoquic_crypto_pool_wait(picoquic_crypto_pool_t* pool, picoquic_crypto_job_t* job);
+void picoquic_crypto_pool_drain(picoquic_crypto_pool_t* pool);
+
+/* Header protection of the packets in a train is deferred until the train
+ * is complete, so that the masks of all packets protected with the same
+ * key can be computed in a single multi-block AES-ECB call. The batch
+ * holds up to the maximum number of GSO segments in a train. If crypto
+ * workers are enabled, the AEAD encryption is deferred as well, and
+ * completed before header protection is applied.
+ */
+#define PICOQUIC_HP_BATCH_MAX 64
+
+typedef struct st_picoquic_hp_batch_entry_t {
+    uint8_t* send_buffer;
+    size_t pn_offset;
+    void* pn_enc;
+    void* pn_enc_ecb;
+    uint8_t first_mask;
+    picoquic_crypto_job_t job; /* AEAD encryption, if job.aead_context is not NULL */
+    picoquic_aead_clones_t* aead_clones;
+} picoquic_hp_batch_entry_t;
+
+typedef struct st_picoquic_hp_batch_t {
+    size_t nb_entries;
+    unsigned int is_active : 1;
+    picoquic_crypto_pool_t* crypto_pool;
+    picoquic_hp_batch_entry_t entries[PICOQUIC_HP_BATCH_MAX];
+} picoquic_hp_batch_t;
+
+/* On receive, the header protection masks of the short header packets
+ * received in a batch for the same connection are computed together,
+ * in a single multi-block AES-ECB call. Each entry keeps a copy of the
+ * sample from which the mask was computed. Header protection keys do
+ * not change with key updates, so the masks remain valid if the key
+ * phase changes in the middle of the batch.
+ */
+typedef struct st_picoquic_hp_mask_entry_t {
+    uint8_t sample[16];
+    uint8_t mask[5];
+} picoquic_hp_mask_entry_t;
+
+typedef struct st_picoquic_hp_mask_cache_t {
+    void* pn_dec;
+    size_t nb_entries;
+    size_t next_entry;
+    picoquic_hp_mask_entry_t entries[PICOQUIC_HP_BATCH_MAX];
+} picoquic_hp_mask_cache_t;
+
+void picoquic_hp_mask_cache_compute(picoquic_hp_mask_cache_t* cache, void* pn_dec, void* pn_dec_ecb,
+    const uint8_t** samples, size_t nb_samples);
+const uint8_t* picoquic_hp_mask_cache_find(picoquic_hp_mask_cache_t* cache, void* pn_dec, const uint8_t* sample);
+
+/* With crypto workers, the short header packets received in a batch for
+ * the same connection are decrypted ahead of their processing, into
+ * scratch buffers holding the unprotected header followed by the
+ * decrypted payload. A result is only used if the packet is decrypted
+ * with the same key and packet number when it is processed, which is
+ * not the case if the key phase changed in the middle of the batch.
+ */
+typedef struct st_picoquic_decrypt_batch_entry_t {
+    picoquic_crypto_job_t job;
+    struct st_picoquic_cnx_t* cnx;
+    const uint8_t* bytes;
+    void* aead_decrypt;
+    uint64_t pn64;
+    size_t offset;
+    size_t payload_length;
+    uint8_t* decrypted;
+} picoquic_decrypt_batch_entry_t;
+
+typedef struct st_picoquic_decrypt_batch_t {
+    size_t nb_entries;
+    uint8_t* buffers;
+    picoquic_decrypt_batch_entry_t entries[PICOQUIC_HP_BATCH_MAX];
+} picoquic_decrypt_batch_t;
+
+void picoquic_decrypt_batch_clear(struct st_picoquic_quic_t* quic, struct st_picoquic_cnx_t* cnx);
+
 /* QUIC context, defining the tables of connections,
  * open sockets, etc.
  */
@@ -631,6 +872,7 @@ typedef struct st_picoquic_quic_t {
     uint32_t default_multipath_option;
     uint64_t default_handshake_timeout;
     uint64_t crypto_epoch_length_max; /* Default packet interval between key rotations */
+    uint64_t default_hibernation_delay; /* Idle time before connections hibernate, 0 if never */
     uint32_t max_simultaneous_logs;
     uint32_t current_number_of_open_logs;
     uint32_t max_half_open_before_retry;
@@ -641,6 +883,8 @@ typedef struct st_picoquic_quic_t {
     uint64_t stateless_reset_next_time; /* Next time Stateless Reset or VN packet can be sent */
     uint64_t stateless_reset_min_interval; /* Enforced interval between two stateless reset packets */
     uint64_t cwin_max; /* max value of cwin per connection */
+    uint64_t pacing_offload_horizon; /* If > 0, pacing may run ahead by up to that many microseconds */
+    uint64_t train_departure_time; /* Departure time of the last prepared train */
     /* Flags */
     unsigned int check_token : 1;
     unsigned int force_check_token : 1;
@@ -666,17 +910,30 @@ typedef struct st_picoquic_quic_t {
     unsigned int is_port_blocking_disabled : 1; /* Do not check client port on incoming connections */
     unsigned int are_path_callbacks_enabled : 1; /* Enable path specific callbacks by default */
     unsigned int use_predictable_random : 1; /* For logging tests */
+    unsigned int is_incoming_batch : 1; /* Processing a batch of incoming packets, wake up deferred */
     picoquic_stateless_packet_t* pending_stateless_packet;
 
     picoquic_congestion_algorithm_t const* default_congestion_alg;
+    picoquic_path_scheduler_t const* default_path_scheduler;
     uint64_t wifi_shadow_rtt;
     double bbr_quantum_ratio;
 
     struct st_picoquic_cnx_t* cnx_list;
     struct st_picoquic_cnx_t* cnx_last;
     picosplay_tree_t cnx_wake_tree;
+    picoquic_wake_wheel_t* wake_wheel; /* If not NULL, used instead of cnx_wake_tree */
 
     struct st_picoquic_cnx_t* cnx_in_progress;
+    /* Incoming batch: connections waiting for wake up reinsertion, cached CID lookup */
+    struct st_picoquic_cnx_t* wake_deferred_first;
+    struct st_picoquic_local_cnxid_t* batch_l_cid;
+    /* Header protection deferred while preparing a packet train */
+    picoquic_hp_batch_t hp_batch;
+    /* Header protection masks computed for a batch of incoming packets */
+    picoquic_hp_mask_cache_t hp_mask_cache;
+    /* Crypto workers, and packets decrypted ahead of processing */
+    picoquic_crypto_pool_t* crypto_pool;
+    picoquic_decrypt_batch_t* decrypt_batch;
 
     picohash_table* table_cnx_by_id;
     picohash_table* table_cnx_by_net;
@@ -688,10 +945,25 @@ typedef struct st_picoquic_quic_t {
     picoquic_issued_ticket_t* table_issued_tickets_last;
     size_t table_issued_tickets_nb;
 
-    picoquic_packet_t * p_first_packet;
+    picohash_table* table_path_metrics;
+    picoquic_path_metrics_t* path_metrics_first;
+    picoquic_path_metrics_t* path_metrics_last;
+    size_t path_metrics_nb;
+    size_t path_metrics_max;
+    uint64_t path_metrics_lifetime;
+
+    picoquic_packet_slab_t* packet_slab_partial;
     int nb_packets_in_pool;
     int nb_packets_allocated;
     int nb_packets_allocated_max;
+    int nb_packet_slabs;
+    size_t packet_pool_max;
+    uint64_t nb_packet_requests;
+    uint64_t nb_packet_pool_hits;
+    uint64_t nb_packet_pool_exhausted;
+    /* Connections blocked by the pool ceiling, woken up in order as packets are recycled */
+    struct st_picoquic_cnx_t* pool_waiting_first;
+    struct st_picoquic_cnx_t* pool_waiting_last;
 
     picoquic_stream_data_node_t* p_first_data_node;
     int nb_data_nodes_in_pool;
@@ -718,6 +990,8 @@ typedef struct st_picoquic_quic_t {
 
     /* Global flow control enforcement */
     uint64_t max_data_limit;
+    uint64_t rwnd_budget; /* memory budget for tuned receive windows, 0 if tuning disabled */
+    uint64_t rwnd_committed; /* sum of the tuned windows of all connections */
 
     /* Path quality callback. These variables store the default values
     * of the min deltas required to perform path quality signaling.
@@ -756,7 +1030,6 @@ void picoquic_registered_token_clear(picoquic_quic_t* quic, uint64_t expiry_time
  */
 
 typedef struct st_picoquic_sack_item_t {
-    picosplay_node_t node;
     uint64_t start_of_sack_range;
     uint64_t end_of_sack_range;
     uint64_t time_created;
@@ -767,13 +1040,49 @@ typedef struct st_picoquic_sack_range_count_t {
     int range_counts[PICOQUIC_MAX_ACK_RANGE_REPEAT];
 } picoquic_sack_range_count_t;
 
+/* The ranges are kept in an array sorted by increasing start, framed by
+ * two sentinel items. The first range is at index "first_index", so
+ * ranges can be removed or added at the low end without moving the others.
+ * If "max_ranges" is set, the lowest ranges are dropped when the list grows
+ * larger, and the eviction floor is moved above them. The list no longer
+ * knows which packets below the floor were received, so these packets are
+ * treated as duplicates. The ack horizon is separate, and only used if a
+ * horizon delay is set.
+ */
+#define PICOQUIC_SACK_RANGES_MAX_ACK 256
+
 typedef struct st_picoquic_sack_list_t {
-    picosplay_tree_t ack_tree;
+    picoquic_sack_item_t* items;
+    size_t first_index;
+    size_t nb_ranges;
+    size_t nb_allocated;
+    size_t max_ranges;
+    uint64_t eviction_floor;
     uint64_t ack_horizon;
     int64_t horizon_delay;
     picoquic_sack_range_count_t rc[2];
 } picoquic_sack_list_t;
 
+/* Reassembly ring for out of order stream data.
+ * Received bytes are stored at the position given by their stream offset
+ * modulo the size of the ring, which is a power of 2. The ring is large enough
+ * to hold all data between the consumed offset and the highest offset stored
+ * in the ring. The received ranges are tracked in a sack list.
+ * The ring only grows beyond the minimum size if the span from the consumed
+ * offset to the end of the new segment is at most PICOQUIC_STREAM_RING_SPAN_RATIO
+ * times the bytes buffered. Sparse segments far ahead of the consumed offset
+ * are kept in the stream data tree instead, so that a few bytes sent at the
+ * edge of the flow control window do not cause a window sized allocation.
+ */
+#define PICOQUIC_STREAM_RING_SIZE_MIN 0x4000
+#define PICOQUIC_STREAM_RING_SPAN_RATIO 4
+
+typedef struct st_picoquic_stream_ring_t {
+    uint8_t* buffer;
+    size_t size;
+    picoquic_sack_list_t ranges;
+} picoquic_stream_ring_t;
+
 /*
  * Stream head.
  * Stream contains bytes of data, which are not always delivered in order.
@@ -784,9 +1093,12 @@ typedef struct st_picoquic_sack_list_t {
  *
  * - a list of open streams, managed as a "splay"
  * - a subset of "output" streams, managed as a double linked list
+ * - for each priority level, a "ready queue" of the output streams that have
+ *   something to send, so the scheduler does not have to scan all output streams.
  *
- * For each stream, the code maintains a list of received stream segments, managed as
- * a "splay" of "stream data nodes".
+ * For each stream, the code maintains a list of received stream segments. Out of order
+ * segments of application streams are copied in a "reassembly ring". Segments of the
+ * crypto streams are managed as a "splay" of "stream data nodes".
  *
  * Two input modes are supported. If streams are marked active, the application receives
  * a callback and provides data "just in time". Other streams can just push data using
@@ -797,10 +1109,32 @@ typedef struct st_picoquic_sack_list_t {
  * The stream structure holds a variety of parameters about the state of the stream.
  */
 
+/* Receive window tuning state, for the connection or for a stream.
+ * The window is the amount of credit advertised beyond the consumed
+ * offset. It is adjusted once per RTT, based on the amount of data
+ * consumed during the measurement epoch. See picoquic_rwnd_update.
+ */
+typedef struct st_picoquic_rwnd_tuning_t {
+    uint64_t window; /* 0 if tuning not started yet */
+    uint64_t window_min;
+    uint64_t epoch_start;
+    uint64_t epoch_offset;
+} picoquic_rwnd_tuning_t;
+
+typedef struct st_picoquic_stream_bucket_t {
+    struct st_picoquic_stream_bucket_t* next_bucket; /* buckets are sorted by increasing priority */
+    struct st_picoquic_stream_head_t* first_ready_stream;
+    struct st_picoquic_stream_head_t* last_ready_stream;
+    uint8_t stream_priority;
+} picoquic_stream_bucket_t;
+
 typedef struct st_picoquic_stream_head_t {
     picosplay_node_t stream_node; /* splay of streams in connection context */
     struct st_picoquic_stream_head_t * next_output_stream; /* link in the list of output streams */
     struct st_picoquic_stream_head_t * previous_output_stream;
+    struct st_picoquic_stream_head_t * next_ready_stream; /* link in the ready queue of the priority bucket */
+    struct st_picoquic_stream_head_t * previous_ready_stream;
+    picoquic_stream_bucket_t * ready_bucket; /* bucket holding the stream if ready, NULL otherwise */
     picoquic_cnx_t * cnx;
     uint64_t stream_id;
     struct st_picoquic_path_t * affinity_path; /* Path for which affinity is set, or NULL if none */
@@ -809,17 +1143,28 @@ typedef struct st_picoquic_stream_head_t {
     uint64_t maxdata_local; /* flow control limit of how much the peer is authorized to send */
     uint64_t maxdata_local_acked; /* highest value in max stream data frame acked by the peer */
     uint64_t maxdata_remote; /* flow control limit of how much we authorize the peer to send */
+    picoquic_rwnd_tuning_t rwnd; /* receive window tuning for the stream */
+    uint64_t rwnd_consumed_offset; /* part of the stream counted in the connection data_consumed */
     uint64_t local_error;
     uint64_t remote_error;
     uint64_t local_stop_error;
     uint64_t remote_stop_error;
     uint64_t last_time_data_sent;
-    picosplay_tree_t stream_data_tree; /* splay of received stream segments */
+    picosplay_tree_t stream_data_tree; /* splay of received stream segments, crypto streams only */
+    picoquic_stream_ring_t* reassembly_ring; /* out of order data received on application streams */
     uint64_t sent_offset; /* Amount of data sent in the stream */
     picoquic_stream_queue_node_t* send_queue; /* if the stream is not "active", list of data segments ready to send */
+    picoquic_stream_queue_node_t* send_queue_last; /* last segment in the send queue, for O(1) append */
+    picoquic_stream_queue_node_t* release_queue; /* segments sent by reference, waiting for acknowledgement */
+    picoquic_stream_queue_node_t* release_queue_last;
     void * app_stream_ctx;
     picoquic_stream_direct_receive_fn direct_receive_fn; /* direct receive function, if not NULL */
     void* direct_receive_ctx; /* direct receive context */
+    picoquic_stream_zero_copy_fn zero_copy_fn; /* zero copy receive notification, if not NULL */
+    void* zero_copy_ctx;
+    picoquic_stream_view_node_t* first_view; /* views of received data, by increasing offset */
+    picoquic_stream_view_node_t* last_view;
+    picoquic_stream_view_node_t* last_contiguous_view; /* last view of the data received in sequence */
     picoquic_sack_list_t sack_list; /* Track which parts of the stream were acknowledged by the peer */
     /* Stream priority -- lowest is most urgent */
     uint8_t stream_priority;
@@ -843,6 +1188,7 @@ typedef struct st_picoquic_stream_head_t {
     unsigned int is_output_stream : 1; /* If stream is listed in the output list */
     unsigned int is_closed : 1; /* Stream is closed, closure is accouted for */
     unsigned int is_discarded : 1; /* There should be no more callback for that stream, the application has discarded it */
+    unsigned int is_zero_copy_notifying : 1; /* The zero copy notification function is running, deletion is deferred */
 } picoquic_stream_head_t;
 
 #define IS_CLIENT_STREAM_ID(id) (unsigned int)(((id) & 1) == 0)
@@ -891,6 +1237,12 @@ typedef struct st_picoquic_packet_context_t {
     uint64_t highest_acknowledged_time; /* time at which the highest ack was received */
     picoquic_packet_t* pending_last;
     picoquic_packet_t* pending_first;
+    /* Index of the pending packets by sequence number. The ring size is a power
+     * of 2, larger than the range of pending sequence numbers. If the ring is
+     * NULL, e.g., if the range exceeds PICOQUIC_SENT_RING_MAX, the pending
+     * list is searched instead. */
+    picoquic_packet_t** sent_ring;
+    uint64_t sent_ring_mask;
     picoquic_packet_t* retransmitted_newest;
     picoquic_packet_t* retransmitted_oldest;
     picoquic_packet_t* preemptive_repeat_ptr;
@@ -1011,9 +1363,12 @@ typedef struct st_picoquic_pacing_t {
     uint64_t quantum_max;
     uint64_t rate_max;
     int bandwidth_pause;
+    /* Departure time of the last packet, later than the send time if pacing is offloaded */
+    uint64_t departure_time;
     /* High precision variables should only be used inside pacing.c */
     int64_t bucket_nanosec;
     int64_t packet_time_nanosec;
+    int64_t horizon_nanosec;
 } picoquic_pacing_t;
 
 /*
@@ -1081,6 +1436,7 @@ typedef struct st_picoquic_path_t {
     struct sockaddr_storage nat_local_addr;
     /* Last time a packet was sent on this path. */
     uint64_t last_sent_time;
+    uint64_t sched_virtual_time; /* Virtual finish time of the path, for weighted round robin */
     uint64_t status_sequence_to_receive_next;
     uint64_t status_sequence_sent_last;
     /* Last 1-RTT "non path validating" packet received on this path */
@@ -1234,6 +1590,10 @@ typedef struct st_picoquic_crypto_context_t {
     void* aead_decrypt;
     void* pn_enc; /* Used for PN encryption */
     void* pn_dec; /* Used for PN decryption */
+    void* pn_enc_ecb; /* ECB form of the PN encryption key, if the cipher has one */
+    void* pn_dec_ecb; /* ECB form of the PN decryption key, if the cipher has one */
+    picoquic_aead_clones_t* aead_encrypt_clones; /* Copies of the AEAD keys for the crypto workers */
+    picoquic_aead_clones_t* aead_decrypt_clones;
 } picoquic_crypto_context_t;
 
 /*
@@ -1275,6 +1635,7 @@ typedef struct st_picoquic_cnx_t {
     unsigned int is_new_token_acked : 1; /* Has the peer acked a new token? This assumes at most one new token sent per connection */
     unsigned int is_1rtt_received : 1; /* If at least one 1RTT packet has been received */
     unsigned int is_1rtt_acked : 1; /* If at least one 1RTT packet has been acked by the peer */
+    unsigned int is_hibernating : 1; /* Recreatable state has been released while the connection is idle */
     unsigned int has_successful_probe : 1; /* At least one probe was successful */
     unsigned int grease_transport_parameters : 1; /* Exercise greasing of transport parameters */
     unsigned int test_large_chello : 1; /* Add a greasing parameter to test sending CHello on multiple packets */
@@ -1310,6 +1671,8 @@ typedef struct st_picoquic_cnx_t {
     unsigned int is_forced_probe_up_required : 1; /* application wants "probe up" if CC requests it */
     unsigned int is_address_discovery_provider : 1; /* send the address discovery extension */
     unsigned int is_address_discovery_receiver : 1; /* receive the address discovery extension */
+    unsigned int is_wake_deferred : 1; /* wake list reinsertion deferred to end of incoming batch */
+    unsigned int is_pool_waiting : 1; /* waiting for a packet to be recycled, pool ceiling reached */
     
     /* PMTUD policy */
     picoquic_pmtud_policy_enum pmtud_policy;
@@ -1370,6 +1733,9 @@ typedef struct st_picoquic_cnx_t {
     /* Next time sending data is expected */
     uint64_t next_wake_time;
     picosplay_node_t cnx_wake_node;
+    picoquic_wake_wheel_node_t wake_wheel_node;
+    struct st_picoquic_cnx_t* next_wake_deferred;
+    struct st_picoquic_cnx_t* next_pool_waiting;
     /* Wakeup time requested by the application */
     uint64_t app_wake_time;
     /* TLS context, TLS Send Buffer, streams, epochs */
@@ -1388,6 +1754,8 @@ typedef struct st_picoquic_cnx_t {
     /* Liveness detection */
     uint64_t latest_progress_time; /* last local time at which the connection progressed */
     uint64_t latest_receive_time; /* last time something was received from the peer */
+    uint64_t latest_busy_time; /* last time the connection had data in flight or queued */
+    uint64_t hibernation_delay; /* Idle time before hibernation, 0 if never */
     /* Close connection management */
     uint64_t last_close_sent;
     /* Sequence and retransmission state */
@@ -1427,6 +1795,8 @@ typedef struct st_picoquic_cnx_t {
     unsigned int stream_blocked : 1;
     /* Congestion algorithm */
     picoquic_congestion_algorithm_t const* congestion_alg;
+    picoquic_path_scheduler_t const* path_scheduler;
+    uint64_t sched_virtual_time; /* Virtual time of the weighted round robin path scheduler */
     /* Management of quality signalling updates */
     uint64_t rtt_update_delta;
     uint64_t pacing_rate_update_delta;
@@ -1442,9 +1812,11 @@ typedef struct st_picoquic_cnx_t {
     /* Flow control information */
     uint64_t data_sent;
     uint64_t data_received;
+    uint64_t data_consumed; /* Stream data consumed by the application, or discarded */
     uint64_t maxdata_local; /* Highest value sent to the peer */
     uint64_t maxdata_local_acked; /* Highest value acked by the peer */
     uint64_t maxdata_remote; /* Highest value received from the peer */
+    picoquic_rwnd_tuning_t rwnd; /* receive window tuning, window charged to the memory budget */
     uint64_t max_stream_data_local;
     uint64_t max_stream_data_remote;
     uint64_t max_stream_id_bidir_local; /* Highest value sent to the peer */
@@ -1464,6 +1836,7 @@ typedef struct st_picoquic_cnx_t {
     picosplay_tree_t stream_tree;
     picoquic_stream_head_t * first_output_stream;
     picoquic_stream_head_t * last_output_stream;
+    picoquic_stream_bucket_t * first_stream_bucket;
     uint64_t high_priority_stream_id;
     uint64_t next_stream_id[4];
     uint64_t priority_limit_for_bypass; /* Bypass CC if dtagram or stream priority lower than this, 0 means never */
@@ -1619,6 +1992,8 @@ picoquic_packet_t* picoquic_dequeue_retransmit_packet(picoquic_cnx_t* cnx, picoq
     picoquic_packet_t* p, int should_free,
     int add_to_data_repeat_queue);
 void picoquic_dequeue_retransmitted_packet(picoquic_cnx_t* cnx, picoquic_packet_context_t* pkt_ctx, picoquic_packet_t* p);
+picoquic_packet_t* picoquic_sent_ring_find(picoquic_packet_context_t* pkt_ctx, uint64_t sequence_number);
+void picoquic_sent_ring_free(picoquic_packet_context_t* pkt_ctx);
 
 /* Reset the connection context, e.g. after retry */
 int picoquic_reset_cnx(picoquic_cnx_t* cnx, uint64_t current_time);
@@ -1626,6 +2001,11 @@ int picoquic_reset_cnx(picoquic_cnx_t* cnx, uint64_t current_time);
 /* Reset packet context */
 void picoquic_reset_packet_context(picoquic_cnx_t* cnx, picoquic_packet_context_t * pkt_ctx);
 
+/* Release and recreate the state of idle connections */
+void picoquic_hibernate_cnx(picoquic_cnx_t* cnx);
+void picoquic_wake_cnx_from_hibernation(picoquic_cnx_t* cnx, uint64_t current_time);
+void picoquic_check_hibernation(picoquic_cnx_t* cnx, uint64_t current_time, uint64_t* next_wake_time);
+
 /* Notify error on connection */
 int picoquic_connection_error(picoquic_cnx_t* cnx, uint64_t local_error, uint64_t frame_type); 
 int picoquic_connection_error_ex(picoquic_cnx_t* cnx, uint64_t local_error, uint64_t frame_type, char const* local_reason);
@@ -1648,6 +2028,7 @@ void picoquic_update_pacing_parameters(picoquic_pacing_t* pacing, double pacing_
     picoquic_path_t* signalled_path);
 void picoquic_update_pacing_window(picoquic_pacing_t* pacing, int slow_start, uint64_t cwin, size_t send_mtu, uint64_t smoothed_rtt, picoquic_path_t * signalled_path);
 void picoquic_update_pacing_data_after_send(picoquic_pacing_t * pacing, size_t length, size_t send_mtu, uint64_t current_time);
+uint64_t picoquic_pacing_next_departure_time(picoquic_pacing_t* pacing, uint64_t current_time);
 
 /* Reset the pacing data after CWIN is updated */
 void picoquic_update_pacing_data(picoquic_cnx_t* cnx, picoquic_path_t * path_x, int slow_start);
@@ -1669,6 +2050,13 @@ void picoquic_reinsert_by_wake_time(picoquic_quic_t* quic, picoquic_cnx_t* cnx,
 #define PICOPARSE_32(b) ((((uint32_t)PICOPARSE_16(b)) << 16) | (uint32_t)PICOPARSE_16((b) + 2))
 #define PICOPARSE_64(b) ((((uint64_t)PICOPARSE_32(b)) << 32) | (uint64_t)PICOPARSE_32((b) + 4))
 
+/* Branchless decoding of a varint, usable when at least 8 bytes can be read
+ * from b. The 8 bytes are loaded as one big endian word, the bytes that
+ * follow the varint are shifted out, and the two length bits are masked. */
+#define PICOPARSE_VARINT_MIN 8
+#define PICOPARSE_VARINT_SHIFT(b) (64 - (8 << ((b)[0] >> 6)))
+#define PICOPARSE_VARINT_8(b) ((PICOPARSE_64(b) >> PICOPARSE_VARINT_SHIFT(b)) & (UINT64_MAX >> (PICOPARSE_VARINT_SHIFT(b) + 2)))
+
 /* Integer formatting functions */
 void picoformat_16(uint8_t* bytes, uint16_t n16);
 void picoformat_24(uint8_t* bytes, uint32_t n24);
@@ -1698,6 +2086,12 @@ int picoquic_parse_packet_header(
     picoquic_cnx_t** pcnx,
     int receiving);
 
+/* Extract the destination CID of an incoming datagram, without parsing the
+ * rest of the header. Short headers use the local CID length of the context.
+ * Sets the null CID if the datagram is too short. */
+void picoquic_parse_incoming_dcid(picoquic_quic_t* quic, const uint8_t* bytes, size_t length,
+    picoquic_connection_id_t* dcid);
+
 size_t picoquic_create_long_header(picoquic_packet_type_enum packet_type, 
     picoquic_connection_id_t* dest_cnx_id, picoquic_connection_id_t* srce_cnx_id,
     int do_grease_quic_bit, uint32_t version, int version_index, uint64_t sequence_number,
@@ -1726,11 +2120,16 @@ size_t picoquic_get_checksum_length(picoquic_cnx_t* cnx, picoquic_epoch_enum is_
 
 void picoquic_protect_packet_header(uint8_t* send_buffer, size_t pn_offset, uint8_t first_mask, void* pn_enc);
 
+picoquic_hp_batch_entry_t* picoquic_hp_batch_add(picoquic_hp_batch_t* batch, uint8_t* send_buffer, size_t pn_offset, uint8_t first_mask,
+    void* pn_enc, void* pn_enc_ecb);
+
+void picoquic_hp_batch_flush(picoquic_hp_batch_t* batch);
+
 size_t picoquic_protect_packet(picoquic_cnx_t* cnx, picoquic_packet_type_enum ptype, uint8_t* bytes, uint64_t sequence_number, size_t length, size_t header_length, uint8_t* send_buffer, size_t send_buffer_max, void* aead_context, void* pn_enc, picoquic_path_t* path_x, uint64_t current_time);
 
 uint64_t picoquic_get_packet_number64(uint64_t highest, uint64_t mask, uint32_t pn);
 
-int picoquic_remove_header_protection_inner(uint8_t* bytes, size_t length, uint8_t* decrypted_bytes, picoquic_packet_header* ph, void* pn_enc, unsigned int is_loss_bit_enabled_incoming, uint64_t sack_list_last);
+int picoquic_remove_header_protection_inner(uint8_t* bytes, size_t length, uint8_t* decrypted_bytes, picoquic_packet_header* ph, void* pn_enc, const uint8_t* precomputed_mask, unsigned int is_loss_bit_enabled_incoming, uint64_t sack_list_last);
 
 size_t picoquic_pad_to_target_length(uint8_t* bytes, size_t length, size_t target);
 
@@ -1793,8 +2192,11 @@ picoquic_sack_item_t* picoquic_sack_first_item(picoquic_sack_list_t* sack_list);
 picoquic_sack_item_t* picoquic_sack_last_item(picoquic_sack_list_t* sack_list);
 picoquic_sack_item_t* picoquic_sack_next_item(picoquic_sack_item_t * sack);
 picoquic_sack_item_t* picoquic_sack_previous_item(picoquic_sack_item_t* sack);
+picoquic_sack_item_t* picoquic_sack_find_range_below_number(picoquic_sack_list_t* sack_list, picoquic_sack_item_t* previous,
+    uint64_t pn64);
 int picoquic_sack_insert_item(picoquic_sack_list_t* sack_list, uint64_t range_min, 
     uint64_t range_max, uint64_t current_time);
+void picoquic_sack_delete_item(picoquic_sack_list_t* sack_list, picoquic_sack_item_t* sack);
 
 int picoquic_sack_list_is_empty(picoquic_sack_list_t* sack_list);
 
@@ -1815,6 +2217,8 @@ int picoquic_sack_list_reset(picoquic_sack_list_t* first_sack,
 
 void picoquic_sack_list_free(picoquic_sack_list_t* first_sack);
 
+void picoquic_sack_list_compact(picoquic_sack_list_t* first_sack);
+
 uint64_t picoquic_sack_item_range_start(picoquic_sack_item_t* sack_item);
 
 uint64_t picoquic_sack_item_range_end(picoquic_sack_item_t* sack_item);
@@ -1858,6 +2262,7 @@ picoquic_stream_head_t* picoquic_create_stream(picoquic_cnx_t* cnx, uint64_t str
 picoquic_stream_head_t* picoquic_create_missing_streams(picoquic_cnx_t* cnx, uint64_t stream_id, int is_remote);
 int picoquic_is_stream_closed(picoquic_stream_head_t* stream, int client_mode);
 int picoquic_delete_stream_if_closed(picoquic_cnx_t* cnx, picoquic_stream_head_t* stream);
+int picoquic_flow_control_check_stream_offset(picoquic_cnx_t* cnx, picoquic_stream_head_t* stream, uint64_t new_fin_offset);
 
 void picoquic_update_stream_initial_remote(picoquic_cnx_t* cnx);
 
@@ -1865,6 +2270,11 @@ picoquic_stream_head_t * picoquic_stream_from_node(picosplay_node_t * node);
 void picoquic_insert_output_stream(picoquic_cnx_t* cnx, picoquic_stream_head_t * stream);
 void picoquic_remove_output_stream(picoquic_cnx_t* cnx, picoquic_stream_head_t * stream);
 void picoquic_reorder_output_stream(picoquic_cnx_t* cnx, picoquic_stream_head_t* stream);
+void picoquic_update_ready_stream(picoquic_cnx_t* cnx, picoquic_stream_head_t* stream);
+void picoquic_remove_ready_stream(picoquic_cnx_t* cnx, picoquic_stream_head_t* stream);
+void picoquic_requeue_ready_stream(picoquic_cnx_t* cnx, picoquic_stream_head_t* stream);
+int picoquic_is_stream_urgent(picoquic_stream_head_t* stream);
+int picoquic_stream_has_data_to_send(picoquic_stream_head_t* stream);
 picoquic_stream_head_t * picoquic_first_stream(picoquic_cnx_t * cnx);
 picoquic_stream_head_t * picoquic_last_stream(picoquic_cnx_t * cnx);
 picoquic_stream_head_t * picoquic_next_stream(picoquic_stream_head_t * stream);
@@ -1969,12 +2379,29 @@ uint8_t* picoquic_format_connection_close_frame(picoquic_cnx_t* cnx, uint8_t* by
 uint8_t* picoquic_format_application_close_frame(picoquic_cnx_t* cnx, uint8_t* bytes, uint8_t* bytes_max, int* more_data, int* is_pure_ack);
 uint8_t* picoquic_format_required_max_stream_data_frames(picoquic_cnx_t* cnx, uint8_t* bytes, uint8_t* bytes_max, int* more_data, int* is_pure_ack);
 uint8_t* picoquic_format_max_data_frame(picoquic_cnx_t* cnx, uint8_t* bytes, uint8_t* bytes_max, int* more_data, int* is_pure_ack, uint64_t maxdata_increase);
+uint64_t picoquic_rwnd_max_data_increase(picoquic_cnx_t* cnx, uint64_t current_time);
+void picoquic_rwnd_release(picoquic_cnx_t* cnx);
+void picoquic_rwnd_consume(picoquic_cnx_t* cnx, picoquic_stream_head_t* stream, uint64_t offset);
+int picoquic_is_max_stream_data_needed(picoquic_cnx_t* cnx, picoquic_stream_head_t* stream);
+int picoquic_is_stream_redundant(picoquic_cnx_t* cnx, picoquic_stream_head_t* stream);
 uint8_t* picoquic_format_max_stream_data_frame(picoquic_cnx_t* cnx, picoquic_stream_head_t* stream, uint8_t* bytes, uint8_t* bytes_max, int* more_data, int* is_pure_ack, uint64_t new_max_data);
 uint64_t picoquic_cc_increased_window(picoquic_cnx_t* cnx, uint64_t previous_window); /* Trigger sending more data if window increases */
 uint8_t* picoquic_format_max_streams_frame_if_needed(picoquic_cnx_t* cnx, uint8_t* bytes, uint8_t* bytes_max, int* more_data, int* is_pure_ack);
 void picoquic_stream_data_node_recycle(picoquic_stream_data_node_t* stream_data);
 picoquic_stream_data_node_t* picoquic_stream_data_node_alloc(picoquic_quic_t* quic);
 void picoquic_clear_stream(picoquic_stream_head_t* stream);
+void picoquic_stream_queue_append(picoquic_stream_head_t* stream, picoquic_stream_queue_node_t* stream_data);
+void picoquic_stream_queue_pop(picoquic_stream_head_t* stream);
+void picoquic_stream_queue_free(picoquic_stream_head_t* stream);
+int picoquic_stream_ring_accepts(picoquic_stream_head_t* stream, uint64_t end_offset, size_t length);
+int picoquic_stream_ring_reserve(picoquic_stream_head_t* stream, uint64_t end_offset);
+void picoquic_stream_ring_write(picoquic_stream_ring_t* ring, uint64_t offset, const uint8_t* bytes, size_t length);
+const uint8_t* picoquic_stream_ring_read(picoquic_stream_ring_t* ring, uint64_t offset, size_t* length);
+void picoquic_stream_ring_free(picoquic_stream_head_t* stream);
+int picoquic_stream_views_input(picoquic_cnx_t* cnx, picoquic_stream_head_t* stream, uint64_t offset, int fin,
+    const uint8_t* bytes, size_t length, picoquic_stream_data_node_t* received_data);
+void picoquic_stream_views_free(picoquic_stream_head_t* stream);
+void picoquic_stream_release_acked(picoquic_stream_head_t* stream);
 void picoquic_delete_stream(picoquic_cnx_t * cnx, picoquic_stream_head_t * stream);
 picoquic_local_cnxid_list_t* picoquic_find_or_create_local_cnxid_list(picoquic_cnx_t* cnx, uint64_t unique_path_id, int do_create);
 picoquic_local_cnxid_t* picoquic_create_local_cnxid(picoquic_cnx_t* cnx,
@@ -44,6 +44,7 @@ typedef struct st_picoquic_socket_ctx_t {
     unsigned int is_started : 1;
     unsigned int supports_udp_send_coalesced : 1;
     unsigned int supports_udp_recv_coalesced : 1;
+    unsigned int reuse_port : 1;
     /* Receive data buffer and fields */
     size_t recv_buffer_size;
     uint8_t* recv_buffer;
@@ -75,7 +76,7 @@ typedef struct st_picoquic_socket_ctx_t {
 typedef enum {
     picoquic_packet_loop_ready = 0, /* Argument type: packet loop options */
     picoquic_packet_loop_after_receive, /* Argument type size_t*: nb packets received */
-    picoquic_packet_loop_after_send, /* Argument type size_t*: nb packets sent */
+    picoquic_packet_loop_after_send, /* Argument type size_t*: nb bytes sent, or packet_loop_after_send_arg_t* if do_after_send_stats is set */
     picoquic_packet_loop_port_update, /* argument type struct_sockaddr*: new address for wakeup */
     picoquic_packet_loop_time_check, /* argument type packet_loop_time_check_arg_t*. Optional. */
     picoquic_packet_loop_system_call_duration, /* argument type packet_loop_system_call_duration_t*. Optional. */
@@ -108,8 +109,29 @@ typedef struct st_packet_loop_time_check_arg_t {
     int64_t delta_t;
 } packet_loop_time_check_arg_t;
 
+/* If the application sets the "after send stats" option, the after send
+* callback receives a pointer to this structure instead of a pointer to
+* the number of bytes sent. The counts are for the current loop iteration.
+* When sends are batched, several messages are sent per system call,
+* and nb_syscalls_saved is the difference between messages and calls.
+*/
+typedef struct st_packet_loop_after_send_arg_t {
+    size_t bytes_sent;
+    uint64_t nb_send_calls;
+    uint64_t nb_send_messages;
+    uint64_t nb_syscalls_saved;
+} packet_loop_after_send_arg_t;
+
 typedef int (*picoquic_packet_loop_cb_fn)(picoquic_quic_t * quic, picoquic_packet_loop_cb_enum cb_mode, void * callback_ctx, void * callback_argv);
 
+/* Optional steering hook, called for each incoming datagram before it is
+ * submitted to the stack. If the hook returns a non zero value, the datagram
+ * was consumed by the hook and is not submitted. This is used by the sharded
+ * server to forward packets to the thread that owns the connection.
+ */
+typedef int (*picoquic_packet_loop_steer_fn)(void* steer_ctx, uint8_t* bytes, size_t length,
+    struct sockaddr* addr_from, struct sockaddr* addr_to, int if_index, unsigned char received_ecn);
+
 /* Packet loop option list shows support by application of optional features.
  * It is set to null initially, and then passed to the socket as argument to
  * the "ready" callback. Application should set the flags corresponding to
@@ -118,6 +140,7 @@ typedef struct st_picoquic_packet_loop_options_t {
     unsigned int do_time_check : 1; /* App should be polled for next time before sock select */
     unsigned int do_system_call_duration : 1; /* App should be notified if the system call duration varies */
     unsigned int provide_alt_port : 1; /* Used for simulating multipath or migrations. */
+    unsigned int do_after_send_stats : 1; /* After send callback receives packet_loop_after_send_arg_t* */
 } picoquic_packet_loop_options_t;
 
 /* Version 2 of packet loop, works in progress.
@@ -133,6 +156,51 @@ typedef struct st_picoquic_packet_loop_param_t {
     int extra_socket_required;
     int simulate_eio;
     size_t send_length_max;
+    /* New fields are added after this point, so the layout of the
+     * fields above stays compatible with existing callers. */
+    /* If recv_batch_size > 0, the loop receives up to that many messages
+     * per system call, using recvmmsg() on Linux (capped at
+     * PICOQUIC_RECVMMSG_MAX). Unless do_not_use_gso is set, it also
+     * enables UDP GRO, and splits coalesced messages into segments
+     * before submitting them to the stack. */
+    int recv_batch_size;
+    /* If send_batch_size > 0, the loop prepares up to that many trains
+     * for different connections before sending them, using a single
+     * sendmmsg() call per socket on Linux (capped at PICOQUIC_SENDMMSG_MAX).
+     * Each train may itself be coalesced with UDP GSO. */
+    int send_batch_size;
+    /* If the library is compiled with PICOQUIC_WITH_IO_URING, the loop
+     * uses the io_uring backend on Linux, unless this flag is set. In that
+     * case recv_batch_size only caps the messages returned per wait, and
+     * sends are always batched. */
+    int do_not_use_io_uring;
+    /* On Linux, the loop waits for packets with epoll instead of select(),
+     * unless this flag is set. */
+    int do_not_use_epoll;
+    /* If set, the sockets are opened with SO_REUSEPORT, so several loops
+     * can listen on the same port. */
+    int reuse_port;
+    /* If pacing_offload_horizon > 0, the sockets are opened with SO_TXTIME
+     * on Linux, and each train is sent with its departure time, letting
+     * the fq qdisc pace the packets. The loop may then prepare packets up
+     * to that many microseconds ahead of time instead of waking up
+     * for each one. If SO_TXTIME is not available, pacing remains in
+     * user space. The socket option is accepted even if the interface
+     * does not use a qdisc that honors departure times, such as fq; the
+     * packets are then sent as soon as they are submitted. The spacing of
+     * packets on the wire with fq has not been compared to user space
+     * pacing. */
+    uint64_t pacing_offload_horizon;
+    picoquic_packet_loop_steer_fn steer_fn;
+    void* steer_ctx;
+    /* Statistics, updated by the loop */
+    uint64_t nb_recv_calls; /* Number of receive calls that returned data */
+    uint64_t nb_recv_datagrams; /* Number of datagrams submitted to the stack */
+    uint64_t nb_send_calls; /* Number of send system calls */
+    uint64_t nb_send_messages; /* Number of messages (trains) sent */
+    uint64_t nb_timer_wakeups; /* Number of waits that ended when the timer expired */
+    uint64_t nb_txtime_messages; /* Number of messages sent with a departure time */
+    int is_io_uring_used; /* Set if the loop runs on the io_uring backend */
 } picoquic_packet_loop_param_t;
 
 int picoquic_packet_loop_v2(picoquic_quic_t* quic,
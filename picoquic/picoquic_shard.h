@@ -0,0 +1,120 @@
+/*
+* Copyright (c) 2026, the picoquic contributors.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef PICOQUIC_SHARD_H
+#define PICOQUIC_SHARD_H
+
+#include "picoquic.h"
+#include "picoquic_packet_loop.h"
+#include "picoquic_lb.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Sharded server. A single picoquic_quic_t context is single threaded.
+ * The sharded server runs N shards, each with its own quic context and
+ * its own network thread, listening on the same port with SO_REUSEPORT.
+ *
+ * The kernel spreads incoming flows between the shards based on the
+ * addresses and ports. Each shard encodes its shard ID in the local
+ * connection IDs, using the load balancer CID generation defined in
+ * picoquic_lb.h. If a packet lands on the wrong shard, e.g., after a
+ * migration or a NAT rebinding, the receiving shard decodes the shard
+ * ID from the destination CID and forwards the packet to the owning
+ * shard through a lock-free queue. Initial and 0-RTT packets, whose
+ * CID is chosen by the client, and packets whose CID does not decode
+ * to a valid shard are processed by the shard that received them.
+ *
+ * The application creates the quic context of each shard through the
+ * create_quic_fn callback. The loop callback is called in the context
+ * of each shard's network thread, with the shard's quic context as
+ * argument, and must be thread safe if it uses shared state.
+ *
+ * The sharded server uses SO_REUSEPORT, and is not available on Windows.
+ */
+
+#define PICOQUIC_SHARD_MAX 64
+#define PICOQUIC_SHARD_QUEUE_SIZE_DEFAULT 1024
+
+typedef picoquic_quic_t* (*picoquic_shard_create_quic_fn)(void* create_quic_ctx, int shard_id);
+
+typedef struct st_picoquic_shard_server_param_t {
+    int nb_shards;
+    /* Template of the packet loop parameters for each shard. If local_port
+     * is zero, the shards use the port obtained by the first shard. */
+    picoquic_packet_loop_param_t loop_param;
+    /* CID configuration. The server ID is set to the shard ID. If
+     * connection_id_length is zero, use a clear text 1 byte server ID
+     * in 8 bytes CIDs. */
+    picoquic_load_balancer_config_t lb_config;
+    picoquic_shard_create_quic_fn create_quic_fn;
+    void* create_quic_ctx;
+    picoquic_packet_loop_cb_fn loop_callback;
+    void* loop_callback_ctx;
+    /* Number of packets in the forwarding queue of each shard, rounded up
+     * to a power of 2. Uses PICOQUIC_SHARD_QUEUE_SIZE_DEFAULT if zero. */
+    size_t queue_size;
+} picoquic_shard_server_param_t;
+
+typedef struct st_picoquic_shard_stats_t {
+    uint64_t nb_forwarded; /* Packets forwarded to other shards */
+    uint64_t nb_dropped; /* Packets dropped because the target queue was full */
+    uint64_t nb_received_forwarded; /* Packets received from other shards */
+} picoquic_shard_stats_t;
+
+typedef struct st_picoquic_shard_server_t picoquic_shard_server_t;
+
+/* Create the shards, their quic contexts and queues, without starting
+ * the network threads. Returns NULL on error. */
+picoquic_shard_server_t* picoquic_shard_server_create(picoquic_shard_server_param_t* param);
+
+/* Start the network threads, and wait until they are ready. */
+int picoquic_shard_server_start(picoquic_shard_server_t* server);
+
+/* Stop the network threads if they are running, and free the quic contexts
+ * and the server. */
+void picoquic_shard_server_delete(picoquic_shard_server_t* server);
+
+int picoquic_shard_server_nb_shards(picoquic_shard_server_t* server);
+picoquic_quic_t* picoquic_shard_server_get_quic(picoquic_shard_server_t* server, int shard_id);
+uint16_t picoquic_shard_server_get_port(picoquic_shard_server_t* server);
+void picoquic_shard_server_get_stats(picoquic_shard_server_t* server, int shard_id, picoquic_shard_stats_t* stats);
+
+/* Steering primitives, used by the network threads, exposed for tests.
+ * picoquic_shard_server_steer returns the ID of the shard that owns the
+ * destination CID of the datagram, or -1 if the datagram is an Initial
+ * or 0-RTT packet, or if the CID does not decode to a valid shard. It
+ * must be called from the thread of shard_id. */
+int picoquic_shard_server_steer(picoquic_shard_server_t* server, int shard_id,
+    const uint8_t* bytes, size_t length);
+/* Copy the datagram to the queue of the target shard, and wake up its
+ * thread if needed. Returns -1 if the queue is full. */
+int picoquic_shard_server_forward(picoquic_shard_server_t* server, int shard_id, int target_id,
+    const uint8_t* bytes, size_t length, const struct sockaddr* addr_from, const struct sockaddr* addr_to,
+    int if_index, unsigned char received_ecn);
+/* Submit the packets queued for the shard to its quic context. Must be
+ * called from the thread of shard_id. Returns the number of packets. */
+int picoquic_shard_server_drain(picoquic_shard_server_t* server, int shard_id, uint64_t current_time);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* PICOQUIC_SHARD_H */
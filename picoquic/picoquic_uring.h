@@ -0,0 +1,69 @@
+/*
+* Copyright (c) 2026, the picoquic contributors.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef PICOQUIC_URING_H
+#define PICOQUIC_URING_H
+
+/* io_uring backend of the packet loop, only available on Linux when
+ * compiled with PICOQUIC_WITH_IO_URING (cmake option WITH_IO_URING).
+ *
+ * The backend keeps one multishot recvmsg operation posted on each
+ * socket, using a ring of buffers provided to the kernel. Waiting for
+ * packets uses a timeout SQE, and sends are submitted as a batch of
+ * sendmsg SQEs. The packet loop falls back to select() if the backend
+ * cannot be initialized, e.g., if io_uring is disabled in the kernel.
+ */
+
+#include "picoquic_packet_loop.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct st_picoquic_uring_ctx_t picoquic_uring_ctx_t;
+
+/* Create the ring, register the buffers and post the receive operations.
+ * The wake up fd, if not -1, is polled and drained by the wait function.
+ * Returns NULL if io_uring is not available. */
+picoquic_uring_ctx_t* picoquic_uring_create(picoquic_socket_ctx_t* s_ctx, int nb_sockets, int wake_up_fd);
+
+void picoquic_uring_delete(picoquic_uring_ctx_t* ctx);
+
+/* Wait for at most delta_t microseconds, and return up to nb_msg
+ * received messages. The message buffers point to the provided buffer
+ * ring, and remain valid until the next call to picoquic_uring_wait,
+ * which returns them to the kernel.
+ * Messages received on sockets of rank nb_sockets_available or higher
+ * are ignored. Sets *is_wake_up_event if the wake up fd was signalled,
+ * in which case no message is returned. Returns -1 on error. */
+int picoquic_uring_wait(picoquic_uring_ctx_t* ctx, int nb_sockets_available,
+    picoquic_recv_msg_t* recv_msgs, int nb_msg, int64_t delta_t, int* is_wake_up_event);
+
+/* Submit the messages as one batch of sendmsg SQEs, and wait for their
+ * completion. On return, sock_err[i] is 0 if message i was sent, or
+ * the error code. Returns the number of messages sent, or -1 if the
+ * ring could not be entered. */
+int picoquic_uring_send(picoquic_uring_ctx_t* ctx, SOCKET_TYPE* fds,
+    picoquic_send_msg_t* msgs, int nb_msgs, int* sock_err);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* PICOQUIC_URING_H */
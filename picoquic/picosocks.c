@@ -19,8 +19,15 @@
 * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE /* Required for recvmmsg() */
+#endif
 #include "picosocks.h"
 #include "picoquic_utils.h"
+#if defined(__linux__)
+#include <linux/net_tstamp.h>
+#include <time.h>
+#endif
 
 int picoquic_bind_to_port(SOCKET_TYPE fd, int af, int port)
 {
@@ -241,6 +248,77 @@ int picoquic_socket_set_pmtud_options(SOCKET_TYPE sd, int af)
     return ret;
 }
 
+/* Ask the kernel to coalesce datagrams received from the same peer
+ * into a single buffer (UDP GRO). The segment size is then reported
+ * in a control message, see picoquic_socks_cmsg_parse.
+ */
+int picoquic_socket_set_udp_gro(SOCKET_TYPE sd)
+{
+    int ret = -1;
+#if !defined(_WINDOWS) && defined(UDP_GRO)
+    int val = 1;
+    ret = setsockopt(sd, SOL_UDP, UDP_GRO, &val, sizeof(val));
+#else
+#ifdef UNREFERENCED_PARAMETER
+    UNREFERENCED_PARAMETER(sd);
+#endif
+#endif
+    return ret;
+}
+
+int picoquic_socket_set_reuse_port(SOCKET_TYPE sd)
+{
+    int ret = -1;
+#if !defined(_WINDOWS) && defined(SO_REUSEPORT)
+    int val = 1;
+    ret = setsockopt(sd, SOL_SOCKET, SO_REUSEPORT, &val, sizeof(val));
+#else
+#ifdef UNREFERENCED_PARAMETER
+    UNREFERENCED_PARAMETER(sd);
+#endif
+#endif
+    return ret;
+}
+
+/* Let the application set the departure time of each message
+ * (SO_TXTIME), expressed in nanoseconds of the monotonic clock. The
+ * departure times are enforced by the fq qdisc, and the messages are
+ * then paced by the kernel.
+ */
+int picoquic_socket_set_txtime(SOCKET_TYPE sd)
+{
+    int ret = -1;
+#if !defined(_WINDOWS) && defined(SO_TXTIME)
+    struct sock_txtime txtime_cfg;
+
+    memset(&txtime_cfg, 0, sizeof(txtime_cfg));
+    txtime_cfg.clockid = CLOCK_MONOTONIC;
+    ret = setsockopt(sd, SOL_SOCKET, SO_TXTIME, &txtime_cfg, sizeof(txtime_cfg));
+#else
+#ifdef UNREFERENCED_PARAMETER
+    UNREFERENCED_PARAMETER(sd);
+#endif
+#endif
+    return ret;
+}
+
+uint64_t picoquic_socks_txtime(uint64_t delay_usec)
+{
+    uint64_t txtime = 0;
+#if !defined(_WINDOWS) && defined(SO_TXTIME)
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+        txtime = ((uint64_t)ts.tv_sec) * 1000000000ull + (uint64_t)ts.tv_nsec + delay_usec * 1000ull;
+    }
+#else
+#ifdef UNREFERENCED_PARAMETER
+    UNREFERENCED_PARAMETER(delay_usec);
+#endif
+#endif
+    return txtime;
+}
+
 SOCKET_TYPE picoquic_open_client_socket(int af)
 {
 #ifdef _WINDOWS
@@ -474,6 +552,15 @@ void picoquic_socks_cmsg_parse(
                 }
             }
         }
+#if defined(UDP_GRO)
+        else if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+            if (udp_coalesced_size != NULL) {
+                int gro_size = 0;
+                memcpy(&gro_size, CMSG_DATA(cmsg), sizeof(int));
+                *udp_coalesced_size = (gro_size > 0) ? (size_t)gro_size : 0;
+            }
+        }
+#endif
     }
 #endif
 }
@@ -531,6 +618,17 @@ void picoquic_socks_cmsg_format(
     size_t send_msg_size,
     struct sockaddr* addr_from,
     int dest_if)
+{
+    picoquic_socks_cmsg_format_ex(vmsg, message_length, send_msg_size, addr_from, dest_if, 0);
+}
+
+void picoquic_socks_cmsg_format_ex(
+    void* vmsg,
+    size_t message_length,
+    size_t send_msg_size,
+    struct sockaddr* addr_from,
+    int dest_if,
+    uint64_t txtime)
 {
 #ifdef _WINDOWS
     WSAMSG* msg = (WSAMSG*)vmsg;
@@ -615,6 +713,8 @@ void picoquic_socks_cmsg_format(
             *pdw = (DWORD)send_msg_size;
         }
     }
+    /* Departure times are not supported on Windows */
+    UNREFERENCED_PARAMETER(txtime);
 
     msg->Control.len = control_length;
     if (control_length == 0) {
@@ -701,6 +801,20 @@ void picoquic_socks_cmsg_format(
         }
     }
 #endif
+#if defined(SCM_TXTIME)
+    if (!is_null && txtime != 0) {
+        uint64_t* pval = (uint64_t*)cmsg_format_header_return_data_ptr(msg, &last_cmsg,
+            &control_length, SOL_SOCKET, SCM_TXTIME, sizeof(uint64_t));
+        if (pval != NULL) {
+            *pval = txtime;
+        }
+        else {
+            is_null = 1;
+        }
+    }
+#else
+    (void)txtime;
+#endif
 
     msg->msg_controllen = control_length;
     if (control_length == 0) {
@@ -1025,6 +1139,65 @@ int picoquic_recvmsg(SOCKET_TYPE fd,
 }
 #endif
 
+int picoquic_recvmmsg(SOCKET_TYPE fd, picoquic_recv_msg_t* msgs, int nb_msg)
+{
+    int nb_recv = 0;
+#if defined(__linux__)
+    struct mmsghdr mmsg[PICOQUIC_RECVMMSG_MAX];
+    struct iovec iov[PICOQUIC_RECVMMSG_MAX];
+
+    if (nb_msg > PICOQUIC_RECVMMSG_MAX) {
+        nb_msg = PICOQUIC_RECVMMSG_MAX;
+    }
+    memset(mmsg, 0, nb_msg * sizeof(struct mmsghdr));
+
+    for (int i = 0; i < nb_msg; i++) {
+        iov[i].iov_base = (char*)msgs[i].buffer;
+        iov[i].iov_len = msgs[i].buffer_max;
+        mmsg[i].msg_hdr.msg_name = (struct sockaddr*)&msgs[i].addr_from;
+        mmsg[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+        mmsg[i].msg_hdr.msg_iov = &iov[i];
+        mmsg[i].msg_hdr.msg_iovlen = 1;
+        mmsg[i].msg_hdr.msg_control = (void*)msgs[i].cmsg_buffer;
+        mmsg[i].msg_hdr.msg_controllen = sizeof(msgs[i].cmsg_buffer);
+    }
+
+    /* Do not block: the caller only calls this after select or poll
+     * reported the socket as readable. */
+    nb_recv = recvmmsg(fd, mmsg, (unsigned int)nb_msg, MSG_DONTWAIT, NULL);
+    if (nb_recv < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        nb_recv = 0;
+    }
+
+    for (int i = 0; i < nb_recv; i++) {
+        msgs[i].bytes_recv = mmsg[i].msg_len;
+        msgs[i].dest_if = 0;
+        msgs[i].received_ecn = 0;
+        msgs[i].udp_coalesced_size = 0;
+        picoquic_socks_cmsg_parse(&mmsg[i].msg_hdr, &msgs[i].addr_dest, &msgs[i].dest_if,
+            &msgs[i].received_ecn, &msgs[i].udp_coalesced_size);
+    }
+#else
+    int bytes_recv;
+
+    if (nb_msg <= 0) {
+        return 0;
+    }
+    msgs[0].received_ecn = 0;
+    msgs[0].udp_coalesced_size = 0;
+    bytes_recv = picoquic_recvmsg(fd, &msgs[0].addr_from, &msgs[0].addr_dest,
+        &msgs[0].dest_if, &msgs[0].received_ecn, msgs[0].buffer, (int)msgs[0].buffer_max);
+    if (bytes_recv > 0) {
+        msgs[0].bytes_recv = (size_t)bytes_recv;
+        nb_recv = 1;
+    }
+    else {
+        nb_recv = bytes_recv;
+    }
+#endif
+    return nb_recv;
+}
+
 int picoquic_sendmsg(SOCKET_TYPE fd,
     struct sockaddr* addr_dest,
     struct sockaddr* addr_from,
@@ -1032,6 +1205,18 @@ int picoquic_sendmsg(SOCKET_TYPE fd,
     const char* bytes, int length,
     int send_msg_size,
     int * sock_err)
+{
+    return picoquic_sendmsg_ex(fd, addr_dest, addr_from, dest_if, bytes, length, send_msg_size, 0, sock_err);
+}
+
+int picoquic_sendmsg_ex(SOCKET_TYPE fd,
+    struct sockaddr* addr_dest,
+    struct sockaddr* addr_from,
+    int dest_if,
+    const char* bytes, int length,
+    int send_msg_size,
+    uint64_t txtime,
+    int * sock_err)
 #ifdef _WINDOWS
 {
     GUID WSASendMsg_GUID = WSAID_WSASENDMSG;
@@ -1069,7 +1254,7 @@ int picoquic_sendmsg(SOCKET_TYPE fd,
         msg.Control.len = sizeof(cmsg_buffer);
 
         /* Format the control message */
-        picoquic_socks_cmsg_format(&msg, length, send_msg_size, addr_from, dest_if);
+        picoquic_socks_cmsg_format_ex(&msg, length, send_msg_size, addr_from, dest_if, txtime);
 
         /* Send the message */
         ret = WSASendMsg(fd, &msg, 0, &dwBytesSent, NULL, NULL);
@@ -1118,7 +1303,7 @@ int picoquic_sendmsg(SOCKET_TYPE fd,
     msg.msg_controllen = sizeof(cmsg_buffer);
 
     /* Format the control message */
-    picoquic_socks_cmsg_format(&msg, length, send_msg_size, addr_from, dest_if);
+    picoquic_socks_cmsg_format_ex(&msg, length, send_msg_size, addr_from, dest_if, txtime);
 
     bytes_sent = sendmsg(fd, &msg, 0);
 
@@ -1137,6 +1322,63 @@ int picoquic_sendmsg(SOCKET_TYPE fd,
 }
 #endif
 
+int picoquic_sendmmsg(SOCKET_TYPE fd, picoquic_send_msg_t* msgs, int nb_msg, int* sock_err)
+{
+    int nb_sent = 0;
+#if defined(__linux__)
+    struct mmsghdr mmsg[PICOQUIC_SENDMMSG_MAX];
+    struct iovec iov[PICOQUIC_SENDMMSG_MAX];
+
+    if (nb_msg > PICOQUIC_SENDMMSG_MAX) {
+        nb_msg = PICOQUIC_SENDMMSG_MAX;
+    }
+    memset(mmsg, 0, nb_msg * sizeof(struct mmsghdr));
+
+    for (int i = 0; i < nb_msg; i++) {
+        iov[i].iov_base = (char*)msgs[i].bytes;
+        iov[i].iov_len = msgs[i].length;
+        mmsg[i].msg_hdr.msg_name = (struct sockaddr*)&msgs[i].addr_dest;
+        mmsg[i].msg_hdr.msg_namelen = picoquic_addr_length((struct sockaddr*)&msgs[i].addr_dest);
+        mmsg[i].msg_hdr.msg_iov = &iov[i];
+        mmsg[i].msg_hdr.msg_iovlen = 1;
+        mmsg[i].msg_hdr.msg_control = (void*)msgs[i].cmsg_buffer;
+        mmsg[i].msg_hdr.msg_controllen = sizeof(msgs[i].cmsg_buffer);
+        /* Format the control message, including source address, segment size and departure time */
+        picoquic_socks_cmsg_format_ex(&mmsg[i].msg_hdr, msgs[i].length, msgs[i].send_msg_size,
+            (struct sockaddr*)&msgs[i].addr_from, msgs[i].dest_if, msgs[i].txtime);
+    }
+
+    nb_sent = sendmmsg(fd, mmsg, (unsigned int)nb_msg, 0);
+
+    if (nb_sent <= 0) {
+        int last_error = errno;
+#ifndef DISABLE_DEBUG_PRINTF
+        DBG_PRINTF("Could not send %d messages on UDP socket, sent %d, err= %d!\n",
+            nb_msg, nb_sent, last_error);
+#endif
+        if (sock_err != NULL) {
+            *sock_err = last_error;
+        }
+    }
+#else
+    /* No batch API, send the messages one at a time. */
+    while (nb_sent < nb_msg) {
+        int bytes_sent = picoquic_sendmsg_ex(fd, (struct sockaddr*)&msgs[nb_sent].addr_dest,
+            (struct sockaddr*)&msgs[nb_sent].addr_from, msgs[nb_sent].dest_if,
+            (const char*)msgs[nb_sent].bytes, (int)msgs[nb_sent].length,
+            (int)msgs[nb_sent].send_msg_size, msgs[nb_sent].txtime, sock_err);
+        if (bytes_sent <= 0) {
+            if (nb_sent == 0) {
+                nb_sent = -1;
+            }
+            break;
+        }
+        nb_sent++;
+    }
+#endif
+    return nb_sent;
+}
+
 int picoquic_select_ex(SOCKET_TYPE* sockets,
     int nb_sockets,
     struct sockaddr_storage* addr_from,
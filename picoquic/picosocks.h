@@ -185,6 +185,17 @@ void picoquic_close_server_sockets(picoquic_server_sockets_t* sockets);
 int picoquic_socket_set_pkt_info(SOCKET_TYPE sd, int af);
 int picoquic_socket_set_ecn_options(SOCKET_TYPE sd, int af, int * recv_set, int * send_set);
 int picoquic_socket_set_pmtud_options(SOCKET_TYPE sd, int af);
+int picoquic_socket_set_udp_gro(SOCKET_TYPE sd);
+/* Let several sockets bind to the same port, with the kernel spreading
+ * the incoming flows between them (SO_REUSEPORT). Not available on Windows. */
+int picoquic_socket_set_reuse_port(SOCKET_TYPE sd);
+/* Let the application set departure times of messages (SO_TXTIME), so
+ * that pacing can be offloaded to the fq qdisc. Not available on Windows.
+ * picoquic_socks_txtime returns the departure time to pass to the socket
+ * for a message sent delay_usec microseconds from now, or 0 if the
+ * feature is not available. */
+int picoquic_socket_set_txtime(SOCKET_TYPE sd);
+uint64_t picoquic_socks_txtime(uint64_t delay_usec);
 
 int picoquic_select(SOCKET_TYPE* sockets, int nb_sockets,
     struct sockaddr_storage* addr_from,
@@ -213,6 +224,32 @@ int picoquic_recvmsg(SOCKET_TYPE fd,
     unsigned char* received_ecn,
     uint8_t* buffer, int buffer_max);
 
+/* Batch receive. On Linux, picoquic_recvmmsg uses a single recvmmsg()
+ * call to receive up to nb_msg messages. On other platforms, it falls
+ * back to a single call to picoquic_recvmsg. The caller provides the
+ * buffers. If UDP GRO is enabled on the socket, a message may contain
+ * several datagrams coalesced by the kernel, in which case
+ * udp_coalesced_size is set to the size of each segment, except
+ * possibly the last one. Returns the number of messages received,
+ * or -1 on error.
+ */
+#define PICOQUIC_RECVMMSG_MAX 64
+#define PICOQUIC_RECVMMSG_CMSG_SIZE 256
+
+typedef struct st_picoquic_recv_msg_t {
+    uint8_t* buffer;
+    size_t buffer_max;
+    struct sockaddr_storage addr_from;
+    struct sockaddr_storage addr_dest;
+    int dest_if;
+    unsigned char received_ecn;
+    size_t udp_coalesced_size;
+    size_t bytes_recv;
+    char cmsg_buffer[PICOQUIC_RECVMMSG_CMSG_SIZE];
+} picoquic_recv_msg_t;
+
+int picoquic_recvmmsg(SOCKET_TYPE fd, picoquic_recv_msg_t* msgs, int nb_msg);
+
 int picoquic_sendmsg(SOCKET_TYPE fd,
     struct sockaddr* addr_dest,
     struct sockaddr* addr_from,
@@ -220,6 +257,40 @@ int picoquic_sendmsg(SOCKET_TYPE fd,
     const char* bytes, int length,
     int send_msg_size, int * sock_err);
 
+/* Same as picoquic_sendmsg, but if txtime is not zero, the message
+ * departs at that time, see picoquic_socket_set_txtime. */
+int picoquic_sendmsg_ex(SOCKET_TYPE fd,
+    struct sockaddr* addr_dest,
+    struct sockaddr* addr_from,
+    int dest_if,
+    const char* bytes, int length,
+    int send_msg_size, uint64_t txtime, int * sock_err);
+
+/* Batch send. On Linux, picoquic_sendmmsg uses a single sendmmsg()
+ * call to send up to nb_msg messages, each with its own destination,
+ * source address and interface, and, if UDP GSO is used, segment size.
+ * On other platforms, it falls back to a series of picoquic_sendmsg calls.
+ * Returns the number of messages sent, or -1 if the first one could not
+ * be sent, in which case *sock_err is set to the error. Fewer than nb_msg
+ * messages may be sent without error, e.g. if nb_msg is larger than
+ * PICOQUIC_SENDMMSG_MAX; the caller retries with the remaining messages.
+ */
+#define PICOQUIC_SENDMMSG_MAX 64
+#define PICOQUIC_SENDMMSG_CMSG_SIZE 256
+
+typedef struct st_picoquic_send_msg_t {
+    const uint8_t* bytes;
+    size_t length;
+    size_t send_msg_size;
+    struct sockaddr_storage addr_dest;
+    struct sockaddr_storage addr_from;
+    int dest_if;
+    uint64_t txtime; /* Departure time if not zero, see picoquic_socket_set_txtime */
+    char cmsg_buffer[PICOQUIC_SENDMMSG_CMSG_SIZE];
+} picoquic_send_msg_t;
+
+int picoquic_sendmmsg(SOCKET_TYPE fd, picoquic_send_msg_t* msgs, int nb_msg, int* sock_err);
+
 int picoquic_send_through_socket(
     SOCKET_TYPE fd,
     struct sockaddr* addr_dest,
@@ -265,6 +336,16 @@ void picoquic_socks_cmsg_format(
     struct sockaddr* addr_from,
     int dest_if);
 
+/* Same as picoquic_socks_cmsg_format, but if txtime is not zero, also
+ * set the departure time of the message (SCM_TXTIME). */
+void picoquic_socks_cmsg_format_ex(
+    void* vmsg,
+    size_t message_length,
+    size_t send_msg_size,
+    struct sockaddr* addr_from,
+    int dest_if,
+    uint64_t txtime);
+
 #ifdef __cplusplus
 }
 #endif
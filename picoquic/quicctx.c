@@ -638,6 +638,7 @@ picoquic_quic_t* picoquic_create(uint32_t max_nb_connections,
 
         quic->default_callback_fn = default_callback_fn;
         quic->default_callback_ctx = default_callback_ctx;
+        quic->default_path_scheduler = picoquic_default_path_scheduler;
         quic->default_congestion_alg = PICOQUIC_DEFAULT_CONGESTION_ALGORITHM;
         quic->default_alpn = picoquic_string_duplicate(default_alpn);
         quic->cnx_id_callback_fn = cnx_id_callback;
@@ -877,6 +878,11 @@ void picoquic_set_max_data_control(picoquic_quic_t* quic, uint64_t max_data)
     }
 }
 
+void picoquic_set_receive_window_tuning(picoquic_quic_t* quic, uint64_t memory_budget)
+{
+    quic->rwnd_budget = memory_budget;
+}
+
 void picoquic_set_default_idle_timeout(picoquic_quic_t* quic, uint64_t idle_timeout_ms)
 {
     quic->default_tp.max_idle_timeout = idle_timeout_ms;
@@ -909,6 +915,21 @@ uint64_t picoquic_get_crypto_epoch_length(picoquic_cnx_t* cnx)
     return cnx->crypto_epoch_length_max;
 }
 
+void picoquic_set_default_hibernation_delay(picoquic_quic_t* quic, uint64_t hibernation_delay_us)
+{
+    quic->default_hibernation_delay = hibernation_delay_us;
+}
+
+void picoquic_set_hibernation_delay(picoquic_cnx_t* cnx, uint64_t hibernation_delay_us)
+{
+    cnx->hibernation_delay = hibernation_delay_us;
+}
+
+int picoquic_is_cnx_hibernating(picoquic_cnx_t* cnx)
+{
+    return cnx->is_hibernating;
+}
+
 
 uint8_t picoquic_get_local_cid_length(picoquic_quic_t* quic)
 {
@@ -947,6 +968,14 @@ void picoquic_free(picoquic_quic_t* quic)
             picoquic_delete_cnx(quic->cnx_list);
         }
 
+        if (quic->wake_wheel != NULL) {
+            picoquic_wake_wheel_delete(quic->wake_wheel);
+            quic->wake_wheel = NULL;
+        }
+
+        /* Stop the crypto workers */
+        (void)picoquic_set_crypto_workers(quic, 0);
+
         /* Delete TLS and AEAD cntexts */
         picoquic_delete_retry_protection_contexts(quic);
 
@@ -975,13 +1004,7 @@ void picoquic_free(picoquic_quic_t* quic)
         picosplay_empty_tree(&quic->token_reuse_tree);
 
         /* delete packets in pool */
-        while (quic->p_first_packet != NULL) {
-            picoquic_packet_t * p = quic->p_first_packet->packet_previous;
-            free(quic->p_first_packet);
-            quic->p_first_packet = p;
-            quic->nb_packets_allocated--;
-            quic->nb_packets_in_pool--;
-        }
+        picoquic_free_packet_pool(quic);
 
         /* delete data nodes in pool */
         while (quic->p_first_data_node != NULL) {
@@ -1015,6 +1038,8 @@ void picoquic_free(picoquic_quic_t* quic)
             picohash_delete(quic->table_issued_tickets, 1);
         }
 
+        picoquic_path_metrics_cache_free(quic);
+
         if (quic->table_cnx_by_secret != NULL) {
             picohash_delete(quic->table_cnx_by_secret, 1);
         }
@@ -1371,12 +1396,62 @@ static void picoquic_wake_list_init(picoquic_quic_t * quic)
 
 static void picoquic_remove_cnx_from_wake_list(picoquic_cnx_t* cnx)
 {
-    picosplay_delete_hint(&cnx->quic->cnx_wake_tree, &cnx->cnx_wake_node);
+    if (cnx->quic->wake_wheel != NULL) {
+        picoquic_wake_wheel_remove(cnx->quic->wake_wheel, cnx);
+    }
+    else {
+        picosplay_delete_hint(&cnx->quic->cnx_wake_tree, &cnx->cnx_wake_node);
+    }
 }
 
 static void picoquic_insert_cnx_by_wake_time(picoquic_quic_t* quic, picoquic_cnx_t* cnx)
 {
-    picosplay_insert(&quic->cnx_wake_tree, cnx);
+    if (quic->wake_wheel != NULL) {
+        picoquic_wake_wheel_insert(quic->wake_wheel, cnx);
+    }
+    else {
+        picosplay_insert(&quic->cnx_wake_tree, cnx);
+    }
+}
+
+static picoquic_cnx_t* picoquic_wake_list_first(picoquic_quic_t* quic)
+{
+    if (quic->wake_wheel != NULL) {
+        return picoquic_wake_wheel_first(quic->wake_wheel);
+    }
+    return (picoquic_cnx_t*)picoquic_wake_list_node_value(picosplay_first(&quic->cnx_wake_tree));
+}
+
+int picoquic_set_wake_scheduler(picoquic_quic_t* quic, picoquic_wake_scheduler_enum wake_scheduler)
+{
+    int ret = 0;
+    int use_wheel = (wake_scheduler == picoquic_wake_scheduler_wheel);
+
+    if (use_wheel != (quic->wake_wheel != NULL)) {
+        picoquic_wake_wheel_t* old_wheel = quic->wake_wheel;
+        picoquic_wake_wheel_t* new_wheel = NULL;
+
+        if (use_wheel && (new_wheel = picoquic_wake_wheel_create(picoquic_get_quic_time(quic))) == NULL) {
+            ret = -1;
+        }
+        else {
+            /* Move the existing connections to the new structure */
+            picoquic_cnx_t* cnx = quic->cnx_list;
+            while (cnx != NULL) {
+                picoquic_remove_cnx_from_wake_list(cnx);
+                cnx = cnx->next_in_table;
+            }
+            quic->wake_wheel = new_wheel;
+            cnx = quic->cnx_list;
+            while (cnx != NULL) {
+                picoquic_insert_cnx_by_wake_time(quic, cnx);
+                cnx = cnx->next_in_table;
+            }
+            picoquic_wake_wheel_delete(old_wheel);
+        }
+    }
+
+    return ret;
 }
 
 void picoquic_reinsert_by_wake_time(picoquic_quic_t* quic, picoquic_cnx_t* cnx, uint64_t next_time)
@@ -1388,7 +1463,7 @@ void picoquic_reinsert_by_wake_time(picoquic_quic_t* quic, picoquic_cnx_t* cnx,
 
 picoquic_cnx_t* picoquic_get_earliest_cnx_to_wake(picoquic_quic_t* quic, uint64_t max_wake_time)
 {
-    picoquic_cnx_t* cnx = (picoquic_cnx_t *)picoquic_wake_list_node_value(picosplay_first(&quic->cnx_wake_tree));
+    picoquic_cnx_t* cnx = picoquic_wake_list_first(quic);
     if (cnx != NULL && max_wake_time != 0 && cnx->next_wake_time > max_wake_time)
     {
         cnx = NULL;
@@ -1405,8 +1480,7 @@ uint64_t picoquic_get_next_wake_time(picoquic_quic_t* quic, uint64_t current_tim
         wake_time = current_time;
     }
     else{
-        picoquic_cnx_t* cnx_wake_first = (picoquic_cnx_t*)picoquic_wake_list_node_value(
-            picosplay_first(&quic->cnx_wake_tree));
+        picoquic_cnx_t* cnx_wake_first = picoquic_wake_list_first(quic);
 
         if (cnx_wake_first != NULL) {
             wake_time = cnx_wake_first->next_wake_time;
@@ -2488,6 +2562,7 @@ void picoquic_reset_path_mtu(picoquic_path_t* path_x)
 void picoquic_init_ack_ctx(picoquic_cnx_t* cnx, picoquic_ack_context_t* ack_ctx)
 {
     picoquic_sack_list_init(&ack_ctx->sack_list);
+    ack_ctx->sack_list.max_ranges = PICOQUIC_SACK_RANGES_MAX_ACK;
     ack_ctx->time_stamp_largest_received = UINT64_MAX;
     ack_ctx->act[0].highest_ack_sent = 0;
     ack_ctx->act[0].highest_ack_sent_time = cnx->start_time;
@@ -2509,6 +2584,8 @@ void picoquic_init_packet_ctx(picoquic_cnx_t* cnx, picoquic_packet_context_t* pk
     }
     pkt_ctx->pending_last = NULL;
     pkt_ctx->pending_first = NULL;
+    pkt_ctx->sent_ring = NULL;
+    pkt_ctx->sent_ring_mask = 0;
     pkt_ctx->highest_acknowledged = pkt_ctx->send_sequence - 1;
     pkt_ctx->latest_time_acknowledged = cnx->start_time;
     pkt_ctx->highest_acknowledged_time = cnx->start_time;
@@ -3018,6 +3095,8 @@ picoquic_stream_data_node_t* picoquic_stream_data_node_alloc(picoquic_quic_t* qu
         quic->p_first_data_node = stream_data->next_stream_data;
         stream_data->next_stream_data = NULL;
         stream_data->bytes = NULL;
+        stream_data->nb_views = 0;
+        stream_data->is_decoding = 0;
         quic->nb_data_nodes_in_pool--;
     }
 
@@ -3044,19 +3123,424 @@ static void * picoquic_stream_node_value(picosplay_node_t * node)
     return (void*)((char*)node - offsetof(struct st_picoquic_stream_head_t, stream_node));
 }
 
-void picoquic_clear_stream(picoquic_stream_head_t* stream)
+/* Management of the stream send queue. Segments are appended at the tail in
+ * constant time. When a segment is fully sent, it is freed, unless it refers
+ * to an application buffer with a release function, in which case it waits
+ * in the release queue until the peer acknowledges it.
+ */
+void picoquic_stream_queue_append(picoquic_stream_head_t* stream, picoquic_stream_queue_node_t* stream_data)
+{
+    uint64_t start_offset = (stream->send_queue_last == NULL) ? stream->sent_offset : stream->send_queue_last->stream_offset_end;
+
+    stream_data->next_stream_data = NULL;
+    stream_data->stream_offset_end = start_offset + stream_data->length - stream_data->offset;
+    if (stream->send_queue_last == NULL) {
+        stream->send_queue = stream_data;
+    }
+    else {
+        stream->send_queue_last->next_stream_data = stream_data;
+    }
+    stream->send_queue_last = stream_data;
+}
+
+static void picoquic_stream_queue_node_free(picoquic_stream_queue_node_t* stream_data, int is_acknowledged)
+{
+    if (stream_data->is_reference) {
+        if (stream_data->release_fn != NULL) {
+            stream_data->release_fn(stream_data->release_ctx, is_acknowledged);
+        }
+    }
+    else if (stream_data->bytes != NULL) {
+        free(stream_data->bytes);
+    }
+    free(stream_data);
+}
+
+void picoquic_stream_queue_pop(picoquic_stream_head_t* stream)
+{
+    picoquic_stream_queue_node_t* stream_data = stream->send_queue;
+
+    if (stream_data != NULL) {
+        stream->send_queue = stream_data->next_stream_data;
+        if (stream->send_queue == NULL) {
+            stream->send_queue_last = NULL;
+        }
+        if (stream_data->is_reference && stream_data->release_fn != NULL) {
+            stream_data->next_stream_data = NULL;
+            if (stream->release_queue_last == NULL) {
+                stream->release_queue = stream_data;
+            }
+            else {
+                stream->release_queue_last->next_stream_data = stream_data;
+            }
+            stream->release_queue_last = stream_data;
+            /* The data may already be acknowledged, e.g., if it was repeated */
+            picoquic_stream_release_acked(stream);
+        }
+        else {
+            picoquic_stream_queue_node_free(stream_data, 0);
+        }
+    }
+}
+
+/* Release the segments whose data was entirely acknowledged, i.e., segments
+ * ending before the end of the first acknowledged range.
+ */
+void picoquic_stream_release_acked(picoquic_stream_head_t* stream)
+{
+    if (stream->release_queue != NULL) {
+        picoquic_sack_item_t* first_range = picoquic_sack_first_item(&stream->sack_list);
+
+        if (first_range != NULL && picoquic_sack_item_range_start(first_range) == 0) {
+            uint64_t acked_end = picoquic_sack_item_range_end(first_range) + 1;
+
+            while (stream->release_queue != NULL && stream->release_queue->stream_offset_end <= acked_end) {
+                picoquic_stream_queue_node_t* stream_data = stream->release_queue;
+                stream->release_queue = stream_data->next_stream_data;
+                if (stream->release_queue == NULL) {
+                    stream->release_queue_last = NULL;
+                }
+                picoquic_stream_queue_node_free(stream_data, 1);
+            }
+        }
+    }
+}
+
+/* Free all the queued segments, e.g., when the stream is reset or deleted.
+ * Application buffers that are not yet acknowledged are released with
+ * is_acknowledged = 0.
+ */
+void picoquic_stream_queue_free(picoquic_stream_head_t* stream)
 {
-    picoquic_stream_queue_node_t* ready = stream->send_queue;
     picoquic_stream_queue_node_t* next;
 
-    while ((next = ready) != NULL) {
-        ready = next->next_stream_data;
-        if (next->bytes != NULL) {
-            free(next->bytes);
+    picoquic_stream_release_acked(stream);
+    while ((next = stream->release_queue) != NULL) {
+        stream->release_queue = next->next_stream_data;
+        picoquic_stream_queue_node_free(next, 0);
+    }
+    stream->release_queue_last = NULL;
+    while ((next = stream->send_queue) != NULL) {
+        stream->send_queue = next->next_stream_data;
+        picoquic_stream_queue_node_free(next, 0);
+    }
+    stream->send_queue_last = NULL;
+}
+
+/* Management of the reassembly ring. The ring is created when the first
+ * out of order segment is received, and grows by powers of 2 until it can
+ * hold all the data between the consumed offset and the end of the segment.
+ * The caller checks that the segment is within the flow control window,
+ * and that the ring accepts it.
+ */
+int picoquic_stream_ring_accepts(picoquic_stream_head_t* stream, uint64_t end_offset, size_t length)
+{
+    uint64_t needed = end_offset - stream->consumed_offset;
+    uint64_t buffered = length;
+    int accepted = (needed <= PICOQUIC_STREAM_RING_SIZE_MIN ||
+        (stream->reassembly_ring != NULL && needed <= stream->reassembly_ring->size));
+
+    if (!accepted) {
+        /* Count the bytes held in the ring, which are all after the consumed offset */
+        if (stream->reassembly_ring != NULL) {
+            picoquic_sack_item_t* range = picoquic_sack_first_item(&stream->reassembly_ring->ranges);
+
+            while (range != NULL) {
+                buffered += range->end_of_sack_range + 1 - range->start_of_sack_range;
+                range = picoquic_sack_next_item(range);
+            }
+        }
+        accepted = (needed / PICOQUIC_STREAM_RING_SPAN_RATIO <= buffered);
+    }
+
+    return accepted;
+}
+
+int picoquic_stream_ring_reserve(picoquic_stream_head_t* stream, uint64_t end_offset)
+{
+    int ret = 0;
+    picoquic_stream_ring_t* ring = stream->reassembly_ring;
+    uint64_t needed = end_offset - stream->consumed_offset;
+
+    if (ring == NULL) {
+        ring = (picoquic_stream_ring_t*)malloc(sizeof(picoquic_stream_ring_t));
+        if (ring == NULL) {
+            ret = PICOQUIC_ERROR_MEMORY;
+        }
+        else {
+            memset(ring, 0, sizeof(picoquic_stream_ring_t));
+            picoquic_sack_list_init(&ring->ranges);
+            stream->reassembly_ring = ring;
+        }
+    }
+
+    if (ret == 0 && needed > ring->size) {
+        picoquic_stream_ring_t new_ring;
+        size_t new_size = (ring->size == 0) ? PICOQUIC_STREAM_RING_SIZE_MIN : ring->size;
+
+        while (new_size < needed && new_size <= (SIZE_MAX >> 1)) {
+            new_size <<= 1;
         }
-        free(next);
+        memset(&new_ring, 0, sizeof(picoquic_stream_ring_t));
+        if (new_size < needed || (new_ring.buffer = (uint8_t*)malloc(new_size)) == NULL) {
+            ret = PICOQUIC_ERROR_MEMORY;
+        }
+        else {
+            /* Move the data received so far to its position in the new ring */
+            picoquic_sack_item_t* range = picoquic_sack_first_item(&ring->ranges);
+
+            new_ring.size = new_size;
+            while (range != NULL) {
+                uint64_t offset = (range->start_of_sack_range > stream->consumed_offset) ?
+                    range->start_of_sack_range : stream->consumed_offset;
+
+                while (offset <= range->end_of_sack_range) {
+                    size_t length = (size_t)(range->end_of_sack_range + 1 - offset);
+                    const uint8_t* bytes = picoquic_stream_ring_read(ring, offset, &length);
+
+                    picoquic_stream_ring_write(&new_ring, offset, bytes, length);
+                    offset += length;
+                }
+                range = picoquic_sack_next_item(range);
+            }
+            free(ring->buffer);
+            ring->buffer = new_ring.buffer;
+            ring->size = new_size;
+        }
+    }
+
+    return ret;
+}
+
+void picoquic_stream_ring_write(picoquic_stream_ring_t* ring, uint64_t offset, const uint8_t* bytes, size_t length)
+{
+    size_t position = (size_t)(offset & (ring->size - 1));
+    size_t first_length = ring->size - position;
+
+    if (first_length > length) {
+        first_length = length;
+    }
+    memcpy(ring->buffer + position, bytes, first_length);
+    if (first_length < length) {
+        memcpy(ring->buffer, bytes + first_length, length - first_length);
+    }
+}
+
+/* Return the bytes stored at the specified offset. The length is reduced
+ * if the data wraps around the end of the ring. */
+const uint8_t* picoquic_stream_ring_read(picoquic_stream_ring_t* ring, uint64_t offset, size_t* length)
+{
+    size_t position = (size_t)(offset & (ring->size - 1));
+
+    if (*length > ring->size - position) {
+        *length = ring->size - position;
+    }
+    return ring->buffer + position;
+}
+
+void picoquic_stream_ring_free(picoquic_stream_head_t* stream)
+{
+    if (stream->reassembly_ring != NULL) {
+        picoquic_sack_list_free(&stream->reassembly_ring->ranges);
+        free(stream->reassembly_ring->buffer);
+        free(stream->reassembly_ring);
+        stream->reassembly_ring = NULL;
+    }
+}
+
+/* Zero copy receive.
+ * The stream keeps a list of views of the received data, ordered by offset and not
+ * overlapping. The views up to "last_contiguous_view" cover the data received in
+ * sequence after the consumed offset. Each view holds a reference to the data node
+ * containing its bytes, which is either a decrypted packet or a copy.
+ */
+static uint64_t picoquic_stream_views_end(picoquic_stream_head_t* stream)
+{
+    return (stream->last_contiguous_view == NULL) ? stream->consumed_offset :
+        stream->last_contiguous_view->offset + stream->last_contiguous_view->length;
+}
+
+static void picoquic_stream_view_release(picoquic_stream_view_node_t* view)
+{
+    view->data_node->nb_views--;
+    if (view->data_node->nb_views <= 0) {
+        if (view->data_node->is_decoding) {
+            /* The views were consumed while the packet is still parsed.
+             * Hand the packet back to the decoder, which recycles it. */
+            view->data_node->bytes = NULL;
+        }
+        else {
+            picoquic_stream_data_node_recycle(view->data_node);
+        }
+    }
+    free(view);
+}
+
+/* Create a view of the bytes, inserted after "previous". The received packet is
+ * referenced if it contains the bytes and is not already owned by another
+ * structure, otherwise the bytes are copied. */
+static picoquic_stream_view_node_t* picoquic_stream_view_create(picoquic_cnx_t* cnx, picoquic_stream_head_t* stream,
+    picoquic_stream_view_node_t* previous, uint64_t offset, const uint8_t* bytes, size_t length,
+    picoquic_stream_data_node_t* received_data)
+{
+    picoquic_stream_view_node_t* view = (picoquic_stream_view_node_t*)malloc(sizeof(picoquic_stream_view_node_t));
+
+    if (view != NULL) {
+        memset(view, 0, sizeof(picoquic_stream_view_node_t));
+        if (received_data != NULL && bytes >= received_data->data &&
+            bytes + length <= received_data->data + PICOQUIC_MAX_PACKET_SIZE &&
+            (received_data->bytes == NULL || received_data->nb_views > 0)) {
+            /* Setting "bytes" prevents recycling of the packet after decoding */
+            received_data->bytes = received_data->data;
+            view->data_node = received_data;
+            view->bytes = bytes;
+        }
+        else if (length <= PICOQUIC_MAX_PACKET_SIZE &&
+            (view->data_node = picoquic_stream_data_node_alloc(cnx->quic)) != NULL) {
+            view->data_node->bytes = view->data_node->data;
+            view->data_node->offset = offset;
+            view->data_node->length = length;
+            memcpy(view->data_node->data, bytes, length);
+            view->bytes = view->data_node->data;
+        }
+        else {
+            free(view);
+            view = NULL;
+        }
+    }
+
+    if (view != NULL) {
+        view->data_node->nb_views++;
+        view->offset = offset;
+        view->length = length;
+        if (previous == NULL) {
+            view->next_view = stream->first_view;
+            stream->first_view = view;
+        }
+        else {
+            view->next_view = previous->next_view;
+            previous->next_view = view;
+        }
+        if (view->next_view == NULL) {
+            stream->last_view = view;
+        }
+    }
+
+    return view;
+}
+
+/* Add the data that was not already received to the views */
+static int picoquic_stream_views_insert(picoquic_cnx_t* cnx, picoquic_stream_head_t* stream, uint64_t offset,
+    const uint8_t* bytes, size_t length, picoquic_stream_data_node_t* received_data)
+{
+    int ret = 0;
+    uint64_t end_offset = offset + length;
+    uint64_t start = picoquic_stream_views_end(stream);
+    picoquic_stream_view_node_t* previous = stream->last_contiguous_view;
+    picoquic_stream_view_node_t* next;
+
+    if (start < offset) {
+        start = offset;
+    }
+    if (stream->last_view != NULL && stream->last_view->offset + stream->last_view->length <= start) {
+        /* Common case, data arriving after all the views */
+        previous = stream->last_view;
+    }
+    next = (previous == NULL) ? stream->first_view : previous->next_view;
+
+    while (ret == 0 && start < end_offset) {
+        while (next != NULL && next->offset + next->length <= start) {
+            previous = next;
+            next = next->next_view;
+        }
+        if (next != NULL && next->offset <= start) {
+            /* Already received */
+            start = next->offset + next->length;
+        }
+        else {
+            uint64_t gap_end = (next != NULL && next->offset < end_offset) ? next->offset : end_offset;
+
+            while (ret == 0 && start < gap_end) {
+                size_t chunk_length = (gap_end - start > PICOQUIC_MAX_PACKET_SIZE) ?
+                    PICOQUIC_MAX_PACKET_SIZE : (size_t)(gap_end - start);
+
+                previous = picoquic_stream_view_create(cnx, stream, previous, start,
+                    bytes + (start - offset), chunk_length, received_data);
+                if (previous == NULL) {
+                    ret = PICOQUIC_ERROR_MEMORY;
+                }
+                else {
+                    start += chunk_length;
+                }
+            }
+        }
+    }
+
+    if (ret == 0) {
+        /* Extend the data received in sequence */
+        uint64_t contiguous_end = picoquic_stream_views_end(stream);
+
+        next = (stream->last_contiguous_view == NULL) ? stream->first_view : stream->last_contiguous_view->next_view;
+        while (next != NULL && next->offset <= contiguous_end) {
+            stream->last_contiguous_view = next;
+            contiguous_end = next->offset + next->length;
+            next = next->next_view;
+        }
+    }
+
+    return ret;
+}
+
+/* The application may consume the views from within the notification. The
+ * stream is not deleted during the call, the caller checks "fin_signalled". */
+static int picoquic_stream_views_notify(picoquic_cnx_t* cnx, picoquic_stream_head_t* stream)
+{
+    int ret;
+    uint64_t contiguous_end = picoquic_stream_views_end(stream);
+    int is_fin = stream->fin_received && contiguous_end >= stream->fin_offset;
+
+    stream->is_zero_copy_notifying = 1;
+    ret = stream->zero_copy_fn(cnx, stream->stream_id, (size_t)(contiguous_end - stream->consumed_offset),
+        is_fin, stream->zero_copy_ctx);
+    stream->is_zero_copy_notifying = 0;
+
+    return ret;
+}
+
+int picoquic_stream_views_input(picoquic_cnx_t* cnx, picoquic_stream_head_t* stream, uint64_t offset, int fin,
+    const uint8_t* bytes, size_t length, picoquic_stream_data_node_t* received_data)
+{
+    uint64_t previous_end = picoquic_stream_views_end(stream);
+    int ret = picoquic_stream_views_insert(cnx, stream, offset, bytes, length, received_data);
+
+    if (ret == 0) {
+        uint64_t contiguous_end = picoquic_stream_views_end(stream);
+
+        if (contiguous_end > previous_end || (fin && contiguous_end >= stream->fin_offset)) {
+            ret = picoquic_stream_views_notify(cnx, stream);
+        }
+    }
+
+    return ret;
+}
+
+void picoquic_stream_views_free(picoquic_stream_head_t* stream)
+{
+    picoquic_stream_view_node_t* view;
+
+    while ((view = stream->first_view) != NULL) {
+        stream->first_view = view->next_view;
+        picoquic_stream_view_release(view);
     }
-    stream->send_queue = NULL;
+    stream->last_view = NULL;
+    stream->last_contiguous_view = NULL;
+}
+
+void picoquic_clear_stream(picoquic_stream_head_t* stream)
+{
+    picoquic_stream_queue_free(stream);
+    picoquic_stream_ring_free(stream);
+    picoquic_stream_views_free(stream);
     if (stream->is_output_stream) {
         picoquic_remove_output_stream(stream->cnx, stream);
     }
@@ -3179,12 +3663,14 @@ void picoquic_insert_output_stream(picoquic_cnx_t* cnx, picoquic_stream_head_t*
 
         stream->is_output_stream = 1;
     }
+    picoquic_update_ready_stream(cnx, stream);
 }
 
 void picoquic_remove_output_stream(picoquic_cnx_t* cnx, picoquic_stream_head_t * stream)
 {
     if (stream->is_output_stream) {
         stream->is_output_stream = 0;
+        picoquic_remove_ready_stream(cnx, stream);
 
         if (stream->previous_output_stream == NULL) {
             cnx->first_output_stream = stream->next_output_stream;
@@ -3220,6 +3706,169 @@ void picoquic_reorder_output_stream(picoquic_cnx_t* cnx, picoquic_stream_head_t*
             stream->is_output_stream = 0;
             picoquic_insert_output_stream(cnx, stream);
         }
+        picoquic_update_ready_stream(cnx, stream);
+    }
+}
+
+/* Ready queues of the output streams.
+ * Output streams that have something to send are queued in the bucket of
+ * their priority level. Streams with urgent actions (reset or stop sending)
+ * are queued at the head of the bucket. In buckets of odd priority, the
+ * other streams are served first in first out, in stream_id order. In
+ * buckets of even priority, they are served in round robin: a stream moves
+ * to the tail of the bucket after sending data, and streams that become
+ * ready are queued at the tail. Streams are removed from the queue when the
+ * scheduler finds that they are idle or blocked by stream flow control, and
+ * queued again when the application provides data or when the peer raises
+ * the flow control limit.
+ */
+int picoquic_is_stream_urgent(picoquic_stream_head_t* stream)
+{
+    return ((stream->reset_requested && !stream->reset_sent) ||
+        (stream->stop_sending_requested && !stream->stop_sending_sent));
+}
+
+int picoquic_stream_has_data_to_send(picoquic_stream_head_t* stream)
+{
+    return (stream->is_active ||
+        (stream->send_queue != NULL && stream->send_queue->length > stream->send_queue->offset) ||
+        (stream->fin_requested && !stream->fin_sent));
+}
+
+static picoquic_stream_bucket_t* picoquic_get_stream_bucket(picoquic_cnx_t* cnx, uint8_t stream_priority)
+{
+    picoquic_stream_bucket_t** p_previous = &cnx->first_stream_bucket;
+    picoquic_stream_bucket_t* bucket;
+
+    while ((bucket = *p_previous) != NULL && bucket->stream_priority < stream_priority) {
+        p_previous = &bucket->next_bucket;
+    }
+
+    if (bucket == NULL || bucket->stream_priority != stream_priority) {
+        picoquic_stream_bucket_t* new_bucket = (picoquic_stream_bucket_t*)malloc(sizeof(picoquic_stream_bucket_t));
+
+        if (new_bucket != NULL) {
+            memset(new_bucket, 0, sizeof(picoquic_stream_bucket_t));
+            new_bucket->stream_priority = stream_priority;
+            new_bucket->next_bucket = bucket;
+            *p_previous = new_bucket;
+        }
+        bucket = new_bucket;
+    }
+
+    return bucket;
+}
+
+static void picoquic_free_stream_buckets(picoquic_cnx_t* cnx)
+{
+    picoquic_stream_bucket_t* bucket;
+
+    while ((bucket = cnx->first_stream_bucket) != NULL) {
+        cnx->first_stream_bucket = bucket->next_bucket;
+        free(bucket);
+    }
+}
+
+/* Queue the stream after the specified stream, or at the head of the bucket if previous is NULL */
+static void picoquic_queue_ready_stream(picoquic_stream_bucket_t* bucket, picoquic_stream_head_t* stream,
+    picoquic_stream_head_t* previous)
+{
+    stream->ready_bucket = bucket;
+    stream->previous_ready_stream = previous;
+    if (previous == NULL) {
+        stream->next_ready_stream = bucket->first_ready_stream;
+        bucket->first_ready_stream = stream;
+    }
+    else {
+        stream->next_ready_stream = previous->next_ready_stream;
+        previous->next_ready_stream = stream;
+    }
+    if (stream->next_ready_stream == NULL) {
+        bucket->last_ready_stream = stream;
+    }
+    else {
+        stream->next_ready_stream->previous_ready_stream = stream;
+    }
+}
+
+void picoquic_remove_ready_stream(picoquic_cnx_t* cnx, picoquic_stream_head_t* stream)
+{
+    picoquic_stream_bucket_t* bucket = stream->ready_bucket;
+
+#ifdef _WINDOWS
+    UNREFERENCED_PARAMETER(cnx);
+#endif
+    if (bucket != NULL) {
+        if (stream->previous_ready_stream == NULL) {
+            bucket->first_ready_stream = stream->next_ready_stream;
+        }
+        else {
+            stream->previous_ready_stream->next_ready_stream = stream->next_ready_stream;
+        }
+        if (stream->next_ready_stream == NULL) {
+            bucket->last_ready_stream = stream->previous_ready_stream;
+        }
+        else {
+            stream->next_ready_stream->previous_ready_stream = stream->previous_ready_stream;
+        }
+        stream->ready_bucket = NULL;
+        stream->previous_ready_stream = NULL;
+        stream->next_ready_stream = NULL;
+    }
+}
+
+/* Called when an event may make the stream ready: data or fin queued by the
+ * application, reset or stop sending requested, flow control limit raised by
+ * the peer, or change of priority.
+ */
+void picoquic_update_ready_stream(picoquic_cnx_t* cnx, picoquic_stream_head_t* stream)
+{
+    if (!stream->is_output_stream) {
+        return;
+    }
+
+    if (stream->ready_bucket != NULL && stream->ready_bucket->stream_priority != stream->stream_priority) {
+        picoquic_remove_ready_stream(cnx, stream);
+    }
+
+    if (picoquic_is_stream_urgent(stream)) {
+        if (stream->ready_bucket == NULL || stream->previous_ready_stream != NULL) {
+            picoquic_stream_bucket_t* bucket = picoquic_get_stream_bucket(cnx, stream->stream_priority);
+
+            if (bucket != NULL) {
+                picoquic_remove_ready_stream(cnx, stream);
+                picoquic_queue_ready_stream(bucket, stream, NULL);
+            }
+        }
+    }
+    else if (stream->ready_bucket == NULL && picoquic_stream_has_data_to_send(stream)) {
+        picoquic_stream_bucket_t* bucket = picoquic_get_stream_bucket(cnx, stream->stream_priority);
+
+        if (bucket != NULL) {
+            picoquic_stream_head_t* previous = bucket->last_ready_stream;
+
+            if ((stream->stream_priority & 1) != 0) {
+                /* FIFO processing: keep the non urgent streams in stream_id order.
+                 * Streams usually become ready in that order, so the loop is short. */
+                while (previous != NULL && previous->stream_id > stream->stream_id &&
+                    !picoquic_is_stream_urgent(previous)) {
+                    previous = previous->previous_ready_stream;
+                }
+            }
+            picoquic_queue_ready_stream(bucket, stream, previous);
+        }
+    }
+}
+
+/* Called after sending data on a stream, to implement round robin processing */
+void picoquic_requeue_ready_stream(picoquic_cnx_t* cnx, picoquic_stream_head_t* stream)
+{
+    picoquic_stream_bucket_t* bucket = stream->ready_bucket;
+
+    if (bucket != NULL && (stream->stream_priority & 1) == 0 && stream->next_ready_stream != NULL &&
+        !picoquic_is_stream_urgent(stream)) {
+        picoquic_remove_ready_stream(cnx, stream);
+        picoquic_queue_ready_stream(bucket, stream, bucket->last_ready_stream);
     }
 }
 
@@ -3317,6 +3966,8 @@ picoquic_stream_head_t* picoquic_create_stream(picoquic_cnx_t* cnx, uint64_t str
 
 void picoquic_delete_stream(picoquic_cnx_t * cnx, picoquic_stream_head_t* stream)
 {
+    /* Data received but not consumed is discarded with the stream */
+    picoquic_rwnd_consume(cnx, stream, stream->fin_offset);
     picosplay_delete(&cnx->stream_tree, stream);
 }
 
@@ -3324,6 +3975,7 @@ int picoquic_mark_direct_receive_stream(picoquic_cnx_t* cnx, uint64_t stream_id,
 {
     int ret = 0;
     picoquic_stream_head_t* stream = picoquic_find_stream(cnx, stream_id);
+    picoquic_sack_item_t* range;
     picoquic_stream_data_node_t* data;
 
     if (stream == NULL) {
@@ -3339,24 +3991,23 @@ int picoquic_mark_direct_receive_stream(picoquic_cnx_t* cnx, uint64_t stream_id,
     else {
         stream->direct_receive_fn = direct_receive_fn;
         stream->direct_receive_ctx = direct_receive_ctx;
+        picoquic_rwnd_consume(cnx, stream, stream->fin_offset);
         /* If there is pending data, pass it. */
         while ((data = (picoquic_stream_data_node_t*)picosplay_first(&stream->stream_data_tree)) != NULL) {
             size_t length = data->length;
             uint64_t offset = data->offset;
+            const uint8_t* bytes = data->bytes;
 
             if (offset < stream->consumed_offset) {
-                if (offset + length < stream->consumed_offset) {
-                    length = 0;
-                }
-                else {
-                    size_t delta_offset = (size_t)(stream->consumed_offset - offset);
-                    length -= delta_offset;
-                    offset += delta_offset;
-                }
+                size_t delta_offset = (offset + length < stream->consumed_offset) ?
+                    length : (size_t)(stream->consumed_offset - offset);
+                length -= delta_offset;
+                offset += delta_offset;
+                bytes += delta_offset;
             }
 
             if (length > 0) {
-                ret = direct_receive_fn(cnx, stream_id, 0, data->bytes, offset, length, direct_receive_ctx);
+                ret = direct_receive_fn(cnx, stream_id, 0, bytes, offset, length, direct_receive_ctx);
             }
 
             if (ret == 0) {
@@ -3366,6 +4017,29 @@ int picoquic_mark_direct_receive_stream(picoquic_cnx_t* cnx, uint64_t stream_id,
                 break;
             }
         }
+        while (ret == 0 && stream->reassembly_ring != NULL &&
+            (range = picoquic_sack_first_item(&stream->reassembly_ring->ranges)) != NULL) {
+            uint64_t offset = (range->start_of_sack_range > stream->consumed_offset) ?
+                range->start_of_sack_range : stream->consumed_offset;
+
+            while (ret == 0 && offset <= range->end_of_sack_range) {
+                size_t length = (size_t)(range->end_of_sack_range + 1 - offset);
+                const uint8_t* bytes = picoquic_stream_ring_read(stream->reassembly_ring, offset, &length);
+
+                ret = direct_receive_fn(cnx, stream_id, 0, bytes, offset, length, direct_receive_ctx);
+                offset += length;
+            }
+
+            if (ret == 0) {
+                picoquic_sack_delete_item(&stream->reassembly_ring->ranges, range);
+            }
+            else {
+                break;
+            }
+        }
+        if (ret == 0) {
+            picoquic_stream_ring_free(stream);
+        }
 
         /* If there is a fin offset, pass it. */
         if (ret == 0 && stream->fin_received && !stream->fin_signalled) {
@@ -3378,6 +4052,131 @@ int picoquic_mark_direct_receive_stream(picoquic_cnx_t* cnx, uint64_t stream_id,
 }
 
 
+int picoquic_mark_zero_copy_receive_stream(picoquic_cnx_t* cnx,
+    uint64_t stream_id, picoquic_stream_zero_copy_fn zero_copy_fn, void* zero_copy_ctx)
+{
+    int ret = 0;
+    picoquic_stream_head_t* stream = picoquic_find_stream(cnx, stream_id);
+    picoquic_sack_item_t* range;
+    picoquic_stream_data_node_t* data;
+
+    if (stream == NULL) {
+        ret = PICOQUIC_ERROR_INVALID_STREAM_ID;
+    }
+    else if (!IS_BIDIR_STREAM_ID(stream_id) && IS_LOCAL_STREAM_ID(stream_id, cnx->client_mode)) {
+        ret = PICOQUIC_ERROR_INVALID_STREAM_ID;
+    }
+    else if (zero_copy_fn == NULL) {
+        ret = PICOQUIC_ERROR_NO_CALLBACK_PROVIDED;
+    }
+    else {
+        int is_new = (stream->zero_copy_fn == NULL);
+
+        stream->zero_copy_fn = zero_copy_fn;
+        stream->zero_copy_ctx = zero_copy_ctx;
+        /* If there is pending data, copy it in views. */
+        while (ret == 0 && (data = (picoquic_stream_data_node_t*)picosplay_first(&stream->stream_data_tree)) != NULL) {
+            ret = picoquic_stream_views_insert(cnx, stream, data->offset, data->bytes, data->length, NULL);
+            picosplay_delete_hint(&stream->stream_data_tree, &data->stream_data_node);
+        }
+        while (ret == 0 && stream->reassembly_ring != NULL &&
+            (range = picoquic_sack_first_item(&stream->reassembly_ring->ranges)) != NULL) {
+            uint64_t offset = (range->start_of_sack_range > stream->consumed_offset) ?
+                range->start_of_sack_range : stream->consumed_offset;
+
+            while (ret == 0 && offset <= range->end_of_sack_range) {
+                size_t length = (size_t)(range->end_of_sack_range + 1 - offset);
+                const uint8_t* bytes = picoquic_stream_ring_read(stream->reassembly_ring, offset, &length);
+
+                ret = picoquic_stream_views_insert(cnx, stream, offset, bytes, length, NULL);
+                offset += length;
+            }
+            picoquic_sack_delete_item(&stream->reassembly_ring->ranges, range);
+        }
+        picoquic_stream_ring_free(stream);
+
+        if (ret == 0 && is_new && (picoquic_stream_views_end(stream) > stream->consumed_offset ||
+            (stream->fin_received && !stream->fin_signalled))) {
+            ret = picoquic_stream_views_notify(cnx, stream);
+            if (ret == 0 && stream->fin_signalled) {
+                (void)picoquic_delete_stream_if_closed(cnx, stream);
+            }
+        }
+    }
+
+    return ret;
+}
+
+size_t picoquic_get_stream_views(picoquic_cnx_t* cnx, uint64_t stream_id,
+    picoquic_stream_view_t* views, size_t nb_views_max)
+{
+    size_t nb_views = 0;
+    picoquic_stream_head_t* stream = picoquic_find_stream(cnx, stream_id);
+
+    if (stream != NULL && stream->last_contiguous_view != NULL) {
+        picoquic_stream_view_node_t* view = stream->first_view;
+
+        while (view != NULL && nb_views < nb_views_max) {
+            /* The first view may be partially consumed */
+            size_t skipped = (view->offset < stream->consumed_offset) ?
+                (size_t)(stream->consumed_offset - view->offset) : 0;
+
+            views[nb_views].bytes = view->bytes + skipped;
+            views[nb_views].length = view->length - skipped;
+            views[nb_views].offset = view->offset + skipped;
+            nb_views++;
+            view = (view == stream->last_contiguous_view) ? NULL : view->next_view;
+        }
+    }
+
+    return nb_views;
+}
+
+int picoquic_consume_stream_views(picoquic_cnx_t* cnx, uint64_t stream_id, size_t nb_bytes)
+{
+    int ret = 0;
+    picoquic_stream_head_t* stream = picoquic_find_stream(cnx, stream_id);
+
+    if (stream == NULL || stream->zero_copy_fn == NULL) {
+        ret = PICOQUIC_ERROR_INVALID_STREAM_ID;
+    }
+    else if (nb_bytes > picoquic_stream_views_end(stream) - stream->consumed_offset) {
+        ret = PICOQUIC_ERROR_UNEXPECTED_ERROR;
+    }
+    else {
+        picoquic_stream_view_node_t* view;
+
+        stream->consumed_offset += nb_bytes;
+        picoquic_rwnd_consume(cnx, stream, stream->consumed_offset);
+        /* Release the views, and the packets, that are fully consumed */
+        while ((view = stream->first_view) != NULL && view->offset + view->length <= stream->consumed_offset) {
+            stream->first_view = view->next_view;
+            if (view == stream->last_contiguous_view) {
+                stream->last_contiguous_view = NULL;
+            }
+            if (view == stream->last_view) {
+                stream->last_view = NULL;
+            }
+            picoquic_stream_view_release(view);
+        }
+
+        if (stream->fin_received && stream->consumed_offset >= stream->fin_offset) {
+            if (!stream->fin_signalled) {
+                stream->fin_signalled = 1;
+                if (!stream->is_zero_copy_notifying) {
+                    (void)picoquic_delete_stream_if_closed(cnx, stream);
+                }
+            }
+        }
+        else if (nb_bytes > 0 && !stream->reset_received && picoquic_is_max_stream_data_needed(cnx, stream)) {
+            cnx->max_stream_data_needed = 1;
+            picoquic_reinsert_by_wake_time(cnx->quic, cnx, picoquic_get_quic_time(cnx->quic));
+        }
+    }
+
+    return ret;
+}
+
 /* Management of local CID.
  * Local CID are created and registered on demand.
  */
@@ -3496,6 +4295,11 @@ void picoquic_delete_local_cnxid_listed(picoquic_cnx_t* cnx,
         }
     }
 
+    if (cnx->quic->batch_l_cid == l_cid) {
+        /* Invalidate the lookup cached by the incoming batch */
+        cnx->quic->batch_l_cid = NULL;
+    }
+
     if (l_cid->cnx_id.id_len > 0) {
         /* Remove the registration in hash tables */
         if (l_cid->registered_cnx != NULL) {
@@ -3710,6 +4514,9 @@ picoquic_cnx_t* picoquic_create_cnx(picoquic_quic_t* quic,
             }
             picoquic_pacing_init(&cnx->priority_bypass_pacing, start_time);
             picoquic_register_path(cnx, cnx->path[0]);
+            if (!client_mode && quic->table_path_metrics != NULL) {
+                picoquic_seed_path_from_metrics(cnx, start_time);
+            }
         }
     }
 
@@ -3784,13 +4591,16 @@ picoquic_cnx_t* picoquic_create_cnx(picoquic_quic_t* quic,
         cnx->callback_fn = quic->default_callback_fn;
         cnx->callback_ctx = quic->default_callback_ctx;
         cnx->congestion_alg = quic->default_congestion_alg;
+        cnx->path_scheduler = quic->default_path_scheduler;
         cnx->is_preemptive_repeat_enabled = quic->is_preemptive_repeat_enabled;
 
         /* Initialize key rotation interval to default value */
         cnx->crypto_epoch_length_max = quic->crypto_epoch_length_max;
+        cnx->hibernation_delay = quic->default_hibernation_delay;
 
         for (int epoch = 0; epoch < PICOQUIC_NUMBER_OF_EPOCHS; epoch++) {
             cnx->tls_stream[epoch].send_queue = NULL;
+            cnx->tls_stream[epoch].send_queue_last = NULL;
         }
 
         /* Perform different initializations for clients and servers */
@@ -3857,6 +4667,7 @@ picoquic_cnx_t* picoquic_create_cnx(picoquic_quic_t* quic,
 
         cnx->latest_progress_time = start_time;
         cnx->latest_receive_time = start_time;
+        cnx->latest_busy_time = start_time;
 
         for (int epoch = 0; epoch < PICOQUIC_NUMBER_OF_EPOCHS; epoch++) {
             cnx->tls_stream[epoch].stream_id = 0;
@@ -4218,6 +5029,16 @@ void picoquic_set_packet_train_mode(picoquic_quic_t* quic, int train_mode)
     quic->packet_train_mode = (train_mode > 0) ? 1 : 0;
 }
 
+void picoquic_set_pacing_offload(picoquic_quic_t* quic, uint64_t horizon_usec)
+{
+    quic->pacing_offload_horizon = horizon_usec;
+}
+
+uint64_t picoquic_get_train_departure_time(picoquic_quic_t* quic)
+{
+    return quic->train_departure_time;
+}
+
 void picoquic_set_padding_policy(picoquic_quic_t* quic, uint32_t padding_min_size, uint32_t padding_multiple)
 {
     quic->padding_minsize_default = padding_min_size;
@@ -4406,6 +5227,7 @@ void picoquic_reset_ack_context(picoquic_ack_context_t* ack_ctx)
     picoquic_clear_ack_ctx(ack_ctx);
 
     picoquic_sack_list_init(&ack_ctx->sack_list);
+    ack_ctx->sack_list.max_ranges = PICOQUIC_SACK_RANGES_MAX_ACK;
 
     ack_ctx->ecn_ect0_total_local = 0;
     ack_ctx->ecn_ect1_total_local = 0;
@@ -4419,6 +5241,7 @@ void picoquic_reset_packet_context(picoquic_cnx_t* cnx,
     while (pkt_ctx->pending_last != NULL) {
         (void)picoquic_dequeue_retransmit_packet(cnx, pkt_ctx, pkt_ctx->pending_last, 1, 0);
     }
+    picoquic_sent_ring_free(pkt_ctx);
     
     while (pkt_ctx->retransmitted_newest != NULL) {
         picoquic_dequeue_retransmitted_packet(cnx, pkt_ctx, pkt_ctx->retransmitted_newest);
@@ -4432,6 +5255,62 @@ void picoquic_reset_packet_context(picoquic_cnx_t* cnx,
     pkt_ctx->ecn_ce_total_remote = 0;
 }
 
+/* Hibernation of idle connections.
+ * The connection has no packet in flight. The index of sent packets and
+ * the copies of packets kept for spurious loss detection can be released,
+ * the congestion control state is recreated when the connection wakes up.
+ * The SACK lists are kept, because they are needed to detect duplicates,
+ * but are shrunk to their current size.
+ */
+static void picoquic_hibernate_packet_context(picoquic_cnx_t* cnx, picoquic_packet_context_t* pkt_ctx)
+{
+    picoquic_sent_ring_free(pkt_ctx);
+    while (pkt_ctx->retransmitted_newest != NULL) {
+        picoquic_dequeue_retransmitted_packet(cnx, pkt_ctx, pkt_ctx->retransmitted_newest);
+    }
+}
+
+void picoquic_hibernate_cnx(picoquic_cnx_t* cnx)
+{
+    picoquic_stream_head_t* stream = picoquic_first_stream(cnx);
+
+    for (int i = 0; i < cnx->nb_paths; i++) {
+        if (cnx->congestion_alg != NULL) {
+            cnx->congestion_alg->alg_delete(cnx->path[i]);
+        }
+        picoquic_hibernate_packet_context(cnx, &cnx->path[i]->pkt_ctx);
+        picoquic_sack_list_compact(&cnx->path[i]->ack_ctx.sack_list);
+    }
+
+    for (picoquic_packet_context_enum pc = 0; pc < picoquic_nb_packet_context; pc++) {
+        picoquic_hibernate_packet_context(cnx, &cnx->pkt_ctx[pc]);
+        picoquic_sack_list_compact(&cnx->ack_ctx[pc].sack_list);
+    }
+
+    /* Reassembly rings that hold no data are recreated on the next out of order segment */
+    while (stream != NULL) {
+        if (stream->reassembly_ring != NULL && picoquic_sack_list_is_empty(&stream->reassembly_ring->ranges)) {
+            picoquic_stream_ring_free(stream);
+        }
+        stream = picoquic_next_stream(stream);
+    }
+
+    cnx->is_hibernating = 1;
+}
+
+void picoquic_wake_cnx_from_hibernation(picoquic_cnx_t* cnx, uint64_t current_time)
+{
+    if (cnx->congestion_alg != NULL) {
+        for (int i = 0; i < cnx->nb_paths; i++) {
+            if (cnx->path[i]->congestion_alg_state == NULL) {
+                cnx->congestion_alg->alg_init(cnx, cnx->path[i], current_time);
+            }
+        }
+    }
+    cnx->is_hibernating = 0;
+    cnx->latest_busy_time = current_time;
+}
+
 /*
 * Reset the connection after an incoming retry packet.
 *
@@ -4589,6 +5468,14 @@ void picoquic_delete_cnx(picoquic_cnx_t* cnx)
             (void)(cnx->quic->perflog_fn)(cnx->quic, cnx, 0);
         }
 
+        if (!cnx->client_mode && cnx->quic->table_path_metrics != NULL) {
+            picoquic_record_path_metrics(cnx, picoquic_get_quic_time(cnx->quic));
+        }
+
+        if (cnx->rwnd.window != 0) {
+            picoquic_rwnd_release(cnx);
+        }
+
         picoquic_log_close_connection(cnx);
 
         if (cnx->is_half_open && cnx->quic->current_number_half_open > 0) {
@@ -4620,6 +5507,25 @@ void picoquic_delete_cnx(picoquic_cnx_t* cnx)
 
         picoquic_remove_cnx_from_list(cnx);
         picoquic_remove_cnx_from_wake_list(cnx);
+        if (cnx->is_wake_deferred) {
+            picoquic_cnx_t** pprevious = &cnx->quic->wake_deferred_first;
+            while (*pprevious != NULL && *pprevious != cnx) {
+                pprevious = &(*pprevious)->next_wake_deferred;
+            }
+            if (*pprevious != NULL) {
+                *pprevious = cnx->next_wake_deferred;
+            }
+            cnx->is_wake_deferred = 0;
+        }
+        picoquic_packet_pool_unwait(cnx->quic, cnx);
+
+        if (cnx->quic->hp_mask_cache.pn_dec != NULL &&
+            cnx->quic->hp_mask_cache.pn_dec == cnx->crypto_context[picoquic_epoch_1rtt].pn_dec) {
+            /* Do not leave masks that could match a key allocated at the same address */
+            cnx->quic->hp_mask_cache.pn_dec = NULL;
+            cnx->quic->hp_mask_cache.nb_entries = 0;
+        }
+        picoquic_decrypt_batch_clear(cnx->quic, cnx);
 
         for (int i = 0; i < PICOQUIC_NUMBER_OF_EPOCHS; i++) {
             picoquic_crypto_context_free(&cnx->crypto_context[i]);
@@ -4649,6 +5555,7 @@ void picoquic_delete_cnx(picoquic_cnx_t* cnx)
         }
 
         picosplay_empty_tree(&cnx->stream_tree);
+        picoquic_free_stream_buckets(cnx);
 
         if (cnx->tls_ctx != NULL) {
             picoquic_tlscontext_free(cnx->tls_ctx);
@@ -4789,38 +5696,41 @@ picoquic_cnx_t* picoquic_cnx_by_secret(picoquic_quic_t* quic, const uint8_t* res
     return ret;
 }
 
-/* Get congestion control algorithm by name
+/* Congestion control algorithms that can be selected by name.
  * TODO: if we want to minimize code size, we should not require linking a whole library
  * of congestion control algorithms. Intead, the application should have a list of
  * configured algorithms, and the configuration program should select from that list.
  */
+static const struct {
+    char const* alg_name;
+    picoquic_congestion_algorithm_t* const* alg;
+} picoquic_congestion_algorithms[] = {
+    { "reno", &picoquic_newreno_algorithm },
+    { "cubic", &picoquic_cubic_algorithm },
+    { "dcubic", &picoquic_dcubic_algorithm },
+    { "fast", &picoquic_fastcc_algorithm },
+    { "bbr", &picoquic_bbr_algorithm },
+    { "bbr1", &picoquic_bbr1_algorithm },
+    { "prague", &picoquic_prague_algorithm }
+};
+
+static const size_t nb_picoquic_congestion_algorithms = sizeof(picoquic_congestion_algorithms) / sizeof(picoquic_congestion_algorithms[0]);
+
+char const* picoquic_get_congestion_algorithm_name(size_t index)
+{
+    return (index < nb_picoquic_congestion_algorithms) ? picoquic_congestion_algorithms[index].alg_name : NULL;
+}
+
+/* Get congestion control algorithm by name */
 picoquic_congestion_algorithm_t const* picoquic_get_congestion_algorithm(char const* alg_name)
 {
     picoquic_congestion_algorithm_t const* alg = NULL;
     if (alg_name != NULL) {
-        if (strcmp(alg_name, "reno") == 0) {
-            alg = picoquic_newreno_algorithm;
-        }
-        else if (strcmp(alg_name, "cubic") == 0) {
-            alg = picoquic_cubic_algorithm;
-        }
-        else if (strcmp(alg_name, "dcubic") == 0) {
-            alg = picoquic_dcubic_algorithm;
-        }
-        else if (strcmp(alg_name, "fast") == 0) {
-            alg = picoquic_fastcc_algorithm;
-        }
-        else if (strcmp(alg_name, "bbr") == 0) {
-            alg = picoquic_bbr_algorithm;
-        }
-        else if (strcmp(alg_name, "prague") == 0) {
-            alg = picoquic_prague_algorithm;
-        }
-        else if (strcmp(alg_name, "bbr1") == 0) {
-            alg = picoquic_bbr1_algorithm;
-        }
-        else {
-            alg = NULL;
+        for (size_t i = 0; i < nb_picoquic_congestion_algorithms; i++) {
+            if (strcmp(alg_name, picoquic_congestion_algorithms[i].alg_name) == 0) {
+                alg = *picoquic_congestion_algorithms[i].alg;
+                break;
+            }
         }
     }
     return alg;
@@ -32,64 +32,103 @@
 * Maintain the list of ACK
 */
 
-/* Procedures to manage the list of ack ranges as a splay
+/* Procedures to manage the list of ack ranges as a sorted array.
+ * The sentinel items before the first range and after the last one
+ * start at UINT64_MAX. This is never the start of an actual range,
+ * because packet numbers and stream offsets are lower than 2^62.
  */
-static void* picoquic_sack_node_value(picosplay_node_t* node)
-{
-    return (void*)((char*)node - offsetof(struct st_picoquic_sack_item_t, node));
-}
-
-static picoquic_sack_item_t* picoquic_sack_item_value(picosplay_node_t* node)
-{
-    return (node == NULL) ? NULL : (picoquic_sack_item_t*)picoquic_sack_node_value(node);
-}
-
-static int64_t picoquic_sack_item_compare(void* l, void* r) {
-    /* ranges are expressed in packet numbers, lower than 2^62,
-     * which implies no risk of integer overflow in 64 bit integers
-     */
-    int64_t delta = ((picoquic_sack_item_t*)l)->start_of_sack_range - ((picoquic_sack_item_t*)r)->start_of_sack_range;
-    return delta;
-}
-
-static picosplay_node_t* picoquic_sack_node_create(void* value)
-{
-    return &((picoquic_sack_item_t*)value)->node;
-}
+#define PICOQUIC_SACK_ITEMS_MIN 8
 
-static void picoquic_sack_node_delete(void* tree, picosplay_node_t* node)
+static void picoquic_sack_set_sentinel(picoquic_sack_item_t* sack)
 {
-#ifdef _WINDOWS
-    UNREFERENCED_PARAMETER(tree);
-#endif
-    free(picoquic_sack_node_value(node));
+    memset(sack, 0, sizeof(picoquic_sack_item_t));
+    sack->start_of_sack_range = UINT64_MAX;
 }
 
 /* Return the first ACK item in the list */
 picoquic_sack_item_t* picoquic_sack_first_item(picoquic_sack_list_t* sack_list)
 {
-    return picoquic_sack_item_value(picosplay_first(&sack_list->ack_tree));
+    return (sack_list->nb_ranges == 0) ? NULL : &sack_list->items[sack_list->first_index];
 }
 
 picoquic_sack_item_t* picoquic_sack_last_item(picoquic_sack_list_t* sack_list)
 {
-    return picoquic_sack_item_value(picosplay_last(&sack_list->ack_tree));
+    return (sack_list->nb_ranges == 0) ? NULL : &sack_list->items[sack_list->first_index + sack_list->nb_ranges - 1];
 }
 
 picoquic_sack_item_t* picoquic_sack_next_item(picoquic_sack_item_t* sack)
 {
-    return picoquic_sack_item_value(picosplay_next(&sack->node));
+    return ((sack + 1)->start_of_sack_range == UINT64_MAX) ? NULL : sack + 1;
 }
 
 picoquic_sack_item_t* picoquic_sack_previous_item(picoquic_sack_item_t* sack)
 {
-    return picoquic_sack_item_value(picosplay_previous(&sack->node));
+    return ((sack - 1)->start_of_sack_range == UINT64_MAX) ? NULL : sack - 1;
+}
+
+/* Open a slot for a new range at the specified index, which is between the
+ * first range and the high sentinel. Slots are opened at the low end by
+ * moving the low sentinel down, and elsewhere by moving the following ranges
+ * up, after compacting or growing the array if needed.
+ */
+static picoquic_sack_item_t* picoquic_sack_open_slot(picoquic_sack_list_t* sack_list, size_t position)
+{
+    size_t end_index = sack_list->first_index + sack_list->nb_ranges;
+
+    if (sack_list->items == NULL) {
+        sack_list->items = (picoquic_sack_item_t*)malloc(PICOQUIC_SACK_ITEMS_MIN * sizeof(picoquic_sack_item_t));
+        if (sack_list->items == NULL) {
+            return NULL;
+        }
+        sack_list->nb_allocated = PICOQUIC_SACK_ITEMS_MIN;
+        sack_list->first_index = 1;
+        position = 1;
+        end_index = 1;
+        picoquic_sack_set_sentinel(&sack_list->items[0]);
+        picoquic_sack_set_sentinel(&sack_list->items[1]);
+    }
+
+    if (position == sack_list->first_index && sack_list->first_index > 1) {
+        sack_list->first_index--;
+        position--;
+        picoquic_sack_set_sentinel(&sack_list->items[sack_list->first_index - 1]);
+    }
+    else {
+        if (end_index + 1 >= sack_list->nb_allocated) {
+            if (sack_list->first_index > 1) {
+                size_t shift = sack_list->first_index - 1;
+
+                memmove(sack_list->items + 1, sack_list->items + sack_list->first_index,
+                    (end_index + 1 - sack_list->first_index) * sizeof(picoquic_sack_item_t));
+                sack_list->first_index = 1;
+                position -= shift;
+                end_index -= shift;
+            }
+            else {
+                picoquic_sack_item_t* new_items = (picoquic_sack_item_t*)realloc(sack_list->items,
+                    2 * sack_list->nb_allocated * sizeof(picoquic_sack_item_t));
+                if (new_items == NULL) {
+                    return NULL;
+                }
+                sack_list->items = new_items;
+                sack_list->nb_allocated *= 2;
+            }
+        }
+        memmove(sack_list->items + position + 1, sack_list->items + position,
+            (end_index + 1 - position) * sizeof(picoquic_sack_item_t));
+    }
+    sack_list->nb_ranges++;
+
+    return &sack_list->items[position];
 }
 
 int picoquic_sack_insert_item(picoquic_sack_list_t* sack_list, uint64_t range_min, uint64_t range_max, uint64_t current_time)
 {
     int ret = 0;
-    picoquic_sack_item_t* sack_new = (picoquic_sack_item_t*)malloc(sizeof(picoquic_sack_item_t));
+    picoquic_sack_item_t* previous = picoquic_sack_find_range_below_number(sack_list, NULL, range_min);
+    size_t position = (previous == NULL) ? sack_list->first_index : (size_t)(previous - sack_list->items) + 1;
+    picoquic_sack_item_t* sack_new = picoquic_sack_open_slot(sack_list, position);
+
     if (sack_new == NULL) {
         ret = -1;
     }
@@ -101,28 +140,52 @@ int picoquic_sack_insert_item(picoquic_sack_list_t* sack_list, uint64_t range_mi
         sack_new->time_created = current_time;
         sack_list->rc[0].range_counts[0] += 1;
         sack_list->rc[1].range_counts[0] += 1;
-        (void)picosplay_insert(&sack_list->ack_tree, sack_new);
+
+        if (sack_list->max_ranges > 0 && sack_list->nb_ranges > sack_list->max_ranges) {
+            /* Drop the lowest range, and consider everything below as received */
+            picoquic_sack_item_t* lowest = picoquic_sack_first_item(sack_list);
+
+            if (lowest->end_of_sack_range + 1 > sack_list->eviction_floor) {
+                sack_list->eviction_floor = lowest->end_of_sack_range + 1;
+            }
+            picoquic_sack_delete_item(sack_list, lowest);
+        }
     }
 
     return ret;
 }
+
 void picoquic_sack_delete_item(picoquic_sack_list_t* sack_list, picoquic_sack_item_t* sack)
 {
+    size_t index = (size_t)(sack - sack_list->items);
+
     /* Accounting of deleted values */
     for (int r = 0; r < 2; r++) {
         if (sack->nb_times_sent[r] < PICOQUIC_MAX_ACK_RANGE_REPEAT) {
             sack_list->rc[r].range_counts[sack->nb_times_sent[r]] -= 1;
         }
     }
-    /* Delete the item in the splay */
-    picosplay_delete_hint(&sack_list->ack_tree, &sack->node);
+    /* Delete the item in the array */
+    if (index == sack_list->first_index) {
+        picoquic_sack_set_sentinel(sack);
+        sack_list->first_index++;
+    }
+    else {
+        memmove(sack, sack + 1, (sack_list->first_index + sack_list->nb_ranges - index) * sizeof(picoquic_sack_item_t));
+    }
+    sack_list->nb_ranges--;
+    if (sack_list->nb_ranges == 0) {
+        sack_list->first_index = 1;
+        picoquic_sack_set_sentinel(&sack_list->items[0]);
+        picoquic_sack_set_sentinel(&sack_list->items[1]);
+    }
 }
 
 /* Check whether the sack list is empty
  */
 int picoquic_sack_list_is_empty(picoquic_sack_list_t* sack_list)
 {
-    return (sack_list->ack_tree.size == 0);
+    return (sack_list->nb_ranges == 0);
 }
 
 /* Find the ack context from the context 
@@ -153,24 +216,47 @@ picoquic_sack_list_t* picoquic_sack_list_from_cnx_context(picoquic_cnx_t* cnx,
     return &picoquic_ack_ctx_from_cnx_context(cnx, pc, l_cid)->sack_list;
 }
 
-/* Find the closest range below an optional specified sack item
+/* Find the closest range below an optional specified sack item.
+ * Most packets arrive in sequence, so the last range is tested first.
  */
 picoquic_sack_item_t* picoquic_sack_find_range_below_number(picoquic_sack_list_t* sack_list, picoquic_sack_item_t* previous,
     uint64_t pn64)
 {
+    picoquic_sack_item_t* sack_found = NULL;
 #ifdef _WINDOWS
     UNREFERENCED_PARAMETER(previous);
 #endif
-    picoquic_sack_item_t v = { 0 };
-    v.start_of_sack_range = pn64;
-    v.end_of_sack_range = pn64;
-    return(picoquic_sack_item_value(picosplay_find_previous(&sack_list->ack_tree, &v)));
+    if (sack_list->nb_ranges > 0) {
+        size_t low = sack_list->first_index;
+        size_t high = low + sack_list->nb_ranges - 1;
+
+        if (sack_list->items[high].start_of_sack_range <= pn64) {
+            sack_found = &sack_list->items[high];
+        }
+        else if (sack_list->items[low].start_of_sack_range <= pn64) {
+            /* The range at "low" starts at or below pn64, the range at "high" above. */
+            while (high - low > 1) {
+                size_t middle = low + (high - low) / 2;
+                if (sack_list->items[middle].start_of_sack_range <= pn64) {
+                    low = middle;
+                }
+                else {
+                    high = middle;
+                }
+            }
+            sack_found = &sack_list->items[low];
+        }
+    }
+    return sack_found;
 }
 
 /*
  * Check whether the packet was already received.
  * If using the "horizon", then consider already received all packets 
  * at or below the horizon.
+ * Packets below the eviction floor of a bounded list are also considered
+ * received. They arrive after more than max_ranges newer ranges, and the
+ * list cannot tell whether they are duplicates, so they are not processed.
  */
 int picoquic_is_pn_already_received(picoquic_cnx_t* cnx, 
     picoquic_packet_context_enum pc, picoquic_local_cnxid_t * l_cid, uint64_t pn64)
@@ -178,7 +264,8 @@ int picoquic_is_pn_already_received(picoquic_cnx_t* cnx,
     int is_received = 0;
     picoquic_sack_list_t* sack_list = picoquic_sack_list_from_cnx_context(cnx, pc, l_cid);
 
-    if (sack_list->horizon_delay > 0 && pn64 < sack_list->ack_horizon) {
+    if (pn64 < sack_list->eviction_floor ||
+        (sack_list->horizon_delay > 0 && pn64 < sack_list->ack_horizon)) {
         is_received = 1;
     }
     else {
@@ -198,9 +285,23 @@ int picoquic_update_sack_list(picoquic_sack_list_t* sack_list,
     uint64_t pn64_min, uint64_t pn64_max, uint64_t current_time)
 {
     int ret = 1; /* duplicate by default, reset to 0 if update found */
-    picoquic_sack_item_t* previous = picoquic_sack_find_range_below_number(sack_list, NULL, pn64_min);
+    picoquic_sack_item_t* previous = picoquic_sack_last_item(sack_list);
 
-    if (previous == NULL || previous->end_of_sack_range + 1 < pn64_min) {
+    if (previous != NULL && pn64_min > previous->end_of_sack_range) {
+        /* Fast path, the range is above all the existing ranges */
+        if (pn64_min == previous->end_of_sack_range + 1) {
+            previous->end_of_sack_range = pn64_max;
+            picoquic_sack_item_record_reset(sack_list, previous);
+            previous->time_created = current_time;
+            ret = 0;
+        }
+        else {
+            ret = picoquic_sack_insert_item(sack_list, pn64_min, pn64_max, current_time);
+        }
+        previous = NULL;
+    }
+    else if ((previous = picoquic_sack_find_range_below_number(sack_list, NULL, pn64_min)) == NULL ||
+        previous->end_of_sack_range + 1 < pn64_min) {
         /* No overlap with a range below */
         picoquic_sack_item_t* next = (previous == NULL) ?
             picoquic_sack_first_item(sack_list) : picoquic_sack_next_item(previous);
@@ -351,7 +452,7 @@ picoquic_sack_item_t* picoquic_process_ack_of_ack_range(picoquic_sack_list_t* sa
     previous = picoquic_sack_find_range_below_number(sack_list, NULL, start_of_range);
 
     if (previous != NULL && previous->start_of_sack_range == start_of_range){
-        picoquic_sack_item_t* next = picoquic_sack_item_value(picosplay_next(&previous->node));
+        picoquic_sack_item_t* next = picoquic_sack_next_item(previous);
         if (next == NULL) {
             /* Matching the highest range, which shall not be deleted */
             if (end_of_range < previous->end_of_sack_range) {
@@ -372,6 +473,7 @@ picoquic_sack_item_t* picoquic_process_ack_of_ack_range(picoquic_sack_list_t* sa
                 }
             } else {
                 picoquic_sack_delete_item(sack_list, previous);
+                previous = NULL;
             }
         }
     }
@@ -388,13 +490,15 @@ void picoquic_update_ack_horizon(picoquic_sack_list_t* sack_list, uint64_t curre
     while (first_sack != NULL && first_sack->nb_times_sent[0] >= PICOQUIC_MAX_ACK_RANGE_REPEAT) {
         int64_t delay = current_time - first_sack->time_created;
         if (delay > sack_list->horizon_delay) {
-            picoquic_sack_item_t* next_sack = picoquic_sack_next_item(first_sack);
-            if (next_sack != NULL) {
+            if (picoquic_sack_next_item(first_sack) != NULL) {
                 /* Always keep the last range */
                 sack_list->ack_horizon = first_sack->end_of_sack_range + 1;
                 picoquic_sack_delete_item(sack_list, first_sack);
+                first_sack = picoquic_sack_first_item(sack_list);
+            }
+            else {
+                first_sack = NULL;
             }
-            first_sack = next_sack;
         }
         else {
             break;
@@ -424,7 +528,7 @@ uint64_t picoquic_sack_list_last(picoquic_sack_list_t* sack_list)
 picoquic_sack_item_t * picoquic_sack_list_first_range(picoquic_sack_list_t* sack_list)
 {
     picoquic_sack_item_t* first = picoquic_sack_first_item(sack_list);
-    return(first == NULL) ? NULL : picoquic_sack_item_value(picosplay_next(&first->node));
+    return(first == NULL) ? NULL : picoquic_sack_next_item(first);
 }
 
 /* Initialize a sack list
@@ -432,8 +536,7 @@ picoquic_sack_item_t * picoquic_sack_list_first_range(picoquic_sack_list_t* sack
 void picoquic_sack_list_init(picoquic_sack_list_t* sack_list)
 {
     memset(sack_list, 0, sizeof(picoquic_sack_list_t));
-    picosplay_init_tree(&sack_list->ack_tree, picoquic_sack_item_compare,
-        picoquic_sack_node_create, picoquic_sack_node_delete, picoquic_sack_node_value);
+    sack_list->first_index = 1;
 }
 
 /* Reset a SACK list to single range
@@ -450,12 +553,52 @@ int picoquic_sack_list_reset(picoquic_sack_list_t* sack_list, uint64_t range_min
  */
 void picoquic_sack_list_free(picoquic_sack_list_t* sack_list)
 {
-    picosplay_empty_tree(&sack_list->ack_tree);
+    free(sack_list->items);
+    sack_list->items = NULL;
+    sack_list->first_index = 1;
+    sack_list->nb_ranges = 0;
+    sack_list->nb_allocated = 0;
     for (int r = 0; r < 2; r++) {
         memset(sack_list->rc[r].range_counts, 0, sizeof(sack_list->rc[r].range_counts));
     }
 }
 
+/* Shrink the array of ranges to the number of ranges in use, e.g.,
+ * when an idle connection hibernates.
+ */
+void picoquic_sack_list_compact(picoquic_sack_list_t* sack_list)
+{
+    if (sack_list->items != NULL) {
+        if (sack_list->nb_ranges == 0) {
+            free(sack_list->items);
+            sack_list->items = NULL;
+            sack_list->first_index = 1;
+            sack_list->nb_allocated = 0;
+        }
+        else {
+            /* The ranges are framed by two sentinels */
+            size_t nb_needed = sack_list->nb_ranges + 2;
+
+            if (sack_list->first_index > 1) {
+                memmove(sack_list->items, sack_list->items + sack_list->first_index - 1,
+                    nb_needed * sizeof(picoquic_sack_item_t));
+                sack_list->first_index = 1;
+            }
+            if (nb_needed < PICOQUIC_SACK_ITEMS_MIN) {
+                nb_needed = PICOQUIC_SACK_ITEMS_MIN;
+            }
+            if (nb_needed < sack_list->nb_allocated) {
+                picoquic_sack_item_t* new_items = (picoquic_sack_item_t*)realloc(sack_list->items,
+                    nb_needed * sizeof(picoquic_sack_item_t));
+                if (new_items != NULL) {
+                    sack_list->items = new_items;
+                    sack_list->nb_allocated = nb_needed;
+                }
+            }
+        }
+    }
+}
+
 /* Access to the elements in sack item
  */
 uint64_t picoquic_sack_item_range_start(picoquic_sack_item_t* sack_item)
@@ -497,5 +640,5 @@ void picoquic_sack_item_record_reset(picoquic_sack_list_t* sack_list, picoquic_s
 
 size_t picoquic_sack_list_size(picoquic_sack_list_t* sack_list)
 {
-    return (size_t)sack_list->ack_tree.size;
+    return sack_list->nb_ranges;
 }
\ No newline at end of file
@@ -148,6 +148,7 @@ int picoquic_mark_active_stream(picoquic_cnx_t* cnx,
                 stream->app_stream_ctx = app_stream_ctx;
                 if (!stream->is_active) {
                     stream->is_active = 1;
+                    picoquic_update_ready_stream(cnx, stream);
                     picoquic_reinsert_by_wake_time(cnx->quic, cnx, picoquic_get_quic_time(cnx->quic));
                 }
             }
@@ -209,34 +210,38 @@ int picoquic_mark_high_priority_stream(picoquic_cnx_t * cnx, uint64_t stream_id,
     return ret;
 }
 
-int picoquic_add_to_stream_with_ctx(picoquic_cnx_t* cnx, uint64_t stream_id,
-    const uint8_t* data, size_t length, int set_fin, void * app_stream_ctx)
+static picoquic_stream_head_t* picoquic_prepare_add_to_stream(picoquic_cnx_t* cnx, uint64_t stream_id,
+    size_t length, int set_fin, int * ret)
 {
-    int ret = 0;
-    picoquic_stream_head_t* stream = picoquic_find_stream_for_writing(cnx, stream_id, &ret);
+    picoquic_stream_head_t* stream = picoquic_find_stream_for_writing(cnx, stream_id, ret);
 
-    if (ret == 0 && set_fin) {
-        if (stream->fin_requested) {
-            /* app error, notified the fin twice*/
-            if (length > 0) {
-                ret = -1;
-            }
-        } else {
-            stream->fin_requested = 1;
-        }
+    /* The FIN is only marked once the data is queued, so a failed call leaves the stream unchanged */
+    if (*ret == 0 && set_fin && stream->fin_requested && length > 0) {
+        /* app error, notified the fin twice*/
+        *ret = -1;
     }
 
     /* If our side has sent RST_STREAM or received STOP_SENDING, we should not send anymore data. */
-    if (ret == 0 && (stream->reset_sent || stream->stop_sending_received)) {
-        ret = -1;
+    if (*ret == 0 && (stream->reset_sent || stream->stop_sending_received)) {
+        *ret = -1;
     }
 
+    return stream;
+}
+
+int picoquic_add_to_stream_with_ctx(picoquic_cnx_t* cnx, uint64_t stream_id,
+    const uint8_t* data, size_t length, int set_fin, void * app_stream_ctx)
+{
+    int ret = 0;
+    picoquic_stream_head_t* stream = picoquic_prepare_add_to_stream(cnx, stream_id, length, set_fin, &ret);
+
     if (ret == 0 && length > 0) {
         picoquic_stream_queue_node_t* stream_data = (picoquic_stream_queue_node_t*)
             malloc(sizeof(picoquic_stream_queue_node_t));
         if (stream_data == 0) {
             ret = -1;
         } else {
+            memset(stream_data, 0, sizeof(picoquic_stream_queue_node_t));
             stream_data->bytes = (uint8_t*)malloc(length);
 
             if (stream_data->bytes == NULL) {
@@ -244,35 +249,121 @@ int picoquic_add_to_stream_with_ctx(picoquic_cnx_t* cnx, uint64_t stream_id,
                 stream_data = NULL;
                 ret = -1;
             } else {
-                picoquic_stream_queue_node_t** pprevious = &stream->send_queue;
-                picoquic_stream_queue_node_t* next = stream->send_queue;
-
                 memcpy(stream_data->bytes, data, length);
                 stream_data->length = length;
-                stream_data->offset = 0;
-                stream_data->next_stream_data = NULL;
+                picoquic_stream_queue_append(stream, stream_data);
+            }
+        }
+
+        picoquic_reinsert_by_wake_time(cnx->quic, cnx, picoquic_get_quic_time(cnx->quic));
+    }
+
+    if (ret == 0) {
+        if (set_fin) {
+            stream->fin_requested = 1;
+        }
+        cnx->nb_bytes_queued += length;
+        stream->is_active = 0;
+        stream->app_stream_ctx = app_stream_ctx;
+        picoquic_update_ready_stream(cnx, stream);
+    }
+
+    return ret;
+}
+
+int picoquic_add_iovec_to_stream_by_reference(picoquic_cnx_t* cnx, uint64_t stream_id,
+    const picoquic_iovec_t* iov, size_t nb_iov, int set_fin,
+    picoquic_stream_data_release_fn release_fn, void* release_ctx)
+{
+    int ret = 0;
+    size_t length = 0;
+    size_t last_iov = nb_iov;
+    picoquic_stream_head_t* stream;
+
+    for (size_t i = 0; i < nb_iov; i++) {
+        if (iov[i].len > 0) {
+            length += iov[i].len;
+            last_iov = i;
+        }
+    }
+
+    stream = picoquic_prepare_add_to_stream(cnx, stream_id, length, set_fin, &ret);
 
-                while (next != NULL) {
-                    pprevious = &next->next_stream_data;
-                    next = next->next_stream_data;
+    if (ret == 0 && length > 0) {
+        picoquic_stream_queue_node_t* first_data = NULL;
+        picoquic_stream_queue_node_t* last_data = NULL;
+
+        /* Allocate all the nodes before queuing them, so a memory error
+         * leaves the stream unchanged. Only the last node carries the
+         * release function. */
+        for (size_t i = 0; ret == 0 && i <= last_iov; i++) {
+            if (iov[i].len > 0) {
+                picoquic_stream_queue_node_t* stream_data = (picoquic_stream_queue_node_t*)
+                    malloc(sizeof(picoquic_stream_queue_node_t));
+                if (stream_data == NULL) {
+                    ret = -1;
+                }
+                else {
+                    memset(stream_data, 0, sizeof(picoquic_stream_queue_node_t));
+                    stream_data->bytes = (uint8_t*)iov[i].base;
+                    stream_data->length = iov[i].len;
+                    stream_data->is_reference = 1;
+                    if (i == last_iov) {
+                        stream_data->release_fn = release_fn;
+                        stream_data->release_ctx = release_ctx;
+                    }
+                    if (last_data == NULL) {
+                        first_data = stream_data;
+                    }
+                    else {
+                        last_data->next_stream_data = stream_data;
+                    }
+                    last_data = stream_data;
                 }
+            }
+        }
 
-                *pprevious = stream_data;
+        while (first_data != NULL) {
+            picoquic_stream_queue_node_t* next = first_data->next_stream_data;
+            if (ret == 0) {
+                picoquic_stream_queue_append(stream, first_data);
+            }
+            else {
+                free(first_data);
             }
+            first_data = next;
         }
 
         picoquic_reinsert_by_wake_time(cnx->quic, cnx, picoquic_get_quic_time(cnx->quic));
     }
 
     if (ret == 0) {
+        if (set_fin) {
+            stream->fin_requested = 1;
+        }
         cnx->nb_bytes_queued += length;
         stream->is_active = 0;
-        stream->app_stream_ctx = app_stream_ctx;
+        picoquic_update_ready_stream(cnx, stream);
+        if (length == 0 && release_fn != NULL) {
+            release_fn(release_ctx, 1);
+        }
     }
 
     return ret;
 }
 
+int picoquic_add_to_stream_by_reference(picoquic_cnx_t* cnx, uint64_t stream_id,
+    const uint8_t* data, size_t length, int set_fin,
+    picoquic_stream_data_release_fn release_fn, void* release_ctx)
+{
+    picoquic_iovec_t iov;
+
+    iov.base = data;
+    iov.len = length;
+
+    return picoquic_add_iovec_to_stream_by_reference(cnx, stream_id, &iov, 1, set_fin, release_fn, release_ctx);
+}
+
 int picoquic_add_to_stream(picoquic_cnx_t* cnx, uint64_t stream_id,
     const uint8_t* data, size_t length, int set_fin)
 {
@@ -342,6 +433,7 @@ int picoquic_reset_stream(picoquic_cnx_t* cnx,
         else if (!stream->reset_requested) {
             stream->local_error = local_stream_error;
             stream->reset_requested = 1;
+            picoquic_update_ready_stream(cnx, stream);
         }
     }
 
@@ -465,29 +557,105 @@ size_t picoquic_pad_to_policy(picoquic_cnx_t * cnx, uint8_t * bytes, size_t leng
  * Packet management
  */
 
-picoquic_packet_t* picoquic_create_packet(picoquic_quic_t * quic)
+static void picoquic_packet_slab_insert_partial(picoquic_quic_t* quic, picoquic_packet_slab_t* slab)
 {
-    picoquic_packet_t* packet = quic->p_first_packet;
-    
-    if (packet == NULL) {
-        packet = (picoquic_packet_t*)malloc(sizeof(picoquic_packet_t));
-        if (packet != NULL) {
-            quic->nb_packets_allocated++;
-            if (quic->nb_packets_allocated > quic->nb_packets_allocated_max) {
-                quic->nb_packets_allocated_max = quic->nb_packets_allocated;
-            }
-        }
+    slab->previous_partial = NULL;
+    slab->next_partial = quic->packet_slab_partial;
+    if (slab->next_partial != NULL) {
+        slab->next_partial->previous_partial = slab;
+    }
+    quic->packet_slab_partial = slab;
+    slab->is_partial = 1;
+}
+
+static void picoquic_packet_slab_remove_partial(picoquic_quic_t* quic, picoquic_packet_slab_t* slab)
+{
+    if (slab->previous_partial == NULL) {
+        quic->packet_slab_partial = slab->next_partial;
     }
     else {
-        quic->p_first_packet = packet->packet_previous;
-        quic->nb_packets_in_pool--;
+        slab->previous_partial->next_partial = slab->next_partial;
     }
+    if (slab->next_partial != NULL) {
+        slab->next_partial->previous_partial = slab->previous_partial;
+    }
+    slab->next_partial = NULL;
+    slab->previous_partial = NULL;
+    slab->is_partial = 0;
+}
 
-    if (packet != NULL) {
-        /* It might be sufficient to zero the metadata, but zeroing everything
-         * appears safer, and does not confuse checkers like valgrind.
-         */
-        memset(packet, 0, sizeof(picoquic_packet_t));
+static picoquic_packet_slab_t* picoquic_packet_slab_create(picoquic_quic_t* quic)
+{
+    picoquic_packet_slab_t* slab = NULL;
+    int nb_packets = PICOQUIC_PACKET_SLAB_SIZE;
+
+    if (quic->packet_pool_max > 0) {
+        if ((size_t)quic->nb_packets_allocated >= quic->packet_pool_max) {
+            nb_packets = 0;
+        }
+        else if (quic->packet_pool_max - (size_t)quic->nb_packets_allocated < (size_t)nb_packets) {
+            nb_packets = (int)(quic->packet_pool_max - (size_t)quic->nb_packets_allocated);
+        }
+    }
+
+    if (nb_packets > 0 &&
+        (slab = (picoquic_packet_slab_t*)malloc(sizeof(picoquic_packet_slab_t) + nb_packets * sizeof(picoquic_packet_t))) != NULL) {
+        /* Only the slab header and the packet links are initialized. */
+        memset(slab, 0, sizeof(picoquic_packet_slab_t));
+        slab->packets = (picoquic_packet_t*)(slab + 1);
+        slab->nb_packets = nb_packets;
+        slab->nb_free = nb_packets;
+        for (int i = nb_packets - 1; i >= 0; i--) {
+            slab->packets[i].slab = slab;
+            slab->packets[i].packet_previous = slab->first_free;
+            slab->first_free = &slab->packets[i];
+        }
+        picoquic_packet_slab_insert_partial(quic, slab);
+        quic->nb_packet_slabs++;
+        quic->nb_packets_allocated += nb_packets;
+        quic->nb_packets_in_pool += nb_packets;
+        if (quic->nb_packets_allocated > quic->nb_packets_allocated_max) {
+            quic->nb_packets_allocated_max = quic->nb_packets_allocated;
+        }
+    }
+    return slab;
+}
+
+static void picoquic_packet_slab_delete(picoquic_quic_t* quic, picoquic_packet_slab_t* slab)
+{
+    if (slab->is_partial) {
+        picoquic_packet_slab_remove_partial(quic, slab);
+    }
+    quic->nb_packet_slabs--;
+    quic->nb_packets_allocated -= slab->nb_packets;
+    quic->nb_packets_in_pool -= slab->nb_free;
+    free(slab);
+}
+
+picoquic_packet_t* picoquic_create_packet(picoquic_quic_t * quic)
+{
+    picoquic_packet_t* packet = NULL;
+    picoquic_packet_slab_t* slab = quic->packet_slab_partial;
+
+    quic->nb_packet_requests++;
+    if (slab != NULL) {
+        quic->nb_packet_pool_hits++;
+    }
+    else if ((slab = picoquic_packet_slab_create(quic)) == NULL) {
+        quic->nb_packet_pool_exhausted++;
+    }
+
+    if (slab != NULL) {
+        packet = slab->first_free;
+        slab->first_free = packet->packet_previous;
+        slab->nb_free--;
+        quic->nb_packets_in_pool--;
+        if (slab->nb_free == 0) {
+            picoquic_packet_slab_remove_partial(quic, slab);
+        }
+        /* Only clear the metadata. The content of the packet is always
+         * written before being read, and padding is set explicitly. */
+        memset(packet, 0, offsetof(struct st_picoquic_packet_t, slab));
     }
 
     return packet;
@@ -496,19 +664,97 @@ picoquic_packet_t* picoquic_create_packet(picoquic_quic_t * quic)
 void picoquic_recycle_packet(picoquic_quic_t * quic, picoquic_packet_t* packet)
 {
     if (packet != NULL) {
-        if (quic->nb_packets_in_pool >= PICOQUIC_MAX_PACKETS_IN_POOL) {
-            free(packet);
-            quic->nb_packets_allocated--;
+        picoquic_packet_slab_t* slab = packet->slab;
+
+        packet->packet_previous = slab->first_free;
+        slab->first_free = packet;
+        slab->nb_free++;
+        quic->nb_packets_in_pool++;
+        if (!slab->is_partial) {
+            picoquic_packet_slab_insert_partial(quic, slab);
+        }
+        if (slab->nb_free == slab->nb_packets &&
+            quic->nb_packets_in_pool - slab->nb_packets >= PICOQUIC_MAX_PACKETS_IN_POOL) {
+            picoquic_packet_slab_delete(quic, slab);
+        }
+        if (quic->pool_waiting_first != NULL) {
+            /* A packet is available again, wake up the connection that waited longest */
+            picoquic_cnx_t* cnx = quic->pool_waiting_first;
+            picoquic_packet_pool_unwait(quic, cnx);
+            picoquic_reinsert_by_wake_time(quic, cnx, picoquic_get_quic_time(quic));
+        }
+    }
+}
+
+/* Queue a connection that could not get a packet because the pool ceiling
+ * was reached. The connection is woken up when a packet is recycled. */
+void picoquic_packet_pool_wait(picoquic_quic_t* quic, picoquic_cnx_t* cnx)
+{
+    if (!cnx->is_pool_waiting) {
+        cnx->is_pool_waiting = 1;
+        cnx->next_pool_waiting = NULL;
+        if (quic->pool_waiting_last == NULL) {
+            quic->pool_waiting_first = cnx;
         }
         else {
-            memset(packet, 0, offsetof(struct st_picoquic_packet_t, bytes));
-            packet->packet_previous = quic->p_first_packet;
-            quic->p_first_packet = packet;
-            quic->nb_packets_in_pool++;
+            quic->pool_waiting_last->next_pool_waiting = cnx;
         }
+        quic->pool_waiting_last = cnx;
     }
 }
 
+void picoquic_packet_pool_unwait(picoquic_quic_t* quic, picoquic_cnx_t* cnx)
+{
+    if (cnx->is_pool_waiting) {
+        picoquic_cnx_t* previous = NULL;
+        picoquic_cnx_t* next = quic->pool_waiting_first;
+
+        while (next != NULL && next != cnx) {
+            previous = next;
+            next = next->next_pool_waiting;
+        }
+        if (next != NULL) {
+            if (previous == NULL) {
+                quic->pool_waiting_first = cnx->next_pool_waiting;
+            }
+            else {
+                previous->next_pool_waiting = cnx->next_pool_waiting;
+            }
+            if (quic->pool_waiting_last == cnx) {
+                quic->pool_waiting_last = previous;
+            }
+        }
+        cnx->next_pool_waiting = NULL;
+        cnx->is_pool_waiting = 0;
+    }
+}
+
+/* Called when the quic context is deleted, after all connections have
+ * been deleted and all packets recycled. */
+void picoquic_free_packet_pool(picoquic_quic_t* quic)
+{
+    while (quic->packet_slab_partial != NULL) {
+        picoquic_packet_slab_delete(quic, quic->packet_slab_partial);
+    }
+}
+
+void picoquic_set_packet_pool_max(picoquic_quic_t* quic, size_t max_packets)
+{
+    quic->packet_pool_max = max_packets;
+}
+
+void picoquic_get_packet_pool_stats(picoquic_quic_t* quic, picoquic_packet_pool_stats_t* stats)
+{
+    stats->nb_requests = quic->nb_packet_requests;
+    stats->nb_pool_hits = quic->nb_packet_pool_hits;
+    stats->nb_slabs = (size_t)quic->nb_packet_slabs;
+    stats->nb_allocated = (size_t)quic->nb_packets_allocated;
+    stats->nb_in_pool = (size_t)quic->nb_packets_in_pool;
+    stats->nb_allocated_max = (size_t)quic->nb_packets_allocated_max;
+    stats->max_packets = quic->packet_pool_max;
+    stats->nb_exhausted = quic->nb_packet_pool_exhausted;
+}
+
 void picoquic_update_payload_length(
     uint8_t* bytes, size_t pnum_index, size_t header_length, size_t packet_length)
 {
@@ -806,6 +1052,18 @@ size_t picoquic_get_checksum_length(picoquic_cnx_t* cnx, picoquic_epoch_enum epo
     return ret;
 }
 
+static void picoquic_apply_header_mask(uint8_t* send_buffer, size_t pn_offset, uint8_t first_mask, const uint8_t* mask_bytes)
+{
+    /* Encode the first byte */
+    uint8_t pn_l = (send_buffer[0] & 3) + 1;
+    send_buffer[0] ^= (mask_bytes[0] & first_mask);
+
+    /* Packet encoding is 1 to 4 bytes */
+    for (uint8_t i = 0; i < pn_l; i++) {
+        send_buffer[pn_offset + i] ^= mask_bytes[i + 1];
+    }
+}
+
 void picoquic_protect_packet_header(uint8_t * send_buffer, size_t pn_offset, uint8_t first_mask, void* pn_enc)
 {
     /* The sample is located after the pn_offset */
@@ -815,18 +1073,93 @@ void picoquic_protect_packet_header(uint8_t * send_buffer, size_t pn_offset, uin
     {
         /* This is always true, as we use pn_length = 4 */
         uint8_t mask_bytes[5] = { 0, 0, 0, 0, 0 };
-        uint8_t pn_l;
 
         picoquic_pn_encrypt(pn_enc, send_buffer + sample_offset, mask_bytes, mask_bytes, 5);
-        /* Encode the first byte */
-        pn_l = (send_buffer[0] & 3) + 1;
-        send_buffer[0] ^= (mask_bytes[0] & first_mask);
+        picoquic_apply_header_mask(send_buffer, pn_offset, first_mask, mask_bytes);
+    }
+}
 
-        /* Packet encoding is 1 to 4 bytes */
-        for (uint8_t i = 0; i < pn_l; i++) {
-            send_buffer[pn_offset+i] ^= mask_bytes[i+1];
+/*
+ * Deferred header protection. With AES, the header protection mask is the
+ * AES-ECB encryption of the 16 bytes sample taken after the packet number,
+ * so the masks of consecutive packets sharing the same key are computed
+ * with a single call over all their samples. Other ciphers, or keys
+ * without an ECB context, fall back to the per packet computation.
+ */
+void picoquic_hp_batch_flush(picoquic_hp_batch_t* batch)
+{
+    uint8_t samples[PICOQUIC_HP_BATCH_MAX * 16];
+    uint8_t masks[PICOQUIC_HP_BATCH_MAX * 16];
+    size_t i = 0;
+
+    /* The sample is taken from the encrypted payload, so deferred AEAD
+     * jobs are completed first. */
+    if (batch->crypto_pool != NULL) {
+        int has_jobs = 0;
+
+        while (i < batch->nb_entries) {
+            picoquic_crypto_job_t* jobs[PICOQUIC_HP_BATCH_MAX];
+            void* aead_context = batch->entries[i].job.aead_context;
+            size_t nb_jobs = 0;
+
+            while (i < batch->nb_entries && batch->entries[i].job.aead_context == aead_context) {
+                jobs[nb_jobs++] = &batch->entries[i].job;
+                i++;
+            }
+            if (aead_context != NULL) {
+                picoquic_crypto_pool_dispatch(batch->crypto_pool, jobs, nb_jobs, aead_context,
+                    batch->entries[i - 1].aead_clones);
+                has_jobs = 1;
+            }
         }
+        if (has_jobs) {
+            picoquic_crypto_pool_drain(batch->crypto_pool);
+        }
+        i = 0;
     }
+
+    while (i < batch->nb_entries) {
+        picoquic_hp_batch_entry_t* first = &batch->entries[i];
+
+        if (first->pn_enc_ecb == NULL) {
+            picoquic_protect_packet_header(first->send_buffer, first->pn_offset, first->first_mask, first->pn_enc);
+            i++;
+        }
+        else {
+            size_t nb_blocks = 0;
+
+            while (i + nb_blocks < batch->nb_entries && batch->entries[i + nb_blocks].pn_enc_ecb == first->pn_enc_ecb) {
+                picoquic_hp_batch_entry_t* entry = &batch->entries[i + nb_blocks];
+                memcpy(samples + 16 * nb_blocks, entry->send_buffer + entry->pn_offset + 4, 16);
+                nb_blocks++;
+            }
+            picoquic_aes128_ecb_encrypt(first->pn_enc_ecb, masks, samples, 16 * nb_blocks);
+            for (size_t j = 0; j < nb_blocks; j++, i++) {
+                picoquic_hp_batch_entry_t* entry = &batch->entries[i];
+                picoquic_apply_header_mask(entry->send_buffer, entry->pn_offset, entry->first_mask, masks + 16 * j);
+            }
+        }
+    }
+    batch->nb_entries = 0;
+}
+
+picoquic_hp_batch_entry_t* picoquic_hp_batch_add(picoquic_hp_batch_t* batch, uint8_t* send_buffer, size_t pn_offset, uint8_t first_mask,
+    void* pn_enc, void* pn_enc_ecb)
+{
+    picoquic_hp_batch_entry_t* entry;
+
+    if (batch->nb_entries >= PICOQUIC_HP_BATCH_MAX) {
+        picoquic_hp_batch_flush(batch);
+    }
+    entry = &batch->entries[batch->nb_entries++];
+    entry->send_buffer = send_buffer;
+    entry->pn_offset = pn_offset;
+    entry->first_mask = first_mask;
+    entry->pn_enc = pn_enc;
+    entry->pn_enc_ecb = pn_enc_ecb;
+    entry->job.aead_context = NULL;
+
+    return entry;
 }
 
 size_t picoquic_protect_packet(picoquic_cnx_t* cnx, 
@@ -844,6 +1177,7 @@ size_t picoquic_protect_packet(picoquic_cnx_t* cnx,
     size_t pn_length = 0;
     size_t aead_checksum_length = picoquic_aead_get_checksum_length(aead_context);
     uint8_t first_mask = 0x0F;
+    picoquic_hp_batch_entry_t* hp_entry = NULL;
 
     /* Create the packet header just before encrypting the content */
     h_length = picoquic_create_packet_header(cnx, ptype,
@@ -890,8 +1224,38 @@ size_t picoquic_protect_packet(picoquic_cnx_t* cnx,
         }
     }
 
+    /* When preparing a train of 1-RTT packets, header protection is deferred
+     * until the train is complete, and so is the encryption if crypto workers
+     * are available. */
+    if (cnx->quic->hp_batch.is_active && ptype == picoquic_packet_1rtt_protected &&
+        pn_enc == cnx->crypto_context[picoquic_epoch_1rtt].pn_enc) {
+        hp_entry = picoquic_hp_batch_add(&cnx->quic->hp_batch, send_buffer, pn_offset, first_mask,
+            pn_enc, cnx->crypto_context[picoquic_epoch_1rtt].pn_enc_ecb);
+    }
+
     /* Encrypt the packet */
-    if (cnx->is_multipath_enabled && ptype == picoquic_packet_1rtt_protected) {
+    if (hp_entry != NULL && cnx->quic->hp_batch.crypto_pool != NULL &&
+        aead_context == cnx->crypto_context[picoquic_epoch_1rtt].aead_encrypt &&
+        cnx->crypto_context[picoquic_epoch_1rtt].aead_encrypt_clones != NULL) {
+        /* The packet may be recycled before the train is complete, so the
+         * clear text is copied to the send buffer and encrypted in place. */
+        picoquic_crypto_job_t* job = &hp_entry->job;
+
+        memcpy(send_buffer + h_length, bytes + header_length, length - header_length);
+        job->output = send_buffer + h_length;
+        job->input = send_buffer + h_length;
+        job->input_length = length - header_length;
+        job->aad = send_buffer;
+        job->aad_length = h_length;
+        job->sequence_number = sequence_number;
+        job->path_id = path_x->unique_path_id;
+        job->is_encrypt = 1;
+        job->is_multipath = cnx->is_multipath_enabled;
+        job->aead_context = aead_context;
+        hp_entry->aead_clones = cnx->crypto_context[picoquic_epoch_1rtt].aead_encrypt_clones;
+        send_length = length - header_length + aead_checksum_length;
+    }
+    else if (cnx->is_multipath_enabled && ptype == picoquic_packet_1rtt_protected) {
         send_length = picoquic_aead_encrypt_mp(send_buffer + /* header_length */ h_length,
             bytes + header_length, length - header_length, path_x->unique_path_id,
             sequence_number, send_buffer, /* header_length */ h_length, aead_context);
@@ -910,7 +1274,9 @@ size_t picoquic_protect_packet(picoquic_cnx_t* cnx,
         send_buffer, send_length, current_time);
 
     /* Next, encrypt the PN -- The sample is located after the pn_offset */
-    picoquic_protect_packet_header(send_buffer, pn_offset, first_mask, pn_enc);
+    if (hp_entry == NULL) {
+        picoquic_protect_packet_header(send_buffer, pn_offset, first_mask, pn_enc);
+    }
 
     return send_length;
 }
@@ -919,6 +1285,86 @@ size_t picoquic_protect_packet(picoquic_cnx_t* cnx,
  * Final steps in packet transmission: queue for retransmission, etc
  */
 
+/*
+ * Index of pending packets by sequence number, used to map ACK ranges
+ * to packets without walking the pending list. Packets are queued in
+ * increasing sequence number order, so all the pending packets have
+ * distinct slots if the ring is larger than the range between the first
+ * and last pending packets. The ring grows when that range increases,
+ * and is rebuilt from the pending list.
+ */
+static void picoquic_sent_ring_insert(picoquic_packet_context_t* pkt_ctx, picoquic_packet_t* packet)
+{
+    uint64_t range = packet->sequence_number - pkt_ctx->pending_first->sequence_number + 1;
+
+    if (range > PICOQUIC_SENT_RING_MAX) {
+        picoquic_sent_ring_free(pkt_ctx);
+    }
+    else if (pkt_ctx->sent_ring != NULL && range <= pkt_ctx->sent_ring_mask + 1) {
+        pkt_ctx->sent_ring[packet->sequence_number & pkt_ctx->sent_ring_mask] = packet;
+    }
+    else {
+        uint64_t ring_size = (pkt_ctx->sent_ring == NULL) ? PICOQUIC_SENT_RING_MIN : pkt_ctx->sent_ring_mask + 1;
+        picoquic_packet_t** sent_ring;
+
+        while (ring_size < range) {
+            ring_size *= 2;
+        }
+        picoquic_sent_ring_free(pkt_ctx);
+        sent_ring = (picoquic_packet_t**)malloc(sizeof(picoquic_packet_t*) * (size_t)ring_size);
+        if (sent_ring != NULL) {
+            picoquic_packet_t* p = pkt_ctx->pending_first;
+
+            memset(sent_ring, 0, sizeof(picoquic_packet_t*) * (size_t)ring_size);
+            pkt_ctx->sent_ring = sent_ring;
+            pkt_ctx->sent_ring_mask = ring_size - 1;
+            while (p != NULL) {
+                sent_ring[p->sequence_number & pkt_ctx->sent_ring_mask] = p;
+                p = p->packet_next;
+            }
+        }
+    }
+}
+
+static void picoquic_sent_ring_remove(picoquic_packet_context_t* pkt_ctx, picoquic_packet_t* packet)
+{
+    if (pkt_ctx->sent_ring != NULL && pkt_ctx->sent_ring[packet->sequence_number & pkt_ctx->sent_ring_mask] == packet) {
+        pkt_ctx->sent_ring[packet->sequence_number & pkt_ctx->sent_ring_mask] = NULL;
+    }
+}
+
+picoquic_packet_t* picoquic_sent_ring_find(picoquic_packet_context_t* pkt_ctx, uint64_t sequence_number)
+{
+    picoquic_packet_t* packet = NULL;
+
+    if (pkt_ctx->sent_ring != NULL) {
+        packet = pkt_ctx->sent_ring[sequence_number & pkt_ctx->sent_ring_mask];
+        if (packet != NULL && packet->sequence_number != sequence_number) {
+            packet = NULL;
+        }
+    }
+    else {
+        packet = pkt_ctx->pending_first;
+        while (packet != NULL && packet->sequence_number < sequence_number) {
+            packet = packet->packet_next;
+        }
+        if (packet != NULL && packet->sequence_number != sequence_number) {
+            packet = NULL;
+        }
+    }
+
+    return packet;
+}
+
+void picoquic_sent_ring_free(picoquic_packet_context_t* pkt_ctx)
+{
+    if (pkt_ctx->sent_ring != NULL) {
+        free(pkt_ctx->sent_ring);
+        pkt_ctx->sent_ring = NULL;
+    }
+    pkt_ctx->sent_ring_mask = 0;
+}
+
 void picoquic_queue_for_retransmit(picoquic_cnx_t* cnx, picoquic_path_t * path_x, picoquic_packet_t* packet,
     size_t length, uint64_t current_time)
 {
@@ -942,6 +1388,7 @@ void picoquic_queue_for_retransmit(picoquic_cnx_t* cnx, picoquic_path_t * path_x
     }
     pkt_ctx->pending_last = packet;
     packet->is_queued_for_retransmit = 1;
+    picoquic_sent_ring_insert(pkt_ctx, packet);
 
     if (!packet->is_ack_trap) {
         /* Account for bytes in transit, for congestion control */
@@ -974,6 +1421,7 @@ picoquic_packet_t* picoquic_dequeue_retransmit_packet(picoquic_cnx_t* cnx,
             p->packet_previous->packet_next = p->packet_next;
         }
         p->is_queued_for_retransmit = 0;
+        picoquic_sent_ring_remove(pkt_ctx, p);
     }
 
     /* Account for bytes in transit, for congestion control */
@@ -1346,6 +1794,8 @@ int picoquic_preemptive_retransmit_in_context(
      * packets from every plausible path.
      */
     int ret = 0;
+    /* The redundant path scheduler repeats packets on another path as soon as possible */
+    int is_redundant = cnx->is_multipath_enabled && cnx->path_scheduler->is_redundant;
 
     /* Check that the connection is still active before adding more preemptive repeats */
     if (cnx->latest_progress_time + rtt < current_time ||
@@ -1366,7 +1816,8 @@ int picoquic_preemptive_retransmit_in_context(
     }
     /* Try to format the repeated packet */
     while (pkt_ctx->preemptive_repeat_ptr != NULL) {
-        uint64_t early_delay = (rtt > 8 * PICOQUIC_ACK_DELAY_MAX) ? rtt / 8 : PICOQUIC_ACK_DELAY_MAX;
+        uint64_t early_delay = (is_redundant) ? 0 :
+            ((rtt > 8 * PICOQUIC_ACK_DELAY_MAX) ? rtt / 8 : PICOQUIC_ACK_DELAY_MAX);
         uint64_t early_time = pkt_ctx->preemptive_repeat_ptr->send_time + early_delay;
 
         if (!pkt_ctx->preemptive_repeat_ptr->was_preemptively_repeated) {
@@ -1428,6 +1879,10 @@ int picoquic_preemptive_retransmit_as_needed(
     if (pc == picoquic_packet_context_application &&
         cnx->is_multipath_enabled) {
         for (int i = 0; i < cnx->nb_paths; i++) {
+            if (cnx->path_scheduler->is_redundant && cnx->path[i] == path_x) {
+                /* Redundant copies are sent on a different path than the original */
+                continue;
+            }
             pkt_ctx = &cnx->path[i]->pkt_ctx;
             ret = picoquic_preemptive_retransmit_in_context(
                 cnx, pkt_ctx, rtt, current_time, next_wake_time,
@@ -3528,6 +3983,13 @@ int picoquic_prepare_packet_ready(picoquic_cnx_t* cnx, picoquic_path_t* path_x,
                                 max_data_increase);
                         }
                     }
+                    else if (cnx->quic->rwnd_budget != 0) {
+                        uint64_t max_data_increase = picoquic_rwnd_max_data_increase(cnx, current_time);
+                        if (max_data_increase > 0) {
+                            bytes_next = picoquic_format_max_data_frame(cnx, bytes_next, bytes_max, &more_data, &is_pure_ack,
+                                max_data_increase);
+                        }
+                    }
                     else if (2 * cnx->data_received > cnx->maxdata_local) {
                         bytes_next = picoquic_format_max_data_frame(cnx, bytes_next, bytes_max, &more_data, &is_pure_ack,
                             picoquic_cc_increased_window(cnx, cnx->maxdata_local));
@@ -3638,6 +4100,7 @@ int picoquic_prepare_packet_ready(picoquic_cnx_t* cnx, picoquic_path_t* path_x,
                         }
 
                         if (cnx->is_preemptive_repeat_enabled ||
+                            (cnx->is_multipath_enabled && cnx->path_scheduler->is_redundant) ||
                             (cnx->is_forced_probe_up_required && path_x->is_cca_probing_up)) {
                             if (length <= header_length) {
                                 /* Consider redundant retransmission:
@@ -4038,14 +4501,15 @@ static int picoquic_select_next_path_mp(picoquic_cnx_t* cnx, uint64_t current_ti
 {
     int path_id = -1;
     int highest_priority = -1;
-    int data_path_cwin = -1;
-    int data_path_pacing = -1;
     int challenge_path = -1;
+    picoquic_path_candidate_t candidates[PICOQUIC_NB_PATH_CANDIDATES_MAX];
+    picoquic_path_candidate_t extra_candidate;
+    int nb_candidates = 0;
+    int is_cwin_candidate_found = 0;
     uint64_t pacing_time_next = UINT64_MAX;
     uint64_t challenge_time_next = UINT64_MAX;
     uint64_t highest_retransmit = UINT64_MAX;
     uint64_t last_sent_pacing = UINT64_MAX;
-    uint64_t last_sent_cwin = UINT64_MAX;
     int i;
     int i_min_rtt = -1;
     int is_min_rtt_pacing_ok = 0;
@@ -4123,15 +4587,20 @@ static int picoquic_select_next_path_mp(picoquic_cnx_t* cnx, uint64_t current_ti
                 if (is_new_priority) {
                     highest_priority = path_priority;
                     highest_retransmit = cnx->path[i]->nb_retransmit;
-                    data_path_cwin = -1;
-                    data_path_pacing = -1;
+                    nb_candidates = 0;
+                    is_cwin_candidate_found = 0;
                     pacing_time_next = UINT64_MAX;
                     last_sent_pacing = UINT64_MAX;
-                    last_sent_cwin = UINT64_MAX;
                     i_min_rtt = -1;
                     is_min_rtt_pacing_ok = 0;
                 }
                 if (is_polled) {
+                    /* Paths beyond the size of the candidate list are polled but not scheduled */
+                    picoquic_path_candidate_t* candidate = (nb_candidates < PICOQUIC_NB_PATH_CANDIDATES_MAX) ?
+                        &candidates[nb_candidates++] : &extra_candidate;
+                    candidate->path_id = i;
+                    candidate->is_pacing_ok = 0;
+                    candidate->is_cwin_ok = 0;
                     /* This path is a candidate for min rtt */
                     if (i_min_rtt < 0 ||
                         cnx->path[i]->nb_retransmit < cnx->path[i_min_rtt]->nb_retransmit ||
@@ -4142,19 +4611,17 @@ static int picoquic_select_next_path_mp(picoquic_cnx_t* cnx, uint64_t current_ti
                     }
                     cnx->path[i]->polled++;
                     if (picoquic_is_sending_authorized_by_pacing(cnx, cnx->path[i], current_time, &pacing_time_next)) {
+                        candidate->is_pacing_ok = 1;
                         if (cnx->path[i]->last_sent_time < last_sent_pacing) {
                             last_sent_pacing = cnx->path[i]->last_sent_time;
-                            data_path_pacing = i;
                             if (i == i_min_rtt) {
                                 is_min_rtt_pacing_ok = 1;
                             }
                         }
                         if (cnx->path[i]->bytes_in_transit < cnx->path[i]->cwin &&
                             cnx->path[i]->bytes_in_transit <  cnx->quic->cwin_max) {
-                            if (cnx->path[i]->last_sent_time < last_sent_cwin) {
-                                last_sent_cwin = cnx->path[i]->last_sent_time;
-                                data_path_cwin = i;
-                            }
+                            candidate->is_cwin_ok = 1;
+                            is_cwin_candidate_found = 1;
                             if (affinity_path_id < 0) {
                                 /* we select here the first path that is either ready to send on
                                  * the highest priority stream with affinity on this path, or
@@ -4194,19 +4661,11 @@ static int picoquic_select_next_path_mp(picoquic_cnx_t* cnx, uint64_t current_ti
     else if (is_ack_needed && is_min_rtt_pacing_ok) {
         path_id = i_min_rtt;
     }
-    else if (data_path_cwin >= 0) {
+    else if (is_cwin_candidate_found && affinity_path_id >= 0) {
         /* if there is a path ready to send the most urgent data, select it */
-        if (affinity_path_id >= 0) {
-            path_id = affinity_path_id;
-        }
-        else {
-            path_id = data_path_cwin;
-        }
+        path_id = affinity_path_id;
     }
-    else if (data_path_pacing >= 0) {
-        path_id = data_path_pacing;
-    }
-    else {
+    else if ((path_id = cnx->path_scheduler->select_path(cnx, candidates, nb_candidates, current_time)) < 0) {
         uint64_t path_wake_time = pacing_time_next;
         if (challenge_time_next < path_wake_time) {
             path_wake_time = challenge_time_next;
@@ -4352,6 +4811,47 @@ int picoquic_program_app_wake_time(picoquic_cnx_t* cnx, uint64_t* next_wake_time
     return ret;
 }
 
+/* A connection is idle if it is ready, has no packet in flight,
+ * and nothing queued for sending. */
+static int picoquic_is_cnx_idle(picoquic_cnx_t* cnx)
+{
+    int is_idle = (cnx->cnx_state == picoquic_state_ready && cnx->first_misc_frame == NULL &&
+        cnx->first_datagram == NULL && !cnx->is_datagram_ready && cnx->queue_data_repeat_tree.root == NULL);
+    picoquic_stream_bucket_t* bucket = cnx->first_stream_bucket;
+
+    for (picoquic_packet_context_enum pc = 0; is_idle && pc < picoquic_nb_packet_context; pc++) {
+        is_idle = (cnx->pkt_ctx[pc].pending_first == NULL);
+    }
+    for (int i = 0; is_idle && i < cnx->nb_paths; i++) {
+        is_idle = (cnx->path[i]->bytes_in_transit == 0 && cnx->path[i]->pkt_ctx.pending_first == NULL);
+    }
+    while (is_idle && bucket != NULL) {
+        is_idle = (bucket->first_ready_stream == NULL);
+        bucket = bucket->next_bucket;
+    }
+
+    return is_idle;
+}
+
+/* Hibernate the connection once it has been idle for the hibernation delay,
+ * or program a wake up at that time. */
+void picoquic_check_hibernation(picoquic_cnx_t* cnx, uint64_t current_time, uint64_t* next_wake_time)
+{
+    if (cnx->hibernation_delay > 0 && !cnx->is_hibernating) {
+        uint64_t hibernation_time = cnx->latest_busy_time + cnx->hibernation_delay;
+
+        if (!picoquic_is_cnx_idle(cnx)) {
+            cnx->latest_busy_time = current_time;
+        }
+        else if (current_time >= hibernation_time) {
+            picoquic_hibernate_cnx(cnx);
+        }
+        else if (*next_wake_time > hibernation_time) {
+            *next_wake_time = hibernation_time;
+        }
+    }
+}
+
 /* Prepare next packet to send, or nothing.. */
 int picoquic_prepare_packet_ex(picoquic_cnx_t* cnx,
     uint64_t current_time, uint8_t* send_buffer, size_t send_buffer_max, size_t* send_length,
@@ -4375,6 +4875,10 @@ int picoquic_prepare_packet_ex(picoquic_cnx_t* cnx,
 
     *send_length = 0;
 
+    if (cnx->is_hibernating) {
+        picoquic_wake_cnx_from_hibernation(cnx, current_time);
+    }
+
     ret = picoquic_handle_app_wake_time(cnx, current_time);
 
     if (ret == 0) {
@@ -4411,6 +4915,13 @@ int picoquic_prepare_packet_ex(picoquic_cnx_t* cnx,
             cnx->is_sending_large_buffer = 1;
         }
 
+        /* When sending a train, protect the packet headers once the train is complete */
+        cnx->quic->hp_batch.is_active = (send_msg_size != NULL);
+
+        /* The train departs with its first packet, which may be delayed if pacing is offloaded */
+        cnx->path[path_id]->pacing.departure_time = current_time;
+        cnx->quic->train_departure_time = current_time;
+
         while (ret == 0)
         {
             /* Create a new packet, which may include several segments */
@@ -4448,7 +4959,15 @@ int picoquic_prepare_packet_ex(picoquic_cnx_t* cnx,
                 packet = picoquic_create_packet(cnx->quic);
 
                 if (packet == NULL) {
-                    ret = PICOQUIC_ERROR_MEMORY;
+                    if (cnx->quic->packet_pool_max == 0 ||
+                        (size_t)cnx->quic->nb_packets_allocated < cnx->quic->packet_pool_max) {
+                        ret = PICOQUIC_ERROR_MEMORY;
+                    }
+                    else {
+                        /* The pool ceiling is reached. Wait until packets
+                         * are acknowledged and recycled. */
+                        picoquic_packet_pool_wait(cnx->quic, cnx);
+                    }
                     break;
                 }
                 else {
@@ -4512,6 +5031,9 @@ int picoquic_prepare_packet_ex(picoquic_cnx_t* cnx,
             }
 
             /* Account for the bytes in the packet. */
+            if (*send_length == 0 && packet_size > 0) {
+                cnx->quic->train_departure_time = cnx->path[path_id]->pacing.departure_time;
+            }
             *send_length += packet_size;
 
             /* Check whether to keep coalescing multiple packets in the send buffer */
@@ -4544,13 +5066,23 @@ int picoquic_prepare_packet_ex(picoquic_cnx_t* cnx,
             else if (*send_length + *send_msg_size > send_buffer_max) {
                 break;
             }
+            else if (picoquic_pacing_next_departure_time(&cnx->path[path_id]->pacing, current_time) >
+                cnx->quic->train_departure_time + cnx->path[path_id]->pacing.packet_time_microsec) {
+                /* The whole train departs at the time of its first packet. End it if
+                 * the next packet is paced to leave more than a packet interval later. */
+                cnx->nb_trains_short++;
+                break;
+            }
         }
         if (*send_length > 0) {
             cnx->nb_trains_sent++;
         }
+        picoquic_hp_batch_flush(&cnx->quic->hp_batch);
+        cnx->quic->hp_batch.is_active = 0;
     }
 
     if (ret == 0) {
+        picoquic_check_hibernation(cnx, current_time, &next_wake_time);
         ret = picoquic_program_app_wake_time(cnx, &next_wake_time);
     }
 
@@ -4616,6 +5148,7 @@ int picoquic_prepare_next_packet_ex(picoquic_quic_t* quic,
     int ret = 0;
     picoquic_stateless_packet_t* sp = picoquic_dequeue_stateless_packet(quic);
 
+    quic->train_departure_time = current_time;
     if (p_last_cnx) {
         *p_last_cnx = NULL;
     }
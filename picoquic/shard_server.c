@@ -0,0 +1,498 @@
+/*
+* Copyright (c) 2026, the picoquic contributors.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Sharded server: one quic context and one network thread per shard,
+ * with packets steered to the owning shard based on the server ID
+ * encoded in the connection ID. See picoquic_shard.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#ifndef _WINDOWS
+#include <unistd.h>
+#endif
+#include "picoquic.h"
+#include "picoquic_internal.h"
+#include "picoquic_utils.h"
+#include "picoquic_packet_loop.h"
+#include "picoquic_lb.h"
+#include "picoquic_shard.h"
+
+#ifndef _WINDOWS
+/* The forwarding queue of each shard is a bounded multi-producer, single
+ * consumer queue, after the bounded MPMC queue of Dmitry Vyukov. Each slot
+ * carries a sequence number. A producer claims a slot by advancing the
+ * enqueue position with compare and swap, copies the packet, and then
+ * publishes the slot by updating its sequence number. The consumer frees
+ * the slot by setting the sequence number for the next round.
+ */
+typedef struct st_picoquic_shard_msg_t {
+    uint64_t sequence;
+    size_t length;
+    struct sockaddr_storage addr_from;
+    struct sockaddr_storage addr_to;
+    int if_index;
+    unsigned char received_ecn;
+    uint8_t bytes[PICOQUIC_MAX_PACKET_SIZE];
+} picoquic_shard_msg_t;
+
+typedef struct st_picoquic_shard_t {
+    picoquic_shard_server_t* server;
+    int shard_id;
+    picoquic_quic_t* quic;
+    picoquic_packet_loop_param_t param;
+    picoquic_network_thread_ctx_t* thread_ctx;
+    uint16_t port;
+    picoquic_cnx_t* last_cnx;
+    /* Queue state. The enqueue position and the wake up flag are shared
+     * by the producers, the dequeue position is only used by the shard. */
+    uint64_t enqueue_pos;
+    int wake_pending;
+    uint64_t dequeue_pos;
+    picoquic_shard_msg_t* msgs;
+    /* Each counter is only updated by the shard's own thread */
+    picoquic_shard_stats_t stats;
+} picoquic_shard_t;
+
+struct st_picoquic_shard_server_t {
+    int nb_shards;
+    int is_started;
+    uint64_t queue_mask;
+    picoquic_load_balancer_config_t lb_config;
+    picoquic_packet_loop_cb_fn loop_callback;
+    void* loop_callback_ctx;
+    picoquic_shard_t shards[PICOQUIC_SHARD_MAX];
+};
+
+int picoquic_shard_server_steer(picoquic_shard_server_t* server, int shard_id,
+    const uint8_t* bytes, size_t length)
+{
+    int target_id = -1;
+    int is_local = 0;
+    picoquic_quic_t* quic = server->shards[shard_id].quic;
+    picoquic_connection_id_t dcid;
+
+    if (length >= 5 && (bytes[0] & 0x80) != 0) {
+        /* Initial and 0-RTT packets carry a CID chosen by the client, which
+         * may decode to any shard by chance. They are processed locally, as
+         * are packets of unknown versions. */
+        int version_index = picoquic_get_version_index(PICOPARSE_32(bytes + 1));
+
+        if (version_index < 0) {
+            is_local = 1;
+        }
+        else {
+            picoquic_packet_type_enum ptype = picoquic_parse_long_packet_type(bytes[0], version_index);
+
+            is_local = (ptype == picoquic_packet_initial || ptype == picoquic_packet_0rtt_protected);
+        }
+    }
+
+    if (!is_local) {
+        picoquic_parse_incoming_dcid(quic, bytes, length, &dcid);
+        if (dcid.id_len > 0) {
+            uint64_t server_id = picoquic_lb_compat_cid_verify(quic, quic->cnx_id_callback_ctx, &dcid);
+
+            if (server_id < (uint64_t)server->nb_shards) {
+                target_id = (int)server_id;
+            }
+        }
+    }
+
+    return target_id;
+}
+
+int picoquic_shard_server_forward(picoquic_shard_server_t* server, int shard_id, int target_id,
+    const uint8_t* bytes, size_t length, const struct sockaddr* addr_from, const struct sockaddr* addr_to,
+    int if_index, unsigned char received_ecn)
+{
+    picoquic_shard_t* target = &server->shards[target_id];
+    picoquic_shard_msg_t* msg = NULL;
+    uint64_t pos = __atomic_load_n(&target->enqueue_pos, __ATOMIC_RELAXED);
+    picoquic_network_thread_ctx_t* thread_ctx;
+
+    while (length <= PICOQUIC_MAX_PACKET_SIZE) {
+        int64_t diff;
+
+        msg = &target->msgs[pos & server->queue_mask];
+        diff = (int64_t)(__atomic_load_n(&msg->sequence, __ATOMIC_ACQUIRE) - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&target->enqueue_pos, &pos, pos + 1, 1,
+                __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            /* The queue is full */
+            msg = NULL;
+            break;
+        }
+        else {
+            pos = __atomic_load_n(&target->enqueue_pos, __ATOMIC_RELAXED);
+        }
+        msg = NULL;
+    }
+
+    if (msg == NULL) {
+        server->shards[shard_id].stats.nb_dropped++;
+        return -1;
+    }
+
+    memcpy(msg->bytes, bytes, length);
+    msg->length = length;
+    picoquic_store_addr(&msg->addr_from, addr_from);
+    picoquic_store_addr(&msg->addr_to, addr_to);
+    msg->if_index = if_index;
+    msg->received_ecn = received_ecn;
+    __atomic_store_n(&msg->sequence, pos + 1, __ATOMIC_RELEASE);
+    server->shards[shard_id].stats.nb_forwarded++;
+
+    /* Only wake up the target thread if it is not already scheduled to drain the queue */
+    thread_ctx = __atomic_load_n(&target->thread_ctx, __ATOMIC_ACQUIRE);
+    if (thread_ctx != NULL && __atomic_exchange_n(&target->wake_pending, 1, __ATOMIC_SEQ_CST) == 0) {
+        (void)picoquic_wake_up_network_thread(thread_ctx);
+    }
+
+    return 0;
+}
+
+int picoquic_shard_server_drain(picoquic_shard_server_t* server, int shard_id, uint64_t current_time)
+{
+    picoquic_shard_t* shard = &server->shards[shard_id];
+    int nb_drained = 0;
+
+    __atomic_store_n(&shard->wake_pending, 0, __ATOMIC_SEQ_CST);
+
+    /* Process at most one queue worth of packets per call, so a busy
+     * producer cannot starve the loop */
+    while ((uint64_t)nb_drained <= server->queue_mask) {
+        picoquic_shard_msg_t* msg = &shard->msgs[shard->dequeue_pos & server->queue_mask];
+
+        if (__atomic_load_n(&msg->sequence, __ATOMIC_ACQUIRE) != shard->dequeue_pos + 1) {
+            break;
+        }
+        /* picoquic_incoming_packet_ex does not return errors for individual packets */
+        (void)picoquic_incoming_packet_ex(shard->quic, msg->bytes, msg->length,
+            (struct sockaddr*)&msg->addr_from, (struct sockaddr*)&msg->addr_to,
+            msg->if_index, msg->received_ecn, &shard->last_cnx, current_time);
+        __atomic_store_n(&msg->sequence, shard->dequeue_pos + server->queue_mask + 1, __ATOMIC_RELEASE);
+        shard->dequeue_pos++;
+        nb_drained++;
+    }
+    shard->stats.nb_received_forwarded += nb_drained;
+
+    return nb_drained;
+}
+
+static int picoquic_shard_steer_cb(void* steer_ctx, uint8_t* bytes, size_t length,
+    struct sockaddr* addr_from, struct sockaddr* addr_to, int if_index, unsigned char received_ecn)
+{
+    picoquic_shard_t* shard = (picoquic_shard_t*)steer_ctx;
+    int target_id = picoquic_shard_server_steer(shard->server, shard->shard_id, bytes, length);
+
+    if (target_id < 0 || target_id == shard->shard_id) {
+        return 0;
+    }
+    /* If the target queue is full, the packet is dropped, as if lost in the network */
+    (void)picoquic_shard_server_forward(shard->server, shard->shard_id, target_id, bytes, length,
+        addr_from, addr_to, if_index, received_ecn);
+    return 1;
+}
+
+static int picoquic_shard_loop_cb(picoquic_quic_t* quic, picoquic_packet_loop_cb_enum cb_mode,
+    void* callback_ctx, void* callback_argv)
+{
+    picoquic_shard_t* shard = (picoquic_shard_t*)callback_ctx;
+    picoquic_shard_server_t* server = shard->server;
+    int ret = 0;
+
+    switch (cb_mode) {
+    case picoquic_packet_loop_port_update:
+        shard->port = picoquic_get_addr_port((struct sockaddr*)callback_argv);
+        break;
+    case picoquic_packet_loop_wake_up:
+        (void)picoquic_shard_server_drain(server, shard->shard_id, picoquic_get_quic_time(quic));
+        break;
+    default:
+        break;
+    }
+
+    if (server->loop_callback != NULL) {
+        ret = server->loop_callback(quic, cb_mode, server->loop_callback_ctx, callback_argv);
+    }
+
+    return ret;
+}
+
+static void picoquic_shard_server_stop(picoquic_shard_server_t* server)
+{
+    /* Stop all the loops before deleting any thread context, because
+     * a running shard may still forward packets to the others. */
+    for (int i = 0; i < server->nb_shards; i++) {
+        picoquic_network_thread_ctx_t* thread_ctx = server->shards[i].thread_ctx;
+        if (thread_ctx != NULL) {
+            thread_ctx->thread_should_close = 1;
+            (void)picoquic_wake_up_network_thread(thread_ctx);
+        }
+    }
+    for (int i = 0; i < server->nb_shards; i++) {
+        picoquic_network_thread_ctx_t* thread_ctx = server->shards[i].thread_ctx;
+        for (int t = 0; thread_ctx != NULL && thread_ctx->thread_is_ready && t < 2000; t++) {
+            usleep(1000);
+        }
+    }
+    for (int i = 0; i < server->nb_shards; i++) {
+        picoquic_network_thread_ctx_t* thread_ctx = server->shards[i].thread_ctx;
+        if (thread_ctx != NULL) {
+            __atomic_store_n(&server->shards[i].thread_ctx, NULL, __ATOMIC_RELEASE);
+            picoquic_delete_network_thread(thread_ctx);
+        }
+    }
+    server->is_started = 0;
+}
+
+picoquic_shard_server_t* picoquic_shard_server_create(picoquic_shard_server_param_t* param)
+{
+    int ret = 0;
+    size_t queue_size = 1;
+    picoquic_shard_server_t* server = NULL;
+
+    if (param->nb_shards <= 0 || param->nb_shards > PICOQUIC_SHARD_MAX || param->create_quic_fn == NULL ||
+        (server = (picoquic_shard_server_t*)malloc(sizeof(picoquic_shard_server_t))) == NULL) {
+        return NULL;
+    }
+    memset(server, 0, sizeof(picoquic_shard_server_t));
+    server->nb_shards = param->nb_shards;
+    server->loop_callback = param->loop_callback;
+    server->loop_callback_ctx = param->loop_callback_ctx;
+    server->lb_config = param->lb_config;
+    if (server->lb_config.connection_id_length == 0) {
+        memset(&server->lb_config, 0, sizeof(picoquic_load_balancer_config_t));
+        server->lb_config.method = picoquic_load_balancer_cid_clear;
+        server->lb_config.server_id_length = 1;
+        server->lb_config.connection_id_length = 8;
+    }
+    while (queue_size < ((param->queue_size == 0) ? PICOQUIC_SHARD_QUEUE_SIZE_DEFAULT : param->queue_size)) {
+        queue_size <<= 1;
+    }
+    server->queue_mask = queue_size - 1;
+
+    for (int i = 0; ret == 0 && i < server->nb_shards; i++) {
+        picoquic_shard_t* shard = &server->shards[i];
+        picoquic_load_balancer_config_t lb_config = server->lb_config;
+
+        shard->server = server;
+        shard->shard_id = i;
+        shard->param = param->loop_param;
+        shard->param.reuse_port = 1;
+        shard->param.steer_fn = picoquic_shard_steer_cb;
+        shard->param.steer_ctx = shard;
+        if ((shard->msgs = (picoquic_shard_msg_t*)malloc(queue_size * sizeof(picoquic_shard_msg_t))) == NULL) {
+            ret = -1;
+            break;
+        }
+        for (size_t j = 0; j < queue_size; j++) {
+            shard->msgs[j].sequence = j;
+        }
+        lb_config.server_id64 = (uint64_t)i;
+        if ((shard->quic = param->create_quic_fn(param->create_quic_ctx, i)) == NULL ||
+            picoquic_lb_compat_cid_config(shard->quic, &lb_config) != 0) {
+            DBG_PRINTF("Cannot configure the quic context of shard %d", i);
+            ret = -1;
+        }
+    }
+
+    if (ret != 0) {
+        picoquic_shard_server_delete(server);
+        server = NULL;
+    }
+
+    return server;
+}
+
+int picoquic_shard_server_start(picoquic_shard_server_t* server)
+{
+    int ret = 0;
+    uint16_t port = server->shards[0].param.local_port;
+
+    for (int i = 0; ret == 0 && i < server->nb_shards; i++) {
+        picoquic_shard_t* shard = &server->shards[i];
+        picoquic_network_thread_ctx_t* thread_ctx;
+
+        shard->param.local_port = port;
+        thread_ctx = picoquic_start_network_thread(shard->quic, &shard->param,
+            picoquic_shard_loop_cb, shard, &ret);
+        if (thread_ctx == NULL) {
+            if (ret == 0) {
+                ret = -1;
+            }
+        }
+        else {
+            __atomic_store_n(&shard->thread_ctx, thread_ctx, __ATOMIC_RELEASE);
+            for (int t = 0; t < 2000 && !thread_ctx->thread_is_ready && !thread_ctx->thread_is_closed; t++) {
+                usleep(1000);
+            }
+            if (!thread_ctx->thread_is_ready) {
+                DBG_PRINTF("Cannot start the network thread of shard %d", i);
+                ret = -1;
+            }
+            else if (port == 0) {
+                /* The other shards share the port obtained by the first one */
+                port = shard->port;
+            }
+        }
+    }
+
+    server->is_started = 1;
+    if (ret == 0) {
+        /* Packets may have been forwarded to a shard before its thread context
+         * was published, make sure that they are processed. */
+        for (int i = 0; i < server->nb_shards; i++) {
+            __atomic_store_n(&server->shards[i].wake_pending, 1, __ATOMIC_SEQ_CST);
+            (void)picoquic_wake_up_network_thread(server->shards[i].thread_ctx);
+        }
+    }
+    else {
+        picoquic_shard_server_stop(server);
+    }
+
+    return ret;
+}
+
+void picoquic_shard_server_delete(picoquic_shard_server_t* server)
+{
+    if (server->is_started) {
+        picoquic_shard_server_stop(server);
+    }
+    for (int i = 0; i < server->nb_shards; i++) {
+        picoquic_shard_t* shard = &server->shards[i];
+
+        if (shard->quic != NULL) {
+            picoquic_lb_compat_cid_config_free(shard->quic);
+            picoquic_free(shard->quic);
+            shard->quic = NULL;
+        }
+        if (shard->msgs != NULL) {
+            free(shard->msgs);
+            shard->msgs = NULL;
+        }
+    }
+    free(server);
+}
+
+int picoquic_shard_server_nb_shards(picoquic_shard_server_t* server)
+{
+    return server->nb_shards;
+}
+
+picoquic_quic_t* picoquic_shard_server_get_quic(picoquic_shard_server_t* server, int shard_id)
+{
+    return (shard_id >= 0 && shard_id < server->nb_shards) ? server->shards[shard_id].quic : NULL;
+}
+
+uint16_t picoquic_shard_server_get_port(picoquic_shard_server_t* server)
+{
+    return server->shards[0].port;
+}
+
+void picoquic_shard_server_get_stats(picoquic_shard_server_t* server, int shard_id, picoquic_shard_stats_t* stats)
+{
+    *stats = server->shards[shard_id].stats;
+}
+#else
+/* SO_REUSEPORT does not spread flows between sockets on Windows. */
+picoquic_shard_server_t* picoquic_shard_server_create(picoquic_shard_server_param_t* param)
+{
+    UNREFERENCED_PARAMETER(param);
+    return NULL;
+}
+
+int picoquic_shard_server_start(picoquic_shard_server_t* server)
+{
+    UNREFERENCED_PARAMETER(server);
+    return -1;
+}
+
+void picoquic_shard_server_delete(picoquic_shard_server_t* server)
+{
+    UNREFERENCED_PARAMETER(server);
+}
+
+int picoquic_shard_server_nb_shards(picoquic_shard_server_t* server)
+{
+    UNREFERENCED_PARAMETER(server);
+    return 0;
+}
+
+picoquic_quic_t* picoquic_shard_server_get_quic(picoquic_shard_server_t* server, int shard_id)
+{
+    UNREFERENCED_PARAMETER(server);
+    UNREFERENCED_PARAMETER(shard_id);
+    return NULL;
+}
+
+uint16_t picoquic_shard_server_get_port(picoquic_shard_server_t* server)
+{
+    UNREFERENCED_PARAMETER(server);
+    return 0;
+}
+
+void picoquic_shard_server_get_stats(picoquic_shard_server_t* server, int shard_id, picoquic_shard_stats_t* stats)
+{
+    UNREFERENCED_PARAMETER(server);
+    UNREFERENCED_PARAMETER(shard_id);
+    memset(stats, 0, sizeof(picoquic_shard_stats_t));
+}
+
+int picoquic_shard_server_steer(picoquic_shard_server_t* server, int shard_id,
+    const uint8_t* bytes, size_t length)
+{
+    UNREFERENCED_PARAMETER(server);
+    UNREFERENCED_PARAMETER(shard_id);
+    UNREFERENCED_PARAMETER(bytes);
+    UNREFERENCED_PARAMETER(length);
+    return -1;
+}
+
+int picoquic_shard_server_forward(picoquic_shard_server_t* server, int shard_id, int target_id,
+    const uint8_t* bytes, size_t length, const struct sockaddr* addr_from, const struct sockaddr* addr_to,
+    int if_index, unsigned char received_ecn)
+{
+    UNREFERENCED_PARAMETER(server);
+    UNREFERENCED_PARAMETER(shard_id);
+    UNREFERENCED_PARAMETER(target_id);
+    UNREFERENCED_PARAMETER(bytes);
+    UNREFERENCED_PARAMETER(length);
+    UNREFERENCED_PARAMETER(addr_from);
+    UNREFERENCED_PARAMETER(addr_to);
+    UNREFERENCED_PARAMETER(if_index);
+    UNREFERENCED_PARAMETER(received_ecn);
+    return -1;
+}
+
+int picoquic_shard_server_drain(picoquic_shard_server_t* server, int shard_id, uint64_t current_time)
+{
+    UNREFERENCED_PARAMETER(server);
+    UNREFERENCED_PARAMETER(shard_id);
+    UNREFERENCED_PARAMETER(current_time);
+    return 0;
+}
+#endif
@@ -78,6 +78,10 @@
 #include <netdb.h>
 #include <netinet/in.h>
 #include <sys/select.h>
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#endif
 
 #ifndef __APPLE__
 #ifdef __LINUX__
@@ -108,6 +112,9 @@
 #include "picoquic_internal.h"
 #include "picoquic_packet_loop.h"
 #include "picoquic_unified_log.h"
+#ifdef PICOQUIC_WITH_IO_URING
+#include "picoquic_uring.h"
+#endif
 
 #if defined(_WINDOWS)
 #ifdef UDP_SEND_MSG_SIZE
@@ -371,6 +378,7 @@ int picoquic_packet_loop_open_socket(int socket_buffer_size, int do_not_use_gso,
         /* TODO: set option IPv6 only */
         picoquic_socket_set_ecn_options(s_ctx->fd, s_ctx->af, &recv_set, &send_set) != 0 ||
         picoquic_socket_set_pkt_info(s_ctx->fd, s_ctx->af) != 0 ||
+        (s_ctx->reuse_port && picoquic_socket_set_reuse_port(s_ctx->fd) != 0) ||
         picoquic_bind_to_port(s_ctx->fd,s_ctx->af, s_ctx->port) != 0 ||
         picoquic_get_local_address(s_ctx->fd, &local_address) != 0 ||
         picoquic_socket_set_pmtud_options(s_ctx->fd, s_ctx->af) != 0)
@@ -565,28 +573,24 @@ int picoquic_packet_loop_wait(picoquic_socket_ctx_t* s_ctx,
     return bytes_recv;
 }
 #else 
-int picoquic_packet_loop_select(picoquic_socket_ctx_t* s_ctx,
+/* Wait until one of the sockets is ready to read, the wake up pipe
+ * is signalled, or the delay expires. Returns -1 on error, 0 otherwise.
+ * If a socket is ready, its rank is set in *socket_rank.
+ */
+static int picoquic_packet_loop_select_wait(picoquic_socket_ctx_t* s_ctx,
     int nb_sockets,
-    struct sockaddr_storage* addr_from,
-    struct sockaddr_storage* addr_dest,
-    int* dest_if,
-    unsigned char * received_ecn,
-    uint8_t* buffer, int buffer_max,
     int64_t delta_t,
-    int * is_wake_up_event,
-    picoquic_network_thread_ctx_t * thread_ctx,
-    int * socket_rank)
+    int* is_wake_up_event,
+    picoquic_network_thread_ctx_t* thread_ctx,
+    int* socket_rank)
 {
     fd_set readfds;
     struct timeval tv;
     int ret_select = 0;
-    int bytes_recv = 0;
+    int ret = 0;
     int sockmax = 0;
 
-    if (received_ecn != NULL) {
-        *received_ecn = 0;
-    }
-
+    *socket_rank = -1;
     FD_ZERO(&readfds);
 
     for (int i = 0; i < nb_sockets; i++) {
@@ -620,7 +624,7 @@ int picoquic_packet_loop_select(picoquic_socket_ctx_t* s_ctx,
     ret_select = select(sockmax + 1, &readfds, NULL, NULL, &tv);
 
     if (ret_select < 0) {
-        bytes_recv = -1;
+        ret = -1;
         DBG_PRINTF("Error: select returns %d\n", ret_select);
     } else if (ret_select > 0) {
         /* Check if the 'wake up' pipe is full. If it is, read the data on it,
@@ -630,7 +634,7 @@ int picoquic_packet_loop_select(picoquic_socket_ctx_t* s_ctx,
             uint8_t eventbuf[8];
             int pipe_recv;
             if ((pipe_recv = read(thread_ctx->wake_up_pipe_fd[0], eventbuf, sizeof(eventbuf))) <= 0) {
-                bytes_recv = -1;
+                ret = -1;
                 DBG_PRINTF("Error: read pipe returns %d\n", (pipe_recv == 0)?EPIPE:errno);
             }
             else {
@@ -642,32 +646,432 @@ int picoquic_packet_loop_select(picoquic_socket_ctx_t* s_ctx,
             for (int i = 0; i < nb_sockets; i++) {
                 if (FD_ISSET(s_ctx[i].fd, &readfds)) {
                     *socket_rank = i;
-                    bytes_recv = picoquic_recvmsg(s_ctx[i].fd, addr_from,
-                        addr_dest, dest_if, received_ecn,
-                        buffer, buffer_max);
-
-                    if (bytes_recv <= 0) {
-                        DBG_PRINTF("Could not receive packet on UDP socket[%d]= %d!\n",
-                            i, (int)s_ctx[i].fd);
-                        break;
-                    }
-                    else {
-                        /* Document incoming port */
-                        if (addr_dest->ss_family == AF_INET6) {
-                            ((struct sockaddr_in6*)addr_dest)->sin6_port = htons(s_ctx[i].port);
-                        }
-                        else if (addr_dest->ss_family == AF_INET) {
-                            ((struct sockaddr_in*)addr_dest)->sin_port = htons(s_ctx[i].port);
-                        }
-                        break;
-                    }
+                    break;
                 }
             }
         }
     }
 
+    return ret;
+}
+
+static void picoquic_packet_loop_set_dest_port(struct sockaddr_storage* addr_dest, uint16_t port)
+{
+    if (addr_dest->ss_family == AF_INET6) {
+        ((struct sockaddr_in6*)addr_dest)->sin6_port = htons(port);
+    }
+    else if (addr_dest->ss_family == AF_INET) {
+        ((struct sockaddr_in*)addr_dest)->sin_port = htons(port);
+    }
+}
+
+int picoquic_packet_loop_select(picoquic_socket_ctx_t* s_ctx,
+    int nb_sockets,
+    struct sockaddr_storage* addr_from,
+    struct sockaddr_storage* addr_dest,
+    int* dest_if,
+    unsigned char * received_ecn,
+    uint8_t* buffer, int buffer_max,
+    int64_t delta_t,
+    int * is_wake_up_event,
+    picoquic_network_thread_ctx_t * thread_ctx,
+    int * socket_rank)
+{
+    int bytes_recv = 0;
+
+    if (received_ecn != NULL) {
+        *received_ecn = 0;
+    }
+
+    if (picoquic_packet_loop_select_wait(s_ctx, nb_sockets, delta_t, is_wake_up_event,
+        thread_ctx, socket_rank) != 0) {
+        bytes_recv = -1;
+    }
+    else if (*socket_rank >= 0) {
+        int i = *socket_rank;
+        bytes_recv = picoquic_recvmsg(s_ctx[i].fd, addr_from,
+            addr_dest, dest_if, received_ecn,
+            buffer, buffer_max);
+
+        if (bytes_recv <= 0) {
+            DBG_PRINTF("Could not receive packet on UDP socket[%d]= %d!\n",
+                i, (int)s_ctx[i].fd);
+        }
+        else {
+            /* Document incoming port */
+            picoquic_packet_loop_set_dest_port(addr_dest, s_ctx[i].port);
+        }
+    }
+
     return bytes_recv;
 }
+
+/* Batch version of picoquic_packet_loop_select: after the wait, pull
+ * up to nb_msg messages from the ready socket in a single system call.
+ * Returns the number of messages received, or -1 on error.
+ */
+int picoquic_packet_loop_select_batch(picoquic_socket_ctx_t* s_ctx,
+    int nb_sockets,
+    picoquic_recv_msg_t* recv_msgs,
+    int nb_msg,
+    int64_t delta_t,
+    int* is_wake_up_event,
+    picoquic_network_thread_ctx_t* thread_ctx,
+    int* socket_rank)
+{
+    int nb_recv = 0;
+
+    if (picoquic_packet_loop_select_wait(s_ctx, nb_sockets, delta_t, is_wake_up_event,
+        thread_ctx, socket_rank) != 0) {
+        nb_recv = -1;
+    }
+    else if (*socket_rank >= 0) {
+        int i = *socket_rank;
+        nb_recv = picoquic_recvmmsg(s_ctx[i].fd, recv_msgs, nb_msg);
+
+        if (nb_recv < 0) {
+            DBG_PRINTF("Could not receive packets on UDP socket[%d]= %d!\n",
+                i, (int)s_ctx[i].fd);
+        }
+        else {
+            for (int j = 0; j < nb_recv; j++) {
+                picoquic_packet_loop_set_dest_port(&recv_msgs[j].addr_dest, s_ctx[i].port);
+            }
+        }
+    }
+
+    return nb_recv;
+}
+
+#if defined(__linux__)
+/* Edge triggered epoll waiter, used by default on Linux instead of select().
+ * The sockets and the wake up pipe are registered once, when the loop starts.
+ * Since epoll only reports new arrivals, a socket remains marked ready until
+ * a receive call finds its queue empty, and the loop polls with a zero
+ * timeout as long as some socket is marked ready.
+ */
+#define PICOQUIC_PACKET_LOOP_EPOLL_WAKE_UP 0xffffffff
+
+typedef struct st_picoquic_packet_loop_epoll_t {
+    int epoll_fd;
+    int nb_sockets;
+    int next_rank;
+    int no_pwait2;
+    int is_ready[PICOQUIC_PACKET_LOOP_SOCKETS_MAX];
+} picoquic_packet_loop_epoll_t;
+
+static int picoquic_packet_loop_epoll_init(picoquic_packet_loop_epoll_t* ep,
+    picoquic_socket_ctx_t* s_ctx, int nb_sockets, picoquic_network_thread_ctx_t* thread_ctx)
+{
+    int ret = 0;
+    struct epoll_event ev;
+
+    memset(ep, 0, sizeof(picoquic_packet_loop_epoll_t));
+    if (nb_sockets > PICOQUIC_PACKET_LOOP_SOCKETS_MAX ||
+        (ep->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+        ret = -1;
+    }
+    for (int i = 0; ret == 0 && i < nb_sockets; i++) {
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLET;
+        ev.data.u32 = (uint32_t)i;
+        if (epoll_ctl(ep->epoll_fd, EPOLL_CTL_ADD, s_ctx[i].fd, &ev) != 0) {
+            ret = -1;
+        }
+        /* Packets may have been queued before the registration */
+        ep->is_ready[i] = 1;
+    }
+    if (ret == 0 && thread_ctx->wake_up_defined) {
+        /* The wake up pipe is drained 8 bytes at a time, keep it level triggered */
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.u32 = PICOQUIC_PACKET_LOOP_EPOLL_WAKE_UP;
+        if (epoll_ctl(ep->epoll_fd, EPOLL_CTL_ADD, thread_ctx->wake_up_pipe_fd[0], &ev) != 0) {
+            ret = -1;
+        }
+    }
+    if (ret == 0) {
+        ep->nb_sockets = nb_sockets;
+    }
+    else {
+        DBG_PRINTF("Cannot initialize epoll, errno= %d\n", errno);
+        if (ep->epoll_fd >= 0) {
+            (void)close(ep->epoll_fd);
+        }
+        ep->epoll_fd = -1;
+    }
+    return ret;
+}
+
+static void picoquic_packet_loop_epoll_close(picoquic_packet_loop_epoll_t* ep)
+{
+    if (ep->epoll_fd >= 0) {
+        (void)close(ep->epoll_fd);
+        ep->epoll_fd = -1;
+    }
+}
+
+/* epoll_wait only has a millisecond resolution, which is too coarse for
+ * pacing. Use epoll_pwait2 if the kernel supports it (Linux 5.11+).
+ */
+static int picoquic_packet_loop_epoll_call(picoquic_packet_loop_epoll_t* ep,
+    struct epoll_event* events, int max_events, int64_t delta_t)
+{
+#ifdef SYS_epoll_pwait2
+    if (!ep->no_pwait2) {
+        struct timespec ts;
+        int nb_events;
+
+        ts.tv_sec = (time_t)(delta_t / 1000000);
+        ts.tv_nsec = (long)((delta_t % 1000000) * 1000);
+        nb_events = (int)syscall(SYS_epoll_pwait2, ep->epoll_fd, events, max_events, &ts, NULL, 0);
+        if (nb_events >= 0 || errno != ENOSYS) {
+            return nb_events;
+        }
+        ep->no_pwait2 = 1;
+    }
+#endif
+    /* Round up, so the loop does not wake up before the timer expires */
+    return epoll_wait(ep->epoll_fd, events, max_events, (int)((delta_t + 999) / 1000));
+}
+
+static int picoquic_packet_loop_epoll_wait(picoquic_packet_loop_epoll_t* ep,
+    int nb_sockets,
+    int64_t delta_t,
+    int* is_wake_up_event,
+    picoquic_network_thread_ctx_t* thread_ctx,
+    int* socket_rank)
+{
+    struct epoll_event events[PICOQUIC_PACKET_LOOP_SOCKETS_MAX + 1];
+    int nb_events;
+    int ret = 0;
+
+    *socket_rank = -1;
+    *is_wake_up_event = 0;
+
+    for (int i = 0; i < nb_sockets; i++) {
+        if (ep->is_ready[i]) {
+            /* Only check for the wake up pipe and for new arrivals */
+            delta_t = 0;
+            break;
+        }
+    }
+    if (delta_t < 0) {
+        delta_t = 0;
+    }
+    else if (delta_t > 10000000) {
+        delta_t = 10000000;
+    }
+
+    nb_events = picoquic_packet_loop_epoll_call(ep, events, PICOQUIC_PACKET_LOOP_SOCKETS_MAX + 1, delta_t);
+
+    if (nb_events < 0) {
+        ret = -1;
+        DBG_PRINTF("Error: epoll_wait returns %d, errno= %d\n", nb_events, errno);
+    }
+    else {
+        for (int i = 0; i < nb_events; i++) {
+            if (events[i].data.u32 == PICOQUIC_PACKET_LOOP_EPOLL_WAKE_UP) {
+                /* Something was written on the "wakeup" pipe. Read it. */
+                uint8_t eventbuf[8];
+                int pipe_recv;
+                if ((pipe_recv = read(thread_ctx->wake_up_pipe_fd[0], eventbuf, sizeof(eventbuf))) <= 0) {
+                    ret = -1;
+                    DBG_PRINTF("Error: read pipe returns %d\n", (pipe_recv == 0) ? EPIPE : errno);
+                }
+                else {
+                    *is_wake_up_event = 1;
+                }
+            }
+            else if (events[i].data.u32 < (uint32_t)ep->nb_sockets) {
+                ep->is_ready[events[i].data.u32] = 1;
+            }
+        }
+        if (ret == 0 && !*is_wake_up_event) {
+            /* Serve the ready sockets in round robin order */
+            for (int j = 0; j < nb_sockets; j++) {
+                int i = (ep->next_rank + j) % nb_sockets;
+                if (ep->is_ready[i]) {
+                    *socket_rank = i;
+                    ep->next_rank = (i + 1) % nb_sockets;
+                    break;
+                }
+            }
+        }
+    }
+
+    return ret;
+}
+
+/* Same contract as picoquic_packet_loop_select_batch. The receive does
+ * not block, and clears the ready mark if the socket queue is drained.
+ */
+static int picoquic_packet_loop_epoll_batch(picoquic_packet_loop_epoll_t* ep,
+    picoquic_socket_ctx_t* s_ctx,
+    int nb_sockets,
+    picoquic_recv_msg_t* recv_msgs,
+    int nb_msg,
+    int64_t delta_t,
+    int* is_wake_up_event,
+    picoquic_network_thread_ctx_t* thread_ctx,
+    int* socket_rank)
+{
+    int nb_recv = 0;
+
+    if (picoquic_packet_loop_epoll_wait(ep, nb_sockets, delta_t, is_wake_up_event,
+        thread_ctx, socket_rank) != 0) {
+        nb_recv = -1;
+    }
+    else if (*socket_rank >= 0) {
+        int i = *socket_rank;
+        nb_recv = picoquic_recvmmsg(s_ctx[i].fd, recv_msgs, nb_msg);
+
+        if (nb_recv < nb_msg) {
+            ep->is_ready[i] = 0;
+        }
+        if (nb_recv < 0) {
+            DBG_PRINTF("Could not receive packets on UDP socket[%d]= %d!\n",
+                i, (int)s_ctx[i].fd);
+        }
+        else {
+            for (int j = 0; j < nb_recv; j++) {
+                picoquic_packet_loop_set_dest_port(&recv_msgs[j].addr_dest, s_ctx[i].port);
+            }
+        }
+    }
+
+    return nb_recv;
+}
+
+/* Same contract as picoquic_packet_loop_select */
+static int picoquic_packet_loop_epoll(picoquic_packet_loop_epoll_t* ep,
+    picoquic_socket_ctx_t* s_ctx,
+    int nb_sockets,
+    struct sockaddr_storage* addr_from,
+    struct sockaddr_storage* addr_dest,
+    int* dest_if,
+    unsigned char* received_ecn,
+    uint8_t* buffer, int buffer_max,
+    int64_t delta_t,
+    int* is_wake_up_event,
+    picoquic_network_thread_ctx_t* thread_ctx,
+    int* socket_rank)
+{
+    picoquic_recv_msg_t msg;
+    int bytes_recv = 0;
+    int nb_recv;
+
+    if (received_ecn != NULL) {
+        *received_ecn = 0;
+    }
+    msg.buffer = buffer;
+    msg.buffer_max = (size_t)buffer_max;
+    nb_recv = picoquic_packet_loop_epoll_batch(ep, s_ctx, nb_sockets, &msg, 1, delta_t,
+        is_wake_up_event, thread_ctx, socket_rank);
+    if (nb_recv < 0) {
+        bytes_recv = -1;
+    }
+    else if (nb_recv > 0) {
+        bytes_recv = (int)msg.bytes_recv;
+        picoquic_store_addr(addr_from, (struct sockaddr*)&msg.addr_from);
+        picoquic_store_addr(addr_dest, (struct sockaddr*)&msg.addr_dest);
+        *dest_if = msg.dest_if;
+        if (received_ecn != NULL) {
+            *received_ecn = msg.received_ecn;
+        }
+    }
+
+    return bytes_recv;
+}
+#endif
+#endif
+
+/* Submit a received message to the stack. The message may contain
+ * several datagrams if the OS coalesced them (UDP GRO on Linux,
+ * URO on Windows), in which case coalesced_size is the size of each
+ * segment, except possibly the last one.
+ */
+static int picoquic_packet_loop_submit_message(picoquic_quic_t* quic, picoquic_packet_loop_param_t* param,
+    uint8_t* buffer, size_t length, size_t coalesced_size,
+    struct sockaddr_storage* addr_from, struct sockaddr_storage* addr_to,
+    int if_index, unsigned char received_ecn,
+    picoquic_cnx_t** last_cnx, uint64_t current_time, uint64_t* nb_datagrams)
+{
+    int ret = 0;
+    size_t recv_bytes = 0;
+
+    while (recv_bytes < length && ret == 0) {
+        size_t recv_length = length - recv_bytes;
+
+        if (coalesced_size > 0 && recv_length > coalesced_size) {
+            recv_length = coalesced_size;
+        }
+        if (param->steer_fn == NULL ||
+            !param->steer_fn(param->steer_ctx, buffer + recv_bytes, recv_length, (struct sockaddr*)addr_from,
+                (struct sockaddr*)addr_to, if_index, received_ecn)) {
+            ret = picoquic_incoming_packet_ex(quic, buffer + recv_bytes,
+                recv_length, (struct sockaddr*)addr_from,
+                (struct sockaddr*)addr_to, if_index, received_ecn,
+                last_cnx, current_time);
+        }
+        recv_bytes += recv_length;
+        *nb_datagrams += 1;
+    }
+
+    return ret;
+}
+
+#ifndef _WINDOWS
+/* Submit the messages obtained by a batched receive, splitting the
+ * coalesced messages into datagrams, and passing them to the stack
+ * through the batch API.
+ */
+static int picoquic_packet_loop_submit_batch(picoquic_quic_t* quic, picoquic_packet_loop_param_t* param,
+    picoquic_recv_msg_t* recv_msgs, int nb_recv_msgs,
+    picoquic_cnx_t** last_cnx, uint64_t current_time, uint64_t* nb_datagrams)
+{
+    int ret = 0;
+    picoquic_incoming_datagram_t datagrams[PICOQUIC_INCOMING_BATCH_MAX];
+    size_t nb_batch = 0;
+
+    for (int i = 0; ret == 0 && i < nb_recv_msgs; i++) {
+        size_t recv_bytes = 0;
+
+        while (ret == 0 && recv_bytes < recv_msgs[i].bytes_recv) {
+            size_t recv_length = recv_msgs[i].bytes_recv - recv_bytes;
+
+            if (recv_msgs[i].udp_coalesced_size > 0 && recv_length > recv_msgs[i].udp_coalesced_size) {
+                recv_length = recv_msgs[i].udp_coalesced_size;
+            }
+            *nb_datagrams += 1;
+            if (param->steer_fn != NULL &&
+                param->steer_fn(param->steer_ctx, recv_msgs[i].buffer + recv_bytes, recv_length,
+                    (struct sockaddr*)&recv_msgs[i].addr_from, (struct sockaddr*)&recv_msgs[i].addr_dest,
+                    recv_msgs[i].dest_if, recv_msgs[i].received_ecn)) {
+                recv_bytes += recv_length;
+                continue;
+            }
+            datagrams[nb_batch].bytes = recv_msgs[i].buffer + recv_bytes;
+            datagrams[nb_batch].length = recv_length;
+            datagrams[nb_batch].addr_from = (struct sockaddr*)&recv_msgs[i].addr_from;
+            datagrams[nb_batch].addr_to = (struct sockaddr*)&recv_msgs[i].addr_dest;
+            datagrams[nb_batch].if_index_to = recv_msgs[i].dest_if;
+            datagrams[nb_batch].received_ecn = recv_msgs[i].received_ecn;
+            nb_batch++;
+            recv_bytes += recv_length;
+
+            if (nb_batch >= PICOQUIC_INCOMING_BATCH_MAX) {
+                ret = picoquic_incoming_packets_batch(quic, datagrams, nb_batch, last_cnx, current_time);
+                nb_batch = 0;
+            }
+        }
+    }
+    if (ret == 0 && nb_batch > 0) {
+        ret = picoquic_incoming_packets_batch(quic, datagrams, nb_batch, last_cnx, current_time);
+    }
+
+    return ret;
+}
 #endif
 
 static int monitor_system_call_duration(packet_loop_system_call_duration_t* sc_duration, uint64_t current_time, uint64_t previous_time)
@@ -699,6 +1103,256 @@ static int monitor_system_call_duration(packet_loop_system_call_duration_t* sc_d
 }
 
 
+/* Find the socket used to send a packet. We have multiple sockets, with
+ * support for either IPv6, or IPv4, or both, and binding to a port number.
+ * Find the first socket where:
+ * - the destination AF is supported.
+ * - either the source port is not specified, or it matches the local port.
+ */
+static SOCKET_TYPE picoquic_packet_loop_get_send_socket(picoquic_socket_ctx_t* s_ctx, int nb_sockets_available,
+    struct sockaddr_storage* peer_addr, struct sockaddr_storage* local_addr)
+{
+    SOCKET_TYPE send_socket = INVALID_SOCKET;
+    uint16_t send_port = (peer_addr->ss_family == AF_INET) ?
+        ((struct sockaddr_in*)local_addr)->sin_port :
+        ((struct sockaddr_in6*)local_addr)->sin6_port;
+
+    /* TODO: verify htons/ntohs */
+    for (int i = 0; i < nb_sockets_available; i++) {
+        if (s_ctx[i].af == peer_addr->ss_family) {
+            send_socket = s_ctx[i].fd;
+            if (send_port != 0 && htons(s_ctx[i].port) == send_port)
+                break;
+        }
+    }
+
+    return send_socket;
+}
+
+/* Handling of send errors: log the error, notify the connection if
+ * the destination is unreachable, and retry without GSO if the
+ * interface does not support it.
+ */
+static void picoquic_packet_loop_send_error(picoquic_quic_t* quic, picoquic_cnx_t* last_cnx,
+    picoquic_connection_id_t* log_cid, SOCKET_TYPE send_socket,
+    struct sockaddr_storage* peer_addr, struct sockaddr_storage* local_addr, int if_index,
+    uint8_t* send_buffer, size_t send_length, size_t send_msg_size,
+    int sock_ret, int sock_err, uint64_t current_time, size_t** send_msg_ptr)
+{
+    /* TODO: add a test in which the socket fails. */
+    if (last_cnx == NULL) {
+        picoquic_log_context_free_app_message(quic, log_cid, "Could not send message to AF_to=%d, AF_from=%d, if=%d, ret=%d, err=%d",
+            peer_addr->ss_family, local_addr->ss_family, if_index, sock_ret, sock_err);
+    }
+    else {
+        picoquic_log_app_message(last_cnx, "Could not send message to AF_to=%d, AF_from=%d, if=%d, ret=%d, err=%d",
+            peer_addr->ss_family, local_addr->ss_family, if_index, sock_ret, sock_err);
+
+        if (picoquic_socket_error_implies_unreachable(sock_err)) {
+            picoquic_notify_destination_unreachable(last_cnx, current_time,
+                (struct sockaddr*)peer_addr, (struct sockaddr*)local_addr, if_index,
+                sock_err);
+        }
+        else if (sock_err == EIO) {
+            /* TODO: this is an error encountered if the system supports GSO, but
+             * the specific interface driver does not. Main example is Mininet.
+             * Not sure that we can treat that correctly. Try to minimize the
+             * amount of untested code? Rely on config flag? Rely on error
+             * recovery? */
+            size_t packet_index = 0;
+            size_t packet_size = send_msg_size;
+
+            while (packet_index < send_length) {
+                if (packet_index + packet_size > send_length) {
+                    packet_size = send_length - packet_index;
+                }
+                sock_ret = picoquic_sendmsg(send_socket,
+                    (struct sockaddr*)peer_addr, (struct sockaddr*)local_addr, if_index,
+                    (const char*)(send_buffer + packet_index), (int)packet_size, 0, &sock_err);
+                if (sock_ret > 0) {
+                    packet_index += packet_size;
+                }
+                else {
+                    picoquic_log_app_message(last_cnx, "Retry with packet size=%zu fails at index %zu, ret=%d, err=%d.",
+                        packet_size, packet_index, sock_ret, sock_err);
+                    break;
+                }
+            }
+            if (sock_ret > 0) {
+                picoquic_log_app_message(last_cnx, "Retry of %zu bytes by chunks of %zu bytes succeeds.",
+                    send_length, send_msg_size);
+            }
+            if (*send_msg_ptr != NULL) {
+                /* Make sure that we do not use GSO anymore in this run */
+                *send_msg_ptr = NULL;
+                picoquic_log_app_message(last_cnx, "%s", "UDP GSO was disabled");
+            }
+        }
+    }
+}
+
+/* Batch send. Trains prepared for different connections are queued
+ * in a ring of buffers, and then sent with as few system calls as
+ * possible, using picoquic_sendmmsg for each run of messages sent
+ * through the same socket.
+ */
+typedef struct st_picoquic_packet_loop_send_batch_t {
+    int nb_msgs_max;
+    int nb_msgs;
+    uint8_t* buffers;
+    picoquic_send_msg_t* msgs;
+    SOCKET_TYPE* sockets;
+    picoquic_cnx_t** cnx;
+    picoquic_connection_id_t* log_cid;
+#ifdef PICOQUIC_WITH_IO_URING
+    picoquic_uring_ctx_t* uring;
+    int* sock_err;
+#endif
+} picoquic_packet_loop_send_batch_t;
+
+static int picoquic_packet_loop_batch_init(picoquic_packet_loop_send_batch_t* batch, int nb_msgs_max,
+    size_t buffer_size)
+{
+    int ret = 0;
+
+    memset(batch, 0, sizeof(picoquic_packet_loop_send_batch_t));
+    batch->buffers = (uint8_t*)malloc(nb_msgs_max * buffer_size);
+    batch->msgs = (picoquic_send_msg_t*)malloc(nb_msgs_max * sizeof(picoquic_send_msg_t));
+    batch->sockets = (SOCKET_TYPE*)malloc(nb_msgs_max * sizeof(SOCKET_TYPE));
+    batch->cnx = (picoquic_cnx_t**)malloc(nb_msgs_max * sizeof(picoquic_cnx_t*));
+    batch->log_cid = (picoquic_connection_id_t*)malloc(nb_msgs_max * sizeof(picoquic_connection_id_t));
+    if (batch->buffers == NULL || batch->msgs == NULL || batch->sockets == NULL ||
+        batch->cnx == NULL || batch->log_cid == NULL) {
+        ret = -1;
+    }
+#ifdef PICOQUIC_WITH_IO_URING
+    else if ((batch->sock_err = (int*)malloc(nb_msgs_max * sizeof(int))) == NULL) {
+        ret = -1;
+    }
+#endif
+    else {
+        batch->nb_msgs_max = nb_msgs_max;
+    }
+    return ret;
+}
+
+static void picoquic_packet_loop_batch_release(picoquic_packet_loop_send_batch_t* batch)
+{
+    if (batch->buffers != NULL) {
+        free(batch->buffers);
+    }
+    if (batch->msgs != NULL) {
+        free(batch->msgs);
+    }
+    if (batch->sockets != NULL) {
+        free(batch->sockets);
+    }
+    if (batch->cnx != NULL) {
+        free(batch->cnx);
+    }
+    if (batch->log_cid != NULL) {
+        free(batch->log_cid);
+    }
+#ifdef PICOQUIC_WITH_IO_URING
+    if (batch->sock_err != NULL) {
+        free(batch->sock_err);
+    }
+#endif
+    memset(batch, 0, sizeof(picoquic_packet_loop_send_batch_t));
+}
+
+static int picoquic_packet_loop_batch_has_cnx(picoquic_packet_loop_send_batch_t* batch, picoquic_cnx_t* cnx)
+{
+    for (int i = 0; i < batch->nb_msgs; i++) {
+        if (batch->cnx[i] == cnx) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void picoquic_packet_loop_batch_add(picoquic_packet_loop_send_batch_t* batch, SOCKET_TYPE send_socket,
+    uint8_t* bytes, size_t length, size_t send_msg_size, uint64_t txtime,
+    struct sockaddr_storage* peer_addr, struct sockaddr_storage* local_addr, int if_index,
+    picoquic_cnx_t* last_cnx, picoquic_connection_id_t* log_cid)
+{
+    picoquic_send_msg_t* msg = &batch->msgs[batch->nb_msgs];
+
+    msg->bytes = bytes;
+    msg->length = length;
+    msg->send_msg_size = send_msg_size;
+    msg->txtime = txtime;
+    picoquic_store_addr(&msg->addr_dest, (struct sockaddr*)peer_addr);
+    picoquic_store_addr(&msg->addr_from, (struct sockaddr*)local_addr);
+    msg->dest_if = if_index;
+    batch->sockets[batch->nb_msgs] = send_socket;
+    batch->cnx[batch->nb_msgs] = last_cnx;
+    batch->log_cid[batch->nb_msgs] = *log_cid;
+    batch->nb_msgs++;
+}
+
+static int picoquic_packet_loop_flush_batch(picoquic_quic_t* quic, picoquic_packet_loop_send_batch_t* batch,
+    packet_loop_after_send_arg_t* send_arg, uint64_t current_time, size_t** send_msg_ptr)
+{
+    int msg_index = 0;
+
+#ifdef PICOQUIC_WITH_IO_URING
+    if (batch->uring != NULL) {
+        /* Submit the whole batch as a single io_uring enter, whatever the sockets */
+        int nb_sent = picoquic_uring_send(batch->uring, batch->sockets, batch->msgs, batch->nb_msgs, batch->sock_err);
+
+        if (nb_sent >= 0) {
+            send_arg->nb_send_calls++;
+            send_arg->nb_send_messages += nb_sent;
+            for (int i = 0; i < batch->nb_msgs; i++) {
+                if (batch->sock_err[i] != 0) {
+                    picoquic_send_msg_t* msg = &batch->msgs[i];
+
+                    picoquic_packet_loop_send_error(quic, batch->cnx[i], &batch->log_cid[i],
+                        batch->sockets[i], &msg->addr_dest, &msg->addr_from, msg->dest_if,
+                        (uint8_t*)msg->bytes, msg->length, msg->send_msg_size, -1, batch->sock_err[i],
+                        current_time, send_msg_ptr);
+                }
+            }
+            batch->nb_msgs = 0;
+            return 0;
+        }
+        /* If the ring cannot be entered, fall back to sendmmsg */
+    }
+#endif
+
+    while (msg_index < batch->nb_msgs) {
+        int nb_run = 1;
+        int nb_sent;
+        int sock_err = 0;
+
+        while (msg_index + nb_run < batch->nb_msgs &&
+            batch->sockets[msg_index + nb_run] == batch->sockets[msg_index]) {
+            nb_run++;
+        }
+        nb_sent = picoquic_sendmmsg(batch->sockets[msg_index], &batch->msgs[msg_index], nb_run, &sock_err);
+        send_arg->nb_send_calls++;
+        if (nb_sent > 0) {
+            /* A partial send is not an error. The remaining messages of the run
+             * are sent by the next call, which reports its own error if any. */
+            send_arg->nb_send_messages += nb_sent;
+            msg_index += nb_sent;
+        }
+        else {
+            /* The message at msg_index failed. Handle the error, then continue with the next one. */
+            picoquic_send_msg_t* msg = &batch->msgs[msg_index];
+
+            picoquic_packet_loop_send_error(quic, batch->cnx[msg_index], &batch->log_cid[msg_index],
+                batch->sockets[msg_index], &msg->addr_dest, &msg->addr_from, msg->dest_if,
+                (uint8_t*)msg->bytes, msg->length, msg->send_msg_size, -1, sock_err, current_time, send_msg_ptr);
+            msg_index++;
+        }
+    }
+    batch->nb_msgs = 0;
+
+    return 0;
+}
+
 #ifdef _WINDOWS
     DWORD WINAPI picoquic_packet_loop_v3(LPVOID v_ctx)
 #else
@@ -718,8 +1372,20 @@ void* picoquic_packet_loop_v3(void* v_ctx)
     int if_index_to;
 #ifndef _WINDOWS
     uint8_t buffer[1536];
+    picoquic_recv_msg_t* recv_msgs = NULL;
+    uint8_t* recv_msgs_buffer = NULL;
+    int nb_recv_msgs_max = 0;
+    int nb_recv_msgs = 0;
+#endif
+#ifdef PICOQUIC_WITH_IO_URING
+    picoquic_uring_ctx_t* uring_ctx = NULL;
+#endif
+#if defined(__linux__)
+    picoquic_packet_loop_epoll_t epoll_ctx = { 0 };
 #endif
     uint8_t* send_buffer = NULL;
+    picoquic_packet_loop_send_batch_t send_batch = { 0 };
+    size_t send_packets_max = PICOQUIC_PACKET_LOOP_SEND_MAX;
     size_t send_length = 0;
     size_t send_msg_size = 0;
     size_t send_buffer_size = param->socket_buffer_size;
@@ -734,6 +1400,7 @@ void* picoquic_packet_loop_v3(void* v_ctx)
     unsigned int nb_loop_immediate = 0;
     picoquic_packet_loop_options_t options = { 0 };
     packet_loop_system_call_duration_t sc_duration = { 0 };
+    int use_txtime = 0;
 
     int is_wake_up_event;
 #ifdef _WINDOWS
@@ -750,6 +1417,9 @@ void* picoquic_packet_loop_v3(void* v_ctx)
     }
 
     memset(s_ctx, 0, sizeof(s_ctx));
+    for (int i = 0; i < (int)(sizeof(s_ctx) / sizeof(picoquic_socket_ctx_t)); i++) {
+        s_ctx[i].reuse_port = (param->reuse_port) ? 1 : 0;
+    }
     if ((nb_sockets = picoquic_packet_loop_open_sockets(param->local_port,
         param->local_af, param->socket_buffer_size,
         param->extra_socket_required, param->do_not_use_gso, s_ctx)) <= 0) {
@@ -780,6 +1450,106 @@ void* picoquic_packet_loop_v3(void* v_ctx)
             ret = -1;
         }
     }
+    if (ret == 0 && param->pacing_offload_horizon > 0) {
+        /* Offload pacing only if all sockets accept departure times */
+        use_txtime = 1;
+        for (int i = 0; use_txtime && i < nb_sockets; i++) {
+            if (picoquic_socket_set_txtime(s_ctx[i].fd) != 0) {
+                use_txtime = 0;
+            }
+        }
+        if (use_txtime) {
+            picoquic_set_pacing_offload(quic, param->pacing_offload_horizon);
+        }
+    }
+#ifdef PICOQUIC_WITH_IO_URING
+    if (ret == 0 && !param->do_not_use_io_uring) {
+        /* If the ring cannot be created, the loop falls back to select() */
+        uring_ctx = picoquic_uring_create(s_ctx, nb_sockets,
+            (thread_ctx->wake_up_defined) ? thread_ctx->wake_up_pipe_fd[0] : -1);
+        param->is_io_uring_used = (uring_ctx != NULL);
+    }
+#endif
+#if defined(__linux__)
+    epoll_ctx.epoll_fd = -1;
+    if (ret == 0 && !param->do_not_use_epoll
+#ifdef PICOQUIC_WITH_IO_URING
+        && uring_ctx == NULL
+#endif
+        ) {
+        /* If epoll cannot be initialized, the loop falls back to select() */
+        (void)picoquic_packet_loop_epoll_init(&epoll_ctx, s_ctx, nb_sockets, thread_ctx);
+    }
+#endif
+    if (ret == 0) {
+        int send_batch_size = param->send_batch_size;
+#ifdef PICOQUIC_WITH_IO_URING
+        if (uring_ctx != NULL && send_batch_size == 0) {
+            send_batch_size = PICOQUIC_PACKET_LOOP_SEND_MAX;
+        }
+#endif
+        if (send_batch_size > 0) {
+            /* Batch send: one buffer per queued train. The loop may send up to
+             * one batch of trains per iteration. */
+            int nb_send_msgs_max = (send_batch_size > PICOQUIC_SENDMMSG_MAX) ?
+                PICOQUIC_SENDMMSG_MAX : send_batch_size;
+
+            ret = picoquic_packet_loop_batch_init(&send_batch, nb_send_msgs_max, send_buffer_size);
+            if (send_packets_max < (size_t)nb_send_msgs_max) {
+                send_packets_max = (size_t)nb_send_msgs_max;
+            }
+#ifdef PICOQUIC_WITH_IO_URING
+            send_batch.uring = uring_ctx;
+#endif
+        }
+    }
+#ifdef PICOQUIC_WITH_IO_URING
+    if (ret == 0 && uring_ctx != NULL) {
+        /* The received messages point into the buffers of the ring,
+         * only the array of message descriptors is needed. */
+        nb_recv_msgs_max = (param->recv_batch_size <= 0) ? PICOQUIC_RECVMMSG_MAX :
+            ((param->recv_batch_size > PICOQUIC_RECVMMSG_MAX) ? PICOQUIC_RECVMMSG_MAX : param->recv_batch_size);
+        recv_msgs = (picoquic_recv_msg_t*)malloc(nb_recv_msgs_max * sizeof(picoquic_recv_msg_t));
+        if (recv_msgs == NULL) {
+            ret = -1;
+        }
+        else {
+            memset(recv_msgs, 0, nb_recv_msgs_max * sizeof(picoquic_recv_msg_t));
+        }
+    }
+    else
+#endif
+#ifndef _WINDOWS
+    if (ret == 0 && param->recv_batch_size > 0) {
+        /* Batch receive: allocate one buffer per message. If UDP GRO is
+         * enabled, each buffer must be large enough for a coalesced train.
+         */
+        size_t recv_msg_size = PICOQUIC_MAX_PACKET_SIZE;
+
+        nb_recv_msgs_max = (param->recv_batch_size > PICOQUIC_RECVMMSG_MAX) ?
+            PICOQUIC_RECVMMSG_MAX : param->recv_batch_size;
+        if (!param->do_not_use_gso) {
+            for (int i = 0; i < nb_sockets; i++) {
+                if (picoquic_socket_set_udp_gro(s_ctx[i].fd) == 0) {
+                    s_ctx[i].supports_udp_recv_coalesced = 1;
+                    recv_msg_size = 0x10000;
+                }
+            }
+        }
+        recv_msgs = (picoquic_recv_msg_t*)malloc(nb_recv_msgs_max * sizeof(picoquic_recv_msg_t));
+        recv_msgs_buffer = (uint8_t*)malloc(nb_recv_msgs_max * recv_msg_size);
+        if (recv_msgs == NULL || recv_msgs_buffer == NULL) {
+            ret = -1;
+        }
+        else {
+            memset(recv_msgs, 0, nb_recv_msgs_max * sizeof(picoquic_recv_msg_t));
+            for (int i = 0; i < nb_recv_msgs_max; i++) {
+                recv_msgs[i].buffer = recv_msgs_buffer + i * recv_msg_size;
+                recv_msgs[i].buffer_max = recv_msg_size;
+            }
+        }
+    }
+#endif
 
     if (ret == 0) {
         thread_ctx->thread_is_ready = 1;
@@ -837,11 +1607,48 @@ void* picoquic_packet_loop_v3(void* v_ctx)
             &addr_from, &addr_to, &if_index_to, &received_ecn, &received_buffer,
             delta_t, &is_wake_up_event, thread_ctx, &socket_rank);
 #else
-        bytes_recv = picoquic_packet_loop_select(s_ctx, nb_sockets_available,
-            &addr_from,
-            &addr_to, &if_index_to, &received_ecn,
-            buffer, sizeof(buffer),
-            delta_t, &is_wake_up_event, thread_ctx, &socket_rank);
+        if (recv_msgs != NULL) {
+#ifdef PICOQUIC_WITH_IO_URING
+            if (uring_ctx != NULL) {
+                nb_recv_msgs = picoquic_uring_wait(uring_ctx, nb_sockets_available,
+                    recv_msgs, nb_recv_msgs_max, delta_t, &is_wake_up_event);
+            }
+            else
+#endif
+#if defined(__linux__)
+            if (epoll_ctx.epoll_fd >= 0) {
+                nb_recv_msgs = picoquic_packet_loop_epoll_batch(&epoll_ctx, s_ctx, nb_sockets_available,
+                    recv_msgs, nb_recv_msgs_max,
+                    delta_t, &is_wake_up_event, thread_ctx, &socket_rank);
+            }
+            else
+#endif
+            {
+                nb_recv_msgs = picoquic_packet_loop_select_batch(s_ctx, nb_sockets_available,
+                    recv_msgs, nb_recv_msgs_max,
+                    delta_t, &is_wake_up_event, thread_ctx, &socket_rank);
+            }
+            bytes_recv = (nb_recv_msgs < 0) ? -1 : 0;
+            for (int i = 0; i < nb_recv_msgs; i++) {
+                bytes_recv += (int)recv_msgs[i].bytes_recv;
+            }
+        }
+#if defined(__linux__)
+        else if (epoll_ctx.epoll_fd >= 0) {
+            bytes_recv = picoquic_packet_loop_epoll(&epoll_ctx, s_ctx, nb_sockets_available,
+                &addr_from,
+                &addr_to, &if_index_to, &received_ecn,
+                buffer, sizeof(buffer),
+                delta_t, &is_wake_up_event, thread_ctx, &socket_rank);
+        }
+#endif
+        else {
+            bytes_recv = picoquic_packet_loop_select(s_ctx, nb_sockets_available,
+                &addr_from,
+                &addr_to, &if_index_to, &received_ecn,
+                buffer, sizeof(buffer),
+                delta_t, &is_wake_up_event, thread_ctx, &socket_rank);
+        }
         received_buffer = buffer;
 #endif
         current_time = picoquic_current_time();
@@ -862,35 +1669,39 @@ void* picoquic_packet_loop_v3(void* v_ctx)
             uint64_t loop_time = current_time;
             size_t bytes_sent = 0;
             size_t nb_packets_sent = 0;
+            packet_loop_after_send_arg_t after_send_arg = { 0 };
+
+            /* Waits may also end without data because of spurious socket events,
+             * or of send completions with io_uring. Only count the waits that
+             * lasted until the timer expired. */
+            if (bytes_recv == 0 && delta_t > 0 && current_time >= previous_time + (uint64_t)delta_t) {
+                param->nb_timer_wakeups++;
+            }
 
             if (bytes_recv > 0) {
+                uint64_t nb_datagrams = 0;
 #ifdef _WINDOWS
-                size_t recv_bytes = 0;
-                while (recv_bytes < (size_t)bytes_recv && ret == 0) {
-                    size_t recv_length = (size_t)(bytes_recv - recv_bytes);
-
-                    if (s_ctx[socket_rank].udp_coalesced_size > 0 &&
-                        recv_length > s_ctx[socket_rank].udp_coalesced_size) {
-                        recv_length = s_ctx[socket_rank].udp_coalesced_size;
-                    }
-                    /* Submit the packet to the client */
-                    ret = picoquic_incoming_packet_ex(quic, s_ctx[socket_rank].recv_buffer + recv_bytes,
-                        recv_length, (struct sockaddr*)&addr_from,
-                        (struct sockaddr*)&addr_to,
-                        s_ctx[socket_rank].dest_if,
-                        s_ctx[socket_rank].received_ecn, &last_cnx, current_time);
-                    recv_bytes += recv_length;
-                }
+                ret = picoquic_packet_loop_submit_message(quic, param, s_ctx[socket_rank].recv_buffer,
+                    (size_t)bytes_recv, s_ctx[socket_rank].udp_coalesced_size, &addr_from, &addr_to,
+                    s_ctx[socket_rank].dest_if, s_ctx[socket_rank].received_ecn,
+                    &last_cnx, current_time, &nb_datagrams);
                 if (ret == 0) {
                     ret = picoquic_win_recvmsg_async_start(&s_ctx[socket_rank]);
                 }
 #else
-                /* Submit the packet to the server */
-                ret = picoquic_incoming_packet_ex(quic, received_buffer,
-                    (size_t)bytes_recv, (struct sockaddr*)&addr_from,
-                    (struct sockaddr*)&addr_to, if_index_to, received_ecn,
-                    &last_cnx, current_time);
+                if (recv_msgs != NULL) {
+                    ret = picoquic_packet_loop_submit_batch(quic, param, recv_msgs, nb_recv_msgs,
+                        &last_cnx, current_time, &nb_datagrams);
+                }
+                else {
+                    /* Submit the packet to the server */
+                    ret = picoquic_packet_loop_submit_message(quic, param, received_buffer,
+                        (size_t)bytes_recv, 0, &addr_from, &addr_to,
+                        if_index_to, received_ecn, &last_cnx, current_time, &nb_datagrams);
+                }
 #endif
+                param->nb_recv_calls++;
+                param->nb_recv_datagrams += nb_datagrams;
 
 
                 if (loop_callback != NULL) {
@@ -929,19 +1740,38 @@ void* picoquic_packet_loop_v3(void* v_ctx)
             * packets may be adding in the receive queue.
              */
 
-            while (ret == 0 && nb_packets_sent < PICOQUIC_PACKET_LOOP_SEND_MAX) {
+            while (ret == 0 && nb_packets_sent < send_packets_max) {
                 struct sockaddr_storage peer_addr;
                 struct sockaddr_storage local_addr = { 0 };
                 int if_index = param->dest_if;
                 int sock_ret = 0;
                 int sock_err = 0;
+                uint8_t* packet_buffer = send_buffer;
+
+                if (send_batch.nb_msgs_max > 0) {
+                    /* A batch holds at most one train per connection, and the connection
+                     * contexts must remain valid until the batch is flushed. Flush
+                     * before preparing a second train for the same connection. */
+                    picoquic_cnx_t* next_cnx = picoquic_get_earliest_cnx_to_wake(quic, loop_time);
+
+                    if (send_batch.nb_msgs >= send_batch.nb_msgs_max ||
+                        (next_cnx != NULL && picoquic_packet_loop_batch_has_cnx(&send_batch, next_cnx))) {
+                        ret = picoquic_packet_loop_flush_batch(quic, &send_batch, &after_send_arg,
+                            current_time, &send_msg_ptr);
+                    }
+                    packet_buffer = send_batch.buffers + send_batch.nb_msgs * send_buffer_size;
+                }
 
-                ret = picoquic_prepare_next_packet_ex(quic, loop_time,
-                    send_buffer, send_buffer_size, &send_length,
-                    &peer_addr, &local_addr, &if_index, &log_cid, &last_cnx,
-                    send_msg_ptr);
+                if (ret == 0) {
+                    ret = picoquic_prepare_next_packet_ex(quic, loop_time,
+                        packet_buffer, send_buffer_size, &send_length,
+                        &peer_addr, &local_addr, &if_index, &log_cid, &last_cnx,
+                        send_msg_ptr);
+                }
 
                 if (ret == 0 && send_length > 0) {
+                    SOCKET_TYPE send_socket;
+                    uint64_t txtime = 0;
                     /* If send_msg_size is defined, sendmsg may send more than one packet.
                      * We compute that to update the number of packets sent in the loop.
                      */
@@ -950,25 +1780,20 @@ void* picoquic_packet_loop_v3(void* v_ctx)
                     if (send_length > param->send_length_max) {
                         param->send_length_max = send_length;
                     }
-                    /* We have multiple sockets, with support for
-                    * either IPv6, or IPv4, or both, and binding to a port number.
-                    * Find the first socket where:
-                    * - the destination AF is supported.
-                    * - either the source port is not specified, or it matches the local port.
-                    */
-                    SOCKET_TYPE send_socket = INVALID_SOCKET;
-                    uint16_t send_port = (peer_addr.ss_family == AF_INET) ?
-                        ((struct sockaddr_in*)&local_addr)->sin_port :
-                        ((struct sockaddr_in6*)&local_addr)->sin6_port;
-
                     bytes_sent += send_length;
 
-                    /* TODO: verify htons/ntohs */
-                    for (int i = 0; i < nb_sockets_available; i++) {
-                        if (s_ctx[i].af == peer_addr.ss_family) {
-                            send_socket = s_ctx[i].fd;
-                            if (send_port != 0 && htons(s_ctx[i].port) == send_port)
-                                break;
+                    send_socket = picoquic_packet_loop_get_send_socket(s_ctx, nb_sockets_available,
+                        &peer_addr, &local_addr);
+
+                    if (use_txtime) {
+                        /* Trains prepared ahead of their departure time are delayed by the kernel.
+                         * The sender ends a train before packets paced a packet interval later
+                         * than the first one, so a single departure time per message is enough. */
+                        uint64_t departure_time = picoquic_get_train_departure_time(quic);
+
+                        if (departure_time > loop_time) {
+                            txtime = picoquic_socks_txtime(departure_time - loop_time);
+                            param->nb_txtime_messages++;
                         }
                     }
 
@@ -982,63 +1807,25 @@ void* picoquic_packet_loop_v3(void* v_ctx)
                         sock_err = EIO;
                         param->simulate_eio = 0;
                     }
+                    else if (send_batch.nb_msgs_max > 0) {
+                        /* Queue the train, it will be sent when the batch is flushed */
+                        picoquic_packet_loop_batch_add(&send_batch, send_socket, packet_buffer, send_length,
+                            (send_msg_ptr == NULL) ? 0 : send_msg_size, txtime, &peer_addr, &local_addr, if_index,
+                            last_cnx, &log_cid);
+                        sock_ret = (int)send_length;
+                    }
                     else {
-                        sock_ret = picoquic_sendmsg(send_socket,
+                        sock_ret = picoquic_sendmsg_ex(send_socket,
                             (struct sockaddr*)&peer_addr, (struct sockaddr*)&local_addr, if_index,
-                            (const char*)send_buffer, (int)send_length, (int)send_msg_size, &sock_err);
+                            (const char*)send_buffer, (int)send_length, (int)send_msg_size, txtime, &sock_err);
+                        after_send_arg.nb_send_calls++;
+                        after_send_arg.nb_send_messages++;
                     }
 
                     if (sock_ret <= 0) {
-                        /* TODO: add a test in which the socket fails. */
-                        if (last_cnx == NULL) {
-                            picoquic_log_context_free_app_message(quic, &log_cid, "Could not send message to AF_to=%d, AF_from=%d, if=%d, ret=%d, err=%d",
-                                peer_addr.ss_family, local_addr.ss_family, if_index, sock_ret, sock_err);
-                        }
-                        else {
-                            picoquic_log_app_message(last_cnx, "Could not send message to AF_to=%d, AF_from=%d, if=%d, ret=%d, err=%d",
-                                peer_addr.ss_family, local_addr.ss_family, if_index, sock_ret, sock_err);
-
-                            if (picoquic_socket_error_implies_unreachable(sock_err)) {
-                                picoquic_notify_destination_unreachable(last_cnx, current_time,
-                                    (struct sockaddr*)&peer_addr, (struct sockaddr*)&local_addr, if_index,
-                                    sock_err);
-                            }
-                            else if (sock_err == EIO) {
-                                /* TODO: this is an error encountered if the system supports GSO, but
-                                 * the specific interface driver does not. Main example is Mininet.
-                                 * Not sure that we can treat that correctly. Try to minimize the
-                                 * amount of untested code? Rely on config flag? Rely on error
-                                 * recovery? */
-                                size_t packet_index = 0;
-                                size_t packet_size = send_msg_size;
-
-                                while (packet_index < send_length) {
-                                    if (packet_index + packet_size > send_length) {
-                                        packet_size = send_length - packet_index;
-                                    }
-                                    sock_ret = picoquic_sendmsg(send_socket,
-                                        (struct sockaddr*)&peer_addr, (struct sockaddr*)&local_addr, if_index,
-                                        (const char*)(send_buffer + packet_index), (int)packet_size, 0, &sock_err);
-                                    if (sock_ret > 0) {
-                                        packet_index += packet_size;
-                                    }
-                                    else {
-                                        picoquic_log_app_message(last_cnx, "Retry with packet size=%zu fails at index %zu, ret=%d, err=%d.",
-                                            packet_size, packet_index, sock_ret, sock_err);
-                                        break;
-                                    }
-                                }
-                                if (sock_ret > 0) {
-                                    picoquic_log_app_message(last_cnx, "Retry of %zu bytes by chunks of %zu bytes succeeds.",
-                                        send_length, send_msg_size);
-                                }
-                                if (send_msg_ptr != NULL) {
-                                    /* Make sure that we do not use GSO anymore in this run */
-                                    send_msg_ptr = NULL;
-                                    picoquic_log_app_message(last_cnx, "%s", "UDP GSO was disabled");
-                                }
-                            }
-                        }
+                        picoquic_packet_loop_send_error(quic, last_cnx, &log_cid, send_socket,
+                            &peer_addr, &local_addr, if_index, packet_buffer, send_length, send_msg_size,
+                            sock_ret, sock_err, current_time, &send_msg_ptr);
                     }
                 }
                 else {
@@ -1046,19 +1833,51 @@ void* picoquic_packet_loop_v3(void* v_ctx)
                 }
             }
 
+            if (send_batch.nb_msgs > 0) {
+                int flush_ret = picoquic_packet_loop_flush_batch(quic, &send_batch, &after_send_arg,
+                    current_time, &send_msg_ptr);
+                if (ret == 0) {
+                    ret = flush_ret;
+                }
+            }
+
+            param->nb_send_calls += after_send_arg.nb_send_calls;
+            param->nb_send_messages += after_send_arg.nb_send_messages;
+
             if (ret == 0 && loop_callback != NULL) {
-                ret = loop_callback(quic, picoquic_packet_loop_after_send, loop_callback_ctx, &bytes_sent);
+                if (options.do_after_send_stats) {
+                    after_send_arg.bytes_sent = bytes_sent;
+                    after_send_arg.nb_syscalls_saved = after_send_arg.nb_send_messages - after_send_arg.nb_send_calls;
+                    ret = loop_callback(quic, picoquic_packet_loop_after_send, loop_callback_ctx, &after_send_arg);
+                }
+                else {
+                    ret = loop_callback(quic, picoquic_packet_loop_after_send, loop_callback_ctx, &bytes_sent);
+                }
             }
         }
     }
 
     thread_ctx->thread_is_ready = 0;
 
+    if (use_txtime) {
+        /* Packets sent outside of the loop will not have departure times */
+        picoquic_set_pacing_offload(quic, 0);
+    }
+
     if (ret == PICOQUIC_NO_ERROR_TERMINATE_PACKET_LOOP) {
         /* Normal termination requested by the application, returns no error */
         ret = 0;
     }
 
+#ifdef PICOQUIC_WITH_IO_URING
+    /* Cancel the pending operations before closing the sockets */
+    if (uring_ctx != NULL) {
+        picoquic_uring_delete(uring_ctx);
+    }
+#endif
+#if defined(__linux__)
+    picoquic_packet_loop_epoll_close(&epoll_ctx);
+#endif
     /* Close the sockets */
     for (int i = 0; i < nb_sockets; i++) {
         picoquic_packet_loop_close_socket(&s_ctx[i]);
@@ -1067,6 +1886,15 @@ void* picoquic_packet_loop_v3(void* v_ctx)
     if (send_buffer != NULL) {
         free(send_buffer);
     }
+    picoquic_packet_loop_batch_release(&send_batch);
+#ifndef _WINDOWS
+    if (recv_msgs != NULL) {
+        free(recv_msgs);
+    }
+    if (recv_msgs_buffer != NULL) {
+        free(recv_msgs_buffer);
+    }
+#endif
     thread_ctx->return_code = ret;
 #ifdef _WINDOWS
     return (DWORD)ret;
@@ -0,0 +1,691 @@
+/*
+* Copyright (c) 2026, the picoquic contributors.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* io_uring backend of the socket loop.
+ *
+ * The backend uses the raw system calls defined in <linux/io_uring.h>,
+ * so that it does not depend on liburing. It requires a kernel that
+ * supports provided buffer rings and multishot recvmsg (Linux 6.0 or
+ * later). If the ring cannot be set up, picoquic_uring_create returns
+ * NULL and the packet loop uses select() instead.
+ *
+ * The completion queue is shared by the receive, wake up, timeout and
+ * send operations. When waiting for send completions, the receive
+ * completions found in the queue are moved to a "stash", and processed
+ * by the next wait.
+ */
+
+#if defined(__linux__) && defined(PICOQUIC_WITH_IO_URING)
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "picosocks.h"
+#include "picoquic_utils.h"
+#include "picoquic_packet_loop.h"
+#include "picoquic_uring.h"
+
+#define PICOQUIC_URING_ENTRIES 256
+#define PICOQUIC_URING_NB_BUFFERS 256
+#define PICOQUIC_URING_BUFFER_GROUP 0
+#define PICOQUIC_URING_STASH_MAX (2*PICOQUIC_URING_ENTRIES)
+
+/* The operation type is encoded in the high order bits of the user data,
+ * the socket rank or message index in the low order bits. */
+#define PICOQUIC_URING_OP_RECV 1
+#define PICOQUIC_URING_OP_WAKE 2
+#define PICOQUIC_URING_OP_TIMEOUT 3
+#define PICOQUIC_URING_OP_SEND 4
+#define PICOQUIC_URING_USER_DATA(op, index) ((((uint64_t)(op)) << 32) | (uint64_t)(index))
+#define PICOQUIC_URING_USER_OP(user_data) ((int)((user_data) >> 32))
+#define PICOQUIC_URING_USER_INDEX(user_data) ((int)((user_data) & 0xffffffff))
+
+typedef struct st_picoquic_uring_cqe_t {
+    uint64_t user_data;
+    int32_t res;
+    uint32_t flags;
+} picoquic_uring_cqe_t;
+
+struct st_picoquic_uring_ctx_t {
+    int ring_fd;
+    /* Submission queue */
+    void* sq_ring_ptr;
+    size_t sq_ring_size;
+    unsigned int* sq_head;
+    unsigned int* sq_tail;
+    unsigned int* sq_mask;
+    unsigned int* sq_array;
+    struct io_uring_sqe* sqes;
+    size_t sqes_size;
+    unsigned int nb_to_submit;
+    /* Completion queue */
+    void* cq_ring_ptr;
+    size_t cq_ring_size;
+    unsigned int* cq_head;
+    unsigned int* cq_tail;
+    unsigned int* cq_mask;
+    struct io_uring_cqe* cqes;
+    /* Completions set aside while waiting for sends */
+    picoquic_uring_cqe_t stash[PICOQUIC_URING_STASH_MAX];
+    int nb_stash;
+    int stash_index;
+    /* Provided buffer ring */
+    struct io_uring_buf_ring* buf_ring;
+    size_t buf_ring_size;
+    uint8_t* buffers;
+    size_t buffer_size;
+    uint16_t recycle[PICOQUIC_URING_NB_BUFFERS];
+    int nb_recycle;
+    /* Receive operations, one per socket */
+    picoquic_socket_ctx_t* s_ctx;
+    int nb_sockets;
+    struct msghdr recv_msghdr[PICOQUIC_PACKET_LOOP_SOCKETS_MAX];
+    int recv_armed[PICOQUIC_PACKET_LOOP_SOCKETS_MAX];
+    /* Wake up */
+    int wake_up_fd;
+    int wake_up_armed;
+    /* Timeout */
+    struct __kernel_timespec timeout_ts;
+    /* Send operations */
+    struct msghdr send_msghdr[PICOQUIC_SENDMMSG_MAX];
+    struct iovec send_iov[PICOQUIC_SENDMMSG_MAX];
+};
+
+static int picoquic_uring_setup(unsigned int entries, struct io_uring_params* p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int picoquic_uring_enter(int ring_fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags)
+{
+    return (int)syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int picoquic_uring_register(int ring_fd, unsigned int opcode, void* arg, unsigned int nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args);
+}
+
+/* Get a free submission entry, submitting the pending ones if the queue is full. */
+static struct io_uring_sqe* picoquic_uring_get_sqe(picoquic_uring_ctx_t* ctx)
+{
+    struct io_uring_sqe* sqe = NULL;
+    unsigned int head = __atomic_load_n(ctx->sq_head, __ATOMIC_ACQUIRE);
+    unsigned int tail = *ctx->sq_tail;
+
+    if (tail - head > *ctx->sq_mask) {
+        if (picoquic_uring_enter(ctx->ring_fd, ctx->nb_to_submit, 0, 0) >= 0) {
+            ctx->nb_to_submit = 0;
+            head = __atomic_load_n(ctx->sq_head, __ATOMIC_ACQUIRE);
+        }
+    }
+    if (tail - head <= *ctx->sq_mask) {
+        unsigned int index = tail & *ctx->sq_mask;
+        sqe = &ctx->sqes[index];
+        memset(sqe, 0, sizeof(struct io_uring_sqe));
+        ctx->sq_array[index] = index;
+        __atomic_store_n(ctx->sq_tail, tail + 1, __ATOMIC_RELEASE);
+        ctx->nb_to_submit++;
+    }
+    return sqe;
+}
+
+static int picoquic_uring_submit(picoquic_uring_ctx_t* ctx, unsigned int min_complete)
+{
+    int ret = picoquic_uring_enter(ctx->ring_fd, ctx->nb_to_submit, min_complete,
+        (min_complete > 0) ? IORING_ENTER_GETEVENTS : 0);
+
+    if (ret >= 0) {
+        ctx->nb_to_submit -= (ret > (int)ctx->nb_to_submit) ? ctx->nb_to_submit : (unsigned int)ret;
+        ret = 0;
+    }
+    else if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+        ret = 0;
+    }
+    return ret;
+}
+
+static int picoquic_uring_arm_recv(picoquic_uring_ctx_t* ctx, int rank)
+{
+    int ret = -1;
+    struct io_uring_sqe* sqe = picoquic_uring_get_sqe(ctx);
+
+    if (sqe != NULL) {
+        sqe->opcode = IORING_OP_RECVMSG;
+        sqe->fd = ctx->s_ctx[rank].fd;
+        sqe->addr = (uint64_t)(uintptr_t)&ctx->recv_msghdr[rank];
+        sqe->len = 1;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = PICOQUIC_URING_BUFFER_GROUP;
+        sqe->user_data = PICOQUIC_URING_USER_DATA(PICOQUIC_URING_OP_RECV, rank);
+        ctx->recv_armed[rank] = 1;
+        ret = 0;
+    }
+    return ret;
+}
+
+static int picoquic_uring_arm_wake_up(picoquic_uring_ctx_t* ctx)
+{
+    int ret = -1;
+    struct io_uring_sqe* sqe = picoquic_uring_get_sqe(ctx);
+
+    if (sqe != NULL) {
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = ctx->wake_up_fd;
+        sqe->len = IORING_POLL_ADD_MULTI;
+        sqe->poll32_events = POLLIN;
+        sqe->user_data = PICOQUIC_URING_USER_DATA(PICOQUIC_URING_OP_WAKE, 0);
+        ctx->wake_up_armed = 1;
+        ret = 0;
+    }
+    return ret;
+}
+
+/* The timeout completes either after delta_t, or as soon as one other
+ * completion is posted, so there is at most one pending timeout when
+ * waiting. */
+static int picoquic_uring_arm_timeout(picoquic_uring_ctx_t* ctx, int64_t delta_t)
+{
+    int ret = -1;
+    struct io_uring_sqe* sqe = picoquic_uring_get_sqe(ctx);
+
+    if (sqe != NULL) {
+        if (delta_t > 10000000) {
+            delta_t = 10000000;
+        }
+        ctx->timeout_ts.tv_sec = delta_t / 1000000;
+        ctx->timeout_ts.tv_nsec = (delta_t % 1000000) * 1000;
+        sqe->opcode = IORING_OP_TIMEOUT;
+        sqe->addr = (uint64_t)(uintptr_t)&ctx->timeout_ts;
+        sqe->len = 1;
+        sqe->off = 1;
+        sqe->user_data = PICOQUIC_URING_USER_DATA(PICOQUIC_URING_OP_TIMEOUT, 0);
+        ret = 0;
+    }
+    return ret;
+}
+
+/* Access to completions: first the stash, then the completion queue. */
+static int picoquic_uring_peek_cq(picoquic_uring_ctx_t* ctx, picoquic_uring_cqe_t* cqe)
+{
+    int ret = 0;
+    unsigned int head = *ctx->cq_head;
+
+    if (head != __atomic_load_n(ctx->cq_tail, __ATOMIC_ACQUIRE)) {
+        struct io_uring_cqe* k_cqe = &ctx->cqes[head & *ctx->cq_mask];
+        cqe->user_data = k_cqe->user_data;
+        cqe->res = k_cqe->res;
+        cqe->flags = k_cqe->flags;
+        ret = 1;
+    }
+    return ret;
+}
+
+static int picoquic_uring_peek_cqe(picoquic_uring_ctx_t* ctx, picoquic_uring_cqe_t* cqe)
+{
+    int ret = 0;
+
+    if (ctx->stash_index < ctx->nb_stash) {
+        *cqe = ctx->stash[ctx->stash_index];
+        ret = 1;
+    }
+    else {
+        ret = picoquic_uring_peek_cq(ctx, cqe);
+    }
+    return ret;
+}
+
+static void picoquic_uring_advance_cqe(picoquic_uring_ctx_t* ctx)
+{
+    if (ctx->stash_index < ctx->nb_stash) {
+        ctx->stash_index++;
+        if (ctx->stash_index >= ctx->nb_stash) {
+            ctx->stash_index = 0;
+            ctx->nb_stash = 0;
+        }
+    }
+    else {
+        __atomic_store_n(ctx->cq_head, *ctx->cq_head + 1, __ATOMIC_RELEASE);
+    }
+}
+
+static void picoquic_uring_add_recycle(picoquic_uring_ctx_t* ctx, uint32_t cqe_flags)
+{
+    if ((cqe_flags & IORING_CQE_F_BUFFER) != 0 && ctx->nb_recycle < PICOQUIC_URING_NB_BUFFERS) {
+        ctx->recycle[ctx->nb_recycle++] = (uint16_t)(cqe_flags >> IORING_CQE_BUFFER_SHIFT);
+    }
+}
+
+static void picoquic_uring_recycle(picoquic_uring_ctx_t* ctx)
+{
+    if (ctx->nb_recycle > 0) {
+        uint16_t tail = ctx->buf_ring->tail;
+        uint16_t mask = PICOQUIC_URING_NB_BUFFERS - 1;
+
+        for (int i = 0; i < ctx->nb_recycle; i++) {
+            struct io_uring_buf* buf = &ctx->buf_ring->bufs[(uint16_t)(tail + i) & mask];
+            buf->addr = (uint64_t)(uintptr_t)(ctx->buffers + (size_t)ctx->recycle[i] * ctx->buffer_size);
+            buf->len = (uint32_t)ctx->buffer_size;
+            buf->bid = ctx->recycle[i];
+        }
+        __atomic_store_n(&ctx->buf_ring->tail, (uint16_t)(tail + ctx->nb_recycle), __ATOMIC_RELEASE);
+        ctx->nb_recycle = 0;
+    }
+}
+
+/* Parse a multishot recvmsg completion. The buffer contains the
+ * io_uring_recvmsg_out header, then the name and control areas with
+ * the sizes set in the msghdr, then the payload. */
+static int picoquic_uring_parse_recv(picoquic_uring_ctx_t* ctx, int rank, picoquic_uring_cqe_t* cqe,
+    picoquic_recv_msg_t* msg)
+{
+    int ret = -1;
+
+    if (cqe->res > 0 && (cqe->flags & IORING_CQE_F_BUFFER) != 0) {
+        uint16_t bid = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+        uint8_t* buf = ctx->buffers + (size_t)bid * ctx->buffer_size;
+        struct io_uring_recvmsg_out* out = (struct io_uring_recvmsg_out*)buf;
+        struct msghdr* msghdr = &ctx->recv_msghdr[rank];
+        uint8_t* name = buf + sizeof(struct io_uring_recvmsg_out);
+        uint8_t* control = name + msghdr->msg_namelen;
+        uint8_t* payload = control + msghdr->msg_controllen;
+
+        /* The result is the number of bytes written in the buffer, including the header */
+        if ((out->flags & MSG_TRUNC) == 0 && payload <= buf + cqe->res &&
+            out->payloadlen <= (size_t)(buf + cqe->res - payload)) {
+            struct msghdr c_msg;
+
+            memset(&c_msg, 0, sizeof(c_msg));
+            c_msg.msg_control = control;
+            c_msg.msg_controllen = (out->controllen < msghdr->msg_controllen) ? out->controllen : msghdr->msg_controllen;
+
+            memset(&msg->addr_from, 0, sizeof(msg->addr_from));
+            memcpy(&msg->addr_from, name, (out->namelen < sizeof(msg->addr_from)) ? out->namelen : sizeof(msg->addr_from));
+            memset(&msg->addr_dest, 0, sizeof(msg->addr_dest));
+            msg->dest_if = 0;
+            msg->received_ecn = 0;
+            msg->udp_coalesced_size = 0;
+            picoquic_socks_cmsg_parse(&c_msg, &msg->addr_dest, &msg->dest_if,
+                &msg->received_ecn, &msg->udp_coalesced_size);
+            if (msg->addr_dest.ss_family == AF_INET6) {
+                ((struct sockaddr_in6*)&msg->addr_dest)->sin6_port = htons(ctx->s_ctx[rank].port);
+            }
+            else if (msg->addr_dest.ss_family == AF_INET) {
+                ((struct sockaddr_in*)&msg->addr_dest)->sin_port = htons(ctx->s_ctx[rank].port);
+            }
+            msg->buffer = payload;
+            msg->buffer_max = out->payloadlen;
+            msg->bytes_recv = out->payloadlen;
+            ret = 0;
+        }
+    }
+    return ret;
+}
+
+int picoquic_uring_wait(picoquic_uring_ctx_t* ctx, int nb_sockets_available,
+    picoquic_recv_msg_t* recv_msgs, int nb_msg, int64_t delta_t, int* is_wake_up_event)
+{
+    int ret = 0;
+    int nb_recv = 0;
+    picoquic_uring_cqe_t cqe;
+
+    *is_wake_up_event = 0;
+
+    /* The messages returned by the previous call have been processed */
+    picoquic_uring_recycle(ctx);
+
+    /* Re-arm the multishot operations that were terminated */
+    for (int i = 0; ret == 0 && i < ctx->nb_sockets; i++) {
+        if (!ctx->recv_armed[i]) {
+            ret = picoquic_uring_arm_recv(ctx, i);
+        }
+    }
+    if (ret == 0 && ctx->wake_up_fd >= 0 && !ctx->wake_up_armed) {
+        ret = picoquic_uring_arm_wake_up(ctx);
+    }
+
+    if (ret == 0) {
+        if (delta_t > 0 && !picoquic_uring_peek_cqe(ctx, &cqe)) {
+            /* Nothing available yet: submit and wait for a completion or the timeout */
+            ret = picoquic_uring_arm_timeout(ctx, delta_t);
+            if (ret == 0) {
+                ret = picoquic_uring_submit(ctx, 1);
+            }
+        }
+        else if (ctx->nb_to_submit > 0) {
+            ret = picoquic_uring_submit(ctx, 0);
+        }
+    }
+
+    while (ret == 0 && nb_recv < nb_msg && picoquic_uring_peek_cqe(ctx, &cqe)) {
+        int op = PICOQUIC_URING_USER_OP(cqe.user_data);
+        int index = PICOQUIC_URING_USER_INDEX(cqe.user_data);
+
+        if (op == PICOQUIC_URING_OP_WAKE) {
+            if (nb_recv > 0) {
+                /* Process the received messages first, handle the wake up in the next call */
+                break;
+            }
+            else {
+                uint8_t eventbuf[8];
+                if (read(ctx->wake_up_fd, eventbuf, sizeof(eventbuf)) <= 0 && errno != EAGAIN) {
+                    ret = -1;
+                }
+                else {
+                    *is_wake_up_event = 1;
+                }
+                if ((cqe.flags & IORING_CQE_F_MORE) == 0) {
+                    ctx->wake_up_armed = 0;
+                }
+                picoquic_uring_advance_cqe(ctx);
+                break;
+            }
+        }
+        else if (op == PICOQUIC_URING_OP_RECV && index < ctx->nb_sockets) {
+            if ((cqe.flags & IORING_CQE_F_MORE) == 0) {
+                /* Multishot terminated, e.g., ENOBUFS if the buffers are exhausted. */
+                ctx->recv_armed[index] = 0;
+            }
+            if (cqe.res < 0 && cqe.res != -ENOBUFS) {
+                DBG_PRINTF("io_uring recvmsg on socket %d returns %d\n", index, cqe.res);
+            }
+            else if (index < nb_sockets_available &&
+                picoquic_uring_parse_recv(ctx, index, &cqe, &recv_msgs[nb_recv]) == 0) {
+                nb_recv++;
+            }
+            picoquic_uring_add_recycle(ctx, cqe.flags);
+        }
+        /* Timeout and stale send completions are simply consumed */
+        picoquic_uring_advance_cqe(ctx);
+    }
+
+    if (ret != 0) {
+        DBG_PRINTF("io_uring wait fails, errno= %d\n", errno);
+        nb_recv = -1;
+    }
+    return nb_recv;
+}
+
+int picoquic_uring_send(picoquic_uring_ctx_t* ctx, SOCKET_TYPE* fds,
+    picoquic_send_msg_t* msgs, int nb_msgs, int* sock_err)
+{
+    int ret = 0;
+    int nb_queued = 0;
+    int nb_completed = 0;
+    int nb_sent = 0;
+
+    if (nb_msgs > PICOQUIC_SENDMMSG_MAX) {
+        nb_msgs = PICOQUIC_SENDMMSG_MAX;
+    }
+
+    for (int i = 0; i < nb_msgs; i++) {
+        sock_err[i] = ENOBUFS;
+    }
+
+    while (nb_queued < nb_msgs) {
+        int i = nb_queued;
+        struct io_uring_sqe* sqe = picoquic_uring_get_sqe(ctx);
+        struct msghdr* msg = &ctx->send_msghdr[i];
+
+        if (sqe == NULL) {
+            /* The remaining messages are reported as not sent */
+            break;
+        }
+        ctx->send_iov[i].iov_base = (void*)msgs[i].bytes;
+        ctx->send_iov[i].iov_len = msgs[i].length;
+        memset(msg, 0, sizeof(struct msghdr));
+        msg->msg_name = &msgs[i].addr_dest;
+        msg->msg_namelen = picoquic_addr_length((struct sockaddr*)&msgs[i].addr_dest);
+        msg->msg_iov = &ctx->send_iov[i];
+        msg->msg_iovlen = 1;
+        msg->msg_control = msgs[i].cmsg_buffer;
+        msg->msg_controllen = sizeof(msgs[i].cmsg_buffer);
+        picoquic_socks_cmsg_format_ex(msg, msgs[i].length, msgs[i].send_msg_size,
+            (struct sockaddr*)&msgs[i].addr_from, msgs[i].dest_if, msgs[i].txtime);
+
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = fds[i];
+        sqe->addr = (uint64_t)(uintptr_t)msg;
+        sqe->len = 1;
+        sqe->user_data = PICOQUIC_URING_USER_DATA(PICOQUIC_URING_OP_SEND, i);
+        sock_err[i] = -1;
+        nb_queued++;
+    }
+
+    /* Submit, and wait until all sends are complete. The buffers will be reused
+     * by the caller after this call returns. */
+    while (ret == 0 && nb_completed < nb_queued) {
+        picoquic_uring_cqe_t cqe;
+        ret = picoquic_uring_submit(ctx, 1);
+
+        /* Stashed completions are never send completions, only look at the queue */
+        while (ret == 0 && nb_completed < nb_queued && picoquic_uring_peek_cq(ctx, &cqe)) {
+            if (PICOQUIC_URING_USER_OP(cqe.user_data) == PICOQUIC_URING_OP_SEND) {
+                int index = PICOQUIC_URING_USER_INDEX(cqe.user_data);
+                if (index < nb_queued && sock_err[index] == -1) {
+                    sock_err[index] = (cqe.res < 0) ? -cqe.res : 0;
+                    if (cqe.res >= 0) {
+                        nb_sent++;
+                    }
+                    nb_completed++;
+                }
+            }
+            else if (ctx->nb_stash < PICOQUIC_URING_STASH_MAX) {
+                ctx->stash[ctx->nb_stash++] = cqe;
+            }
+            else {
+                /* No room left, drop the packet. */
+                if (PICOQUIC_URING_USER_OP(cqe.user_data) == PICOQUIC_URING_OP_RECV) {
+                    if ((cqe.flags & IORING_CQE_F_MORE) == 0) {
+                        ctx->recv_armed[PICOQUIC_URING_USER_INDEX(cqe.user_data)] = 0;
+                    }
+                    picoquic_uring_add_recycle(ctx, cqe.flags);
+                }
+            }
+            __atomic_store_n(ctx->cq_head, *ctx->cq_head + 1, __ATOMIC_RELEASE);
+        }
+    }
+
+    return (ret == 0) ? nb_sent : -1;
+}
+
+static int picoquic_uring_map_rings(picoquic_uring_ctx_t* ctx, struct io_uring_params* p)
+{
+    int ret = 0;
+
+    ctx->sq_ring_size = p->sq_off.array + p->sq_entries * sizeof(unsigned int);
+    ctx->cq_ring_size = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+    if ((p->features & IORING_FEAT_SINGLE_MMAP) != 0 && ctx->cq_ring_size > ctx->sq_ring_size) {
+        ctx->sq_ring_size = ctx->cq_ring_size;
+    }
+    ctx->sq_ring_ptr = mmap(NULL, ctx->sq_ring_size, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, ctx->ring_fd, IORING_OFF_SQ_RING);
+    if (ctx->sq_ring_ptr == MAP_FAILED) {
+        ctx->sq_ring_ptr = NULL;
+        ret = -1;
+    }
+    else if ((p->features & IORING_FEAT_SINGLE_MMAP) != 0) {
+        ctx->cq_ring_ptr = ctx->sq_ring_ptr;
+    }
+    else {
+        ctx->cq_ring_ptr = mmap(NULL, ctx->cq_ring_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, ctx->ring_fd, IORING_OFF_CQ_RING);
+        if (ctx->cq_ring_ptr == MAP_FAILED) {
+            ctx->cq_ring_ptr = NULL;
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        ctx->sqes_size = p->sq_entries * sizeof(struct io_uring_sqe);
+        ctx->sqes = (struct io_uring_sqe*)mmap(NULL, ctx->sqes_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, ctx->ring_fd, IORING_OFF_SQES);
+        if (ctx->sqes == MAP_FAILED) {
+            ctx->sqes = NULL;
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        uint8_t* sq = (uint8_t*)ctx->sq_ring_ptr;
+        uint8_t* cq = (uint8_t*)ctx->cq_ring_ptr;
+
+        ctx->sq_head = (unsigned int*)(sq + p->sq_off.head);
+        ctx->sq_tail = (unsigned int*)(sq + p->sq_off.tail);
+        ctx->sq_mask = (unsigned int*)(sq + p->sq_off.ring_mask);
+        ctx->sq_array = (unsigned int*)(sq + p->sq_off.array);
+        ctx->cq_head = (unsigned int*)(cq + p->cq_off.head);
+        ctx->cq_tail = (unsigned int*)(cq + p->cq_off.tail);
+        ctx->cq_mask = (unsigned int*)(cq + p->cq_off.ring_mask);
+        ctx->cqes = (struct io_uring_cqe*)(cq + p->cq_off.cqes);
+    }
+
+    return ret;
+}
+
+static int picoquic_uring_register_buffers(picoquic_uring_ctx_t* ctx)
+{
+    int ret = 0;
+    struct io_uring_buf_reg reg;
+
+    ctx->buf_ring_size = PICOQUIC_URING_NB_BUFFERS * sizeof(struct io_uring_buf);
+    ctx->buf_ring = (struct io_uring_buf_ring*)mmap(NULL, ctx->buf_ring_size, PROT_READ | PROT_WRITE,
+        MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (ctx->buf_ring == MAP_FAILED) {
+        ctx->buf_ring = NULL;
+        ret = -1;
+    }
+    else {
+        memset(&reg, 0, sizeof(reg));
+        reg.ring_addr = (uint64_t)(uintptr_t)ctx->buf_ring;
+        reg.ring_entries = PICOQUIC_URING_NB_BUFFERS;
+        reg.bgid = PICOQUIC_URING_BUFFER_GROUP;
+        if (picoquic_uring_register(ctx->ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) {
+            DBG_PRINTF("Cannot register io_uring buffer ring, errno= %d\n", errno);
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        /* Each buffer holds the recvmsg_out header, the name and control areas, and one packet */
+        ctx->buffer_size = sizeof(struct io_uring_recvmsg_out) + sizeof(struct sockaddr_storage) +
+            PICOQUIC_RECVMMSG_CMSG_SIZE + PICOQUIC_MAX_PACKET_SIZE;
+        ctx->buffer_size = (ctx->buffer_size + 63) & ~((size_t)63);
+        ctx->buffers = (uint8_t*)malloc(PICOQUIC_URING_NB_BUFFERS * ctx->buffer_size);
+        if (ctx->buffers == NULL) {
+            ret = -1;
+        }
+        else {
+            ctx->buf_ring->tail = 0;
+            for (int i = 0; i < PICOQUIC_URING_NB_BUFFERS; i++) {
+                ctx->recycle[i] = (uint16_t)i;
+            }
+            ctx->nb_recycle = PICOQUIC_URING_NB_BUFFERS;
+            picoquic_uring_recycle(ctx);
+        }
+    }
+    return ret;
+}
+
+picoquic_uring_ctx_t* picoquic_uring_create(picoquic_socket_ctx_t* s_ctx, int nb_sockets, int wake_up_fd)
+{
+    int ret = 0;
+    struct io_uring_params p;
+    picoquic_uring_ctx_t* ctx = (picoquic_uring_ctx_t*)malloc(sizeof(picoquic_uring_ctx_t));
+
+    if (ctx == NULL || nb_sockets > PICOQUIC_PACKET_LOOP_SOCKETS_MAX) {
+        ret = -1;
+    }
+    else {
+        memset(ctx, 0, sizeof(picoquic_uring_ctx_t));
+        ctx->ring_fd = -1;
+        ctx->s_ctx = s_ctx;
+        ctx->nb_sockets = nb_sockets;
+        ctx->wake_up_fd = wake_up_fd;
+        memset(&p, 0, sizeof(p));
+        ctx->ring_fd = picoquic_uring_setup(PICOQUIC_URING_ENTRIES, &p);
+        if (ctx->ring_fd < 0) {
+            DBG_PRINTF("io_uring not available, errno= %d\n", errno);
+            ret = -1;
+        }
+        else if ((p.features & IORING_FEAT_NODROP) == 0) {
+            /* Old kernel, would not support the buffer rings either */
+            ret = -1;
+        }
+        else {
+            ret = picoquic_uring_map_rings(ctx, &p);
+        }
+    }
+
+    if (ret == 0) {
+        ret = picoquic_uring_register_buffers(ctx);
+    }
+
+    if (ret == 0) {
+        for (int i = 0; i < nb_sockets; i++) {
+            ctx->recv_msghdr[i].msg_namelen = sizeof(struct sockaddr_storage);
+            ctx->recv_msghdr[i].msg_controllen = PICOQUIC_RECVMMSG_CMSG_SIZE;
+        }
+    }
+
+    if (ret != 0 && ctx != NULL) {
+        picoquic_uring_delete(ctx);
+        ctx = NULL;
+    }
+    return ctx;
+}
+
+void picoquic_uring_delete(picoquic_uring_ctx_t* ctx)
+{
+    if (ctx->ring_fd >= 0) {
+        /* Closing the ring cancels the pending operations */
+        close(ctx->ring_fd);
+    }
+    if (ctx->sqes != NULL) {
+        munmap(ctx->sqes, ctx->sqes_size);
+    }
+    if (ctx->cq_ring_ptr != NULL && ctx->cq_ring_ptr != ctx->sq_ring_ptr) {
+        munmap(ctx->cq_ring_ptr, ctx->cq_ring_size);
+    }
+    if (ctx->sq_ring_ptr != NULL) {
+        munmap(ctx->sq_ring_ptr, ctx->sq_ring_size);
+    }
+    if (ctx->buf_ring != NULL) {
+        munmap(ctx->buf_ring, ctx->buf_ring_size);
+    }
+    if (ctx->buffers != NULL) {
+        free(ctx->buffers);
+    }
+    free(ctx);
+}
+
+#endif /* __linux__ && PICOQUIC_WITH_IO_URING */
@@ -1212,7 +1212,44 @@ static int picoquic_set_aead_from_secret(void ** v_aead,ptls_cipher_suite_t * ci
     return ret;
 }
 
-static int picoquic_set_pn_enc_from_secret(void ** v_pn_enc, ptls_cipher_suite_t * cipher, int is_enc, const void *secret, const char *prefix_label)
+static void picoquic_aead_clones_free(picoquic_aead_clones_t** clones)
+{
+    if (*clones != NULL) {
+        for (int i = 0; i < (*clones)->nb_clones; i++) {
+            ptls_aead_free((ptls_aead_context_t*)(*clones)->aead[i]);
+        }
+        free(*clones);
+        *clones = NULL;
+    }
+}
+
+/* Copies of the AEAD key used by the crypto workers. Failing to create
+ * them is not fatal, the packets are then encrypted by the protocol thread. */
+static void picoquic_set_aead_clones_from_secret(picoquic_aead_clones_t** clones, int nb_clones,
+    ptls_cipher_suite_t* cipher, int is_enc, const void* secret, const char* prefix_label)
+{
+    picoquic_aead_clones_free(clones);
+
+    if (nb_clones > 0 && (*clones = (picoquic_aead_clones_t*)malloc(sizeof(picoquic_aead_clones_t))) != NULL) {
+        memset(*clones, 0, sizeof(picoquic_aead_clones_t));
+        while ((*clones)->nb_clones < nb_clones) {
+            void* aead = ptls_aead_new(cipher->aead, cipher->hash, is_enc, secret, prefix_label);
+
+            if (aead == NULL) {
+                picoquic_aead_clones_free(clones);
+                break;
+            }
+            (*clones)->aead[(*clones)->nb_clones++] = aead;
+        }
+    }
+}
+
+/* If v_pn_enc_ecb is not NULL and the cipher suite uses AES, an ECB context
+ * is also created with the same key, so that the header protection masks
+ * of several packets can be computed in a single call. The mask is the
+ * encryption of the sample, so that context is used for encryption even
+ * when removing header protection. */
+static int picoquic_set_pn_enc_from_secret(void ** v_pn_enc, void ** v_pn_enc_ecb, ptls_cipher_suite_t * cipher, int is_enc, const void *secret, const char *prefix_label)
 {
     uint8_t pnekey[PTLS_MAX_SECRET_SIZE];
     int ret;
@@ -1222,12 +1259,22 @@ static int picoquic_set_pn_enc_from_secret(void ** v_pn_enc, ptls_cipher_suite_t
         *v_pn_enc = NULL;
     }
 
+    if (v_pn_enc_ecb != NULL && *v_pn_enc_ecb != NULL) {
+        ptls_cipher_free((ptls_cipher_context_t*)*v_pn_enc_ecb);
+        *v_pn_enc_ecb = NULL;
+    }
+
     if ((ret = ptls_hkdf_expand_label(cipher->hash, pnekey, 
         cipher->aead->ctr_cipher->key_size, ptls_iovec_init(secret, cipher->hash->digest_size), 
         PICOQUIC_LABEL_HP, ptls_iovec_init(NULL, 0), prefix_label)) == 0) {
         if ((*v_pn_enc = ptls_cipher_new(cipher->aead->ctr_cipher, is_enc, pnekey)) == NULL) {
             ret = PTLS_ERROR_NO_MEMORY;
         }
+        else if (v_pn_enc_ecb != NULL && cipher->aead->ecb_cipher != NULL &&
+            cipher->aead->ecb_cipher->key_size == cipher->aead->ctr_cipher->key_size) {
+            /* Not fatal: without ECB context, masks are computed one packet at a time */
+            *v_pn_enc_ecb = ptls_cipher_new(cipher->aead->ecb_cipher, 1, pnekey);
+        }
     }
     
     return ret;
@@ -1243,7 +1290,7 @@ void picoquic_aes128_ecb_encrypt(void* v_aesecb, uint8_t * output, const uint8_t
     ptls_cipher_encrypt((ptls_cipher_context_t*)v_aesecb, output, input, len);
 }
 
-static int picoquic_set_key_from_secret(ptls_cipher_suite_t * cipher, int is_enc, int is_rotation, picoquic_crypto_context_t * ctx, const void *secret, const char *prefix_label)
+static int picoquic_set_key_from_secret(ptls_cipher_suite_t * cipher, int is_enc, int is_rotation, int nb_clones, picoquic_crypto_context_t * ctx, const void *secret, const char *prefix_label)
 {
     int ret = 0;
 
@@ -1251,19 +1298,32 @@ static int picoquic_set_key_from_secret(ptls_cipher_suite_t * cipher, int is_enc
         ret = picoquic_set_aead_from_secret(&ctx->aead_encrypt, cipher, is_enc, secret, prefix_label);
         
         if (ret == 0 && !is_rotation) {
-            ret = picoquic_set_pn_enc_from_secret(&ctx->pn_enc, cipher, is_enc, secret, prefix_label);
+            ret = picoquic_set_pn_enc_from_secret(&ctx->pn_enc, &ctx->pn_enc_ecb, cipher, is_enc, secret, prefix_label);
+        }
+        if (ret == 0) {
+            picoquic_set_aead_clones_from_secret(&ctx->aead_encrypt_clones, nb_clones, cipher, is_enc, secret, prefix_label);
         }
     } else {
         ret = picoquic_set_aead_from_secret(&ctx->aead_decrypt, cipher, is_enc, secret, prefix_label);
         
         if (ret == 0 && !is_rotation) {
-            ret = picoquic_set_pn_enc_from_secret(&ctx->pn_dec, cipher, is_enc, secret, prefix_label);
+            ret = picoquic_set_pn_enc_from_secret(&ctx->pn_dec, &ctx->pn_dec_ecb, cipher, is_enc, secret, prefix_label);
+        }
+        if (ret == 0) {
+            picoquic_set_aead_clones_from_secret(&ctx->aead_decrypt_clones, nb_clones, cipher, is_enc, secret, prefix_label);
         }
     }
 
     return ret;
 }
 
+/* Only the 1-RTT keys are used by the crypto workers */
+static int picoquic_get_nb_aead_clones(picoquic_cnx_t* cnx, size_t epoch)
+{
+    return (epoch == picoquic_epoch_1rtt && cnx->quic->crypto_pool != NULL) ?
+        picoquic_crypto_pool_nb_workers(cnx->quic->crypto_pool) : 0;
+}
+
 
 /* Key update callback: this is called by TLS whenever the session key has changed,
  * from the function "setup_traffic_protection" in picotls.c.
@@ -1300,7 +1360,8 @@ static int picoquic_update_traffic_key_callback(ptls_update_traffic_key_t * self
     UNREFERENCED_PARAMETER(self);
     const char *prefix_label = picoquic_supported_versions[cnx->version_index].tls_prefix_label;
 
-    int ret = picoquic_set_key_from_secret(cipher, is_enc, 0, &cnx->crypto_context[epoch], secret, prefix_label);
+    int ret = picoquic_set_key_from_secret(cipher, is_enc, 0, picoquic_get_nb_aead_clones(cnx, epoch),
+        &cnx->crypto_context[epoch], secret, prefix_label);
     if (cnx->cnx_state < picoquic_state_ready) {
         cnx->recycle_sooner_needed = 1;
     }
@@ -1422,10 +1483,10 @@ int picoquic_setup_initial_traffic_keys(picoquic_cnx_t* cnx)
             secret2 = server_secret;
         }
         
-        ret = picoquic_set_key_from_secret(cipher, 1, 0, &cnx->crypto_context[0], secret1, prefix_label);
+        ret = picoquic_set_key_from_secret(cipher, 1, 0, 0, &cnx->crypto_context[0], secret1, prefix_label);
 
         if (ret == 0) {
-            ret = picoquic_set_key_from_secret(cipher, 0, 0, &cnx->crypto_context[0], secret2, prefix_label);
+            ret = picoquic_set_key_from_secret(cipher, 0, 0, 0, &cnx->crypto_context[0], secret2, prefix_label);
         }
     }
 
@@ -1458,7 +1519,7 @@ int picoquic_get_initial_aead_context(picoquic_quic_t * quic, int version_index,
 
         ret = picoquic_set_aead_from_secret(aead_ctx, cipher, is_enc, selected_secret, prefix_label);
         if (ret == 0) {
-            ret = picoquic_set_pn_enc_from_secret(pn_enc_ctx, cipher, is_enc, selected_secret, prefix_label);
+            ret = picoquic_set_pn_enc_from_secret(pn_enc_ctx, NULL, cipher, is_enc, selected_secret, prefix_label);
         }
     }
     return ret;
@@ -1545,7 +1606,8 @@ int picoquic_compute_new_rotated_keys(picoquic_cnx_t * cnx)
     }
 
     if (ret == 0) {
-        ret = picoquic_set_key_from_secret(cipher, 1, 1, &cnx->crypto_context_new, tls_ctx->app_secret_enc, prefix_label);
+        ret = picoquic_set_key_from_secret(cipher, 1, 1, picoquic_get_nb_aead_clones(cnx, picoquic_epoch_1rtt),
+            &cnx->crypto_context_new, tls_ctx->app_secret_enc, prefix_label);
     }
 
     if (ret == 0) {
@@ -1563,7 +1625,8 @@ int picoquic_compute_new_rotated_keys(picoquic_cnx_t * cnx)
     }
 
     if (ret == 0) {
-        ret = picoquic_set_key_from_secret(cipher, 0, 1, &cnx->crypto_context_new, tls_ctx->app_secret_dec, prefix_label);
+        ret = picoquic_set_key_from_secret(cipher, 0, 1, picoquic_get_nb_aead_clones(cnx, picoquic_epoch_1rtt),
+            &cnx->crypto_context_new, tls_ctx->app_secret_dec, prefix_label);
     }
 
     return (ret == 0)?0: PICOQUIC_ERROR_CANNOT_COMPUTE_KEY;
@@ -1572,23 +1635,37 @@ int picoquic_compute_new_rotated_keys(picoquic_cnx_t * cnx)
 void picoquic_apply_rotated_keys(picoquic_cnx_t * cnx, int is_enc)
 {
     if (is_enc) {
+        /* Complete the packets of the current train before releasing the key */
+        if (cnx->quic->hp_batch.nb_entries > 0) {
+            picoquic_hp_batch_flush(&cnx->quic->hp_batch);
+        }
+
         if (cnx->crypto_context[3].aead_encrypt != NULL) {
             ptls_aead_free((ptls_aead_context_t *)cnx->crypto_context[3].aead_encrypt);
         }
 
         cnx->crypto_context[3].aead_encrypt = cnx->crypto_context_new.aead_encrypt;
         cnx->crypto_context_new.aead_encrypt = NULL;
+        picoquic_aead_clones_free(&cnx->crypto_context[3].aead_encrypt_clones);
+        cnx->crypto_context[3].aead_encrypt_clones = cnx->crypto_context_new.aead_encrypt_clones;
+        cnx->crypto_context_new.aead_encrypt_clones = NULL;
 
         cnx->key_phase_enc ^= 1;
     }
     else {
         if (cnx->crypto_context_old.aead_decrypt != NULL) {
+            /* Packets decrypted ahead with that key are not used anymore */
+            picoquic_decrypt_batch_clear(cnx->quic, cnx);
             ptls_aead_free((ptls_aead_context_t *)cnx->crypto_context_old.aead_decrypt);
         }
+        picoquic_aead_clones_free(&cnx->crypto_context_old.aead_decrypt_clones);
 
         cnx->crypto_context_old.aead_decrypt = cnx->crypto_context[3].aead_decrypt;
+        cnx->crypto_context_old.aead_decrypt_clones = cnx->crypto_context[3].aead_decrypt_clones;
         cnx->crypto_context[3].aead_decrypt = cnx->crypto_context_new.aead_decrypt;
+        cnx->crypto_context[3].aead_decrypt_clones = cnx->crypto_context_new.aead_decrypt_clones;
         cnx->crypto_context_new.aead_decrypt = NULL;
+        cnx->crypto_context_new.aead_decrypt_clones = NULL;
 
         cnx->key_phase_dec ^= 1;
     }
@@ -1619,6 +1696,19 @@ void picoquic_crypto_context_free(picoquic_crypto_context_t * ctx)
         ptls_cipher_free((ptls_cipher_context_t *)ctx->pn_dec);
         ctx->pn_dec = NULL;
     }
+
+    if (ctx->pn_enc_ecb != NULL) {
+        ptls_cipher_free((ptls_cipher_context_t*)ctx->pn_enc_ecb);
+        ctx->pn_enc_ecb = NULL;
+    }
+
+    if (ctx->pn_dec_ecb != NULL) {
+        ptls_cipher_free((ptls_cipher_context_t*)ctx->pn_dec_ecb);
+        ctx->pn_dec_ecb = NULL;
+    }
+
+    picoquic_aead_clones_free(&ctx->aead_encrypt_clones);
+    picoquic_aead_clones_free(&ctx->aead_decrypt_clones);
 }
 
 /*
@@ -2058,6 +2148,7 @@ static int picoquic_add_to_tls_stream(picoquic_cnx_t* cnx, const uint8_t* data,
             ret = -1;
         }
         else {
+            memset(stream_data, 0, sizeof(picoquic_stream_queue_node_t));
             stream_data->bytes = (uint8_t*)malloc(length);
 
             if (stream_data->bytes == NULL) {
@@ -2066,20 +2157,9 @@ static int picoquic_add_to_tls_stream(picoquic_cnx_t* cnx, const uint8_t* data,
                 ret = -1;
             }
             else {
-                picoquic_stream_queue_node_t** pprevious = &stream->send_queue;
-                picoquic_stream_queue_node_t* next = stream->send_queue;
-
                 memcpy(stream_data->bytes, data, length);
                 stream_data->length = length;
-                stream_data->offset = 0;
-                stream_data->next_stream_data = NULL;
-
-                while (next != NULL) {
-                    pprevious = &next->next_stream_data;
-                    next = next->next_stream_data;
-                }
-
-                *pprevious = stream_data;
+                picoquic_stream_queue_append(stream, stream_data);
             }
         }
     }
@@ -2230,7 +2310,7 @@ void * picoquic_pn_enc_create_for_test(const uint8_t * secret, const char *prefi
     ptls_cipher_suite_t *cipher = picoquic_get_aes128gcm_sha256(1);
     void *v_pn_enc = NULL;
     
-    (void)picoquic_set_pn_enc_from_secret(&v_pn_enc, cipher, 1, secret, prefix_label);
+    (void)picoquic_set_pn_enc_from_secret(&v_pn_enc, NULL, cipher, 1, secret, prefix_label);
 
     return v_pn_enc;
 }
@@ -733,7 +733,13 @@ const uint8_t* picoquic_frames_varint_decode(const uint8_t* bytes, const uint8_t
 {
     uint8_t length;
 
-    if (bytes < bytes_max && bytes + (length = VARINT_LEN_T(bytes, uint8_t)) <= bytes_max) {
+    if (bytes + PICOPARSE_VARINT_MIN <= bytes_max) {
+        /* Fast path, 8 bytes can be read without checking the varint length */
+        length = VARINT_LEN_T(bytes, uint8_t);
+        *n64 = PICOPARSE_VARINT_8(bytes);
+        bytes += length;
+    }
+    else if (bytes < bytes_max && bytes + (length = VARINT_LEN_T(bytes, uint8_t)) <= bytes_max) {
         uint64_t v = *bytes++ & 0x3F;
 
         while (--length > 0) {
@@ -0,0 +1,221 @@
+/*
+* Copyright (c) 2026, the picoquic contributors.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Hierarchical timing wheel for the connection wake list.
+ *
+ * Wake times are expressed in microseconds. A connection is placed in
+ * the level corresponding to the highest 6 bit digit in which its wake
+ * time differs from the wheel time, and in the slot given by the value
+ * of that digit. This maintains two invariants:
+ *
+ * - all connections in level N wake up before those in level N+1,
+ * - within a level, slots of higher rank wake up later.
+ *
+ * Connections whose wake time is lower than the wheel time are late.
+ * They wake up before all the connections in the wheel, and are kept
+ * apart in a splay tree ordered by wake time, using the wake list node
+ * of the connection, which is not used when the wheel is. A server that
+ * falls behind may have many late connections, and the tree returns the
+ * earliest of them without scanning the others.
+ *
+ * The earliest connection is thus the first of the late tree, if any.
+ * Otherwise, it is found in the first occupied slot of the lowest
+ * occupied level. If that level is 0, all connections in the slot have
+ * the same wake time. Otherwise, the wheel time advances to the
+ * beginning of the slot, and the connections in that slot are cascaded
+ * to the lower levels. Each connection is cascaded at most once per
+ * level between reinsertions.
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "picoquic_internal.h"
+
+/* Index of the lowest bit set in a non zero 64 bit value */
+static const uint8_t picoquic_wake_wheel_debruijn[64] = {
+    0, 1, 2, 53, 3, 7, 54, 27, 4, 38, 41, 8, 34, 55, 48, 28,
+    62, 5, 39, 46, 44, 42, 22, 9, 24, 35, 59, 56, 49, 18, 29, 11,
+    63, 52, 6, 26, 37, 40, 33, 47, 61, 45, 43, 21, 23, 58, 17, 10,
+    51, 25, 36, 32, 60, 20, 57, 16, 50, 31, 19, 15, 30, 14, 13, 12
+};
+
+static int picoquic_wake_wheel_lowest_bit(uint64_t x)
+{
+    return picoquic_wake_wheel_debruijn[((x & (0 - x)) * 0x022fdd63cc95386dull) >> 58];
+}
+
+static void* picoquic_wake_wheel_late_value(picosplay_node_t* cnx_wake_node)
+{
+    return (cnx_wake_node == NULL) ? NULL : (void*)((char*)cnx_wake_node - offsetof(struct st_picoquic_cnx_t, cnx_wake_node));
+}
+
+static int64_t picoquic_wake_wheel_late_compare(void* l, void* r)
+{
+    const uint64_t ltime = ((picoquic_cnx_t*)l)->next_wake_time;
+    const uint64_t rtime = ((picoquic_cnx_t*)r)->next_wake_time;
+    if (ltime < rtime) return -1;
+    if (ltime > rtime) return 1;
+    return 0;
+}
+
+static picosplay_node_t* picoquic_wake_wheel_late_create(void* v_cnx)
+{
+    return &((picoquic_cnx_t*)v_cnx)->cnx_wake_node;
+}
+
+static void picoquic_wake_wheel_late_delete(void* tree, picosplay_node_t* node)
+{
+#ifdef _WINDOWS
+    UNREFERENCED_PARAMETER(tree);
+#endif
+    memset(node, 0, sizeof(picosplay_node_t));
+}
+
+picoquic_wake_wheel_t* picoquic_wake_wheel_create(uint64_t wheel_time)
+{
+    picoquic_wake_wheel_t* wheel = (picoquic_wake_wheel_t*)malloc(sizeof(picoquic_wake_wheel_t));
+
+    if (wheel != NULL) {
+        memset(wheel, 0, sizeof(picoquic_wake_wheel_t));
+        wheel->wheel_time = wheel_time;
+        picosplay_init_tree(&wheel->late_tree, picoquic_wake_wheel_late_compare,
+            picoquic_wake_wheel_late_create, picoquic_wake_wheel_late_delete, picoquic_wake_wheel_late_value);
+    }
+    return wheel;
+}
+
+void picoquic_wake_wheel_delete(picoquic_wake_wheel_t* wheel)
+{
+    free(wheel);
+}
+
+static void picoquic_wake_wheel_place(picoquic_wake_wheel_t* wheel, picoquic_cnx_t* cnx)
+{
+    uint64_t wake_time = cnx->next_wake_time;
+    uint64_t delta = (wake_time ^ wheel->wheel_time) >> PICOQUIC_WAKE_WHEEL_SLOT_BITS;
+    int level = 0;
+    int slot;
+
+    if (wake_time < wheel->wheel_time) {
+        cnx->wake_wheel_node.level = PICOQUIC_WAKE_WHEEL_LATE;
+        picosplay_insert(&wheel->late_tree, cnx);
+        return;
+    }
+
+    while (delta != 0) {
+        delta >>= PICOQUIC_WAKE_WHEEL_SLOT_BITS;
+        level++;
+    }
+    slot = (int)((wake_time >> (level * PICOQUIC_WAKE_WHEEL_SLOT_BITS)) & (PICOQUIC_WAKE_WHEEL_SLOTS - 1));
+
+    cnx->wake_wheel_node.level = (uint8_t)level;
+    cnx->wake_wheel_node.slot = (uint8_t)slot;
+    cnx->wake_wheel_node.previous = NULL;
+    cnx->wake_wheel_node.next = wheel->slots[level][slot];
+    if (cnx->wake_wheel_node.next != NULL) {
+        cnx->wake_wheel_node.next->wake_wheel_node.previous = cnx;
+    }
+    wheel->slots[level][slot] = cnx;
+    wheel->occupied[level] |= 1ull << slot;
+}
+
+void picoquic_wake_wheel_insert(picoquic_wake_wheel_t* wheel, picoquic_cnx_t* cnx)
+{
+    if (!cnx->wake_wheel_node.is_in_wheel) {
+        picoquic_wake_wheel_place(wheel, cnx);
+        cnx->wake_wheel_node.is_in_wheel = 1;
+        wheel->nb_cnx++;
+    }
+}
+
+void picoquic_wake_wheel_remove(picoquic_wake_wheel_t* wheel, picoquic_cnx_t* cnx)
+{
+    if (cnx->wake_wheel_node.is_in_wheel) {
+        int level = cnx->wake_wheel_node.level;
+        int slot = cnx->wake_wheel_node.slot;
+
+        if (level == PICOQUIC_WAKE_WHEEL_LATE) {
+            picosplay_delete_hint(&wheel->late_tree, &cnx->cnx_wake_node);
+        }
+        else if (cnx->wake_wheel_node.previous == NULL) {
+            wheel->slots[level][slot] = cnx->wake_wheel_node.next;
+            if (cnx->wake_wheel_node.next == NULL) {
+                wheel->occupied[level] &= ~(1ull << slot);
+            }
+        }
+        else {
+            cnx->wake_wheel_node.previous->wake_wheel_node.next = cnx->wake_wheel_node.next;
+        }
+        if (cnx->wake_wheel_node.next != NULL) {
+            cnx->wake_wheel_node.next->wake_wheel_node.previous = cnx->wake_wheel_node.previous;
+        }
+        memset(&cnx->wake_wheel_node, 0, sizeof(picoquic_wake_wheel_node_t));
+        wheel->nb_cnx--;
+    }
+}
+
+picoquic_cnx_t* picoquic_wake_wheel_first(picoquic_wake_wheel_t* wheel)
+{
+    picoquic_cnx_t* first = NULL;
+
+    if (wheel->late_tree.root != NULL) {
+        first = (picoquic_cnx_t*)picoquic_wake_wheel_late_value(picosplay_first(&wheel->late_tree));
+    }
+
+    while (first == NULL && wheel->nb_cnx > 0) {
+        if (wheel->occupied[0] != 0) {
+            /* All connections in the slot are due at the same time */
+            first = wheel->slots[0][picoquic_wake_wheel_lowest_bit(wheel->occupied[0])];
+        }
+        else {
+            int level = 1;
+            int slot;
+            int shift;
+            picoquic_cnx_t* cnx;
+
+            while (level < PICOQUIC_WAKE_WHEEL_LEVELS - 1 && wheel->occupied[level] == 0) {
+                level++;
+            }
+            slot = picoquic_wake_wheel_lowest_bit(wheel->occupied[level]);
+            shift = level * PICOQUIC_WAKE_WHEEL_SLOT_BITS;
+            /* Advance the wheel time to the start of the slot, then cascade the
+             * connections of that slot to the lower levels. */
+            if (shift + PICOQUIC_WAKE_WHEEL_SLOT_BITS < 64) {
+                wheel->wheel_time &= ~((1ull << (shift + PICOQUIC_WAKE_WHEEL_SLOT_BITS)) - 1);
+            }
+            else {
+                wheel->wheel_time = 0;
+            }
+            wheel->wheel_time |= ((uint64_t)slot) << shift;
+
+            cnx = wheel->slots[level][slot];
+            wheel->slots[level][slot] = NULL;
+            wheel->occupied[level] &= ~(1ull << slot);
+            while (cnx != NULL) {
+                picoquic_cnx_t* next = cnx->wake_wheel_node.next;
+                picoquic_wake_wheel_place(wheel, cnx);
+                cnx = next;
+            }
+        }
+    }
+
+    return first;
+}
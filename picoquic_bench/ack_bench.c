@@ -0,0 +1,212 @@
+/*
+* Copyright (c) 2026, the picoquic contributors.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Micro benchmark of ACK processing.
+ *
+ * Measures the cost of processing an ACK frame as a function of the number
+ * of packets in flight. The sender keeps a fixed number of 1-RTT packets
+ * in flight. At each step, it sends a new packet, and receives an ACK for
+ * the oldest packet in flight. A few packets in each window are lost:
+ * they remain in the pending list until they are one window old, and the
+ * ACK frames carry one range per loss, as a receiver would.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "picoquic_internal.h"
+#include "picoquic_utils.h"
+
+#define ACK_BENCH_STEPS_DEFAULT 200000
+#define ACK_BENCH_LOSSES_PER_WINDOW 8
+
+typedef struct st_ack_bench_ctx_t {
+    picoquic_quic_t* quic;
+    picoquic_cnx_t* cnx;
+    uint64_t simulated_time;
+    uint64_t nb_in_flight;
+    uint64_t loss_interval;
+    uint64_t next_to_ack;
+    uint64_t pn64;
+    uint64_t holes[2 * ACK_BENCH_LOSSES_PER_WINDOW + 4];
+    int nb_holes;
+} ack_bench_ctx_t;
+
+static int ack_bench_send(ack_bench_ctx_t* ctx)
+{
+    picoquic_packet_context_t* pkt_ctx = &ctx->cnx->pkt_ctx[picoquic_packet_context_application];
+    picoquic_packet_t* packet = picoquic_create_packet(ctx->quic);
+
+    if (packet == NULL) {
+        return -1;
+    }
+    packet->sequence_number = pkt_ctx->send_sequence++;
+    packet->ptype = picoquic_packet_1rtt_protected;
+    packet->pc = picoquic_packet_context_application;
+    packet->send_path = ctx->cnx->path[0];
+    packet->send_time = ctx->simulated_time;
+    packet->offset = 20;
+    packet->bytes[packet->offset] = picoquic_frame_type_ping;
+    packet->length = packet->offset + 1;
+    packet->is_ack_eliciting = 1;
+    picoquic_queue_for_retransmit(ctx->cnx, ctx->cnx->path[0], packet, packet->length, ctx->simulated_time);
+
+    if (packet->sequence_number % ctx->loss_interval == ctx->loss_interval / 2) {
+        ctx->holes[ctx->nb_holes++] = packet->sequence_number;
+    }
+
+    return 0;
+}
+
+/* Acknowledge the oldest packet in flight, with one range per lost packet */
+static int ack_bench_receive_ack(ack_bench_ctx_t* ctx)
+{
+    picoquic_packet_context_t* pkt_ctx = &ctx->cnx->pkt_ctx[picoquic_packet_context_application];
+    uint8_t ack[256];
+    uint8_t* bytes = ack;
+    uint8_t* bytes_max = ack + sizeof(ack);
+    uint64_t largest;
+    uint64_t lowest;
+    uint64_t high;
+    int nb_gaps = 0;
+
+    /* Lost packets are declared lost after one window */
+    while (ctx->nb_holes > 0 && ctx->holes[0] + ctx->nb_in_flight < ctx->next_to_ack) {
+        picoquic_packet_t* lost = picoquic_sent_ring_find(pkt_ctx, ctx->holes[0]);
+        if (lost != NULL) {
+            (void)picoquic_dequeue_retransmit_packet(ctx->cnx, pkt_ctx, lost, 1, 0);
+        }
+        ctx->nb_holes--;
+        memmove(ctx->holes, ctx->holes + 1, ctx->nb_holes * sizeof(uint64_t));
+    }
+    for (int i = 0; i < ctx->nb_holes; i++) {
+        if (ctx->holes[i] == ctx->next_to_ack) {
+            ctx->next_to_ack++;
+        }
+    }
+    largest = ctx->next_to_ack++;
+    lowest = (largest > ctx->nb_in_flight) ? largest - ctx->nb_in_flight : 0;
+    for (int i = 0; i < ctx->nb_holes; i++) {
+        if (ctx->holes[i] > lowest && ctx->holes[i] < largest) {
+            nb_gaps++;
+        }
+    }
+
+    bytes = picoquic_frames_uint8_encode(bytes, bytes_max, picoquic_frame_type_ack);
+    bytes = picoquic_frames_varint_encode(bytes, bytes_max, largest);
+    bytes = picoquic_frames_varint_encode(bytes, bytes_max, 0);
+    bytes = picoquic_frames_varint_encode(bytes, bytes_max, nb_gaps);
+    high = largest;
+    for (int i = ctx->nb_holes - 1; bytes != NULL && i >= 0; i--) {
+        if (ctx->holes[i] > lowest && ctx->holes[i] < largest) {
+            bytes = picoquic_frames_varint_encode(bytes, bytes_max, high - ctx->holes[i] - 1);
+            bytes = picoquic_frames_varint_encode(bytes, bytes_max, 0);
+            high = ctx->holes[i] - 1;
+        }
+    }
+    bytes = picoquic_frames_varint_encode(bytes, bytes_max, high - lowest);
+
+    if (bytes == NULL) {
+        return -1;
+    }
+    return picoquic_decode_frames(ctx->cnx, ctx->cnx->path[0], ack, bytes - ack, NULL, picoquic_epoch_1rtt,
+        NULL, NULL, ctx->pn64++, 0, ctx->simulated_time);
+}
+
+/* Run the workload, return the elapsed time in microseconds, or 0 on error */
+static uint64_t ack_bench_run(uint64_t nb_in_flight, int nb_steps)
+{
+    ack_bench_ctx_t ctx;
+    struct sockaddr_storage addr;
+    uint64_t start_time;
+    uint64_t elapsed = 0;
+    int ret = 0;
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.nb_in_flight = nb_in_flight;
+    ctx.loss_interval = nb_in_flight / ACK_BENCH_LOSSES_PER_WINDOW;
+    ctx.simulated_time = 1000000;
+    ctx.quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+        ctx.simulated_time, &ctx.simulated_time, NULL, NULL, 0);
+    if (ctx.quic == NULL || picoquic_store_text_addr(&addr, "10.0.0.1", 4433) != 0 ||
+        (ctx.cnx = picoquic_create_cnx(ctx.quic, picoquic_null_connection_id, picoquic_null_connection_id,
+            (struct sockaddr*)&addr, ctx.simulated_time, 0, "test-sni", "test-alpn", 1)) == NULL) {
+        fprintf(stderr, "Cannot create the connection context\n");
+        ret = -1;
+    }
+    else {
+        ctx.next_to_ack = ctx.cnx->pkt_ctx[picoquic_packet_context_application].send_sequence;
+        for (uint64_t i = 0; ret == 0 && i < nb_in_flight; i++) {
+            ret = ack_bench_send(&ctx);
+        }
+    }
+
+    start_time = picoquic_current_time();
+    for (int step = 0; ret == 0 && step < nb_steps; step++) {
+        ctx.simulated_time += 10;
+        /* Skipping lost packets may acknowledge more than one per step */
+        while (ret == 0 && ctx.cnx->pkt_ctx[picoquic_packet_context_application].send_sequence <=
+            ctx.next_to_ack + nb_in_flight) {
+            ret = ack_bench_send(&ctx);
+        }
+        if (ret == 0) {
+            ret = ack_bench_receive_ack(&ctx);
+        }
+    }
+    elapsed = picoquic_current_time() - start_time;
+
+    if (ret != 0) {
+        fprintf(stderr, "ACK processing failed, %" PRIu64 " packets in flight\n", nb_in_flight);
+        elapsed = 0;
+    }
+    if (ctx.quic != NULL) {
+        picoquic_free(ctx.quic);
+    }
+
+    return elapsed;
+}
+
+int main(int argc, char** argv)
+{
+    const uint64_t nb_in_flight[4] = { 1000, 10000, 50000, 100000 };
+    int nb_steps = ACK_BENCH_STEPS_DEFAULT;
+
+    if (argc > 1) {
+        nb_steps = atoi(argv[1]);
+        if (nb_steps <= 0) {
+            fprintf(stderr, "Usage: %s [nb_steps]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    printf("In flight, ns/ack\n");
+    for (int i = 0; i < 4; i++) {
+        uint64_t elapsed = ack_bench_run(nb_in_flight[i], nb_steps);
+
+        if (elapsed == 0) {
+            return 1;
+        }
+        printf("%9" PRIu64 ", %7.1f\n", nb_in_flight[i], ((double)elapsed) * 1000.0 / nb_steps);
+    }
+
+    return 0;
+}
@@ -0,0 +1,548 @@
+/*
+* Copyright (c) 2026, the picoquic contributors.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Performance matrix of the congestion control algorithms.
+ *
+ * Runs each congestion control algorithm over a matrix of simulated
+ * network scenarios: bandwidth, RTT, bottleneck buffer, random loss,
+ * jitter, and number of competing flows. Each flow is a connection
+ * uploading an unbounded stream from client to server. All connections
+ * share the same bottleneck link, simulated with sim_link in simulated
+ * time, so the results are reproducible.
+ *
+ * The flows start at regular intervals. The measurement covers the
+ * time from the start of the last flow to the end of the scenario. For
+ * each algorithm and scenario, the program writes one CSV line with:
+ *
+ * - the aggregate goodput, and the fraction of the link rate it uses,
+ * - the median and 99th percentile of the bottleneck queuing delay,
+ * - the fraction of packets lost at the bottleneck, by overflow or
+ *   random loss,
+ * - Jain's fairness index of the goodput of the competing flows.
+ *
+ * The connections perform a full handshake, so the program only runs
+ * in a build with the TLS backend.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "picoquic.h"
+#include "picoquic_internal.h"
+#include "picoquic_utils.h"
+
+#define CC_BENCH_ALPN "cc-bench"
+#define CC_BENCH_DURATION_DEFAULT 10
+#define CC_BENCH_MAX_FLOWS 8
+
+typedef struct st_cc_bench_scenario_t {
+    char const* name;
+    double mbps;
+    uint64_t rtt_ms;
+    double buffer_bdp; /* Bottleneck buffer, as a fraction of the bandwidth delay product */
+    uint64_t loss_ppm; /* Random loss, in packets per million */
+    uint64_t jitter_ms;
+    int nb_flows;
+    uint64_t flow_interval_ms; /* Delay between the start of successive flows */
+    char const* competing_alg; /* If set, all flows but the first use this algorithm */
+} cc_bench_scenario_t;
+
+static const cc_bench_scenario_t cc_bench_scenarios[] = {
+    { "base", 10.0, 40, 1.0, 0, 0, 1, 0, NULL },
+    { "high_bw", 200.0, 20, 1.0, 0, 0, 1, 0, NULL },
+    { "long_rtt", 10.0, 300, 1.0, 0, 0, 1, 0, NULL },
+    { "shallow_buffer", 50.0, 40, 0.1, 0, 0, 1, 0, NULL },
+    { "deep_buffer", 50.0, 40, 4.0, 0, 0, 1, 0, NULL },
+    { "loss_0.1pct", 50.0, 40, 1.0, 1000, 0, 1, 0, NULL },
+    { "loss_1pct", 50.0, 40, 1.0, 10000, 0, 1, 0, NULL },
+    { "jitter", 50.0, 40, 1.0, 0, 5, 1, 0, NULL },
+    { "compete_2", 50.0, 40, 1.0, 0, 0, 2, 1000, NULL },
+    { "compete_4", 50.0, 40, 1.0, 0, 0, 4, 500, NULL },
+    { "vs_cubic", 50.0, 40, 1.0, 0, 0, 2, 1000, "cubic" },
+    { "vs_reno", 50.0, 40, 1.0, 0, 0, 2, 1000, "reno" }
+};
+
+static const size_t nb_cc_bench_scenarios = sizeof(cc_bench_scenarios) / sizeof(cc_bench_scenario_t);
+
+
+typedef struct st_cc_bench_flow_t {
+    picoquic_cnx_t* cnx_client;
+    uint64_t start_time;
+    uint64_t bytes_received;
+    uint64_t bytes_at_measure_start;
+} cc_bench_flow_t;
+
+typedef struct st_cc_bench_result_t {
+    double goodput_mbps;
+    double utilization;
+    double queue_p50_ms;
+    double queue_p99_ms;
+    double loss_rate;
+    double fairness;
+} cc_bench_result_t;
+
+typedef struct st_cc_bench_ctx_t {
+    cc_bench_scenario_t const* scenario;
+    uint64_t simulated_time;
+    uint64_t end_time;
+    uint64_t measure_start;
+    int is_measuring;
+    picoquic_quic_t* qclient;
+    picoquic_quic_t* qserver;
+    picoquictest_sim_link_t* data_link;
+    picoquictest_sim_link_t* return_link;
+    struct sockaddr_storage client_addr;
+    struct sockaddr_storage server_addr;
+    int nb_flows_started;
+    cc_bench_flow_t flows[CC_BENCH_MAX_FLOWS];
+    uint64_t random_ctx;
+    /* Bottleneck statistics, collected during the measurement */
+    uint64_t nb_submitted;
+    uint64_t nb_random_losses;
+    uint64_t nb_dropped_at_start;
+    uint32_t* queue_delays;
+    size_t nb_queue_delays;
+    size_t queue_delays_max;
+} cc_bench_ctx_t;
+
+/* The client sends an unbounded stream of data */
+static int cc_bench_client_callback(picoquic_cnx_t* cnx,
+    uint64_t stream_id, uint8_t* bytes, size_t length,
+    picoquic_call_back_event_t fin_or_event, void* callback_ctx, void* v_stream_ctx)
+{
+    (void)cnx;
+    (void)stream_id;
+    (void)callback_ctx;
+    (void)v_stream_ctx;
+
+    if (fin_or_event == picoquic_callback_prepare_to_send) {
+        uint8_t* buffer = picoquic_provide_stream_data_buffer(bytes, length, 0, 1);
+
+        if (buffer == NULL) {
+            return -1;
+        }
+        memset(buffer, 0x5a, length);
+    }
+    return 0;
+}
+
+/* The server counts the bytes received on each connection. The flow is
+ * found by matching the initial connection ID chosen by the client. */
+static int cc_bench_server_callback(picoquic_cnx_t* cnx,
+    uint64_t stream_id, uint8_t* bytes, size_t length,
+    picoquic_call_back_event_t fin_or_event, void* callback_ctx, void* v_stream_ctx)
+{
+    cc_bench_ctx_t* ctx = (cc_bench_ctx_t*)callback_ctx;
+    (void)stream_id;
+    (void)bytes;
+    (void)v_stream_ctx;
+
+    if (fin_or_event == picoquic_callback_stream_data || fin_or_event == picoquic_callback_stream_fin) {
+        for (int i = 0; i < ctx->nb_flows_started; i++) {
+            if (picoquic_compare_connection_id(&cnx->initial_cnxid, &ctx->flows[i].cnx_client->initial_cnxid) == 0) {
+                ctx->flows[i].bytes_received += length;
+                break;
+            }
+        }
+    }
+    return 0;
+}
+
+static int cc_bench_start_flow(cc_bench_ctx_t* ctx, char const* alg_name)
+{
+    int ret = 0;
+    cc_bench_flow_t* flow = &ctx->flows[ctx->nb_flows_started];
+    char const* flow_alg_name = (ctx->nb_flows_started > 0 && ctx->scenario->competing_alg != NULL) ?
+        ctx->scenario->competing_alg : alg_name;
+
+    flow->start_time = ctx->simulated_time;
+    flow->cnx_client = picoquic_create_cnx(ctx->qclient, picoquic_null_connection_id, picoquic_null_connection_id,
+        (struct sockaddr*)&ctx->server_addr, ctx->simulated_time, 0, PICOQUIC_TEST_SNI, CC_BENCH_ALPN, 1);
+
+    if (flow->cnx_client == NULL) {
+        ret = -1;
+    }
+    else {
+        picoquic_set_congestion_algorithm(flow->cnx_client, picoquic_get_congestion_algorithm(flow_alg_name));
+        picoquic_set_callback(flow->cnx_client, cc_bench_client_callback, ctx);
+        ret = picoquic_mark_active_stream(flow->cnx_client, 0, 1, NULL);
+        if (ret == 0) {
+            ret = picoquic_start_client_cnx(flow->cnx_client);
+        }
+        ctx->nb_flows_started++;
+    }
+    return ret;
+}
+
+/* Submit a packet to a link, recording the bottleneck statistics on the data link */
+static int cc_bench_submit(cc_bench_ctx_t* ctx, picoquictest_sim_link_t* link, picoquictest_sim_packet_t* packet)
+{
+    int ret = 0;
+
+    if (link == ctx->data_link && ctx->is_measuring) {
+        uint64_t queue_delay = (link->queue_time > ctx->simulated_time) ? link->queue_time - ctx->simulated_time : 0;
+
+        ctx->nb_submitted++;
+        if (ctx->nb_queue_delays >= ctx->queue_delays_max) {
+            size_t new_max = (ctx->queue_delays_max == 0) ? 0x10000 : 2 * ctx->queue_delays_max;
+            uint32_t* new_delays = (uint32_t*)realloc(ctx->queue_delays, new_max * sizeof(uint32_t));
+
+            if (new_delays == NULL) {
+                ret = -1;
+            }
+            else {
+                ctx->queue_delays = new_delays;
+                ctx->queue_delays_max = new_max;
+            }
+        }
+        if (ret == 0) {
+            ctx->queue_delays[ctx->nb_queue_delays++] = (queue_delay > UINT32_MAX) ? UINT32_MAX : (uint32_t)queue_delay;
+        }
+    }
+
+    if (link == ctx->data_link && ctx->scenario->loss_ppm > 0 &&
+        picoquic_test_uniform_random(&ctx->random_ctx, 1000000) < ctx->scenario->loss_ppm) {
+        if (ctx->is_measuring) {
+            ctx->nb_random_losses++;
+        }
+        free(packet);
+    }
+    else {
+        picoquictest_sim_link_submit(link, packet, ctx->simulated_time);
+    }
+
+    return ret;
+}
+
+/* Send all the packets that the endpoint is ready to send */
+static int cc_bench_send(cc_bench_ctx_t* ctx, picoquic_quic_t* quic, picoquictest_sim_link_t* link,
+    struct sockaddr_storage* local_addr)
+{
+    int ret = 0;
+
+    while (ret == 0) {
+        picoquictest_sim_packet_t* packet = picoquictest_sim_link_create_packet();
+        int if_index = 0;
+        picoquic_connection_id_t log_cid;
+        picoquic_cnx_t* last_cnx = NULL;
+
+        if (packet == NULL) {
+            ret = -1;
+            break;
+        }
+        ret = picoquic_prepare_next_packet(quic, ctx->simulated_time, packet->bytes, sizeof(packet->bytes),
+            &packet->length, &packet->addr_to, &packet->addr_from, &if_index, &log_cid, &last_cnx);
+        if (ret != 0 || packet->length == 0) {
+            free(packet);
+            break;
+        }
+        if (packet->addr_from.ss_family == 0) {
+            picoquic_store_addr(&packet->addr_from, (struct sockaddr*)local_addr);
+        }
+        ret = cc_bench_submit(ctx, link, packet);
+    }
+
+    return ret;
+}
+
+static int cc_bench_receive(cc_bench_ctx_t* ctx, picoquic_quic_t* quic, picoquictest_sim_link_t* link)
+{
+    int ret = 0;
+    picoquictest_sim_packet_t* packet;
+
+    while (ret == 0 && (packet = picoquictest_sim_link_dequeue(link, ctx->simulated_time)) != NULL) {
+        ret = picoquic_incoming_packet(quic, packet->bytes, packet->length,
+            (struct sockaddr*)&packet->addr_from, (struct sockaddr*)&packet->addr_to, 0,
+            packet->ecn_mark, ctx->simulated_time);
+        free(packet);
+    }
+
+    return ret;
+}
+
+static void cc_bench_start_measure(cc_bench_ctx_t* ctx)
+{
+    ctx->is_measuring = 1;
+    ctx->measure_start = ctx->simulated_time;
+    ctx->nb_dropped_at_start = ctx->data_link->packets_dropped;
+    for (int i = 0; i < ctx->nb_flows_started; i++) {
+        ctx->flows[i].bytes_at_measure_start = ctx->flows[i].bytes_received;
+    }
+}
+
+static int cc_bench_compare_delays(const void* a, const void* b)
+{
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+
+    return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+static void cc_bench_compute_result(cc_bench_ctx_t* ctx, cc_bench_result_t* result)
+{
+    double duration = (double)(ctx->end_time - ctx->measure_start);
+    double sum_x = 0;
+    double sum_x2 = 0;
+    uint64_t nb_lost = ctx->data_link->packets_dropped - ctx->nb_dropped_at_start + ctx->nb_random_losses;
+
+    memset(result, 0, sizeof(cc_bench_result_t));
+    for (int i = 0; i < ctx->nb_flows_started; i++) {
+        double x = (double)(ctx->flows[i].bytes_received - ctx->flows[i].bytes_at_measure_start);
+
+        sum_x += x;
+        sum_x2 += x * x;
+    }
+    if (duration > 0) {
+        result->goodput_mbps = (sum_x * 8.0) / duration;
+        result->utilization = result->goodput_mbps / ctx->scenario->mbps;
+    }
+    if (sum_x2 > 0) {
+        result->fairness = (sum_x * sum_x) / (ctx->nb_flows_started * sum_x2);
+    }
+    if (ctx->nb_queue_delays > 0) {
+        qsort(ctx->queue_delays, ctx->nb_queue_delays, sizeof(uint32_t), cc_bench_compare_delays);
+        result->queue_p50_ms = ((double)ctx->queue_delays[ctx->nb_queue_delays / 2]) / 1000.0;
+        result->queue_p99_ms = ((double)ctx->queue_delays[(ctx->nb_queue_delays * 99) / 100]) / 1000.0;
+    }
+    if (ctx->nb_submitted > 0) {
+        result->loss_rate = ((double)nb_lost) / ((double)ctx->nb_submitted);
+    }
+}
+
+static void cc_bench_delete_ctx(cc_bench_ctx_t* ctx)
+{
+    if (ctx->qclient != NULL) {
+        picoquic_free(ctx->qclient);
+    }
+    if (ctx->qserver != NULL) {
+        picoquic_free(ctx->qserver);
+    }
+    if (ctx->data_link != NULL) {
+        picoquictest_sim_link_delete(ctx->data_link);
+    }
+    if (ctx->return_link != NULL) {
+        picoquictest_sim_link_delete(ctx->return_link);
+    }
+    if (ctx->queue_delays != NULL) {
+        free(ctx->queue_delays);
+    }
+}
+
+static int cc_bench_run(char const* solution_dir, char const* alg_name, cc_bench_scenario_t const* scenario,
+    uint64_t duration_sec, cc_bench_result_t* result)
+{
+    int ret = 0;
+    cc_bench_ctx_t ctx;
+    char cert_file[512];
+    char key_file[512];
+    char cert_store_file[512];
+    double data_rate_gbps = scenario->mbps / 1000.0;
+    uint64_t bdp_delay = scenario->rtt_ms * 1000;
+    uint64_t next_flow_time = 0;
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.scenario = scenario;
+    ctx.random_ctx = 0xcc0bec4a11ull;
+    ctx.end_time = (scenario->nb_flows - 1) * scenario->flow_interval_ms * 1000 + duration_sec * 1000000;
+
+    if (picoquic_store_text_addr(&ctx.client_addr, "10.0.0.2", 1234) != 0 ||
+        picoquic_store_text_addr(&ctx.server_addr, "10.0.0.1", 4433) != 0) {
+        ret = -1;
+    }
+    else if (picoquic_get_input_path(cert_file, sizeof(cert_file), solution_dir, PICOQUIC_TEST_FILE_SERVER_CERT) != 0 ||
+        picoquic_get_input_path(key_file, sizeof(key_file), solution_dir, PICOQUIC_TEST_FILE_SERVER_KEY) != 0 ||
+        picoquic_get_input_path(cert_store_file, sizeof(cert_store_file), solution_dir, PICOQUIC_TEST_FILE_CERT_STORE) != 0) {
+        fprintf(stderr, "Cannot find the certificate files in %s\n", solution_dir);
+        ret = -1;
+    }
+    else if ((ctx.qclient = picoquic_create(CC_BENCH_MAX_FLOWS, NULL, NULL, cert_store_file, NULL, NULL, NULL,
+        NULL, NULL, NULL, ctx.simulated_time, &ctx.simulated_time, NULL, NULL, 0)) == NULL ||
+        (ctx.qserver = picoquic_create(CC_BENCH_MAX_FLOWS, cert_file, key_file, cert_store_file, CC_BENCH_ALPN,
+            cc_bench_server_callback, &ctx, NULL, NULL, NULL, ctx.simulated_time, &ctx.simulated_time,
+            NULL, NULL, 0)) == NULL) {
+        fprintf(stderr, "Cannot create the QUIC contexts\n");
+        ret = -1;
+    }
+    else if ((ctx.data_link = picoquictest_sim_link_create(data_rate_gbps, bdp_delay / 2, NULL,
+        (uint64_t)(scenario->buffer_bdp * (double)bdp_delay), ctx.simulated_time)) == NULL ||
+        (ctx.return_link = picoquictest_sim_link_create(data_rate_gbps, bdp_delay / 2, NULL, 0,
+            ctx.simulated_time)) == NULL) {
+        fprintf(stderr, "Cannot create the simulated links\n");
+        ret = -1;
+    }
+    else {
+        ctx.data_link->jitter = scenario->jitter_ms * 1000;
+    }
+
+    while (ret == 0 && ctx.simulated_time < ctx.end_time) {
+        uint64_t next_time = ctx.end_time;
+
+        if (ctx.nb_flows_started < scenario->nb_flows) {
+            if (next_flow_time <= ctx.simulated_time) {
+                ret = cc_bench_start_flow(&ctx, alg_name);
+                next_flow_time += scenario->flow_interval_ms * 1000;
+                if (ctx.nb_flows_started == scenario->nb_flows) {
+                    cc_bench_start_measure(&ctx);
+                }
+            }
+            if (next_flow_time < next_time) {
+                next_time = next_flow_time;
+            }
+        }
+        if (ret == 0) {
+            ret = cc_bench_receive(&ctx, ctx.qserver, ctx.data_link);
+        }
+        if (ret == 0) {
+            ret = cc_bench_receive(&ctx, ctx.qclient, ctx.return_link);
+        }
+        if (ret == 0) {
+            ret = cc_bench_send(&ctx, ctx.qclient, ctx.data_link, &ctx.client_addr);
+        }
+        if (ret == 0) {
+            ret = cc_bench_send(&ctx, ctx.qserver, ctx.return_link, &ctx.server_addr);
+        }
+        if (ret == 0) {
+            uint64_t wake_time = picoquic_get_next_wake_time(ctx.qclient, ctx.simulated_time);
+
+            if (wake_time < next_time) {
+                next_time = wake_time;
+            }
+            wake_time = picoquic_get_next_wake_time(ctx.qserver, ctx.simulated_time);
+            if (wake_time < next_time) {
+                next_time = wake_time;
+            }
+            next_time = picoquictest_sim_link_next_arrival(ctx.data_link, next_time);
+            next_time = picoquictest_sim_link_next_arrival(ctx.return_link, next_time);
+            if (next_time > ctx.simulated_time) {
+                ctx.simulated_time = next_time;
+            }
+        }
+    }
+
+    if (ret == 0) {
+        cc_bench_compute_result(&ctx, result);
+    }
+    cc_bench_delete_ctx(&ctx);
+
+    return ret;
+}
+
+static void cc_bench_usage(char const* argv0)
+{
+    fprintf(stderr, "Usage: %s [-S solution_dir] [-a algorithm] [-s scenario] [-d seconds] [-o report.csv]\n", argv0);
+    fprintf(stderr, "  -S solution_dir  directory containing the certs folder, default \".\"\n");
+    fprintf(stderr, "  -a algorithm     only test this algorithm, e.g. \"bbr\"\n");
+    fprintf(stderr, "  -s scenario      only run this scenario, e.g. \"compete_2\"\n");
+    fprintf(stderr, "  -d seconds       simulated duration of each scenario, default %d\n", CC_BENCH_DURATION_DEFAULT);
+    fprintf(stderr, "  -o report.csv    write the report to this file instead of stdout\n");
+}
+
+int main(int argc, char** argv)
+{
+    int ret = 0;
+    char const* solution_dir = ".";
+    char const* alg_filter = NULL;
+    char const* alg_name = NULL;
+    char const* scenario_filter = NULL;
+    char const* report_name = NULL;
+    uint64_t duration_sec = CC_BENCH_DURATION_DEFAULT;
+    FILE* F = stdout;
+    int nb_runs = 0;
+
+    for (int i = 1; ret == 0 && i < argc; i++) {
+        if (i + 1 < argc && strcmp(argv[i], "-S") == 0) {
+            solution_dir = argv[++i];
+        }
+        else if (i + 1 < argc && strcmp(argv[i], "-a") == 0) {
+            alg_filter = argv[++i];
+        }
+        else if (i + 1 < argc && strcmp(argv[i], "-s") == 0) {
+            scenario_filter = argv[++i];
+        }
+        else if (i + 1 < argc && strcmp(argv[i], "-d") == 0) {
+            int d = atoi(argv[++i]);
+            if (d <= 0) {
+                ret = -1;
+            }
+            duration_sec = (uint64_t)d;
+        }
+        else if (i + 1 < argc && strcmp(argv[i], "-o") == 0) {
+            report_name = argv[++i];
+        }
+        else {
+            ret = -1;
+        }
+    }
+    if (ret == 0 && alg_filter != NULL && picoquic_get_congestion_algorithm(alg_filter) == NULL) {
+        fprintf(stderr, "Unknown algorithm: %s\n", alg_filter);
+        ret = -1;
+    }
+    if (ret != 0) {
+        cc_bench_usage(argv[0]);
+        return 1;
+    }
+
+    if (report_name != NULL && (F = picoquic_file_open(report_name, "w")) == NULL) {
+        fprintf(stderr, "Cannot open %s\n", report_name);
+        return 1;
+    }
+
+    fprintf(F, "algorithm, scenario, mbps, rtt_ms, buffer_bdp, loss_ppm, jitter_ms, flows, goodput_mbps, utilization, queue_p50_ms, queue_p99_ms, loss_rate, fairness\n");
+    /* Run every congestion control algorithm registered in the stack */
+    for (size_t a = 0; ret == 0 && (alg_name = picoquic_get_congestion_algorithm_name(a)) != NULL; a++) {
+        if (alg_filter != NULL && strcmp(alg_filter, alg_name) != 0) {
+            continue;
+        }
+        for (size_t s = 0; ret == 0 && s < nb_cc_bench_scenarios; s++) {
+            cc_bench_scenario_t const* scenario = &cc_bench_scenarios[s];
+            cc_bench_result_t result;
+
+            if (scenario_filter != NULL && strcmp(scenario_filter, scenario->name) != 0) {
+                continue;
+            }
+            ret = cc_bench_run(solution_dir, alg_name, scenario, duration_sec, &result);
+            if (ret != 0) {
+                fprintf(stderr, "Simulation failed, algorithm %s, scenario %s\n", alg_name, scenario->name);
+            }
+            else {
+                fprintf(F, "%s, %s, %.1f, %" PRIu64 ", %.2f, %" PRIu64 ", %" PRIu64 ", %d, %.3f, %.3f, %.3f, %.3f, %.5f, %.3f\n",
+                    alg_name, scenario->name, scenario->mbps, scenario->rtt_ms, scenario->buffer_bdp,
+                    scenario->loss_ppm, scenario->jitter_ms, scenario->nb_flows,
+                    result.goodput_mbps, result.utilization, result.queue_p50_ms, result.queue_p99_ms,
+                    result.loss_rate, result.fairness);
+                fflush(F);
+                nb_runs++;
+            }
+        }
+    }
+
+    if (ret == 0 && nb_runs == 0) {
+        fprintf(stderr, "No scenario matches %s\n", scenario_filter);
+        ret = -1;
+    }
+
+    if (F != stdout) {
+        (void)picoquic_file_close(F);
+    }
+
+    return (ret == 0) ? 0 : 1;
+}
@@ -0,0 +1,393 @@
+/*
+* Copyright (c) 2026, the picoquic contributors.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+/* Micro benchmark of frame parsing.
+ *
+ * Measures the parsing throughput of the frames carried in the 1-RTT
+ * packets recorded in binary logs, such as those written by the test
+ * suite. The logs keep the header of STREAM frames but only the first
+ * bytes of the stream data, so the packets are rebuilt with each STREAM
+ * frame carrying an explicit length and filler data of that length.
+ *
+ * Each packet is parsed as in picoquic_decode_frames: STREAM and ACK
+ * frames with their header parsers, other frames with the generic
+ * picoquic_skip_frame. The packets are parsed by batches of 64, each
+ * batch repeatedly, so the measure reflects the parsing cost rather than
+ * the cache misses of a large capture. The result is reported in ns per
+ * packet and in Gbps of frame bytes.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "picoquic_internal.h"
+#include "picoquic_utils.h"
+#include "bytestream.h"
+#include "logreader.h"
+#include "cidset.h"
+
+#define FRAME_PARSE_BENCH_ROUNDS_DEFAULT 1000
+#define FRAME_PARSE_BENCH_DEFAULT_LOG "picoquictest/binlog_ref.log"
+#define FRAME_PARSE_BENCH_BATCH 64
+
+typedef struct st_frame_parse_bench_ctx_t {
+    uint8_t* packets;
+    size_t* packet_length;
+    size_t nb_packets;
+    size_t nb_packets_max;
+    size_t nb_bytes;
+    uint8_t current[PICOQUIC_MAX_PACKET_SIZE];
+    size_t current_length;
+    int is_1rtt;
+    int is_truncated;
+    FILE* f_binlog;
+} frame_parse_bench_ctx_t;
+
+static int frame_parse_bench_connection_start(uint64_t time, const picoquic_connection_id_t* cid, int client_mode,
+    uint32_t proposed_version, const picoquic_connection_id_t* remote_cnxid, void* ptr)
+{
+    (void)time;
+    (void)cid;
+    (void)client_mode;
+    (void)proposed_version;
+    (void)remote_cnxid;
+    (void)ptr;
+    return 0;
+}
+
+static int frame_parse_bench_ignore_event(uint64_t time, bytestream* s, void* ptr)
+{
+    (void)time;
+    (void)s;
+    (void)ptr;
+    return 0;
+}
+
+static int frame_parse_bench_ignore_pdu(uint64_t time, int rxtx, bytestream* s, void* ptr)
+{
+    (void)rxtx;
+    return frame_parse_bench_ignore_event(time, s, ptr);
+}
+
+static int frame_parse_bench_ignore_path_event(uint64_t time, uint64_t path_id, bytestream* s, void* ptr)
+{
+    (void)path_id;
+    return frame_parse_bench_ignore_event(time, s, ptr);
+}
+
+static int frame_parse_bench_connection_end(uint64_t time, void* ptr)
+{
+    (void)time;
+    (void)ptr;
+    return 0;
+}
+
+static int frame_parse_bench_packet_start(uint64_t time, uint64_t path_id, uint64_t size,
+    const picoquic_packet_header* ph, int rxtx, void* ptr)
+{
+    frame_parse_bench_ctx_t* ctx = (frame_parse_bench_ctx_t*)ptr;
+
+    (void)time;
+    (void)path_id;
+    (void)size;
+    (void)rxtx;
+    ctx->is_1rtt = (ph->ptype == picoquic_packet_1rtt_protected);
+    ctx->is_truncated = 0;
+    ctx->current_length = 0;
+
+    return 0;
+}
+
+/* Rebuild a STREAM frame from its logged header: the length is always
+ * present in the log, even if the frame type did not have the length bit,
+ * and only the first bytes of data are kept. */
+static size_t frame_parse_bench_rebuild_stream(uint8_t* buffer, size_t buffer_size, const uint8_t* frame, size_t frame_length)
+{
+    const uint8_t* bytes = frame + 1;
+    const uint8_t* bytes_max = frame + frame_length;
+    const uint8_t* data;
+    uint64_t data_length = 0;
+    size_t header_length;
+    size_t rebuilt_length = 0;
+
+    if ((bytes = picoquic_frames_varint_skip(bytes, bytes_max)) != NULL &&
+        ((frame[0] & 4) == 0 || (bytes = picoquic_frames_varint_skip(bytes, bytes_max)) != NULL) &&
+        (data = picoquic_frames_varint_decode(bytes, bytes_max, &data_length)) != NULL) {
+        header_length = data - frame;
+        if (header_length + data_length <= buffer_size) {
+            memcpy(buffer, frame, header_length);
+            buffer[0] |= 2;
+            memset(buffer + header_length, 0x5a, (size_t)data_length);
+            memcpy(buffer + header_length, data, (size_t)((bytes_max - data < (ptrdiff_t)data_length) ? (size_t)(bytes_max - data) : data_length));
+            rebuilt_length = header_length + (size_t)data_length;
+        }
+    }
+
+    return rebuilt_length;
+}
+
+static int frame_parse_bench_packet_frame(bytestream* s, void* ptr)
+{
+    frame_parse_bench_ctx_t* ctx = (frame_parse_bench_ctx_t*)ptr;
+    const uint8_t* frame = bytestream_data(s);
+    size_t frame_length = bytestream_size(s);
+
+    if (ctx->is_1rtt && !ctx->is_truncated && frame_length > 0) {
+        uint8_t* buffer = ctx->current + ctx->current_length;
+        size_t buffer_size = sizeof(ctx->current) - ctx->current_length;
+        size_t rebuilt_length = 0;
+
+        if (PICOQUIC_IN_RANGE(frame[0], picoquic_frame_type_stream_range_min, picoquic_frame_type_stream_range_max)) {
+            rebuilt_length = frame_parse_bench_rebuild_stream(buffer, buffer_size, frame, frame_length);
+        }
+        else {
+            size_t consumed = 0;
+            int pure_ack = 0;
+
+            if (picoquic_skip_frame(frame, frame_length, &consumed, &pure_ack) != 0 || consumed != frame_length) {
+                /* Frames such as CRYPTO or DATAGRAM are also truncated in the log, ignore them */
+                return 0;
+            }
+            if (frame_length <= buffer_size) {
+                memcpy(buffer, frame, frame_length);
+                rebuilt_length = frame_length;
+            }
+        }
+
+        if (rebuilt_length == 0) {
+            /* Keep the frames that could be rebuilt so far */
+            ctx->is_truncated = 1;
+        }
+        else {
+            ctx->current_length += rebuilt_length;
+        }
+    }
+
+    return 0;
+}
+
+static int frame_parse_bench_packet_end(void* ptr)
+{
+    int ret = 0;
+    frame_parse_bench_ctx_t* ctx = (frame_parse_bench_ctx_t*)ptr;
+
+    if (ctx->is_1rtt && ctx->current_length > 0) {
+        if (ctx->nb_packets >= ctx->nb_packets_max) {
+            size_t new_max = (ctx->nb_packets_max == 0) ? 256 : 2 * ctx->nb_packets_max;
+            uint8_t* new_packets = (uint8_t*)realloc(ctx->packets, new_max * PICOQUIC_MAX_PACKET_SIZE);
+            size_t* new_length = (new_packets == NULL) ? NULL :
+                (size_t*)realloc(ctx->packet_length, new_max * sizeof(size_t));
+
+            if (new_packets != NULL) {
+                ctx->packets = new_packets;
+            }
+            if (new_length == NULL) {
+                ret = -1;
+            }
+            else {
+                ctx->packet_length = new_length;
+                ctx->nb_packets_max = new_max;
+            }
+        }
+        if (ret == 0) {
+            memcpy(ctx->packets + ctx->nb_packets * PICOQUIC_MAX_PACKET_SIZE, ctx->current, ctx->current_length);
+            ctx->packet_length[ctx->nb_packets] = ctx->current_length;
+            ctx->nb_packets++;
+            ctx->nb_bytes += ctx->current_length;
+        }
+    }
+    ctx->current_length = 0;
+
+    return ret;
+}
+
+static int frame_parse_bench_load_cid(const picoquic_connection_id_t* cid, void* ptr)
+{
+    frame_parse_bench_ctx_t* ctx = (frame_parse_bench_ctx_t*)ptr;
+    binlog_convert_cb_t callbacks = { 0 };
+
+    callbacks.connection_start = frame_parse_bench_connection_start;
+    callbacks.connection_end = frame_parse_bench_connection_end;
+    callbacks.alpn_update = frame_parse_bench_ignore_event;
+    callbacks.param_update = frame_parse_bench_ignore_event;
+    callbacks.pdu = frame_parse_bench_ignore_pdu;
+    callbacks.packet_start = frame_parse_bench_packet_start;
+    callbacks.packet_frame = frame_parse_bench_packet_frame;
+    callbacks.packet_end = frame_parse_bench_packet_end;
+    callbacks.packet_lost = frame_parse_bench_ignore_path_event;
+    callbacks.packet_dropped = frame_parse_bench_ignore_path_event;
+    callbacks.packet_buffered = frame_parse_bench_ignore_path_event;
+    callbacks.cc_update = frame_parse_bench_ignore_path_event;
+    callbacks.info_message = frame_parse_bench_ignore_event;
+    callbacks.ptr = ctx;
+
+    return binlog_convert(ctx->f_binlog, cid, &callbacks);
+}
+
+static int frame_parse_bench_load(frame_parse_bench_ctx_t* ctx, char const* binlog_name)
+{
+    int ret = 0;
+    uint16_t flags = 0;
+    uint64_t log_time = 0;
+    picohash_table* cids = cidset_create();
+
+    if (cids == NULL) {
+        ret = -1;
+    }
+    else if ((ctx->f_binlog = picoquic_open_cc_log_file_for_read(binlog_name, &flags, &log_time)) == NULL) {
+        fprintf(stderr, "Cannot open binary log %s\n", binlog_name);
+        ret = -1;
+    }
+    else {
+        ret = binlog_list_cids(ctx->f_binlog, cids);
+        if (ret == 0) {
+            ret = cidset_iterate(cids, frame_parse_bench_load_cid, ctx);
+        }
+        if (ret != 0) {
+            fprintf(stderr, "Cannot read the packets in %s\n", binlog_name);
+        }
+        ctx->f_binlog = picoquic_file_close(ctx->f_binlog);
+    }
+    (void)cidset_delete(cids);
+
+    return ret;
+}
+
+/* Parse all the frames in the packet, return the number of frames or -1 on error */
+static int frame_parse_bench_packet(const uint8_t* bytes, size_t length)
+{
+    const uint8_t* bytes_max = bytes + length;
+    int nb_frames = 0;
+
+    while (nb_frames >= 0 && bytes != NULL && bytes < bytes_max) {
+        size_t consumed = 0;
+        int ret;
+
+        if (PICOQUIC_IN_RANGE(bytes[0], picoquic_frame_type_stream_range_min, picoquic_frame_type_stream_range_max)) {
+            uint64_t stream_id;
+            uint64_t offset;
+            size_t data_length;
+            int fin;
+
+            ret = picoquic_parse_stream_header(bytes, bytes_max - bytes, &stream_id, &offset, &data_length, &fin, &consumed);
+            bytes += consumed + data_length;
+        }
+        else if (bytes[0] == picoquic_frame_type_ack || bytes[0] == picoquic_frame_type_ack_ecn) {
+            uint64_t num_block;
+            uint64_t largest;
+            uint64_t ack_delay;
+            uint64_t value;
+            int nb_values;
+
+            ret = picoquic_parse_ack_header(bytes, bytes_max - bytes, &num_block, NULL, &largest, &ack_delay, &consumed, 3);
+            if (ret == 0) {
+                /* First range, then gap and range for each block, then ECN counts */
+                nb_values = 1 + 2 * (int)num_block + ((bytes[0] == picoquic_frame_type_ack_ecn) ? 3 : 0);
+                bytes += consumed;
+                for (int i = 0; bytes != NULL && i < nb_values; i++) {
+                    bytes = picoquic_frames_varint_decode(bytes, bytes_max, &value);
+                }
+            }
+        }
+        else {
+            int pure_ack;
+
+            ret = picoquic_skip_frame(bytes, bytes_max - bytes, &consumed, &pure_ack);
+            bytes += consumed;
+        }
+
+        nb_frames = (ret == 0 && bytes != NULL) ? nb_frames + 1 : -1;
+    }
+
+    return nb_frames;
+}
+
+int main(int argc, char** argv)
+{
+    int ret = 0;
+    int nb_rounds = FRAME_PARSE_BENCH_ROUNDS_DEFAULT;
+    int arg_index = 1;
+    uint64_t nb_frames = 0;
+    uint64_t start_time;
+    uint64_t elapsed;
+    frame_parse_bench_ctx_t ctx;
+
+    memset(&ctx, 0, sizeof(ctx));
+
+    if (argc > 2 && strcmp(argv[1], "-n") == 0) {
+        nb_rounds = atoi(argv[2]);
+        arg_index = 3;
+    }
+    if (nb_rounds <= 0) {
+        fprintf(stderr, "Usage: %s [-n nb_rounds] [binlog_file ...]\n", argv[0]);
+        return 1;
+    }
+
+    if (arg_index >= argc) {
+        ret = frame_parse_bench_load(&ctx, FRAME_PARSE_BENCH_DEFAULT_LOG);
+    }
+    for (int i = arg_index; ret == 0 && i < argc; i++) {
+        ret = frame_parse_bench_load(&ctx, argv[i]);
+    }
+
+    if (ret == 0 && ctx.nb_packets == 0) {
+        fprintf(stderr, "No 1-RTT packet found in the binary logs\n");
+        ret = -1;
+    }
+
+    /* Check that all the packets can be parsed before timing */
+    for (size_t i = 0; ret == 0 && i < ctx.nb_packets; i++) {
+        if (frame_parse_bench_packet(ctx.packets + i * PICOQUIC_MAX_PACKET_SIZE, ctx.packet_length[i]) < 0) {
+            fprintf(stderr, "Cannot parse packet %zu\n", i);
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        start_time = picoquic_current_time();
+        for (size_t first = 0; first < ctx.nb_packets; first += FRAME_PARSE_BENCH_BATCH) {
+            size_t last = (first + FRAME_PARSE_BENCH_BATCH < ctx.nb_packets) ? first + FRAME_PARSE_BENCH_BATCH : ctx.nb_packets;
+
+            for (int round = 0; round < nb_rounds; round++) {
+                for (size_t i = first; i < last; i++) {
+                    nb_frames += frame_parse_bench_packet(ctx.packets + i * PICOQUIC_MAX_PACKET_SIZE, ctx.packet_length[i]);
+                }
+            }
+        }
+        elapsed = picoquic_current_time() - start_time;
+        if (elapsed == 0) {
+            elapsed = 1;
+        }
+
+        printf("Packets, Frames, Bytes, ns/packet, ns/frame, Gbps\n");
+        printf("%7zu, %6" PRIu64 ", %5zu, %9.1f, %8.1f, %4.2f\n", ctx.nb_packets, nb_frames / nb_rounds, ctx.nb_bytes,
+            ((double)elapsed) * 1000.0 / ((double)ctx.nb_packets * nb_rounds),
+            ((double)elapsed) * 1000.0 / (double)nb_frames,
+            ((double)ctx.nb_bytes) * 8.0 * nb_rounds / (((double)elapsed) * 1000.0));
+    }
+
+    free(ctx.packets);
+    free(ctx.packet_length);
+
+    return (ret == 0) ? 0 : 1;
+}
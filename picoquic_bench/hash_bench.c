@@ -0,0 +1,170 @@
+/*
+* Copyright (c) 2026, the picoquic contributors.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+/* Micro benchmark of the connection ID hash table.
+ *
+ * The table is created for 1000 connections, as a server would for its
+ * expected load, then filled with a larger number of 8 bytes connection
+ * IDs, to check how the cost of lookups evolves when the actual number of
+ * connections exceeds the estimate. Two workloads are tested:
+ *
+ * - lookup: retrieve a random connection ID present in the table, as for
+ *   incoming packets, plus one unknown connection ID every 4 lookups,
+ *   as for stray packets,
+ * - churn: delete a random connection ID and insert a new one, as when
+ *   connection IDs are retired and renewed.
+ *
+ * The connection ID records embed the hash item, as picoquic_local_cnxid_t.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "picoquic.h"
+#include "picoquic_utils.h"
+#include "picohash.h"
+
+#define HASH_BENCH_STEPS_DEFAULT 1000000
+#define HASH_BENCH_ESTIMATE 1000
+
+typedef struct st_hash_bench_cid_t {
+    picoquic_connection_id_t cnx_id;
+    picohash_item hash_item;
+} hash_bench_cid_t;
+
+static uint64_t hash_bench_hash(const void* key)
+{
+    return picoquic_connection_id_hash(&((const hash_bench_cid_t*)key)->cnx_id);
+}
+
+static int hash_bench_compare(const void* key1, const void* key2)
+{
+    return picoquic_compare_connection_id(&((const hash_bench_cid_t*)key1)->cnx_id, &((const hash_bench_cid_t*)key2)->cnx_id);
+}
+
+static picohash_item* hash_bench_to_item(const void* key)
+{
+    return &((hash_bench_cid_t*)key)->hash_item;
+}
+
+static void hash_bench_new_cid(hash_bench_cid_t* cid, uint64_t* random_ctx)
+{
+    memset(cid, 0, sizeof(hash_bench_cid_t));
+    cid->cnx_id.id_len = 8;
+    picoquic_test_random_bytes(random_ctx, cid->cnx_id.id, 8);
+}
+
+/* Run both workloads, return the elapsed times in microseconds, or -1 on error */
+static int hash_bench_run(size_t nb_cid, int nb_steps, uint64_t* lookup_time, uint64_t* churn_time)
+{
+    int ret = 0;
+    uint64_t random_ctx = 0xc1dc1dc1dc1dull;
+    uint64_t start_time;
+    size_t nb_found = 0;
+    hash_bench_cid_t unknown;
+    /* Each step of the churn replaces a record, and the previous records are freed in bulk */
+    hash_bench_cid_t* records = (hash_bench_cid_t*)malloc(sizeof(hash_bench_cid_t) * (nb_cid + (size_t)nb_steps));
+    hash_bench_cid_t** present = (hash_bench_cid_t**)malloc(sizeof(hash_bench_cid_t*) * nb_cid);
+    picohash_table* table = picohash_create_ex(4 * HASH_BENCH_ESTIMATE, hash_bench_hash, hash_bench_compare, hash_bench_to_item);
+
+    if (records == NULL || present == NULL || table == NULL) {
+        fprintf(stderr, "Cannot allocate %zu connection IDs\n", nb_cid);
+        ret = -1;
+    }
+
+    for (size_t i = 0; ret == 0 && i < nb_cid; i++) {
+        hash_bench_new_cid(&records[i], &random_ctx);
+        present[i] = &records[i];
+        ret = picohash_insert(table, &records[i]);
+    }
+
+    start_time = picoquic_current_time();
+    for (int step = 0; ret == 0 && step < nb_steps; step++) {
+        if ((step & 3) == 3) {
+            hash_bench_new_cid(&unknown, &random_ctx);
+            nb_found += (picohash_retrieve(table, &unknown) != NULL);
+        }
+        else {
+            nb_found += (picohash_retrieve(table, present[picoquic_test_uniform_random(&random_ctx, nb_cid)]) != NULL);
+        }
+    }
+    *lookup_time = picoquic_current_time() - start_time;
+
+    if (ret == 0 && nb_found != (size_t)(nb_steps - nb_steps / 4)) {
+        fprintf(stderr, "Found %zu connection IDs instead of %d\n", nb_found, nb_steps - nb_steps / 4);
+        ret = -1;
+    }
+
+    start_time = picoquic_current_time();
+    for (int step = 0; ret == 0 && step < nb_steps; step++) {
+        size_t rank = (size_t)picoquic_test_uniform_random(&random_ctx, nb_cid);
+        hash_bench_cid_t* cid = &records[nb_cid + step];
+
+        picohash_delete_item(table, &present[rank]->hash_item, 0);
+        hash_bench_new_cid(cid, &random_ctx);
+        present[rank] = cid;
+        ret = picohash_insert(table, cid);
+    }
+    *churn_time = picoquic_current_time() - start_time;
+
+    if (ret == 0 && table->count != nb_cid) {
+        fprintf(stderr, "Table holds %zu connection IDs instead of %zu\n", table->count, nb_cid);
+        ret = -1;
+    }
+
+    if (table != NULL) {
+        picohash_delete(table, 0);
+    }
+    free(present);
+    free(records);
+
+    return ret;
+}
+
+int main(int argc, char** argv)
+{
+    const size_t nb_cid[4] = { 1000, 10000, 100000, 1000000 };
+    int nb_steps = HASH_BENCH_STEPS_DEFAULT;
+
+    if (argc > 1) {
+        nb_steps = atoi(argv[1]);
+        if (nb_steps <= 0) {
+            fprintf(stderr, "Usage: %s [nb_steps]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    printf("CIDs, Lookup ns/op, Churn ns/op\n");
+    for (int i = 0; i < 4; i++) {
+        uint64_t lookup_time = 0;
+        uint64_t churn_time = 0;
+
+        if (hash_bench_run(nb_cid[i], nb_steps, &lookup_time, &churn_time) != 0) {
+            return 1;
+        }
+        printf("%7zu, %14.1f, %12.1f\n", nb_cid[i],
+            ((double)lookup_time) * 1000.0 / nb_steps, ((double)churn_time) * 1000.0 / nb_steps);
+    }
+
+    return 0;
+}
@@ -0,0 +1,249 @@
+/*
+* Copyright (c) 2026, the picoquic contributors.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+/* Measurement of the memory used by idle connections.
+ *
+ * Creates connections that have been active before becoming idle:
+ * each one sent packets, a few of which were lost and are kept for
+ * spurious loss detection, received packets with holes, and received
+ * out of order data on a few streams, all of it since delivered to the
+ * application. The heap used per connection is measured after that
+ * activity, and again after the connections hibernate.
+ *
+ * The packets kept for spurious loss detection come from the packet pool
+ * of the QUIC context. They are reported separately, because they return
+ * to that pool during hibernation instead of being freed.
+ *
+ * The TLS state and the encryption keys are not created in this test.
+ * They are kept during hibernation.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include "picoquic_internal.h"
+#include "picoquic_utils.h"
+
+#define HIBERNATE_BENCH_CNX_DEFAULT 1000
+#define HIBERNATE_BENCH_DELAY 10000000
+#define HIBERNATE_BENCH_PACKETS 400
+#define HIBERNATE_BENCH_LOSS_INTERVAL 20
+#define HIBERNATE_BENCH_RECEIVED 400
+#define HIBERNATE_BENCH_STREAMS 4
+#define HIBERNATE_BENCH_STREAM_DATA 0x8000
+
+static size_t hibernate_bench_heap_size()
+{
+#ifdef __GLIBC__
+    return mallinfo2().uordblks;
+#else
+    return 0;
+#endif
+}
+
+static int hibernate_bench_callback(picoquic_cnx_t* cnx,
+    uint64_t stream_id, uint8_t* bytes, size_t length,
+    picoquic_call_back_event_t fin_or_event, void* callback_ctx, void* v_stream_ctx)
+{
+    (void)cnx;
+    (void)stream_id;
+    (void)bytes;
+    (void)length;
+    (void)fin_or_event;
+    (void)callback_ctx;
+    (void)v_stream_ctx;
+
+    return 0;
+}
+
+static int hibernate_bench_packets_held(picoquic_quic_t* quic)
+{
+    return quic->nb_packets_allocated - quic->nb_packets_in_pool;
+}
+
+/* Reproduce the state left by a period of activity */
+static int hibernate_bench_activity(picoquic_cnx_t* cnx, uint64_t current_time, uint64_t* pn64)
+{
+    int ret = 0;
+    picoquic_packet_context_t* pkt_ctx = &cnx->pkt_ctx[picoquic_packet_context_application];
+    uint8_t data[PICOQUIC_MAX_PACKET_SIZE];
+
+    memset(data, 0x5a, sizeof(data));
+    for (int i = 0; ret == 0 && i < HIBERNATE_BENCH_PACKETS; i++) {
+        picoquic_packet_t* packet = picoquic_create_packet(cnx->quic);
+
+        if (packet == NULL) {
+            ret = -1;
+        }
+        else {
+            packet->sequence_number = pkt_ctx->send_sequence++;
+            packet->ptype = picoquic_packet_1rtt_protected;
+            packet->pc = picoquic_packet_context_application;
+            packet->send_path = cnx->path[0];
+            packet->send_time = current_time;
+            packet->length = PICOQUIC_MAX_PACKET_SIZE;
+            picoquic_queue_for_retransmit(cnx, cnx->path[0], packet, packet->length, current_time);
+        }
+    }
+    while (ret == 0 && pkt_ctx->pending_first != NULL) {
+        (void)picoquic_dequeue_retransmit_packet(cnx, pkt_ctx, pkt_ctx->pending_first,
+            pkt_ctx->pending_first->sequence_number % HIBERNATE_BENCH_LOSS_INTERVAL != 0, 0);
+    }
+
+    for (uint64_t pn = 0; ret == 0 && pn < HIBERNATE_BENCH_RECEIVED; pn++) {
+        if (pn % HIBERNATE_BENCH_LOSS_INTERVAL != 0) {
+            ret = picoquic_record_pn_received(cnx, picoquic_packet_context_application,
+                cnx->path[0]->p_local_cnxid, pn, current_time);
+        }
+    }
+
+    /* On each stream, the second half of the data arrives before the first half */
+    for (int i = 0; ret == 0 && i < HIBERNATE_BENCH_STREAMS; i++) {
+        uint64_t stream_id = STREAM_ID_FROM_RANK(i + 1, !cnx->client_mode, 0);
+
+        for (int half = 1; ret == 0 && half >= 0; half--) {
+            uint64_t offset = half * HIBERNATE_BENCH_STREAM_DATA / 2;
+            uint64_t offset_max = offset + HIBERNATE_BENCH_STREAM_DATA / 2;
+
+            while (ret == 0 && offset < offset_max) {
+                uint8_t frame[PICOQUIC_MAX_PACKET_SIZE + 32];
+                uint8_t* bytes = frame;
+                uint8_t* bytes_max = frame + sizeof(frame);
+                size_t length = (offset_max - offset < 1024) ? (size_t)(offset_max - offset) : 1024;
+
+                bytes = picoquic_frames_uint8_encode(bytes, bytes_max, picoquic_frame_type_stream_range_min + 6);
+                bytes = picoquic_frames_varint_encode(bytes, bytes_max, stream_id);
+                bytes = picoquic_frames_varint_encode(bytes, bytes_max, offset);
+                bytes = picoquic_frames_varint_encode(bytes, bytes_max, length);
+                if (bytes == NULL || bytes + length > bytes_max) {
+                    ret = -1;
+                }
+                else {
+                    memcpy(bytes, data, length);
+                    bytes += length;
+                    ret = picoquic_decode_frames(cnx, cnx->path[0], frame, bytes - frame, NULL, picoquic_epoch_1rtt,
+                        NULL, NULL, HIBERNATE_BENCH_RECEIVED + (*pn64)++, 0, current_time);
+                    offset += length;
+                }
+            }
+        }
+    }
+
+    return ret;
+}
+
+int main(int argc, char** argv)
+{
+    int nb_cnx = HIBERNATE_BENCH_CNX_DEFAULT;
+    int ret = 0;
+    uint64_t simulated_time = 1000000;
+    struct sockaddr_storage addr;
+    picoquic_quic_t* quic = NULL;
+    picoquic_cnx_t** cnx = NULL;
+    size_t heap_start;
+    size_t heap_active = 0;
+    size_t heap_idle = 0;
+    int packets_active = 0;
+    int packets_idle = 0;
+
+    if (argc > 1) {
+        nb_cnx = atoi(argv[1]);
+        if (nb_cnx <= 0) {
+            fprintf(stderr, "Usage: %s [nb_connections]\n", argv[0]);
+            return 1;
+        }
+    }
+
+#ifndef __GLIBC__
+    fprintf(stderr, "Heap statistics are not available on this platform.\n");
+#endif
+
+    quic = picoquic_create(nb_cnx, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+        simulated_time, &simulated_time, NULL, NULL, 0);
+    cnx = (picoquic_cnx_t**)calloc((size_t)nb_cnx, sizeof(picoquic_cnx_t*));
+    if (quic == NULL || cnx == NULL || picoquic_store_text_addr(&addr, "10.0.0.1", 4433) != 0) {
+        fprintf(stderr, "Cannot create the QUIC context\n");
+        ret = -1;
+    }
+    else {
+        picoquic_set_default_hibernation_delay(quic, HIBERNATE_BENCH_DELAY);
+    }
+
+    heap_start = hibernate_bench_heap_size();
+    for (int i = 0; ret == 0 && i < nb_cnx; i++) {
+        if ((cnx[i] = picoquic_create_cnx(quic, picoquic_null_connection_id, picoquic_null_connection_id,
+            (struct sockaddr*)&addr, simulated_time, 0, "test-sni", "test-alpn", 1)) == NULL) {
+            ret = -1;
+        }
+        else {
+            uint64_t pn64 = 0;
+
+            picoquic_set_callback(cnx[i], hibernate_bench_callback, NULL);
+            cnx[i]->cnx_state = picoquic_state_ready;
+            ret = hibernate_bench_activity(cnx[i], simulated_time, &pn64);
+        }
+    }
+    if (ret == 0) {
+        heap_active = hibernate_bench_heap_size() - heap_start;
+        packets_active = hibernate_bench_packets_held(quic);
+    }
+
+    /* All connections stay idle past the hibernation delay */
+    for (int pass = 0; ret == 0 && pass < 2; pass++) {
+        for (int i = 0; i < nb_cnx; i++) {
+            uint64_t next_wake_time = UINT64_MAX;
+            picoquic_check_hibernation(cnx[i], simulated_time, &next_wake_time);
+        }
+        simulated_time += HIBERNATE_BENCH_DELAY;
+    }
+    for (int i = 0; ret == 0 && i < nb_cnx; i++) {
+        if (!picoquic_is_cnx_hibernating(cnx[i])) {
+            fprintf(stderr, "Connection %d did not hibernate\n", i);
+            ret = -1;
+        }
+    }
+    if (ret == 0) {
+        heap_idle = hibernate_bench_heap_size() - heap_start;
+        packets_idle = hibernate_bench_packets_held(quic);
+    }
+
+    if (ret == 0) {
+        printf("State, Heap bytes/cnx, Pool packets/cnx\n");
+        printf("active, %zu, %.1f\n", heap_active / nb_cnx, ((double)packets_active) / nb_cnx);
+        printf("hibernating, %zu, %.1f\n", heap_idle / nb_cnx, ((double)packets_idle) / nb_cnx);
+        printf("Packet size in pool: %zu bytes\n", sizeof(picoquic_packet_t));
+    }
+    else {
+        fprintf(stderr, "Hibernation test failed\n");
+    }
+
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+    free(cnx);
+
+    return (ret == 0) ? 0 : 1;
+}
@@ -0,0 +1,237 @@
+/*
+* Copyright (c) 2026, the picoquic contributors.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Micro benchmark of the SACK lists.
+ *
+ * Measures the cost of recording received packet numbers, formatting
+ * ACK frames, and processing acknowledgements of ACK frames, with the
+ * arrival patterns used in the SACK tests:
+ *
+ * - reorder: packets arrive in blocks of 22, in the order of the
+ *   "ack_sack" test,
+ * - loss: packets arrive in order, but one in 32 is lost,
+ * - disorder: even packets arrive through a low latency path, odd packets
+ *   through a high latency path, as in the "ack_disorder" test.
+ *
+ * An ACK frame is formatted every 2 packets, with up to 32 ranges, and
+ * is acknowledged 64 ACK frames later.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "picoquic_internal.h"
+#include "picoquic_utils.h"
+
+#define SACK_BENCH_PACKETS_DEFAULT 1000000
+#define SACK_BENCH_ACK_RANGES 32
+#define SACK_BENCH_ACK_DELAY 64
+#define SACK_BENCH_LOSS_INTERVAL 32
+
+static const uint64_t sack_bench_reorder[] = {
+    3, 4, 0, 2, 7, 8, 11, 12, 13, 17, 19, 21, 18, 16, 20, 10, 5, 6, 9, 1, 14, 15
+};
+
+#define SACK_BENCH_REORDER_BLOCK (sizeof(sack_bench_reorder) / sizeof(uint64_t))
+
+typedef enum {
+    sack_bench_reorder_pattern = 0,
+    sack_bench_loss_pattern,
+    sack_bench_disorder_pattern
+} sack_bench_pattern_enum;
+
+typedef struct st_sack_bench_ack_t {
+    int nb_ranges;
+    uint64_t start[SACK_BENCH_ACK_RANGES + 1];
+    uint64_t end[SACK_BENCH_ACK_RANGES + 1];
+} sack_bench_ack_t;
+
+typedef struct st_sack_bench_ctx_t {
+    picoquic_sack_list_t sack_list;
+    sack_bench_ack_t acks[SACK_BENCH_ACK_DELAY];
+    uint64_t nb_acks;
+    uint64_t sum_ranges;
+} sack_bench_ctx_t;
+
+/* Format an ACK frame as "picoquic_format_ack_frame" would, selecting the
+ * ranges from the highest down, and record its ranges. */
+static void sack_bench_send_ack(sack_bench_ctx_t* ctx)
+{
+    sack_bench_ack_t* ack = &ctx->acks[ctx->nb_acks % SACK_BENCH_ACK_DELAY];
+    picoquic_sack_item_t* last_sack = picoquic_sack_last_item(&ctx->sack_list);
+
+    ack->nb_ranges = 0;
+    if (last_sack != NULL) {
+        int nb_sent_max_acked = 0;
+        int nb_sent_max_skip = 0;
+        picoquic_sack_item_t* next_sack = picoquic_sack_previous_item(last_sack);
+
+        ack->start[0] = picoquic_sack_item_range_start(last_sack);
+        ack->end[0] = picoquic_sack_item_range_end(last_sack);
+        ack->nb_ranges = 1;
+        picoquic_sack_item_record_sent(&ctx->sack_list, last_sack, 0);
+        picoquic_sack_select_ack_ranges(&ctx->sack_list, last_sack, SACK_BENCH_ACK_RANGES, 0,
+            &nb_sent_max_acked, &nb_sent_max_skip);
+
+        while (ack->nb_ranges <= SACK_BENCH_ACK_RANGES && next_sack != NULL) {
+            int nb_times_sent = picoquic_sack_item_nb_times_sent(next_sack, 0);
+
+            if (nb_times_sent <= nb_sent_max_acked) {
+                if (nb_times_sent == nb_sent_max_acked && nb_sent_max_skip > 0) {
+                    nb_sent_max_skip--;
+                }
+                else {
+                    ack->start[ack->nb_ranges] = picoquic_sack_item_range_start(next_sack);
+                    ack->end[ack->nb_ranges] = picoquic_sack_item_range_end(next_sack);
+                    ack->nb_ranges++;
+                    picoquic_sack_item_record_sent(&ctx->sack_list, next_sack, 0);
+                }
+            }
+            next_sack = picoquic_sack_previous_item(next_sack);
+        }
+    }
+    ctx->sum_ranges += picoquic_sack_list_size(&ctx->sack_list);
+    ctx->nb_acks++;
+}
+
+/* Process the acknowledgement of an old ACK frame, as "picoquic_process_ack_of_ack_frame"
+ * would, from the highest range down. */
+static void sack_bench_receive_ack_of_ack(sack_bench_ctx_t* ctx)
+{
+    sack_bench_ack_t* ack = &ctx->acks[ctx->nb_acks % SACK_BENCH_ACK_DELAY];
+    picoquic_sack_item_t* previous = NULL;
+
+    for (int i = 0; i < ack->nb_ranges; i++) {
+        previous = picoquic_process_ack_of_ack_range(&ctx->sack_list, previous, ack->start[i], ack->end[i]);
+    }
+}
+
+/* Compute the packet numbers in order of arrival */
+static void sack_bench_arrival_order(sack_bench_pattern_enum pattern, uint64_t* order, size_t nb_packets)
+{
+    uint64_t even_pn = 0;
+    uint64_t odd_pn = 1;
+
+    for (size_t rank = 0; rank < nb_packets; rank++) {
+        switch (pattern) {
+        case sack_bench_reorder_pattern:
+            order[rank] = (rank / SACK_BENCH_REORDER_BLOCK) * SACK_BENCH_REORDER_BLOCK +
+                sack_bench_reorder[rank % SACK_BENCH_REORDER_BLOCK];
+            break;
+        case sack_bench_loss_pattern:
+            /* Skip one number every SACK_BENCH_LOSS_INTERVAL */
+            order[rank] = rank + rank / (SACK_BENCH_LOSS_INTERVAL - 1);
+            break;
+        case sack_bench_disorder_pattern:
+        default:
+            /* Packets are sent every 1ms. Even packets arrive after 11.111ms,
+             * odd packets after 300ms. */
+            if (even_pn * 1000 + 11111 <= odd_pn * 1000 + 300000) {
+                order[rank] = even_pn;
+                even_pn += 2;
+            }
+            else {
+                order[rank] = odd_pn;
+                odd_pn += 2;
+            }
+            break;
+        }
+    }
+}
+
+/* Run the workload, return the elapsed time in microseconds, or 0 on error */
+static uint64_t sack_bench_run(sack_bench_pattern_enum pattern, size_t nb_packets, double* average_ranges)
+{
+    sack_bench_ctx_t* ctx = (sack_bench_ctx_t*)malloc(sizeof(sack_bench_ctx_t));
+    uint64_t* order = (uint64_t*)malloc(nb_packets * sizeof(uint64_t));
+    uint64_t start_time;
+    uint64_t elapsed = 0;
+    int ret = 0;
+
+    if (ctx == NULL || order == NULL) {
+        fprintf(stderr, "Cannot allocate the context\n");
+        ret = -1;
+    }
+    else {
+        memset(ctx, 0, sizeof(sack_bench_ctx_t));
+        picoquic_sack_list_init(&ctx->sack_list);
+        sack_bench_arrival_order(pattern, order, nb_packets);
+    }
+
+    start_time = picoquic_current_time();
+    for (size_t rank = 0; ret == 0 && rank < nb_packets; rank++) {
+        if (picoquic_update_sack_list(&ctx->sack_list, order[rank], order[rank], rank) < 0) {
+            ret = -1;
+        }
+        else if (rank % 2 == 1) {
+            if (ctx->nb_acks >= SACK_BENCH_ACK_DELAY) {
+                sack_bench_receive_ack_of_ack(ctx);
+            }
+            sack_bench_send_ack(ctx);
+        }
+    }
+    elapsed = picoquic_current_time() - start_time;
+
+    if (ret != 0) {
+        fprintf(stderr, "Cannot update the SACK list\n");
+        elapsed = 0;
+    }
+    else {
+        *average_ranges = (ctx->nb_acks == 0) ? 0 : ((double)ctx->sum_ranges) / ((double)ctx->nb_acks);
+    }
+
+    if (ctx != NULL) {
+        picoquic_sack_list_free(&ctx->sack_list);
+        free(ctx);
+    }
+    free(order);
+
+    return elapsed;
+}
+
+int main(int argc, char** argv)
+{
+    const char* pattern_name[3] = { "reorder", "loss", "disorder" };
+    size_t nb_packets = SACK_BENCH_PACKETS_DEFAULT;
+
+    if (argc > 1) {
+        int n = atoi(argv[1]);
+        if (n <= 0) {
+            fprintf(stderr, "Usage: %s [nb_packets]\n", argv[0]);
+            return 1;
+        }
+        nb_packets = (size_t)n;
+    }
+
+    printf("Pattern, Average ranges, ns/packet\n");
+    for (int i = 0; i < 3; i++) {
+        double average_ranges = 0;
+        uint64_t elapsed = sack_bench_run((sack_bench_pattern_enum)i, nb_packets, &average_ranges);
+
+        if (elapsed == 0) {
+            return 1;
+        }
+        printf("%8s, %14.1f, %9.1f\n", pattern_name[i], average_ranges, ((double)elapsed) * 1000.0 / nb_packets);
+    }
+
+    return 0;
+}
@@ -0,0 +1,307 @@
+/*
+* Copyright (c) 2026, the picoquic contributors.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Throughput benchmark of the sharded server.
+ *
+ * Runs a quicperf server with 1, 2, 4, ... up to the requested number of
+ * shards, and for each configuration a set of client threads, each
+ * running its own packet loop and opening several connections to the
+ * server on the loopback address. Each connection downloads one stream.
+ * Reports the aggregate download rate and the number of packets that
+ * were forwarded between shards.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "picoquic.h"
+#include "picoquic_internal.h"
+#include "picoquic_utils.h"
+#include "picosocks.h"
+#include "picoquic_packet_loop.h"
+#include "picoquic_shard.h"
+#include "quicperf.h"
+
+#ifndef UNREFERENCED_PARAMETER
+#define UNREFERENCED_PARAMETER(x) (void)(x)
+#endif
+
+#ifdef _WINDOWS
+int main(int argc, char** argv)
+{
+    UNREFERENCED_PARAMETER(argc);
+    UNREFERENCED_PARAMETER(argv);
+    fprintf(stderr, "The sharded server is not available on Windows.\n");
+    return -1;
+}
+#else
+
+typedef struct st_shard_bench_config_t {
+    const char* solution_dir;
+    int max_shards;
+    int nb_clients;
+    int nb_cnx_per_client;
+    uint64_t download_size;
+} shard_bench_config_t;
+
+typedef struct st_shard_bench_client_t {
+    shard_bench_config_t* config;
+    uint16_t server_port;
+    picoquic_thread_t thread;
+    quicperf_ctx_t** perf_ctx;
+    uint64_t data_received;
+    int ret;
+} shard_bench_client_t;
+
+static picoquic_quic_t* shard_bench_create_quic(void* create_quic_ctx, int shard_id)
+{
+    shard_bench_config_t* config = (shard_bench_config_t*)create_quic_ctx;
+    char cert_file[512];
+    char key_file[512];
+    picoquic_quic_t* quic = NULL;
+
+    UNREFERENCED_PARAMETER(shard_id);
+
+    if (picoquic_get_input_path(cert_file, sizeof(cert_file), config->solution_dir, PICOQUIC_TEST_FILE_SERVER_CERT) == 0 &&
+        picoquic_get_input_path(key_file, sizeof(key_file), config->solution_dir, PICOQUIC_TEST_FILE_SERVER_KEY) == 0) {
+        quic = picoquic_create(1024, cert_file, key_file, NULL, QUICPERF_ALPN,
+            quicperf_callback, NULL, NULL, NULL, NULL, picoquic_current_time(), NULL, NULL, NULL, 0);
+    }
+    return quic;
+}
+
+static int shard_bench_client_loop_cb(picoquic_quic_t* quic, picoquic_packet_loop_cb_enum cb_mode,
+    void* callback_ctx, void* callback_arg)
+{
+    int ret = 0;
+
+    UNREFERENCED_PARAMETER(callback_ctx);
+    UNREFERENCED_PARAMETER(callback_arg);
+
+    if (cb_mode == picoquic_packet_loop_after_receive || cb_mode == picoquic_packet_loop_after_send) {
+        picoquic_cnx_t* cnx = picoquic_get_first_cnx(quic);
+        int all_done = 1;
+
+        while (cnx != NULL) {
+            if (picoquic_get_cnx_state(cnx) < picoquic_state_disconnected) {
+                all_done = 0;
+                break;
+            }
+            cnx = picoquic_get_next_cnx(cnx);
+        }
+        if (all_done) {
+            ret = PICOQUIC_NO_ERROR_TERMINATE_PACKET_LOOP;
+        }
+    }
+    return ret;
+}
+
+static picoquic_thread_return_t shard_bench_client_thread(void* arg)
+{
+    shard_bench_client_t* client = (shard_bench_client_t*)arg;
+    shard_bench_config_t* config = client->config;
+    char scenario[64];
+    struct sockaddr_in server_addr;
+    uint64_t current_time = picoquic_current_time();
+    picoquic_quic_t* quic = picoquic_create(config->nb_cnx_per_client, NULL, NULL, NULL, QUICPERF_ALPN,
+        NULL, NULL, NULL, NULL, NULL, current_time, NULL, NULL, NULL, 0);
+
+    (void)picoquic_sprintf(scenario, sizeof(scenario), NULL, "=b1:*1:64:%" PRIu64 ";", config->download_size);
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    server_addr.sin_port = htons(client->server_port);
+
+    if (quic == NULL) {
+        client->ret = -1;
+    }
+    else {
+        picoquic_set_null_verifier(quic);
+        for (int i = 0; client->ret == 0 && i < config->nb_cnx_per_client; i++) {
+            picoquic_cnx_t* cnx = NULL;
+
+            client->perf_ctx[i] = quicperf_create_ctx(scenario);
+            if (client->perf_ctx[i] == NULL ||
+                (cnx = picoquic_create_cnx(quic, picoquic_null_connection_id, picoquic_null_connection_id,
+                    (struct sockaddr*)&server_addr, current_time, 0, PICOQUIC_TEST_SNI, QUICPERF_ALPN, 1)) == NULL) {
+                client->ret = -1;
+            }
+            else {
+                picoquic_set_callback(cnx, quicperf_callback, client->perf_ctx[i]);
+                client->ret = picoquic_start_client_cnx(cnx);
+            }
+        }
+
+        if (client->ret == 0) {
+            picoquic_packet_loop_param_t param = { 0 };
+            param.local_af = AF_INET;
+            client->ret = picoquic_packet_loop_v2(quic, &param, shard_bench_client_loop_cb, client);
+            if (client->ret == PICOQUIC_NO_ERROR_TERMINATE_PACKET_LOOP) {
+                client->ret = 0;
+            }
+        }
+
+        for (int i = 0; i < config->nb_cnx_per_client; i++) {
+            if (client->perf_ctx[i] != NULL) {
+                client->data_received += client->perf_ctx[i]->data_received;
+                if (client->perf_ctx[i]->nb_streams == 0) {
+                    client->ret = -1;
+                }
+            }
+        }
+        picoquic_free(quic);
+    }
+    picoquic_thread_do_return;
+}
+
+static int shard_bench_run(shard_bench_config_t* config, int nb_shards)
+{
+    int ret = 0;
+    picoquic_shard_server_param_t param;
+    picoquic_shard_server_t* server = NULL;
+    shard_bench_client_t* clients = (shard_bench_client_t*)calloc(config->nb_clients, sizeof(shard_bench_client_t));
+
+    memset(&param, 0, sizeof(param));
+    param.nb_shards = nb_shards;
+    param.loop_param.local_af = AF_INET;
+    param.create_quic_fn = shard_bench_create_quic;
+    param.create_quic_ctx = config;
+
+    if (clients == NULL || (server = picoquic_shard_server_create(&param)) == NULL ||
+        picoquic_shard_server_start(server) != 0) {
+        fprintf(stderr, "Cannot start the server with %d shards\n", nb_shards);
+        ret = -1;
+    }
+    else {
+        uint64_t start_time = picoquic_current_time();
+        uint64_t elapsed;
+        uint64_t data_received = 0;
+        uint64_t nb_forwarded = 0;
+        int nb_started = 0;
+
+        for (int i = 0; ret == 0 && i < config->nb_clients; i++) {
+            clients[i].config = config;
+            clients[i].server_port = picoquic_shard_server_get_port(server);
+            clients[i].perf_ctx = (quicperf_ctx_t**)calloc(config->nb_cnx_per_client, sizeof(quicperf_ctx_t*));
+            if (clients[i].perf_ctx == NULL ||
+                picoquic_create_thread(&clients[i].thread, shard_bench_client_thread, &clients[i]) != 0) {
+                ret = -1;
+            }
+            else {
+                nb_started++;
+            }
+        }
+        for (int i = 0; i < nb_started; i++) {
+            (void)picoquic_wait_thread(clients[i].thread);
+            if (clients[i].ret != 0) {
+                ret = -1;
+            }
+            data_received += clients[i].data_received;
+        }
+        elapsed = picoquic_current_time() - start_time;
+
+        for (int i = 0; i < nb_shards; i++) {
+            picoquic_shard_stats_t stats;
+            picoquic_shard_server_get_stats(server, i, &stats);
+            nb_forwarded += stats.nb_forwarded;
+        }
+        printf("%6d, %10.3f, %10.3f, %10" PRIu64 "%s\n", nb_shards, ((double)elapsed) / 1000000.0,
+            (elapsed > 0) ? ((double)data_received) * 8.0 / ((double)elapsed) : 0.0, nb_forwarded,
+            (ret == 0) ? "" : ", error");
+    }
+
+    if (server != NULL) {
+        picoquic_shard_server_delete(server);
+    }
+    if (clients != NULL) {
+        for (int i = 0; i < config->nb_clients; i++) {
+            if (clients[i].perf_ctx != NULL) {
+                for (int j = 0; j < config->nb_cnx_per_client; j++) {
+                    if (clients[i].perf_ctx[j] != NULL) {
+                        quicperf_delete_ctx(clients[i].perf_ctx[j]);
+                    }
+                }
+                free(clients[i].perf_ctx);
+            }
+        }
+        free(clients);
+    }
+    return ret;
+}
+
+static void usage(char const* argv0)
+{
+    fprintf(stderr, "Usage: %s [options]\n", argv0);
+    fprintf(stderr, "  -S solution_dir  Directory containing the certs folder, default: current directory\n");
+    fprintf(stderr, "  -n nb_shards     Maximum number of shards, default: 4\n");
+    fprintf(stderr, "  -c nb_clients    Number of client threads, default: 4\n");
+    fprintf(stderr, "  -k nb_cnx        Connections per client thread, default: 8\n");
+    fprintf(stderr, "  -d bytes         Bytes downloaded per connection, default: 10000000\n");
+    exit(1);
+}
+
+int main(int argc, char** argv)
+{
+    int ret = 0;
+    shard_bench_config_t config = { NULL, 4, 4, 8, 10000000 };
+
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] != '-' || argv[i][1] == 0 || argv[i][2] != 0 || i + 1 >= argc) {
+            usage(argv[0]);
+        }
+        switch (argv[i][1]) {
+        case 'S':
+            config.solution_dir = argv[++i];
+            break;
+        case 'n':
+            config.max_shards = atoi(argv[++i]);
+            break;
+        case 'c':
+            config.nb_clients = atoi(argv[++i]);
+            break;
+        case 'k':
+            config.nb_cnx_per_client = atoi(argv[++i]);
+            break;
+        case 'd':
+            config.download_size = strtoull(argv[++i], NULL, 10);
+            break;
+        default:
+            usage(argv[0]);
+            break;
+        }
+    }
+    if (config.max_shards < 1 || config.max_shards > PICOQUIC_SHARD_MAX ||
+        config.nb_clients < 1 || config.nb_cnx_per_client < 1) {
+        usage(argv[0]);
+    }
+
+    printf("Shards,    Seconds,       Mbps,  Forwarded\n");
+    for (int nb_shards = 1; ret == 0 && nb_shards <= config.max_shards; nb_shards *= 2) {
+        ret = shard_bench_run(&config, nb_shards);
+    }
+    if (ret == 0 && (config.max_shards & (config.max_shards - 1)) != 0) {
+        ret = shard_bench_run(&config, config.max_shards);
+    }
+
+    return (ret == 0) ? 0 : 1;
+}
+#endif
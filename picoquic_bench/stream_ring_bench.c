@@ -0,0 +1,183 @@
+/*
+* Copyright (c) 2026, the picoquic contributors.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Micro benchmark of the stream reassembly.
+ *
+ * Measures the cost of receiving one stream frame, from frame decoding
+ * to the delivery of the data to the application callback, as a function
+ * of the size of the reordering window. The stream data is received in
+ * successive windows of frames. In each window, the first frame arrives
+ * last, so all the other frames of the window have to be held until the
+ * gap is filled. A window of 1 frame measures the in order path.
+ *
+ * The frames are prepared before the timing starts, so the measurement
+ * does not include the cost of formatting them.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "picoquic_internal.h"
+#include "picoquic_utils.h"
+
+#define STREAM_RING_BENCH_FRAMES_DEFAULT 200000
+#define STREAM_RING_BENCH_FRAME_SIZE 1200
+#define STREAM_RING_BENCH_FRAME_LENGTH (12 + STREAM_RING_BENCH_FRAME_SIZE) /* type, ID, 8 bytes offset, 2 bytes length */
+
+typedef struct st_stream_ring_bench_ctx_t {
+    uint64_t nb_delivered;
+} stream_ring_bench_ctx_t;
+
+static int stream_ring_bench_callback(picoquic_cnx_t* cnx,
+    uint64_t stream_id, uint8_t* bytes, size_t length,
+    picoquic_call_back_event_t fin_or_event, void* callback_ctx, void* v_stream_ctx)
+{
+    stream_ring_bench_ctx_t* ctx = (stream_ring_bench_ctx_t*)callback_ctx;
+    (void)cnx;
+    (void)stream_id;
+    (void)bytes;
+    (void)v_stream_ctx;
+
+    if (fin_or_event == picoquic_callback_stream_data) {
+        ctx->nb_delivered += length;
+    }
+    return 0;
+}
+
+/* Set the offset of a stream frame, encoded on 8 bytes so it can be
+ * updated in place from one window to the next */
+static void stream_ring_bench_set_offset(uint8_t* frame, uint64_t offset)
+{
+    picoformat_64(frame + 2, offset | 0xC000000000000000ull);
+}
+
+/* Format the frames of one window, in arrival order: the first frame last */
+static void stream_ring_bench_format(uint8_t* frames, int window)
+{
+    for (int i = 0; i < window; i++) {
+        uint8_t* frame = frames + (size_t)i * STREAM_RING_BENCH_FRAME_LENGTH;
+
+        frame[0] = picoquic_frame_type_stream_range_min | 6; /* Offset and length present */
+        frame[1] = 0; /* Stream ID */
+        stream_ring_bench_set_offset(frame, 0);
+        (void)picoquic_frames_varint_encode(frame + 10, frame + 12, STREAM_RING_BENCH_FRAME_SIZE);
+        memset(frame + 12, (uint8_t)i, STREAM_RING_BENCH_FRAME_SIZE);
+    }
+}
+
+/* Run the workload, return the elapsed time in microseconds, or 0 on error */
+static uint64_t stream_ring_bench_run(int window, int nb_frames)
+{
+    uint64_t simulated_time = 0;
+    uint64_t elapsed = 0;
+    uint64_t start_time;
+    uint64_t stream_length = (uint64_t)nb_frames * STREAM_RING_BENCH_FRAME_SIZE;
+    int nb_windows = nb_frames / window;
+    int ret = 0;
+    struct sockaddr_storage addr;
+    picoquic_quic_t* quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+        simulated_time, &simulated_time, NULL, NULL, 0);
+    picoquic_cnx_t* cnx = NULL;
+    uint8_t* frames = (uint8_t*)malloc((size_t)window * STREAM_RING_BENCH_FRAME_LENGTH);
+    stream_ring_bench_ctx_t ctx;
+
+    memset(&ctx, 0, sizeof(ctx));
+
+    if (frames == NULL || quic == NULL || picoquic_store_text_addr(&addr, "10.0.0.1", 4433) != 0 ||
+        (cnx = picoquic_create_cnx(quic, picoquic_null_connection_id, picoquic_null_connection_id,
+            (struct sockaddr*)&addr, simulated_time, 0, "test-sni", "test-alpn", 1)) == NULL) {
+        fprintf(stderr, "Cannot create the connection context\n");
+        ret = -1;
+    }
+    else {
+        /* Receive on the client initiated stream 0, as a server would */
+        cnx->client_mode = 0;
+        cnx->maxdata_local = stream_length;
+        cnx->local_parameters.initial_max_stream_data_bidi_remote = stream_length;
+        picoquic_set_callback(cnx, stream_ring_bench_callback, &ctx);
+        stream_ring_bench_format(frames, window);
+    }
+
+    start_time = picoquic_current_time();
+    for (int w = 0; ret == 0 && w < nb_windows; w++) {
+        uint64_t window_offset = (uint64_t)w * window * STREAM_RING_BENCH_FRAME_SIZE;
+
+        for (int i = 0; ret == 0 && i < window; i++) {
+            uint8_t* frame = frames + (size_t)i * STREAM_RING_BENCH_FRAME_LENGTH;
+            int rank = (i + 1 < window) ? i + 1 : 0;
+
+            stream_ring_bench_set_offset(frame, window_offset + (uint64_t)rank * STREAM_RING_BENCH_FRAME_SIZE);
+            if (picoquic_decode_stream_frame(cnx, frame, frame + STREAM_RING_BENCH_FRAME_LENGTH, NULL, simulated_time) !=
+                frame + STREAM_RING_BENCH_FRAME_LENGTH) {
+                ret = -1;
+            }
+        }
+    }
+    elapsed = picoquic_current_time() - start_time;
+
+    if (ret == 0 && ctx.nb_delivered != (uint64_t)nb_windows * window * STREAM_RING_BENCH_FRAME_SIZE) {
+        ret = -1;
+    }
+    if (ret != 0) {
+        fprintf(stderr, "Reassembly failed, window %d\n", window);
+        elapsed = 0;
+    }
+
+    if (cnx != NULL) {
+        picoquic_delete_cnx(cnx);
+    }
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+    if (frames != NULL) {
+        free(frames);
+    }
+
+    return elapsed;
+}
+
+int main(int argc, char** argv)
+{
+    const int window[4] = { 1, 8, 64, 512 };
+    int nb_frames = STREAM_RING_BENCH_FRAMES_DEFAULT;
+
+    if (argc > 1) {
+        nb_frames = atoi(argv[1]);
+        if (nb_frames < window[3]) {
+            fprintf(stderr, "Usage: %s [nb_frames], with nb_frames >= %d\n", argv[0], window[3]);
+            return 1;
+        }
+    }
+
+    printf("Window, ns/frame\n");
+    for (int i = 0; i < 4; i++) {
+        int nb_received = (nb_frames / window[i]) * window[i];
+        uint64_t reassembly_time = stream_ring_bench_run(window[i], nb_frames);
+
+        if (reassembly_time == 0) {
+            return 1;
+        }
+        printf("%6d, %8.1f\n", window[i], ((double)reassembly_time) * 1000.0 / nb_received);
+    }
+
+    return 0;
+}
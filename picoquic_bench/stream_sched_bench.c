@@ -0,0 +1,170 @@
+/*
+* Copyright (c) 2026, the picoquic contributors.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Micro benchmark of the stream scheduler.
+ *
+ * Measures the cost of selecting the next stream and formatting one
+ * packet worth of stream data, as a function of the number of open
+ * streams. Two workloads are tested:
+ *
+ * - round robin: all streams have data to send, at an even priority
+ *   level, so the scheduler rotates between them,
+ * - sparse FIFO: all streams are open, but only the last one has data
+ *   to send, at an odd priority level, as with a server holding many
+ *   idle request streams while one response is sent.
+ *
+ * Streams are marked active, and the application callback provides data
+ * on demand. Flow control limits are set high enough to never block.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "picoquic_internal.h"
+#include "picoquic_utils.h"
+
+#define STREAM_SCHED_BENCH_STEPS_DEFAULT 200000
+#define STREAM_SCHED_BENCH_PACKET_SIZE 1440
+
+static int stream_sched_bench_callback(picoquic_cnx_t* cnx,
+    uint64_t stream_id, uint8_t* bytes, size_t length,
+    picoquic_call_back_event_t fin_or_event, void* callback_ctx, void* v_stream_ctx)
+{
+    (void)cnx;
+    (void)stream_id;
+    (void)callback_ctx;
+    (void)v_stream_ctx;
+
+    if (fin_or_event == picoquic_callback_prepare_to_send) {
+        uint8_t* buffer = picoquic_provide_stream_data_buffer(bytes, length, 0, 1);
+
+        if (buffer == NULL) {
+            return -1;
+        }
+        memset(buffer, 0x5a, length);
+    }
+    return 0;
+}
+
+/* Run the workload, return the elapsed time in microseconds, or 0 on error */
+static uint64_t stream_sched_bench_run(int nb_streams, int is_sparse, int nb_steps)
+{
+    uint64_t simulated_time = 0;
+    uint64_t elapsed = 0;
+    uint64_t start_time;
+    uint8_t priority = (is_sparse) ? 3 : 2;
+    int ret = 0;
+    struct sockaddr_storage addr;
+    picoquic_quic_t* quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+        simulated_time, &simulated_time, NULL, NULL, 0);
+    picoquic_cnx_t* cnx = NULL;
+    uint8_t packet[STREAM_SCHED_BENCH_PACKET_SIZE];
+
+    if (quic == NULL || picoquic_store_text_addr(&addr, "10.0.0.1", 4433) != 0 ||
+        (cnx = picoquic_create_cnx(quic, picoquic_null_connection_id, picoquic_null_connection_id,
+            (struct sockaddr*)&addr, simulated_time, 0, "test-sni", "test-alpn", 1)) == NULL) {
+        fprintf(stderr, "Cannot create the connection context\n");
+        ret = -1;
+    }
+    else {
+        picoquic_set_callback(cnx, stream_sched_bench_callback, NULL);
+        cnx->maxdata_remote = UINT64_MAX;
+        cnx->remote_parameters.initial_max_stream_data_bidi_remote = UINT64_MAX;
+        cnx->max_stream_id_bidir_remote = STREAM_ID_FROM_RANK(nb_streams, cnx->client_mode, 0);
+
+        for (int i = 0; ret == 0 && i < nb_streams; i++) {
+            uint64_t stream_id = STREAM_ID_FROM_RANK(i + 1, cnx->client_mode, 0);
+
+            ret = picoquic_set_stream_priority(cnx, stream_id, priority);
+            if (ret == 0 && (!is_sparse || i == nb_streams - 1)) {
+                ret = picoquic_mark_active_stream(cnx, stream_id, 1, NULL);
+            }
+        }
+        if (ret != 0) {
+            fprintf(stderr, "Cannot create %d streams\n", nb_streams);
+        }
+    }
+
+    start_time = picoquic_current_time();
+    for (int step = 0; ret == 0 && step < nb_steps; step++) {
+        picoquic_stream_head_t* stream = picoquic_find_ready_stream(cnx);
+
+        simulated_time++;
+        if (stream == NULL) {
+            ret = -1;
+        }
+        else {
+            int more_data = 0;
+            int is_pure_ack = 1;
+            int is_still_active = 0;
+            uint8_t* bytes_next = picoquic_format_stream_frame(cnx, stream, packet, packet + sizeof(packet),
+                &more_data, &is_pure_ack, &is_still_active, &ret);
+
+            if (ret == 0 && (bytes_next == NULL || bytes_next == packet)) {
+                ret = -1;
+            }
+        }
+    }
+    elapsed = picoquic_current_time() - start_time;
+
+    if (ret != 0) {
+        fprintf(stderr, "Scheduling failed, %d streams\n", nb_streams);
+        elapsed = 0;
+    }
+
+    if (cnx != NULL) {
+        picoquic_delete_cnx(cnx);
+    }
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+
+    return elapsed;
+}
+
+int main(int argc, char** argv)
+{
+    const int nb_streams[3] = { 1, 100, 10000 };
+    int nb_steps = STREAM_SCHED_BENCH_STEPS_DEFAULT;
+
+    if (argc > 1) {
+        nb_steps = atoi(argv[1]);
+        if (nb_steps <= 0) {
+            fprintf(stderr, "Usage: %s [nb_steps]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    printf("Streams, Round robin ns/packet, Sparse FIFO ns/packet\n");
+    for (int i = 0; i < 3; i++) {
+        uint64_t round_robin_time = stream_sched_bench_run(nb_streams[i], 0, nb_steps);
+        uint64_t sparse_time = stream_sched_bench_run(nb_streams[i], 1, nb_steps);
+
+        if (round_robin_time == 0 || sparse_time == 0) {
+            return 1;
+        }
+        printf("%7d, %22.1f, %22.1f\n", nb_streams[i],
+            ((double)round_robin_time) * 1000.0 / nb_steps, ((double)sparse_time) * 1000.0 / nb_steps);
+    }
+
+    return 0;
+}
@@ -0,0 +1,186 @@
+/*
+* Copyright (c) 2026, the picoquic contributors.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Micro benchmark of the stream send path.
+ *
+ * Compares "picoquic_add_to_stream", which copies the application data
+ * in the send queue, and "picoquic_add_to_stream_by_reference", which
+ * queues the application buffer and releases it once acknowledged.
+ *
+ * The application writes the transfer in chunks, keeping a fixed number
+ * of chunks queued. The stream frames are formatted in packet sized
+ * buffers and acknowledged immediately, so the measurement covers the
+ * queuing, the copy of the data in the packets, and the processing of
+ * acknowledgements, but not the encryption or the network.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "picoquic_internal.h"
+#include "picoquic_utils.h"
+
+#define STREAM_SEND_BENCH_MB_DEFAULT 1024
+#define STREAM_SEND_BENCH_CHUNK_SIZE 0x10000
+#define STREAM_SEND_BENCH_CHUNKS_QUEUED 16
+#define STREAM_SEND_BENCH_PACKET_SIZE 1440
+
+int picoquic_process_ack_of_stream_frame(picoquic_cnx_t* cnx, uint8_t* bytes,
+    size_t bytes_max, size_t* consumed);
+
+typedef struct st_stream_send_bench_ctx_t {
+    uint64_t nb_released;
+    uint64_t nb_abandoned;
+} stream_send_bench_ctx_t;
+
+static void stream_send_bench_release(void* release_ctx, int is_acknowledged)
+{
+    stream_send_bench_ctx_t* ctx = (stream_send_bench_ctx_t*)release_ctx;
+
+    if (is_acknowledged) {
+        ctx->nb_released++;
+    }
+    else {
+        ctx->nb_abandoned++;
+    }
+}
+
+/* Run the transfer, return the elapsed time in microseconds, or 0 on error */
+static uint64_t stream_send_bench_run(uint64_t transfer_size, int by_reference)
+{
+    uint64_t simulated_time = 0;
+    uint64_t queued = 0;
+    uint64_t elapsed = 0;
+    uint64_t start_time;
+    int ret = 0;
+    struct sockaddr_storage addr;
+    picoquic_quic_t* quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+        simulated_time, &simulated_time, NULL, NULL, 0);
+    picoquic_cnx_t* cnx = NULL;
+    picoquic_stream_head_t* stream = NULL;
+    stream_send_bench_ctx_t ctx;
+    uint8_t* chunks = (uint8_t*)malloc((size_t)STREAM_SEND_BENCH_CHUNK_SIZE * STREAM_SEND_BENCH_CHUNKS_QUEUED);
+    uint8_t packet[STREAM_SEND_BENCH_PACKET_SIZE];
+
+    memset(&ctx, 0, sizeof(ctx));
+    if (quic == NULL || chunks == NULL || picoquic_store_text_addr(&addr, "10.0.0.1", 4433) != 0 ||
+        (cnx = picoquic_create_cnx(quic, picoquic_null_connection_id, picoquic_null_connection_id,
+            (struct sockaddr*)&addr, simulated_time, 0, "test-sni", "test-alpn", 1)) == NULL ||
+        (stream = picoquic_create_stream(cnx, 0)) == NULL) {
+        fprintf(stderr, "Cannot create the connection context\n");
+        ret = -1;
+    }
+    else {
+        memset(chunks, 0x5a, (size_t)STREAM_SEND_BENCH_CHUNK_SIZE * STREAM_SEND_BENCH_CHUNKS_QUEUED);
+        cnx->maxdata_remote = UINT64_MAX;
+        stream->maxdata_remote = UINT64_MAX;
+    }
+
+    start_time = picoquic_current_time();
+    while (ret == 0 && !stream->fin_sent) {
+        int more_data = 0;
+        int is_pure_ack = 1;
+        int is_still_active = 0;
+        uint8_t* bytes_next;
+
+        /* Keep the queue filled, as the application would */
+        while (ret == 0 && queued < transfer_size &&
+            queued - stream->sent_offset < (uint64_t)STREAM_SEND_BENCH_CHUNK_SIZE * (STREAM_SEND_BENCH_CHUNKS_QUEUED - 1)) {
+            uint8_t* chunk = chunks + (size_t)((queued / STREAM_SEND_BENCH_CHUNK_SIZE) % STREAM_SEND_BENCH_CHUNKS_QUEUED) * STREAM_SEND_BENCH_CHUNK_SIZE;
+            size_t length = (transfer_size - queued < STREAM_SEND_BENCH_CHUNK_SIZE) ? (size_t)(transfer_size - queued) : STREAM_SEND_BENCH_CHUNK_SIZE;
+            int is_fin = (queued + length >= transfer_size);
+
+            if (by_reference) {
+                ret = picoquic_add_to_stream_by_reference(cnx, 0, chunk, length, is_fin, stream_send_bench_release, &ctx);
+            }
+            else {
+                ret = picoquic_add_to_stream(cnx, 0, chunk, length, is_fin);
+            }
+            queued += length;
+        }
+
+        /* Send one packet worth of data, and acknowledge it */
+        if (ret == 0) {
+            bytes_next = picoquic_format_stream_frame(cnx, stream, packet, packet + sizeof(packet),
+                &more_data, &is_pure_ack, &is_still_active, &ret);
+            if (ret == 0 && bytes_next != NULL && bytes_next > packet) {
+                size_t consumed = 0;
+                ret = picoquic_process_ack_of_stream_frame(cnx, packet, bytes_next - packet, &consumed);
+            }
+            else if (ret == 0) {
+                ret = -1;
+            }
+        }
+    }
+    elapsed = picoquic_current_time() - start_time;
+
+    if (ret != 0) {
+        fprintf(stderr, "Transfer failed after %" PRIu64 " bytes\n", (stream == NULL) ? 0 : stream->sent_offset);
+        elapsed = 0;
+    }
+    else if (by_reference && ctx.nb_released != (transfer_size + STREAM_SEND_BENCH_CHUNK_SIZE - 1) / STREAM_SEND_BENCH_CHUNK_SIZE) {
+        fprintf(stderr, "Released %" PRIu64 " chunks, abandoned %" PRIu64 "\n", ctx.nb_released, ctx.nb_abandoned);
+        elapsed = 0;
+    }
+
+    if (cnx != NULL) {
+        picoquic_delete_cnx(cnx);
+    }
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+    free(chunks);
+
+    return elapsed;
+}
+
+int main(int argc, char** argv)
+{
+    int nb_mb = STREAM_SEND_BENCH_MB_DEFAULT;
+    uint64_t transfer_size;
+    uint64_t copy_time;
+    uint64_t reference_time;
+
+    if (argc > 1) {
+        nb_mb = atoi(argv[1]);
+        if (nb_mb <= 0) {
+            fprintf(stderr, "Usage: %s [transfer size in MB]\n", argv[0]);
+            return 1;
+        }
+    }
+    transfer_size = ((uint64_t)nb_mb) << 20;
+
+    copy_time = stream_send_bench_run(transfer_size, 0);
+    reference_time = stream_send_bench_run(transfer_size, 1);
+    if (copy_time == 0 || reference_time == 0) {
+        return 1;
+    }
+
+    printf("Mode, MB, Seconds, Gbps\n");
+    printf("copy, %d, %.3f, %.2f\n", nb_mb, ((double)copy_time) / 1000000.0,
+        ((double)transfer_size) * 8.0 / (((double)copy_time) * 1000.0));
+    printf("reference, %d, %.3f, %.2f\n", nb_mb, ((double)reference_time) / 1000000.0,
+        ((double)transfer_size) * 8.0 / (((double)reference_time) * 1000.0));
+    printf("Speedup: %.2f\n", ((double)copy_time) / ((double)reference_time));
+
+    return 0;
+}
@@ -0,0 +1,213 @@
+/*
+* Copyright (c) 2026, the picoquic contributors.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Micro benchmark of the connection wake list.
+ *
+ * Compares the splay tree and the timing wheel used to order connections
+ * by wake time, for increasing numbers of connections. The workload
+ * mimics a server with mostly idle connections:
+ *
+ * - a small fraction of the connections is active, and is rescheduled
+ *   a few milliseconds after each wake up, as with pacing or acks,
+ * - the other connections are rescheduled 10 to 30 seconds later, as
+ *   with keep alive or idle timers,
+ * - packets arrive on random active connections, which are then
+ *   rescheduled within the ack delay.
+ *
+ * Each step retrieves the earliest connection, advances the virtual
+ * time, and reinserts that connection and the target of a packet arrival.
+ *
+ * In the overload workload, packets arrive on two connections at each
+ * step, so the server falls behind. A connection that receives a packet
+ * is due at the arrival time, up to 10 ms in the past, and most active
+ * connections end up late.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "picoquic_internal.h"
+#include "picoquic_utils.h"
+
+#define WAKE_BENCH_STEPS_DEFAULT 1000000
+#define WAKE_BENCH_OVERLOAD_BACKLOG 10000 /* microseconds */
+
+typedef struct st_wake_bench_ctx_t {
+    picoquic_cnx_t* cnx;
+    int nb_cnx;
+    int nb_active;
+    picosplay_tree_t tree;
+    picoquic_wake_wheel_t* wheel;
+    uint64_t random_ctx;
+    uint64_t current_time;
+} wake_bench_ctx_t;
+
+static void* wake_bench_node_value(picosplay_node_t* cnx_wake_node)
+{
+    return (cnx_wake_node == NULL) ? NULL : (void*)((char*)cnx_wake_node - offsetof(struct st_picoquic_cnx_t, cnx_wake_node));
+}
+
+static int64_t wake_bench_compare(void* l, void* r)
+{
+    const uint64_t ltime = ((picoquic_cnx_t*)l)->next_wake_time;
+    const uint64_t rtime = ((picoquic_cnx_t*)r)->next_wake_time;
+    if (ltime < rtime) return -1;
+    if (ltime > rtime) return 1;
+    return 0;
+}
+
+static picosplay_node_t* wake_bench_create_node(void* v_cnx)
+{
+    return &((picoquic_cnx_t*)v_cnx)->cnx_wake_node;
+}
+
+static void wake_bench_delete_node(void* tree, picosplay_node_t* node)
+{
+    (void)tree;
+    memset(node, 0, sizeof(picosplay_node_t));
+}
+
+static void wake_bench_insert(wake_bench_ctx_t* ctx, picoquic_cnx_t* cnx)
+{
+    if (ctx->wheel != NULL) {
+        picoquic_wake_wheel_insert(ctx->wheel, cnx);
+    }
+    else {
+        picosplay_insert(&ctx->tree, cnx);
+    }
+}
+
+static void wake_bench_reinsert(wake_bench_ctx_t* ctx, picoquic_cnx_t* cnx, uint64_t next_time)
+{
+    if (ctx->wheel != NULL) {
+        picoquic_wake_wheel_remove(ctx->wheel, cnx);
+    }
+    else {
+        picosplay_delete_hint(&ctx->tree, &cnx->cnx_wake_node);
+    }
+    cnx->next_wake_time = next_time;
+    wake_bench_insert(ctx, cnx);
+}
+
+static picoquic_cnx_t* wake_bench_first(wake_bench_ctx_t* ctx)
+{
+    if (ctx->wheel != NULL) {
+        return picoquic_wake_wheel_first(ctx->wheel);
+    }
+    return (picoquic_cnx_t*)wake_bench_node_value(picosplay_first(&ctx->tree));
+}
+
+static uint64_t wake_bench_next_time(wake_bench_ctx_t* ctx, picoquic_cnx_t* cnx)
+{
+    if (cnx - ctx->cnx < ctx->nb_active) {
+        return ctx->current_time + 100 + picoquic_test_uniform_random(&ctx->random_ctx, 5000);
+    }
+    return ctx->current_time + 10000000 + picoquic_test_uniform_random(&ctx->random_ctx, 20000000);
+}
+
+/* Run the workload, return the elapsed time in microseconds */
+static uint64_t wake_bench_run(int nb_cnx, int use_wheel, int overload, int nb_steps)
+{
+    wake_bench_ctx_t ctx;
+    uint64_t start_time;
+    uint64_t elapsed = 0;
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.nb_cnx = nb_cnx;
+    ctx.nb_active = (nb_cnx + 19) / 20;
+    ctx.random_ctx = 0xbe4c0ffee0ddf00dull;
+    ctx.current_time = 1000000;
+    ctx.cnx = (picoquic_cnx_t*)malloc(sizeof(picoquic_cnx_t) * (size_t)nb_cnx);
+    picosplay_init_tree(&ctx.tree, wake_bench_compare, wake_bench_create_node, wake_bench_delete_node, wake_bench_node_value);
+    if (use_wheel) {
+        ctx.wheel = picoquic_wake_wheel_create(ctx.current_time);
+    }
+
+    if (ctx.cnx == NULL || (use_wheel && ctx.wheel == NULL)) {
+        fprintf(stderr, "Cannot allocate %d connections\n", nb_cnx);
+        exit(1);
+    }
+
+    memset(ctx.cnx, 0, sizeof(picoquic_cnx_t) * (size_t)nb_cnx);
+    for (int i = 0; i < nb_cnx; i++) {
+        ctx.cnx[i].next_wake_time = ctx.current_time + picoquic_test_uniform_random(&ctx.random_ctx, 30000000);
+        wake_bench_insert(&ctx, &ctx.cnx[i]);
+    }
+
+    start_time = picoquic_current_time();
+    for (int step = 0; step < nb_steps; step++) {
+        picoquic_cnx_t* cnx = wake_bench_first(&ctx);
+        picoquic_cnx_t* target = &ctx.cnx[picoquic_test_uniform_random(&ctx.random_ctx, ctx.nb_active)];
+
+        if (cnx->next_wake_time > ctx.current_time) {
+            ctx.current_time = cnx->next_wake_time;
+        }
+        wake_bench_reinsert(&ctx, cnx, wake_bench_next_time(&ctx, cnx));
+        if (overload) {
+            wake_bench_reinsert(&ctx, target, ctx.current_time - picoquic_test_uniform_random(&ctx.random_ctx, WAKE_BENCH_OVERLOAD_BACKLOG));
+            target = &ctx.cnx[picoquic_test_uniform_random(&ctx.random_ctx, ctx.nb_active)];
+            wake_bench_reinsert(&ctx, target, ctx.current_time - picoquic_test_uniform_random(&ctx.random_ctx, WAKE_BENCH_OVERLOAD_BACKLOG));
+        }
+        else {
+            wake_bench_reinsert(&ctx, target, ctx.current_time + picoquic_test_uniform_random(&ctx.random_ctx, 25000));
+        }
+    }
+    elapsed = picoquic_current_time() - start_time;
+
+    if (ctx.wheel != NULL) {
+        picoquic_wake_wheel_delete(ctx.wheel);
+    }
+    else {
+        picosplay_empty_tree(&ctx.tree);
+    }
+    free(ctx.cnx);
+
+    return elapsed;
+}
+
+int main(int argc, char** argv)
+{
+    const int nb_cnx[3] = { 1000, 10000, 100000 };
+    int nb_steps = WAKE_BENCH_STEPS_DEFAULT;
+
+    if (argc > 1) {
+        nb_steps = atoi(argv[1]);
+        if (nb_steps <= 0) {
+            fprintf(stderr, "Usage: %s [nb_steps]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    for (int overload = 0; overload < 2; overload++) {
+        printf("%sConnections, Splay ns/step, Wheel ns/step, Speedup\n", (overload) ? "Overload\n" : "");
+        for (int i = 0; i < 3; i++) {
+            uint64_t splay_time = wake_bench_run(nb_cnx[i], 0, overload, nb_steps);
+            uint64_t wheel_time = wake_bench_run(nb_cnx[i], 1, overload, nb_steps);
+
+            printf("%11d, %14.1f, %13.1f, %7.2f\n", nb_cnx[i],
+                ((double)splay_time) * 1000.0 / nb_steps, ((double)wheel_time) * 1000.0 / nb_steps,
+                (wheel_time > 0) ? ((double)splay_time) / ((double)wheel_time) : 0.0);
+        }
+    }
+
+    return 0;
+}
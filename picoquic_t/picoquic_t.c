@@ -52,6 +52,11 @@ static const picoquic_test_def_t test_table[] = {
     { "threading", util_threading_test },
     { "picohash", picohash_test },
     { "picohash_embedded", picohash_embedded_test },
+    { "picohash_grow", picohash_grow_test },
+    { "picohash_duplicate", picohash_duplicate_test },
+    { "picohash_churn", picohash_churn_test },
+    { "crypto_pool", crypto_pool_test },
+    { "path_cache", path_cache_test },
     { "picolog_basic", picolog_basic_test },
     { "bytestream", bytestream_test },
     { "sockloop_basic", sockloop_basic_test },
@@ -62,8 +67,21 @@ static const picoquic_test_def_t test_table[] = {
     { "sockloop_nat", sockloop_nat_test },
     { "sockloop_thread", sockloop_thread_test },
     { "sockloop_thread_name", sockloop_thread_name_test },
+    { "sockloop_batch_recv", sockloop_batch_recv_test },
+    { "sockloop_uring", sockloop_uring_test },
+    { "sockloop_uring_backend", sockloop_uring_backend_test },
+    { "sockloop_batch_send", sockloop_batch_send_test },
+    { "sockloop_txtime", sockloop_txtime_test },
+    { "sockloop_select", sockloop_select_test },
+    { "shard_steering", shard_steering_test },
     { "splay", splay_test },
     { "create_cnx", create_cnx_test },
+    { "incoming_batch", incoming_batch_test },
+    { "wake_wheel", wake_wheel_test },
+    { "packet_pool", packet_pool_test },
+    { "packet_pool_wait", packet_pool_wait_test },
+    { "sent_ring", sent_ring_test },
+    { "cnx_hibernation", cnx_hibernation_test },
     { "create_quic", create_quic_test },
     { "parseheader", parseheadertest },
     { "incoming_initial", incoming_initial_test },
@@ -78,13 +96,20 @@ static const picoquic_test_def_t test_table[] = {
     { "frames_repeat", frames_repeat_test },
     { "frames_ackack_error", frames_ackack_error_test },
     { "frames_format", frames_format_test },
+    { "frame_fast_parse", frame_fast_parse_test },
     { "logger", logger_test },
     { "binlog", binlog_test },
     { "app_message_overflow", app_message_overflow_test },
     { "TlsStreamFrame", TlsStreamFrameTest },
     { "StreamZeroFrame", StreamZeroFrameTest },
+    { "stream_ring", stream_ring_test },
+    { "stream_ring_sparse", stream_ring_sparse_test },
+    { "stream_views", stream_views_test },
+    { "rwnd_tuning", rwnd_tuning_test },
+    { "path_scheduler", path_scheduler_test },
     { "stream_splay", stream_splay_test },
     { "stream_output", stream_output_test },
+    { "stream_scheduler", stream_scheduler_test },
     { "stream_retransmit_copy", test_copy_for_retransmit },
     { "dataqueue_copy", dataqueue_copy_test },
     { "dataqueue_packet", dataqueue_packet_test },
@@ -95,12 +120,16 @@ static const picoquic_test_def_t test_table[] = {
     { "ack_disorder", ack_disorder_test },
     { "ack_horizon", ack_horizon_test },
     { "ack_of_ack", ack_of_ack_test },
+    { "ack_sack_array", ack_sack_array_test },
+    { "ack_reorder_bounded", ack_reorder_bounded_test },
     { "ackfrq_basic", ackfrq_basic_test },
     { "ackfrq_short", ackfrq_short_test },
     { "sim_link", sim_link_test },
     { "clear_text_aead", cleartext_aead_test },
     { "pn_ctr", pn_ctr_test },
     { "cleartext_pn_enc", cleartext_pn_enc_test },
+    { "pn_enc_batch", pn_enc_batch_test },
+    { "pn_dec_batch", pn_dec_batch_test },
     { "cid_for_lb", cid_for_lb_test },
     { "cid_for_lb_cli", cid_for_lb_cli_test },
     { "retry_protection_vector", retry_protection_vector_test },
@@ -115,6 +144,7 @@ static const picoquic_test_def_t test_table[] = {
     { "new_cnxid", new_cnxid_test },
     { "pacing", pacing_test },
     { "pacing_repeat", pacing_repeat_test },
+    { "pacing_offload", pacing_offload_test },
 #if 0
     /* The TLS API connect test is only useful when debugging issues step by step */
     { "tls_api_connect", tls_api_connect_test },
@@ -188,6 +218,7 @@ static const picoquic_test_def_t test_table[] = {
     { "nat_attack", nat_attack_test },
     { "sockets", socket_test },
     { "socket_ecn", socket_ecn_test },
+    { "socket_sendmmsg", socket_sendmmsg_test },
     { "ticket_store", ticket_store_test },
     { "ticket_seed", ticket_seed_test },
     { "ticket_seed_from_bdp_frame", ticket_seed_from_bdp_frame_test },
@@ -300,6 +331,8 @@ static const picoquic_test_def_t test_table[] = {
     { "qlog_trace_only", qlog_trace_only_test },
     { "qlog_trace_ecn", qlog_trace_ecn_test },
     { "perflog", perflog_test },
+    { "crypto_workers", crypto_workers_test },
+    { "key_rotation_train", key_rotation_train_test },
     { "nat_rebinding_stress", rebinding_stress_test },
     { "random_padding", random_padding_test },
     { "ec00_zero", ec00_zero_test },
@@ -394,6 +427,7 @@ static const picoquic_test_def_t test_table[] = {
     { "limited_safe", limited_safe_test },
     { "send_stream_blocked", send_stream_blocked_test },
     { "stream_ack", stream_ack_test },
+    { "stream_zero_copy", stream_zero_copy_test },
     { "queue_network_input", queue_network_input_test },
     { "pacing_update", pacing_update_test },
     { "quality_update", quality_update_test },
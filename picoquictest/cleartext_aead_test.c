@@ -533,6 +533,161 @@ int cleartext_pn_enc_test()
     return ret;
 }
 
+/*
+ * Test that the batched header protection, which computes the masks of
+ * several packets in a single ECB call, produces the same result as the
+ * packet by packet protection.
+ */
+
+#define PN_ENC_BATCH_TEST_NB 70
+#define PN_ENC_BATCH_TEST_LENGTH 48
+
+int pn_enc_batch_test()
+{
+    int ret = 0;
+    struct sockaddr_in test_addr_c;
+    picoquic_cnx_t* cnx_client = NULL;
+    picoquic_quic_t* qclient = picoquic_create(8, NULL, NULL, NULL, NULL, NULL, NULL,
+        NULL, NULL, NULL, 0, NULL, NULL, NULL, 0);
+    uint8_t expected[PN_ENC_BATCH_TEST_NB][PN_ENC_BATCH_TEST_LENGTH];
+    uint8_t batched[PN_ENC_BATCH_TEST_NB][PN_ENC_BATCH_TEST_LENGTH];
+    uint64_t random_ctx = 0x5ca1ab1e;
+
+    if (qclient == NULL) {
+        DBG_PRINTF("%s", "Could not create Quic context.\n");
+        ret = -1;
+    }
+    else {
+        memset(&test_addr_c, 0, sizeof(struct sockaddr_in));
+        test_addr_c.sin_family = AF_INET;
+        memcpy(&test_addr_c.sin_addr, addr1, 4);
+        test_addr_c.sin_port = 12345;
+
+        cnx_client = picoquic_create_cnx(qclient, picoquic_null_connection_id, picoquic_null_connection_id,
+            (struct sockaddr*)&test_addr_c, 0, 0, NULL, PICOQUIC_TEST_ALPN, 1);
+        if (cnx_client == NULL) {
+            DBG_PRINTF("%s", "Could not create client connection context.\n");
+            ret = -1;
+        }
+        else if (cnx_client->crypto_context[0].pn_enc == NULL || cnx_client->crypto_context[0].pn_enc_ecb == NULL) {
+            DBG_PRINTF("%s", "Initial context has no ECB key.\n");
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        for (int i = 0; i < PN_ENC_BATCH_TEST_NB; i++) {
+            picoquic_test_random_bytes(&random_ctx, expected[i], PN_ENC_BATCH_TEST_LENGTH);
+            memcpy(batched[i], expected[i], PN_ENC_BATCH_TEST_LENGTH);
+            picoquic_protect_packet_header(expected[i], 1 + (i % 21), 0x1F, cnx_client->crypto_context[0].pn_enc);
+            /* Some packets have no ECB key, to test the fallback */
+            picoquic_hp_batch_add(&qclient->hp_batch, batched[i], 1 + (i % 21), 0x1F, cnx_client->crypto_context[0].pn_enc,
+                (i % 7 == 3) ? NULL : cnx_client->crypto_context[0].pn_enc_ecb);
+        }
+        picoquic_hp_batch_flush(&qclient->hp_batch);
+
+        if (qclient->hp_batch.nb_entries != 0 || memcmp(expected, batched, sizeof(expected)) != 0) {
+            DBG_PRINTF("%s", "Batched header protection does not match.\n");
+            ret = -1;
+        }
+    }
+
+    if (cnx_client != NULL) {
+        picoquic_delete_cnx(cnx_client);
+    }
+
+    if (qclient != NULL) {
+        picoquic_free(qclient);
+    }
+
+    return ret;
+}
+
+/*
+ * Test that the header protection masks computed for a batch of incoming
+ * packets match those computed packet by packet, including when the
+ * packets are decoded out of order.
+ */
+
+int pn_dec_batch_test()
+{
+    int ret = 0;
+    struct sockaddr_in test_addr_c;
+    picoquic_cnx_t* cnx_client = NULL;
+    picoquic_quic_t* qclient = picoquic_create(8, NULL, NULL, NULL, NULL, NULL, NULL,
+        NULL, NULL, NULL, 0, NULL, NULL, NULL, 0);
+    uint8_t samples[PICOQUIC_HP_BATCH_MAX][16];
+    const uint8_t* sample_ptr[PICOQUIC_HP_BATCH_MAX];
+    uint64_t random_ctx = 0xdecafbad;
+
+    if (qclient == NULL) {
+        DBG_PRINTF("%s", "Could not create Quic context.\n");
+        ret = -1;
+    }
+    else {
+        memset(&test_addr_c, 0, sizeof(struct sockaddr_in));
+        test_addr_c.sin_family = AF_INET;
+        memcpy(&test_addr_c.sin_addr, addr1, 4);
+        test_addr_c.sin_port = 12345;
+
+        cnx_client = picoquic_create_cnx(qclient, picoquic_null_connection_id, picoquic_null_connection_id,
+            (struct sockaddr*)&test_addr_c, 0, 0, NULL, PICOQUIC_TEST_ALPN, 1);
+        if (cnx_client == NULL) {
+            DBG_PRINTF("%s", "Could not create client connection context.\n");
+            ret = -1;
+        }
+        else if (cnx_client->crypto_context[0].pn_dec == NULL || cnx_client->crypto_context[0].pn_dec_ecb == NULL) {
+            DBG_PRINTF("%s", "Initial context has no ECB key.\n");
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        void* pn_dec = cnx_client->crypto_context[0].pn_dec;
+
+        for (int i = 0; i < PICOQUIC_HP_BATCH_MAX; i++) {
+            picoquic_test_random_bytes(&random_ctx, samples[i], 16);
+            sample_ptr[i] = samples[i];
+        }
+        picoquic_hp_mask_cache_compute(&qclient->hp_mask_cache, pn_dec, cnx_client->crypto_context[0].pn_dec_ecb,
+            sample_ptr, PICOQUIC_HP_BATCH_MAX);
+
+        for (int i = 0; ret == 0 && i < PICOQUIC_HP_BATCH_MAX; i++) {
+            /* Decode in a different order than the masks were computed */
+            int j = (i * 7) % PICOQUIC_HP_BATCH_MAX;
+            uint8_t expected[5] = { 0, 0, 0, 0, 0 };
+            const uint8_t* mask = picoquic_hp_mask_cache_find(&qclient->hp_mask_cache, pn_dec, samples[j]);
+
+            picoquic_pn_encrypt(pn_dec, samples[j], expected, expected, sizeof(expected));
+            if (mask == NULL || memcmp(mask, expected, sizeof(expected)) != 0) {
+                DBG_PRINTF("Batched mask %d does not match.\n", j);
+                ret = -1;
+            }
+        }
+
+        if (ret == 0) {
+            uint8_t unknown[16];
+
+            picoquic_test_random_bytes(&random_ctx, unknown, sizeof(unknown));
+            if (picoquic_hp_mask_cache_find(&qclient->hp_mask_cache, pn_dec, unknown) != NULL ||
+                picoquic_hp_mask_cache_find(&qclient->hp_mask_cache, cnx_client->crypto_context[0].pn_enc, samples[0]) != NULL) {
+                DBG_PRINTF("%s", "Mask found for unknown sample or key.\n");
+                ret = -1;
+            }
+        }
+    }
+
+    if (cnx_client != NULL) {
+        picoquic_delete_cnx(cnx_client);
+    }
+
+    if (qclient != NULL) {
+        picoquic_free(qclient);
+    }
+
+    return ret;
+}
+
 /* Test vector copied from Kazuho Ohu's test code in quicly -- then changed */
 
 int cleartext_pn_vector_test()
@@ -20,6 +20,7 @@
 */
 
 #include "picoquic_internal.h"
+#include "picoquictest_internal.h"
 #include <stdlib.h>
 #ifdef _WINDOWS
 #include <malloc.h>
@@ -331,4 +332,1316 @@ int create_quic_test()
     }
 
     return ret;
-}
\ No newline at end of file
+}
+/*
+ * Test the incoming batch API:
+ * - create a set of connections, and set their wake time in the future.
+ * - submit a batch of short header packets interleaving several connections
+ *   and an unknown CID. The packets cannot be decrypted and will be dropped.
+ * - verify that the connections that received packets, and only those,
+ *   are rescheduled at the current time, that the deferred list is empty
+ *   at the end of the batch, and that the last connection is reported.
+ * - verify that packets sent to two CIDs of the same connection are
+ *   grouped, and that packets are not grouped across a long header
+ *   packet that cannot be attributed to a connection.
+ */
+#define INCOMING_BATCH_CNX_COUNT 4
+#define INCOMING_BATCH_NB_PACKETS 11
+
+int incoming_batch_test()
+{
+    int ret = 0;
+    uint64_t current_time = 1000000;
+    uint64_t wake_time = current_time + 10000000;
+    picoquic_quic_t* quic = NULL;
+    picoquic_cnx_t* test_cnx[INCOMING_BATCH_CNX_COUNT] = { NULL, NULL, NULL, NULL };
+    picoquic_cnx_t* last_cnx = NULL;
+    struct sockaddr_in test4[INCOMING_BATCH_CNX_COUNT];
+    struct sockaddr_in local4;
+    /* Index of the target connection for each packet, -1 for an unknown CID */
+    const int packet_target[INCOMING_BATCH_NB_PACKETS] = { 0, 1, 0, -1, 2, 1, 0, 2, -1, 1, 0 };
+    uint8_t packet[INCOMING_BATCH_NB_PACKETS][64];
+    picoquic_incoming_datagram_t datagrams[INCOMING_BATCH_NB_PACKETS];
+
+    memset(&local4, 0, sizeof(local4));
+    local4.sin_family = AF_INET;
+    local4.sin_port = 4433;
+
+    quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, current_time, NULL, NULL, NULL, 0);
+    if (quic == NULL) {
+        ret = -1;
+    }
+
+    for (int i = 0; ret == 0 && i < INCOMING_BATCH_CNX_COUNT; i++) {
+        memset(&test4[i], 0, sizeof(test4[i]));
+        test4[i].sin_family = AF_INET;
+        test4[i].sin_port = (uint16_t)(1000 + i);
+        test_cnx[i] = picoquic_create_cnx(quic, picoquic_null_connection_id, picoquic_null_connection_id,
+            (struct sockaddr*)&test4[i], current_time, 0, NULL, NULL, 1);
+        if (test_cnx[i] == NULL || test_cnx[i]->path[0]->p_local_cnxid == NULL) {
+            ret = -1;
+        }
+        else {
+            picoquic_reinsert_by_wake_time(quic, test_cnx[i], wake_time);
+        }
+    }
+
+    /* Format the packets */
+    for (int i = 0; ret == 0 && i < INCOMING_BATCH_NB_PACKETS; i++) {
+        size_t length = 1;
+
+        memset(packet[i], 0x5a, sizeof(packet[i]));
+        packet[i][0] = 0x41;
+        if (packet_target[i] >= 0) {
+            length += picoquic_format_connection_id(packet[i] + 1, sizeof(packet[i]) - 1,
+                test_cnx[packet_target[i]]->path[0]->p_local_cnxid->cnx_id);
+        }
+        else {
+            length += quic->local_cnxid_length;
+        }
+        datagrams[i].bytes = packet[i];
+        datagrams[i].length = sizeof(packet[i]);
+        datagrams[i].addr_from = (struct sockaddr*)((packet_target[i] >= 0) ? &test4[packet_target[i]] : &test4[0]);
+        datagrams[i].addr_to = (struct sockaddr*)&local4;
+        datagrams[i].if_index_to = 0;
+        datagrams[i].received_ecn = 0;
+        if (length >= sizeof(packet[i])) {
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        ret = picoquic_incoming_packets_batch(quic, datagrams, INCOMING_BATCH_NB_PACKETS, &last_cnx, current_time);
+        if (ret != 0) {
+            DBG_PRINTF("Incoming batch returns 0x%x", ret);
+        }
+    }
+
+    if (ret == 0 && (quic->is_incoming_batch || quic->wake_deferred_first != NULL || quic->batch_l_cid != NULL)) {
+        DBG_PRINTF("%s", "Incoming batch state not reset");
+        ret = -1;
+    }
+
+    for (int i = 0; ret == 0 && i < INCOMING_BATCH_CNX_COUNT; i++) {
+        /* Connections 0, 1 and 2 received packets, connection 3 did not */
+        uint64_t expected_wake_time = (i < 3) ? current_time : wake_time;
+
+        if (test_cnx[i]->is_wake_deferred || test_cnx[i]->next_wake_deferred != NULL) {
+            DBG_PRINTF("Connection %d still deferred", i);
+            ret = -1;
+        }
+        else if (test_cnx[i]->next_wake_time != expected_wake_time) {
+            DBG_PRINTF("Connection %d wake time %" PRIu64 " instead of %" PRIu64,
+                i, test_cnx[i]->next_wake_time, expected_wake_time);
+            ret = -1;
+        }
+    }
+
+    /* Groups are processed in order of first arrival, the last group targets connection 2 */
+    if (ret == 0 && last_cnx != test_cnx[2]) {
+        DBG_PRINTF("%s", "Unexpected last connection");
+        ret = -1;
+    }
+
+    if (ret == 0 && picoquic_get_earliest_cnx_to_wake(quic, 0) != test_cnx[0]) {
+        DBG_PRINTF("%s", "Wake up order does not follow arrival order");
+        ret = -1;
+    }
+
+    /* Packets are grouped by connection, not by CID. Connection 1 receives
+     * packets on two CIDs, so the last group targets connection 2 */
+    if (ret == 0) {
+        picoquic_local_cnxid_t* l_cid2 = picoquic_create_local_cnxid(test_cnx[1], 0, NULL, current_time);
+
+        if (l_cid2 == NULL) {
+            ret = -1;
+        }
+        else {
+            (void)picoquic_format_connection_id(packet[0] + 1, sizeof(packet[0]) - 1, test_cnx[1]->path[0]->p_local_cnxid->cnx_id);
+            (void)picoquic_format_connection_id(packet[1] + 1, sizeof(packet[1]) - 1, test_cnx[2]->path[0]->p_local_cnxid->cnx_id);
+            (void)picoquic_format_connection_id(packet[2] + 1, sizeof(packet[2]) - 1, l_cid2->cnx_id);
+            last_cnx = NULL;
+            ret = picoquic_incoming_packets_batch(quic, datagrams, 3, &last_cnx, current_time);
+            if (ret == 0 && last_cnx != test_cnx[2]) {
+                DBG_PRINTF("%s", "Packets of a connection not grouped across CIDs");
+                ret = -1;
+            }
+        }
+    }
+
+    /* A long header packet with an unknown CID might belong to any connection.
+     * Packets that follow it are not grouped with those that precede it */
+    if (ret == 0) {
+        memset(packet[1], 0x5a, sizeof(packet[1]));
+        packet[1][0] = 0xe0;
+        picoformat_32(packet[1] + 1, PICOQUIC_V1_VERSION);
+        packet[1][5] = 8;
+        (void)picoquic_format_connection_id(packet[2] + 1, sizeof(packet[2]) - 1, test_cnx[2]->path[0]->p_local_cnxid->cnx_id);
+        (void)picoquic_format_connection_id(packet[3] + 1, sizeof(packet[3]) - 1, test_cnx[1]->path[0]->p_local_cnxid->cnx_id);
+        packet[3][0] = 0x41;
+        last_cnx = NULL;
+        ret = picoquic_incoming_packets_batch(quic, datagrams, 4, &last_cnx, current_time);
+        if (ret == 0 && last_cnx != test_cnx[1]) {
+            DBG_PRINTF("%s", "Packets grouped across a long header packet");
+            ret = -1;
+        }
+    }
+
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+
+    return ret;
+}
+
+/*
+ * Wake wheel test.
+ * - Exercise the timing wheel with a set of dummy connections and random
+ *   wake times spanning all levels, including late connections and
+ *   connections waiting forever. After each step, verify that the first
+ *   connection returned by the wheel has the lowest wake time.
+ * - Create a QUIC context with connections, switch the scheduler from the
+ *   splay to the wheel and back, and verify that the connections are
+ *   returned in wake time order.
+ * - Insert many late connections, and verify that they are returned in
+ *   wake time order.
+ */
+#define WAKE_WHEEL_TEST_NB_CNX 257
+#define WAKE_WHEEL_TEST_NB_STEPS 20000
+#define WAKE_WHEEL_TEST_QUIC_CNX 5
+#define WAKE_WHEEL_TEST_LATE_CNX 1000
+
+static uint64_t wake_wheel_test_time(uint64_t* random_ctx, uint64_t current_time)
+{
+    uint64_t wake_time;
+
+    switch (picoquic_test_uniform_random(random_ctx, 6)) {
+    case 0:
+        /* Late connection */
+        wake_time = current_time - picoquic_test_uniform_random(random_ctx, 1000);
+        break;
+    case 1:
+        /* Pacing or ack delay */
+        wake_time = current_time + picoquic_test_uniform_random(random_ctx, 25000);
+        break;
+    case 2:
+        /* Retransmission timer */
+        wake_time = current_time + 100000 + picoquic_test_uniform_random(random_ctx, 2000000);
+        break;
+    case 3:
+        /* Keep alive or idle timeout */
+        wake_time = current_time + 10000000 + picoquic_test_uniform_random(random_ctx, 20000000);
+        break;
+    case 4:
+        /* Exact same time as the current time */
+        wake_time = current_time;
+        break;
+    default:
+        wake_time = UINT64_MAX;
+        break;
+    }
+    return wake_time;
+}
+
+static int wake_wheel_test_check(picoquic_wake_wheel_t* wheel, picoquic_cnx_t* cnx, int nb_cnx, int step)
+{
+    int ret = 0;
+    picoquic_cnx_t* first = picoquic_wake_wheel_first(wheel);
+    uint64_t min_time = UINT64_MAX;
+    size_t nb_in_wheel = 0;
+
+    for (int i = 0; i < nb_cnx; i++) {
+        if (cnx[i].wake_wheel_node.is_in_wheel) {
+            nb_in_wheel++;
+            if (cnx[i].next_wake_time < min_time) {
+                min_time = cnx[i].next_wake_time;
+            }
+        }
+    }
+
+    if (nb_in_wheel != wheel->nb_cnx) {
+        DBG_PRINTF("Step %d, wheel has %zu cnx instead of %zu", step, wheel->nb_cnx, nb_in_wheel);
+        ret = -1;
+    }
+    else if (nb_in_wheel == 0) {
+        if (first != NULL) {
+            DBG_PRINTF("Step %d, empty wheel returns a connection", step);
+            ret = -1;
+        }
+    }
+    else if (first == NULL || first->next_wake_time != min_time) {
+        DBG_PRINTF("Step %d, first wake time is %" PRIu64 " instead of %" PRIu64, step,
+            (first == NULL) ? 0 : first->next_wake_time, min_time);
+        ret = -1;
+    }
+    return ret;
+}
+
+static int wake_wheel_quic_test()
+{
+    int ret = 0;
+    uint64_t current_time = 1000000;
+    const uint64_t wake_delta[WAKE_WHEEL_TEST_QUIC_CNX] = { 30000000, 1000, 250000, 0, 5000000 };
+    const int wake_order[WAKE_WHEEL_TEST_QUIC_CNX] = { 3, 1, 2, 4, 0 };
+    picoquic_cnx_t* test_cnx[WAKE_WHEEL_TEST_QUIC_CNX] = { NULL, NULL, NULL, NULL, NULL };
+    struct sockaddr_in test4[WAKE_WHEEL_TEST_QUIC_CNX];
+    picoquic_quic_t* quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, current_time, NULL, NULL, NULL, 0);
+
+    if (quic == NULL) {
+        ret = -1;
+    }
+
+    for (int i = 0; ret == 0 && i < WAKE_WHEEL_TEST_QUIC_CNX; i++) {
+        memset(&test4[i], 0, sizeof(test4[i]));
+        test4[i].sin_family = AF_INET;
+        test4[i].sin_port = (uint16_t)(1000 + i);
+        test_cnx[i] = picoquic_create_cnx(quic, picoquic_null_connection_id, picoquic_null_connection_id,
+            (struct sockaddr*)&test4[i], current_time, 0, NULL, NULL, 1);
+        if (test_cnx[i] == NULL) {
+            ret = -1;
+        }
+        else {
+            picoquic_reinsert_by_wake_time(quic, test_cnx[i], current_time + wake_delta[i]);
+        }
+    }
+
+    /* Switch to the wheel, back to the splay, then to the wheel again */
+    for (int pass = 0; ret == 0 && pass < 3; pass++) {
+        picoquic_wake_scheduler_enum scheduler = (pass == 1) ? picoquic_wake_scheduler_splay : picoquic_wake_scheduler_wheel;
+
+        if (picoquic_set_wake_scheduler(quic, scheduler) != 0 ||
+            (quic->wake_wheel != NULL) != (scheduler == picoquic_wake_scheduler_wheel)) {
+            DBG_PRINTF("Cannot set wake scheduler %d", scheduler);
+            ret = -1;
+        }
+        /* Retrieve the connections in order, then push each one beyond the others */
+        for (int i = 0; ret == 0 && i < WAKE_WHEEL_TEST_QUIC_CNX; i++) {
+            int x = wake_order[i];
+            if (picoquic_get_earliest_cnx_to_wake(quic, 0) != test_cnx[x]) {
+                DBG_PRINTF("Pass %d, wake %d: expected cnx %d", pass, i, x);
+                ret = -1;
+            }
+            else {
+                picoquic_reinsert_by_wake_time(quic, test_cnx[x], current_time + 60000000 + wake_delta[x]);
+            }
+        }
+        for (int i = 0; ret == 0 && i < WAKE_WHEEL_TEST_QUIC_CNX; i++) {
+            picoquic_reinsert_by_wake_time(quic, test_cnx[i], current_time + wake_delta[i]);
+        }
+        if (ret == 0 && picoquic_get_next_wake_time(quic, current_time) != current_time + wake_delta[wake_order[0]]) {
+            DBG_PRINTF("Pass %d, unexpected next wake time", pass);
+            ret = -1;
+        }
+    }
+
+    /* Delete a connection while using the wheel */
+    if (ret == 0) {
+        picoquic_delete_cnx(test_cnx[wake_order[0]]);
+        if (picoquic_get_earliest_cnx_to_wake(quic, 0) != test_cnx[wake_order[1]] ||
+            quic->wake_wheel->nb_cnx != WAKE_WHEEL_TEST_QUIC_CNX - 1) {
+            DBG_PRINTF("%s", "Wheel not updated after connection delete");
+            ret = -1;
+        }
+    }
+
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+
+    return ret;
+}
+
+/* Overload: after the wheel time advanced to a far connection, insert many
+ * connections due before it. They are kept in the late tree, and are
+ * returned in wake time order before the far connection. */
+static int wake_wheel_late_test()
+{
+    int ret = 0;
+    uint64_t random_ctx = 0x1a7e1a7e1a7e1a7eull;
+    uint64_t current_time = 0x0001234567890000ull;
+    uint64_t last_time = 0;
+    picoquic_cnx_t* cnx = (picoquic_cnx_t*)malloc(sizeof(picoquic_cnx_t) * (WAKE_WHEEL_TEST_LATE_CNX + 1));
+    picoquic_wake_wheel_t* wheel = picoquic_wake_wheel_create(current_time);
+    picoquic_cnx_t* far_cnx = NULL;
+
+    if (cnx == NULL || wheel == NULL) {
+        ret = -1;
+    }
+    else {
+        memset(cnx, 0, sizeof(picoquic_cnx_t) * (WAKE_WHEEL_TEST_LATE_CNX + 1));
+        far_cnx = &cnx[WAKE_WHEEL_TEST_LATE_CNX];
+        far_cnx->next_wake_time = current_time + 10000000;
+        picoquic_wake_wheel_insert(wheel, far_cnx);
+        if (picoquic_wake_wheel_first(wheel) != far_cnx || wheel->wheel_time <= current_time) {
+            DBG_PRINTF("%s", "Wheel time did not advance to the far connection");
+            ret = -1;
+        }
+    }
+
+    for (int i = 0; ret == 0 && i < WAKE_WHEEL_TEST_LATE_CNX; i++) {
+        cnx[i].next_wake_time = current_time + picoquic_test_uniform_random(&random_ctx, 10000000);
+        picoquic_wake_wheel_insert(wheel, &cnx[i]);
+        if (cnx[i].wake_wheel_node.level != PICOQUIC_WAKE_WHEEL_LATE) {
+            DBG_PRINTF("Connection %d is not in the late tree", i);
+            ret = -1;
+        }
+    }
+
+    if (ret == 0 && wheel->late_tree.size != WAKE_WHEEL_TEST_LATE_CNX) {
+        DBG_PRINTF("Late tree has %d connections instead of %d", wheel->late_tree.size, WAKE_WHEEL_TEST_LATE_CNX);
+        ret = -1;
+    }
+
+    for (int i = 0; ret == 0 && i < WAKE_WHEEL_TEST_LATE_CNX; i++) {
+        picoquic_cnx_t* first = picoquic_wake_wheel_first(wheel);
+
+        if (first == NULL || first == far_cnx || first->next_wake_time < last_time) {
+            DBG_PRINTF("Late connection %d returned out of order", i);
+            ret = -1;
+        }
+        else {
+            last_time = first->next_wake_time;
+            picoquic_wake_wheel_remove(wheel, first);
+        }
+    }
+
+    if (ret == 0 && (picoquic_wake_wheel_first(wheel) != far_cnx || wheel->late_tree.size != 0 || wheel->nb_cnx != 1)) {
+        DBG_PRINTF("%s", "Far connection not returned after the late ones");
+        ret = -1;
+    }
+
+    if (wheel != NULL) {
+        picoquic_wake_wheel_delete(wheel);
+    }
+    if (cnx != NULL) {
+        free(cnx);
+    }
+
+    return ret;
+}
+
+int wake_wheel_test()
+{
+    int ret = 0;
+    uint64_t random_ctx = 0x77a4e3be5c6f1d29ull;
+    uint64_t current_time = 0x0001234567890000ull;
+    picoquic_cnx_t* cnx = (picoquic_cnx_t*)malloc(sizeof(picoquic_cnx_t) * WAKE_WHEEL_TEST_NB_CNX);
+    picoquic_wake_wheel_t* wheel = picoquic_wake_wheel_create(current_time);
+
+    if (cnx == NULL || wheel == NULL) {
+        ret = -1;
+    }
+    else {
+        memset(cnx, 0, sizeof(picoquic_cnx_t) * WAKE_WHEEL_TEST_NB_CNX);
+        for (int i = 0; i < WAKE_WHEEL_TEST_NB_CNX; i++) {
+            cnx[i].next_wake_time = wake_wheel_test_time(&random_ctx, current_time);
+            picoquic_wake_wheel_insert(wheel, &cnx[i]);
+        }
+    }
+
+    for (int step = 0; ret == 0 && step < WAKE_WHEEL_TEST_NB_STEPS; step++) {
+        ret = wake_wheel_test_check(wheel, cnx, WAKE_WHEEL_TEST_NB_CNX, step);
+        if (ret == 0) {
+            picoquic_cnx_t* first = picoquic_wake_wheel_first(wheel);
+            picoquic_cnx_t* target = &cnx[picoquic_test_uniform_random(&random_ctx, WAKE_WHEEL_TEST_NB_CNX)];
+
+            /* Process the first connection if due, or advance the time */
+            if (first != NULL && first->next_wake_time != UINT64_MAX) {
+                if (first->next_wake_time > current_time) {
+                    current_time = first->next_wake_time;
+                }
+                picoquic_wake_wheel_remove(wheel, first);
+                first->next_wake_time = wake_wheel_test_time(&random_ctx, current_time);
+                picoquic_wake_wheel_insert(wheel, first);
+            }
+            else {
+                current_time += 1000000;
+            }
+            /* Random event on another connection: remove, or reinsert */
+            picoquic_wake_wheel_remove(wheel, target);
+            if ((step % 7) != 0) {
+                target->next_wake_time = wake_wheel_test_time(&random_ctx, current_time);
+                picoquic_wake_wheel_insert(wheel, target);
+            }
+        }
+    }
+
+    /* Empty the wheel in order */
+    while (ret == 0 && wheel->nb_cnx > 0) {
+        ret = wake_wheel_test_check(wheel, cnx, WAKE_WHEEL_TEST_NB_CNX, WAKE_WHEEL_TEST_NB_STEPS);
+        picoquic_wake_wheel_remove(wheel, picoquic_wake_wheel_first(wheel));
+    }
+    if (ret == 0) {
+        ret = wake_wheel_test_check(wheel, cnx, WAKE_WHEEL_TEST_NB_CNX, WAKE_WHEEL_TEST_NB_STEPS);
+    }
+
+    if (wheel != NULL) {
+        picoquic_wake_wheel_delete(wheel);
+    }
+    if (cnx != NULL) {
+        free(cnx);
+    }
+
+    if (ret == 0) {
+        ret = wake_wheel_quic_test();
+    }
+
+    if (ret == 0) {
+        ret = wake_wheel_late_test();
+    }
+
+    return ret;
+}
+
+/*
+ * Packet pool test.
+ * - Allocate packets, verify that they are carved from slabs, that the
+ *   metadata is cleared on reuse, and that the statistics are correct.
+ * - Verify that allocation fails when the ceiling is reached, and
+ *   resumes once packets are recycled.
+ * - Verify that fully free slabs are released when the pool exceeds
+ *   PICOQUIC_MAX_PACKETS_IN_POOL.
+ */
+#define PACKET_POOL_TEST_NB (PICOQUIC_MAX_PACKETS_IN_POOL + 4 * PICOQUIC_PACKET_SLAB_SIZE)
+
+static int packet_pool_test_stats(picoquic_quic_t* quic, uint64_t nb_requests, uint64_t nb_hits,
+    size_t nb_slabs, size_t nb_allocated, size_t nb_in_pool)
+{
+    int ret = 0;
+    picoquic_packet_pool_stats_t stats;
+
+    picoquic_get_packet_pool_stats(quic, &stats);
+    if (stats.nb_requests != nb_requests || stats.nb_pool_hits != nb_hits || stats.nb_slabs != nb_slabs ||
+        stats.nb_allocated != nb_allocated || stats.nb_in_pool != nb_in_pool) {
+        DBG_PRINTF("Pool stats: requests %" PRIu64 "/%" PRIu64 ", hits %" PRIu64 "/%" PRIu64 ", slabs %zu/%zu, allocated %zu/%zu, in pool %zu/%zu",
+            stats.nb_requests, nb_requests, stats.nb_pool_hits, nb_hits, stats.nb_slabs, nb_slabs,
+            stats.nb_allocated, nb_allocated, stats.nb_in_pool, nb_in_pool);
+        ret = -1;
+    }
+    return ret;
+}
+
+int packet_pool_test()
+{
+    int ret = 0;
+    const size_t max_packets = PICOQUIC_PACKET_SLAB_SIZE + 8;
+    picoquic_packet_t** packets = (picoquic_packet_t**)malloc(sizeof(picoquic_packet_t*) * PACKET_POOL_TEST_NB);
+    picoquic_quic_t* quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, 0, NULL, NULL, NULL, 0);
+    picoquic_packet_pool_stats_t stats;
+
+    if (quic == NULL || packets == NULL) {
+        ret = -1;
+    }
+
+    /* First packet creates a slab, the next ones are hits */
+    if (ret == 0) {
+        picoquic_set_packet_pool_max(quic, max_packets);
+        for (size_t i = 0; ret == 0 && i < max_packets; i++) {
+            if ((packets[i] = picoquic_create_packet(quic)) == NULL) {
+                DBG_PRINTF("Cannot allocate packet %zu", i);
+                ret = -1;
+            }
+        }
+        if (ret == 0) {
+            ret = packet_pool_test_stats(quic, max_packets, max_packets - 2, 2, max_packets, 0);
+        }
+    }
+
+    /* The ceiling is reached */
+    if (ret == 0 && picoquic_create_packet(quic) != NULL) {
+        DBG_PRINTF("%s", "Allocation beyond the ceiling");
+        ret = -1;
+    }
+
+    /* Recycle a packet, check that it comes back with clear metadata */
+    if (ret == 0) {
+        picoquic_packet_t* packet = packets[3];
+        packet->length = 1234;
+        packet->sequence_number = 77;
+        packet->is_ack_eliciting = 1;
+        packet->bytes[0] = 0xaa;
+        picoquic_recycle_packet(quic, packet);
+        packets[3] = picoquic_create_packet(quic);
+        if (packets[3] != packet || packet->length != 0 || packet->sequence_number != 0 ||
+            packet->is_ack_eliciting || packet->slab == NULL) {
+            DBG_PRINTF("%s", "Recycled packet not reset properly");
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        picoquic_get_packet_pool_stats(quic, &stats);
+        if (stats.nb_exhausted != 1 || stats.nb_allocated_max != max_packets || stats.max_packets != max_packets) {
+            DBG_PRINTF("Unexpected stats, exhausted %" PRIu64 ", max %zu", stats.nb_exhausted, stats.nb_allocated_max);
+            ret = -1;
+        }
+    }
+
+    /* Recycle everything. The pool keeps the slabs */
+    if (ret == 0) {
+        for (size_t i = 0; i < max_packets; i++) {
+            picoquic_recycle_packet(quic, packets[i]);
+        }
+        ret = packet_pool_test_stats(quic, max_packets + 2, max_packets - 1, 2, max_packets, max_packets);
+    }
+
+    /* Without ceiling, allocate more than the pool limit, then recycle */
+    if (ret == 0) {
+        picoquic_set_packet_pool_max(quic, 0);
+        for (size_t i = 0; ret == 0 && i < PACKET_POOL_TEST_NB; i++) {
+            if ((packets[i] = picoquic_create_packet(quic)) == NULL) {
+                DBG_PRINTF("Cannot allocate packet %zu", i);
+                ret = -1;
+            }
+        }
+        for (size_t i = 0; ret == 0 && i < PACKET_POOL_TEST_NB; i++) {
+            picoquic_recycle_packet(quic, packets[i]);
+        }
+        if (ret == 0) {
+            picoquic_get_packet_pool_stats(quic, &stats);
+            if (stats.nb_in_pool != stats.nb_allocated || stats.nb_in_pool < PICOQUIC_MAX_PACKETS_IN_POOL ||
+                stats.nb_in_pool >= PICOQUIC_MAX_PACKETS_IN_POOL + PICOQUIC_PACKET_SLAB_SIZE ||
+                stats.nb_allocated_max < PACKET_POOL_TEST_NB) {
+                DBG_PRINTF("Pool not trimmed, %zu in pool, %zu allocated", stats.nb_in_pool, stats.nb_allocated);
+                ret = -1;
+            }
+        }
+    }
+
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+    if (packets != NULL) {
+        free(packets);
+    }
+
+    return ret;
+}
+
+/* Test that a connection blocked by the pool ceiling is woken up when
+ * packets are recycled, and that sending resumes.
+ */
+static int packet_pool_wait_fill(picoquic_quic_t* quic, picoquic_packet_t** packets, size_t max_packets, size_t * nb_packets)
+{
+    int ret = 0;
+
+    while (*nb_packets < max_packets) {
+        if ((packets[*nb_packets] = picoquic_create_packet(quic)) == NULL) {
+            DBG_PRINTF("Cannot allocate packet %zu", *nb_packets);
+            ret = -1;
+            break;
+        }
+        (*nb_packets)++;
+    }
+    return ret;
+}
+
+static int packet_pool_wait_prepare(picoquic_cnx_t* cnx, uint64_t current_time, size_t* send_length)
+{
+    uint8_t send_buffer[PICOQUIC_MAX_PACKET_SIZE];
+    struct sockaddr_storage addr_to;
+    struct sockaddr_storage addr_from;
+    int if_index = 0;
+    int ret = picoquic_prepare_packet_ex(cnx, current_time, send_buffer, sizeof(send_buffer), send_length,
+        &addr_to, &addr_from, &if_index, NULL);
+
+    if (ret != 0) {
+        DBG_PRINTF("Prepare packet returns 0x%x", ret);
+    }
+    return ret;
+}
+
+int packet_pool_wait_test()
+{
+    int ret = 0;
+    uint64_t simulated_time = 0;
+    const size_t max_packets = PICOQUIC_PACKET_SLAB_SIZE;
+    size_t nb_packets = 0;
+    size_t send_length = 0;
+    struct sockaddr_in addr4;
+    picoquic_cnx_t* cnx = NULL;
+    picoquic_packet_t** packets = (picoquic_packet_t**)malloc(sizeof(picoquic_packet_t*) * max_packets);
+    picoquic_quic_t* quic = picoquic_create(8, NULL, NULL, NULL, PICOQUIC_TEST_ALPN, NULL, NULL, NULL, NULL, NULL,
+        simulated_time, &simulated_time, NULL, NULL, 0);
+
+    memset(&addr4, 0, sizeof(addr4));
+    addr4.sin_family = AF_INET;
+    addr4.sin_port = 4433;
+
+    if (quic == NULL || packets == NULL || (cnx = picoquic_create_cnx(quic, picoquic_null_connection_id,
+        picoquic_null_connection_id, (struct sockaddr*)&addr4, simulated_time, 0, PICOQUIC_TEST_SNI,
+        PICOQUIC_TEST_ALPN, 1)) == NULL) {
+        ret = -1;
+    }
+    else {
+        picoquic_set_packet_pool_max(quic, max_packets);
+        ret = packet_pool_wait_fill(quic, packets, max_packets, &nb_packets);
+        if (ret == 0) {
+            ret = picoquic_start_client_cnx(cnx);
+        }
+    }
+
+    /* The pool is exhausted, nothing is sent and the connection waits */
+    if (ret == 0 && (ret = packet_pool_wait_prepare(cnx, simulated_time, &send_length)) == 0) {
+        if (send_length != 0 || !cnx->is_pool_waiting || quic->pool_waiting_first != cnx ||
+            quic->pool_waiting_last != cnx) {
+            DBG_PRINTF("Connection not waiting for the pool, sent %zu", send_length);
+            ret = -1;
+        }
+    }
+
+    /* Recycling a packet wakes the connection up immediately */
+    if (ret == 0) {
+        simulated_time += 1000;
+        picoquic_recycle_packet(quic, packets[--nb_packets]);
+        if (cnx->is_pool_waiting || quic->pool_waiting_first != NULL || quic->pool_waiting_last != NULL ||
+            cnx->next_wake_time != simulated_time || picoquic_get_earliest_cnx_to_wake(quic, simulated_time) != cnx) {
+            DBG_PRINTF("Connection not woken up, wake time %" PRIu64, cnx->next_wake_time);
+            ret = -1;
+        }
+    }
+
+    /* Once packets are acknowledged and recycled, sending resumes. Check
+     * that the connection obtains a packet from the pool rather than the
+     * number of bytes sent, since the content of the first flight depends
+     * on the TLS stack. */
+    if (ret == 0) {
+        picoquic_packet_pool_stats_t stats_before;
+        picoquic_packet_pool_stats_t stats_after;
+
+        while (nb_packets > 0) {
+            picoquic_recycle_packet(quic, packets[--nb_packets]);
+        }
+        picoquic_get_packet_pool_stats(quic, &stats_before);
+        if ((ret = packet_pool_wait_prepare(cnx, simulated_time, &send_length)) == 0) {
+            picoquic_get_packet_pool_stats(quic, &stats_after);
+            if (cnx->is_pool_waiting || stats_after.nb_requests == stats_before.nb_requests ||
+                stats_after.nb_exhausted != stats_before.nb_exhausted) {
+                DBG_PRINTF("%s", "Sending did not resume");
+                ret = -1;
+            }
+        }
+    }
+
+    /* A waiting connection is removed from the list when deleted */
+    if (ret == 0 && (ret = packet_pool_wait_fill(quic, packets, max_packets, &nb_packets)) == 0) {
+        picoquic_cnx_t* cnx_waiting = NULL;
+
+        if ((cnx_waiting = picoquic_create_cnx(quic, picoquic_null_connection_id, picoquic_null_connection_id,
+            (struct sockaddr*)&addr4, simulated_time, 0, PICOQUIC_TEST_SNI, PICOQUIC_TEST_ALPN, 1)) == NULL ||
+            (ret = picoquic_start_client_cnx(cnx_waiting)) != 0 ||
+            (ret = packet_pool_wait_prepare(cnx_waiting, simulated_time, &send_length)) != 0 ||
+            !cnx_waiting->is_pool_waiting) {
+            DBG_PRINTF("%s", "Second connection not waiting for the pool");
+            ret = -1;
+        }
+        if (cnx_waiting != NULL) {
+            picoquic_delete_cnx(cnx_waiting);
+        }
+        if (ret == 0 && (quic->pool_waiting_first != NULL || quic->pool_waiting_last != NULL)) {
+            DBG_PRINTF("%s", "Deleted connection still waiting for the pool");
+            ret = -1;
+        }
+    }
+
+    while (nb_packets > 0) {
+        picoquic_recycle_packet(quic, packets[--nb_packets]);
+    }
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+    if (packets != NULL) {
+        free(packets);
+    }
+
+    return ret;
+}
+
+/* Test of the sent packet index. Queue packets in a packet context, and
+ * verify that they can be found by sequence number as the ring grows,
+ * after packets are removed, and after the range of pending sequence
+ * numbers exceeds the maximum ring size.
+ */
+#define SENT_RING_TEST_NB 1000
+
+static picoquic_packet_t* sent_ring_test_queue(picoquic_cnx_t* cnx, uint64_t sequence_number)
+{
+    picoquic_packet_t* packet = picoquic_create_packet(cnx->quic);
+
+    if (packet != NULL) {
+        packet->sequence_number = sequence_number;
+        packet->ptype = picoquic_packet_1rtt_protected;
+        packet->pc = picoquic_packet_context_application;
+        packet->send_path = cnx->path[0];
+        packet->length = 100;
+        picoquic_queue_for_retransmit(cnx, cnx->path[0], packet, packet->length, 0);
+    }
+    return packet;
+}
+
+static int sent_ring_test_check(picoquic_packet_context_t* pkt_ctx, uint64_t first, uint64_t last, int step)
+{
+    int ret = 0;
+
+    for (uint64_t s = first; ret == 0 && s <= last; s++) {
+        picoquic_packet_t* packet = picoquic_sent_ring_find(pkt_ctx, s);
+        int is_pending = (s % 2 == 0);
+
+        if ((is_pending && (packet == NULL || packet->sequence_number != s)) || (!is_pending && packet != NULL)) {
+            DBG_PRINTF("Step %d, wrong lookup of packet %" PRIu64, step, s);
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+int sent_ring_test()
+{
+    int ret = 0;
+    uint64_t current_time = 0;
+    struct sockaddr_in addr4;
+    picoquic_cnx_t* cnx = NULL;
+    picoquic_packet_context_t* pkt_ctx = NULL;
+    uint64_t far_sequence = 2 * PICOQUIC_SENT_RING_MAX;
+    picoquic_quic_t* quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, current_time, NULL, NULL, NULL, 0);
+
+    memset(&addr4, 0, sizeof(addr4));
+    addr4.sin_family = AF_INET;
+    addr4.sin_port = 4433;
+
+    if (quic == NULL || (cnx = picoquic_create_cnx(quic, picoquic_null_connection_id, picoquic_null_connection_id,
+        (struct sockaddr*)&addr4, current_time, 0, NULL, NULL, 1)) == NULL) {
+        ret = -1;
+    }
+    else {
+        pkt_ctx = &cnx->pkt_ctx[picoquic_packet_context_application];
+    }
+
+    /* Queue enough packets to grow the ring */
+    for (uint64_t s = 0; ret == 0 && s <= SENT_RING_TEST_NB; s++) {
+        if (sent_ring_test_queue(cnx, s) == NULL) {
+            ret = -1;
+        }
+    }
+
+    if (ret == 0 && (pkt_ctx->sent_ring == NULL || pkt_ctx->sent_ring_mask + 1 <= SENT_RING_TEST_NB)) {
+        DBG_PRINTF("%s", "Sent ring did not grow");
+        ret = -1;
+    }
+
+    /* Remove the odd packets */
+    for (uint64_t s = 1; ret == 0 && s < SENT_RING_TEST_NB; s += 2) {
+        picoquic_packet_t* packet = picoquic_sent_ring_find(pkt_ctx, s);
+        if (packet == NULL) {
+            ret = -1;
+        }
+        else {
+            (void)picoquic_dequeue_retransmit_packet(cnx, pkt_ctx, packet, 1, 0);
+        }
+    }
+
+    if (ret == 0) {
+        ret = sent_ring_test_check(pkt_ctx, 0, SENT_RING_TEST_NB, 1);
+    }
+
+    /* A packet too far from the first pending packet disables the ring */
+    if (ret == 0) {
+        if (sent_ring_test_queue(cnx, far_sequence) == NULL) {
+            ret = -1;
+        }
+        else if (pkt_ctx->sent_ring != NULL) {
+            DBG_PRINTF("%s", "Sent ring not disabled");
+            ret = -1;
+        }
+        else if (picoquic_sent_ring_find(pkt_ctx, far_sequence) == NULL) {
+            DBG_PRINTF("%s", "Cannot find packet without ring");
+            ret = -1;
+        }
+        else {
+            ret = sent_ring_test_check(pkt_ctx, 0, SENT_RING_TEST_NB, 2);
+        }
+    }
+
+    /* Once the old packets are removed, the ring is rebuilt */
+    while (ret == 0 && pkt_ctx->pending_first->sequence_number < far_sequence) {
+        (void)picoquic_dequeue_retransmit_packet(cnx, pkt_ctx, pkt_ctx->pending_first, 1, 0);
+    }
+    if (ret == 0) {
+        if (sent_ring_test_queue(cnx, far_sequence + 1) == NULL) {
+            ret = -1;
+        }
+        else if (pkt_ctx->sent_ring == NULL || picoquic_sent_ring_find(pkt_ctx, far_sequence) == NULL ||
+            picoquic_sent_ring_find(pkt_ctx, far_sequence + 1) == NULL ||
+            picoquic_sent_ring_find(pkt_ctx, 0) != NULL) {
+            DBG_PRINTF("%s", "Sent ring not rebuilt");
+            ret = -1;
+        }
+    }
+
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+
+    return ret;
+}
+
+/* Test of the hibernation of idle connections. Create a connection with
+ * an index of sent packets, packets kept for spurious loss detection and
+ * an empty reassembly ring, and a SACK list that used to hold more ranges,
+ * verify that this state is released or shrunk after the hibernation delay, and that the congestion control state is recreated
+ * when the connection wakes up.
+ */
+#define CNX_HIBERNATION_TEST_DELAY 5000000
+
+int cnx_hibernation_test()
+{
+    int ret = 0;
+    uint64_t current_time = 0;
+    uint64_t next_wake_time = UINT64_MAX;
+    struct sockaddr_in addr4;
+    picoquic_cnx_t* cnx = NULL;
+    picoquic_packet_context_t* pkt_ctx = NULL;
+    picoquic_stream_head_t* stream = NULL;
+    picoquic_sack_list_t* sack_list = NULL;
+    size_t sack_allocated = 0;
+    uint8_t data[16];
+    picoquic_quic_t* quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, current_time, NULL, NULL, NULL, 0);
+
+    memset(&addr4, 0, sizeof(addr4));
+    addr4.sin_family = AF_INET;
+    addr4.sin_port = 4433;
+    memset(data, 0x5a, sizeof(data));
+
+    if (quic == NULL) {
+        ret = -1;
+    }
+    else {
+        picoquic_set_default_hibernation_delay(quic, CNX_HIBERNATION_TEST_DELAY);
+        if ((cnx = picoquic_create_cnx(quic, picoquic_null_connection_id, picoquic_null_connection_id,
+            (struct sockaddr*)&addr4, current_time, 0, NULL, NULL, 1)) == NULL ||
+            (stream = picoquic_create_stream(cnx, 0)) == NULL) {
+            ret = -1;
+        }
+        else {
+            cnx->cnx_state = picoquic_state_ready;
+            pkt_ctx = &cnx->pkt_ctx[picoquic_packet_context_application];
+        }
+    }
+
+    /* Send packets and declare one in ten lost, so it is kept for spurious loss detection */
+    for (uint64_t s = 0; ret == 0 && s < 100; s++) {
+        if (sent_ring_test_queue(cnx, s) == NULL) {
+            ret = -1;
+        }
+    }
+    while (ret == 0 && pkt_ctx->pending_first != NULL) {
+        (void)picoquic_dequeue_retransmit_packet(cnx, pkt_ctx, pkt_ctx->pending_first,
+            pkt_ctx->pending_first->sequence_number % 10 != 0, 0);
+    }
+    if (ret == 0) {
+        ret = picoquic_stream_ring_reserve(stream, 100);
+    }
+    /* Receive packets with holes, then forget the oldest ranges */
+    if (ret == 0) {
+        sack_list = &cnx->ack_ctx[picoquic_packet_context_application].sack_list;
+        for (uint64_t s = 0; ret == 0 && s < 40; s += 2) {
+            ret = picoquic_record_pn_received(cnx, picoquic_packet_context_application, cnx->path[0]->p_local_cnxid, s, current_time);
+        }
+        for (int i = 0; ret == 0 && i < 15; i++) {
+            picoquic_sack_delete_item(sack_list, picoquic_sack_first_item(sack_list));
+        }
+        sack_allocated = sack_list->nb_allocated;
+    }
+    if (ret == 0 && (pkt_ctx->sent_ring == NULL || pkt_ctx->retransmitted_newest == NULL ||
+        stream->reassembly_ring == NULL || cnx->path[0]->congestion_alg_state == NULL)) {
+        DBG_PRINTF("%s", "Cannot set up the connection state");
+        ret = -1;
+    }
+
+    /* The connection does not hibernate before the delay, but wakes up to do so */
+    if (ret == 0) {
+        current_time = CNX_HIBERNATION_TEST_DELAY / 2;
+        picoquic_check_hibernation(cnx, current_time, &next_wake_time);
+        if (picoquic_is_cnx_hibernating(cnx) || next_wake_time != CNX_HIBERNATION_TEST_DELAY) {
+            DBG_PRINTF("Hibernation too early, or wake time %" PRIu64 " not at delay", next_wake_time);
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        current_time = CNX_HIBERNATION_TEST_DELAY;
+        picoquic_check_hibernation(cnx, current_time, &next_wake_time);
+        if (!picoquic_is_cnx_hibernating(cnx)) {
+            DBG_PRINTF("%s", "Connection did not hibernate");
+            ret = -1;
+        }
+        else if (pkt_ctx->sent_ring != NULL || pkt_ctx->retransmitted_newest != NULL ||
+            stream->reassembly_ring != NULL || cnx->path[0]->congestion_alg_state != NULL) {
+            DBG_PRINTF("%s", "State not released during hibernation");
+            ret = -1;
+        }
+        else if (sack_list->nb_allocated >= sack_allocated || picoquic_sack_list_size(sack_list) != 5 ||
+            picoquic_sack_list_first(sack_list) != 30 || picoquic_sack_list_last(sack_list) != 38) {
+            DBG_PRINTF("%s", "SACK list not compacted");
+            ret = -1;
+        }
+    }
+
+    /* The connection wakes up when the application queues data, and stays awake while data is pending */
+    if (ret == 0) {
+        current_time += CNX_HIBERNATION_TEST_DELAY;
+        picoquic_wake_cnx_from_hibernation(cnx, current_time);
+        ret = picoquic_add_to_stream(cnx, 0, data, sizeof(data), 0);
+    }
+    if (ret == 0) {
+        current_time += 2 * CNX_HIBERNATION_TEST_DELAY;
+        picoquic_check_hibernation(cnx, current_time, &next_wake_time);
+        if (picoquic_is_cnx_hibernating(cnx) || cnx->path[0]->congestion_alg_state == NULL ||
+            cnx->latest_busy_time != current_time) {
+            DBG_PRINTF("%s", "Connection not awake with pending data");
+            ret = -1;
+        }
+    }
+
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+
+    return ret;
+}
+
+/*
+ * Test of the crypto worker pool. The job function does not use real
+ * keys: the output is the input xored with the value of the AEAD context
+ * and with the sequence number, so the test can verify that each job
+ * was processed once, by the protocol thread with the primary context
+ * or by a worker with its own clone.
+ */
+#ifdef _WINDOWS
+int crypto_pool_test()
+{
+    /* Crypto workers are not available on Windows */
+    return 0;
+}
+#else
+#define CRYPTO_POOL_TEST_JOBS_MAX 1200
+#define CRYPTO_POOL_TEST_LENGTH 32
+
+static void crypto_pool_test_job(picoquic_crypto_job_t* job)
+{
+    uint8_t key = (uint8_t)((uintptr_t)job->aead_context) ^ (uint8_t)job->sequence_number;
+
+    for (size_t i = 0; i < job->input_length; i++) {
+        job->output[i] = job->input[i] ^ key;
+    }
+    job->result = job->input_length;
+}
+
+static int crypto_pool_test_round(picoquic_crypto_pool_t* pool, picoquic_crypto_job_t* jobs,
+    uint8_t* input, uint8_t* output, size_t nb_jobs, picoquic_aead_clones_t* clones, int use_drain)
+{
+    int ret = 0;
+    picoquic_crypto_job_t* job_list[CRYPTO_POOL_TEST_JOBS_MAX];
+    void* primary = (void*)((uintptr_t)0x01);
+
+    for (size_t i = 0; i < nb_jobs; i++) {
+        memset(&jobs[i], 0, sizeof(picoquic_crypto_job_t));
+        memset(output + i * CRYPTO_POOL_TEST_LENGTH, 0, CRYPTO_POOL_TEST_LENGTH);
+        jobs[i].input = input + i * CRYPTO_POOL_TEST_LENGTH;
+        jobs[i].output = output + i * CRYPTO_POOL_TEST_LENGTH;
+        jobs[i].input_length = CRYPTO_POOL_TEST_LENGTH;
+        jobs[i].sequence_number = i;
+        job_list[i] = &jobs[i];
+    }
+    picoquic_crypto_pool_dispatch(pool, job_list, nb_jobs, primary, clones);
+    if (use_drain) {
+        picoquic_crypto_pool_drain(pool);
+    }
+
+    for (size_t i = 0; ret == 0 && i < nb_jobs; i++) {
+        void* expected_context = primary;
+        uint8_t key;
+
+        if (!use_drain) {
+            picoquic_crypto_pool_wait(pool, &jobs[i]);
+        }
+        if (jobs[i].worker_id >= 0) {
+            if (clones == NULL || jobs[i].worker_id >= clones->nb_clones) {
+                DBG_PRINTF("Job %zu posted to worker %d", i, jobs[i].worker_id);
+                ret = -1;
+                break;
+            }
+            expected_context = clones->aead[jobs[i].worker_id];
+        }
+        key = (uint8_t)((uintptr_t)expected_context) ^ (uint8_t)i;
+        if (!jobs[i].is_done || jobs[i].aead_context != expected_context || jobs[i].result != CRYPTO_POOL_TEST_LENGTH) {
+            DBG_PRINTF("Job %zu not processed as expected", i);
+            ret = -1;
+        }
+        for (size_t j = 0; ret == 0 && j < CRYPTO_POOL_TEST_LENGTH; j++) {
+            if (output[i * CRYPTO_POOL_TEST_LENGTH + j] != (input[i * CRYPTO_POOL_TEST_LENGTH + j] ^ key)) {
+                DBG_PRINTF("Job %zu, wrong output at %zu", i, j);
+                ret = -1;
+            }
+        }
+    }
+
+    return ret;
+}
+
+int crypto_pool_test()
+{
+    int ret = 0;
+    picoquic_crypto_pool_t* pool = picoquic_crypto_pool_create(3, crypto_pool_test_job);
+    picoquic_crypto_job_t* jobs = (picoquic_crypto_job_t*)malloc(sizeof(picoquic_crypto_job_t) * CRYPTO_POOL_TEST_JOBS_MAX);
+    uint8_t* input = (uint8_t*)malloc(CRYPTO_POOL_TEST_JOBS_MAX * CRYPTO_POOL_TEST_LENGTH);
+    uint8_t* output = (uint8_t*)malloc(CRYPTO_POOL_TEST_JOBS_MAX * CRYPTO_POOL_TEST_LENGTH);
+    picoquic_aead_clones_t clones;
+    uint64_t random_ctx = 0xc1a55e5;
+    uint64_t nb_jobs_total = 0;
+    uint64_t nb_jobs_posted = 0;
+    uint64_t nb_jobs_local = 0;
+    picoquic_quic_t* quic = NULL;
+
+    memset(&clones, 0, sizeof(clones));
+    clones.nb_clones = 3;
+    for (int i = 0; i < clones.nb_clones; i++) {
+        clones.aead[i] = (void*)((uintptr_t)(0x10 + i));
+    }
+
+    if (pool == NULL || jobs == NULL || input == NULL || output == NULL ||
+        picoquic_crypto_pool_nb_workers(pool) != 3) {
+        DBG_PRINTF("%s", "Cannot create the crypto pool");
+        ret = -1;
+    }
+    else {
+        picoquic_test_random_bytes(&random_ctx, input, CRYPTO_POOL_TEST_JOBS_MAX * CRYPTO_POOL_TEST_LENGTH);
+    }
+
+    /* Batches of varying sizes, some overflowing the rings */
+    for (int round = 0; ret == 0 && round < 100; round++) {
+        size_t nb_jobs = 1 + (size_t)(round * 37) % CRYPTO_POOL_TEST_JOBS_MAX;
+
+        ret = crypto_pool_test_round(pool, jobs, input, output, nb_jobs, &clones, round & 1);
+        nb_jobs_total += nb_jobs;
+        if (ret != 0) {
+            DBG_PRINTF("Round %d fails, %zu jobs", round, nb_jobs);
+        }
+    }
+
+    /* Fewer clones than workers, or none at all */
+    if (ret == 0) {
+        clones.nb_clones = 1;
+        ret = crypto_pool_test_round(pool, jobs, input, output, 64, &clones, 0);
+        nb_jobs_total += 64;
+    }
+    if (ret == 0) {
+        ret = crypto_pool_test_round(pool, jobs, input, output, 64, NULL, 0);
+        nb_jobs_total += 64;
+    }
+
+    /* Let the workers go to sleep, and verify that they wake up */
+    if (ret == 0) {
+        uint64_t start_time = picoquic_current_time();
+
+        while (picoquic_current_time() < start_time + 20000);
+        clones.nb_clones = 3;
+        ret = crypto_pool_test_round(pool, jobs, input, output, 64, &clones, 0);
+        nb_jobs_total += 64;
+    }
+
+    if (ret == 0) {
+        picoquic_crypto_pool_get_stats(pool, &nb_jobs_posted, &nb_jobs_local);
+        if (nb_jobs_posted + nb_jobs_local != nb_jobs_total || nb_jobs_posted == 0 || nb_jobs_local == 0) {
+            DBG_PRINTF("Unexpected stats, %" PRIu64 " posted, %" PRIu64 " local", nb_jobs_posted, nb_jobs_local);
+            ret = -1;
+        }
+    }
+
+    /* Start and stop the workers of a QUIC context */
+    if (ret == 0) {
+        quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+            0, NULL, NULL, NULL, 0);
+        if (quic == NULL || picoquic_set_crypto_workers(quic, PICOQUIC_CRYPTO_WORKERS_MAX + 1) == 0 ||
+            picoquic_set_crypto_workers(quic, 2) != 0 || quic->crypto_pool == NULL ||
+            quic->hp_batch.crypto_pool != quic->crypto_pool || quic->decrypt_batch == NULL ||
+            picoquic_set_crypto_workers(quic, 0) != 0 || quic->crypto_pool != NULL ||
+            quic->hp_batch.crypto_pool != NULL || picoquic_set_crypto_workers(quic, 1) != 0) {
+            DBG_PRINTF("%s", "Cannot set the crypto workers");
+            ret = -1;
+        }
+    }
+
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+    if (pool != NULL) {
+        picoquic_crypto_pool_delete(pool);
+    }
+    free(jobs);
+    free(input);
+    free(output);
+
+    return ret;
+}
+#endif
+
+/* Test the path metrics cache: prefix matching, merging of samples, seeding
+ * of new server connections, recording when connections are deleted, LRU
+ * eviction and aging.
+ */
+#define PATH_CACHE_TEST_LIFETIME 1000000ull
+
+static void path_cache_test_addr(struct sockaddr_in* addr4, uint32_t ip)
+{
+    memset(addr4, 0, sizeof(struct sockaddr_in));
+    addr4->sin_family = AF_INET;
+    addr4->sin_port = 4433;
+    addr4->sin_addr.s_addr = htonl(ip);
+}
+
+int path_cache_test()
+{
+    int ret = 0;
+    uint64_t simulated_time = 0;
+    struct sockaddr_in addr4;
+    struct sockaddr_in6 addr6;
+    picoquic_path_metrics_t* metrics = NULL;
+    picoquic_cnx_t* cnx = NULL;
+    picoquic_quic_t* quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+        simulated_time, &simulated_time, NULL, NULL, 0);
+
+    if (quic == NULL || picoquic_set_path_metrics_cache(quic, 2, PATH_CACHE_TEST_LIFETIME) != 0) {
+        DBG_PRINTF("%s", "Cannot create the path metrics cache");
+        ret = -1;
+    }
+
+    /* Entries are shared by all addresses in the same /24 */
+    if (ret == 0) {
+        path_cache_test_addr(&addr4, 0x0a000001);
+        ret = picoquic_remember_path_metrics(quic, (struct sockaddr*)&addr4,
+            40000, 50000, 10000000, 1000, simulated_time);
+    }
+    if (ret == 0) {
+        path_cache_test_addr(&addr4, 0x0a0000c8);
+        if ((metrics = picoquic_retrieve_path_metrics(quic, (struct sockaddr*)&addr4, simulated_time)) == NULL ||
+            metrics->rtt_min != 40000 || metrics->smoothed_rtt != 50000 || metrics->bandwidth != 10000000 ||
+            metrics->loss_ppm != 1000 || metrics->nb_samples != 1) {
+            DBG_PRINTF("%s", "Cannot retrieve metrics for the same /24");
+            ret = -1;
+        }
+    }
+    if (ret == 0) {
+        path_cache_test_addr(&addr4, 0x0a000101);
+        if (picoquic_retrieve_path_metrics(quic, (struct sockaddr*)&addr4, simulated_time) != NULL) {
+            DBG_PRINTF("%s", "Retrieved metrics for a different /24");
+            ret = -1;
+        }
+    }
+    /* New samples are merged in the moving average */
+    if (ret == 0) {
+        simulated_time += 1000;
+        path_cache_test_addr(&addr4, 0x0a000007);
+        ret = picoquic_remember_path_metrics(quic, (struct sockaddr*)&addr4,
+            80000, 90000, 2000000, 5000, simulated_time);
+        if (ret == 0 && (quic->path_metrics_nb != 1 ||
+            (metrics = picoquic_retrieve_path_metrics(quic, (struct sockaddr*)&addr4, simulated_time)) == NULL ||
+            metrics->rtt_min != 50000 || metrics->smoothed_rtt != 60000 || metrics->bandwidth != 8000000 ||
+            metrics->loss_ppm != 2000 || metrics->nb_samples != 2)) {
+            DBG_PRINTF("%s", "Samples not merged");
+            ret = -1;
+        }
+    }
+    /* A new server connection from the prefix is seeded */
+    if (ret == 0) {
+        path_cache_test_addr(&addr4, 0x0a000042);
+        if ((cnx = picoquic_create_cnx(quic, picoquic_null_connection_id, picoquic_null_connection_id,
+            (struct sockaddr*)&addr4, simulated_time, 0, NULL, NULL, 0)) == NULL) {
+            DBG_PRINTF("%s", "Cannot create server connection");
+            ret = -1;
+        }
+        else if (cnx->path[0]->smoothed_rtt != 60000 || cnx->path[0]->rtt_variant != 30000 ||
+            cnx->path[0]->retransmit_timer != 150000 || cnx->seed_rtt_min != 50000 ||
+            cnx->seed_cwin != 400000 || cnx->seed_ip_addr_length != 4 ||
+            memcmp(cnx->seed_ip_addr, &addr4.sin_addr, 4) != 0) {
+            DBG_PRINTF("%s", "Server connection not seeded");
+            ret = -1;
+        }
+    }
+    /* The metrics of the connection are recorded when it is deleted */
+    if (ret == 0) {
+        cnx->path[0]->rtt_is_initialized = 1;
+        cnx->path[0]->rtt_min = 50000;
+        cnx->path[0]->smoothed_rtt = 60000;
+        cnx->path[0]->bandwidth_estimate_max = 8000000;
+        cnx->path[0]->bytes_sent = 1000000;
+        cnx->path[0]->total_bytes_lost = 2000;
+        simulated_time += 1000;
+        picoquic_delete_cnx(cnx);
+        cnx = NULL;
+        if ((metrics = picoquic_retrieve_path_metrics(quic, (struct sockaddr*)&addr4, simulated_time)) == NULL ||
+            metrics->nb_samples != 3 || metrics->last_update_time != simulated_time) {
+            DBG_PRINTF("%s", "Metrics not recorded on delete");
+            ret = -1;
+        }
+    }
+    /* IPv6 entries are shared by addresses in the same /48, and the least
+     * recently updated entry is evicted when the cache is full */
+    if (ret == 0) {
+        memset(&addr6, 0, sizeof(addr6));
+        addr6.sin6_family = AF_INET6;
+        addr6.sin6_addr.s6_addr[0] = 0x20;
+        addr6.sin6_addr.s6_addr[1] = 0x01;
+        addr6.sin6_addr.s6_addr[15] = 1;
+        simulated_time += 1000;
+        ret = picoquic_remember_path_metrics(quic, (struct sockaddr*)&addr6,
+            20000, 25000, 1000000, 0, simulated_time);
+        addr6.sin6_addr.s6_addr[6] = 0xff;
+        if (ret == 0 && picoquic_retrieve_path_metrics(quic, (struct sockaddr*)&addr6, simulated_time) == NULL) {
+            DBG_PRINTF("%s", "Cannot retrieve metrics for the same /48");
+            ret = -1;
+        }
+    }
+    if (ret == 0) {
+        simulated_time += 1000;
+        path_cache_test_addr(&addr4, 0x0b000001);
+        ret = picoquic_remember_path_metrics(quic, (struct sockaddr*)&addr4,
+            30000, 30000, 1000000, 0, simulated_time);
+        path_cache_test_addr(&addr4, 0x0a000001);
+        if (ret == 0 && (quic->path_metrics_nb != 2 ||
+            picoquic_retrieve_path_metrics(quic, (struct sockaddr*)&addr4, simulated_time) != NULL ||
+            picoquic_retrieve_path_metrics(quic, (struct sockaddr*)&addr6, simulated_time) == NULL)) {
+            DBG_PRINTF("%s", "Least recently updated entry not evicted");
+            ret = -1;
+        }
+    }
+    /* Stale entries are ignored and removed, and do not seed connections */
+    if (ret == 0) {
+        simulated_time += PATH_CACHE_TEST_LIFETIME + 1;
+        path_cache_test_addr(&addr4, 0x0b000002);
+        if ((cnx = picoquic_create_cnx(quic, picoquic_null_connection_id, picoquic_null_connection_id,
+            (struct sockaddr*)&addr4, simulated_time, 0, NULL, NULL, 0)) == NULL) {
+            DBG_PRINTF("%s", "Cannot create server connection");
+            ret = -1;
+        }
+        else if (cnx->path[0]->smoothed_rtt != PICOQUIC_INITIAL_RTT || cnx->seed_cwin != 0 ||
+            quic->path_metrics_nb != 1) {
+            DBG_PRINTF("%s", "Stale entry was used");
+            ret = -1;
+        }
+    }
+    /* Disabling the cache releases the entries */
+    if (ret == 0 && (picoquic_set_path_metrics_cache(quic, 0, 0) != 0 ||
+        quic->table_path_metrics != NULL || quic->path_metrics_nb != 0 ||
+        quic->path_metrics_first != NULL)) {
+        DBG_PRINTF("%s", "Cache not disabled");
+        ret = -1;
+    }
+
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+
+    return ret;
+}
@@ -246,6 +246,21 @@ int getter_test()
                 ret = -1;
             }
         }
+        /* Each enumerated name selects an algorithm, and all algorithms are enumerated */
+        if (ret == 0) {
+            size_t nb_enumerated = 0;
+            char const* name;
+
+            while ((name = picoquic_get_congestion_algorithm_name(nb_enumerated)) != NULL && ret == 0) {
+                if (picoquic_get_congestion_algorithm(name) == NULL) {
+                    ret = -1;
+                }
+                nb_enumerated++;
+            }
+            if (nb_enumerated != nb_alg - 2) {
+                ret = -1;
+            }
+        }
     }
 
     if (ret == 0) {
@@ -200,3 +200,206 @@ int picohash_embedded_test()
 {
     return(picohash_test_one(1));
 }
+
+/* Test of the table growth. Insert many more items than the initial size,
+ * while deleting some of them, so that items are inserted, retrieved and
+ * deleted while the items of the previous table are being moved.
+ */
+#define PICOHASH_GROW_TEST_NB 10000
+
+int picohash_grow_test()
+{
+    int ret = 0;
+    size_t nb_items = 0;
+    size_t nb_enumerated = 0;
+    size_t position = 0;
+    struct hashtestkey hk;
+    picohash_table* t = picohash_create_ex(32, hashtest_hash, hashtest_compare, hashtest_key_to_item);
+
+    if (t == NULL) {
+        DBG_PRINTF("%s", "picohash_create_ex() failed\n");
+        ret = -1;
+    }
+
+    /* Insert all values, and delete every third value after inserting the next one */
+    for (uint64_t i = 0; ret == 0 && i < PICOHASH_GROW_TEST_NB; i++) {
+        if (picohash_insert(t, hashtest_item(i)) != 0) {
+            DBG_PRINTF("picohash_insert(%"PRId64") failed\n", i);
+            ret = -1;
+        }
+        else if (i > 0 && (i - 1) % 3 == 0) {
+            picohash_item* pi;
+
+            hk.x = i - 1;
+            pi = picohash_retrieve(t, &hk);
+            if (pi == NULL) {
+                DBG_PRINTF("picohash_retrieve(%"PRId64") failed\n", i - 1);
+                ret = -1;
+            }
+            else {
+                picohash_delete_item(t, pi, 1);
+            }
+        }
+    }
+
+    for (uint64_t i = 0; ret == 0 && i < PICOHASH_GROW_TEST_NB; i++) {
+        picohash_item* pi;
+
+        hk.x = i;
+        pi = picohash_retrieve(t, &hk);
+        if ((pi == NULL) != (i % 3 == 0 && i < PICOHASH_GROW_TEST_NB - 1)) {
+            DBG_PRINTF("picohash_retrieve(%"PRId64") returned %s\n", i, (pi == NULL) ? "NULL" : "deleted item");
+            ret = -1;
+        }
+        else if (pi != NULL) {
+            nb_items++;
+        }
+    }
+
+    if (ret == 0 && (t->count != nb_items || t->nb_slots < 2 * nb_items)) {
+        DBG_PRINTF("picohash count %"PRIst", expected %"PRIst", %"PRIst" slots\n", t->count, nb_items, t->nb_slots);
+        ret = -1;
+    }
+
+    while (ret == 0 && picohash_next_item(t, &position) != NULL) {
+        nb_enumerated++;
+    }
+    if (ret == 0 && nb_enumerated != nb_items) {
+        DBG_PRINTF("picohash enumerated %"PRIst" items, expected %"PRIst"\n", nb_enumerated, nb_items);
+        ret = -1;
+    }
+
+    if (t != NULL) {
+        picohash_delete(t, 1);
+    }
+
+    return ret;
+}
+
+/* Test of duplicate keys. Retrieving a key that was inserted several times
+ * returns the last inserted item, including after the items of the previous
+ * table were moved, and the previous item once the last one is deleted.
+ */
+#define PICOHASH_DUPLICATE_TEST_NB 1000
+
+int picohash_duplicate_test()
+{
+    int ret = 0;
+    struct hashtestkey* first[PICOHASH_DUPLICATE_TEST_NB];
+    struct hashtestkey* second[PICOHASH_DUPLICATE_TEST_NB];
+    struct hashtestkey hk;
+    picohash_table* t = picohash_create_ex(32, hashtest_hash, hashtest_compare, hashtest_key_to_item);
+
+    memset(first, 0, sizeof(first));
+    memset(second, 0, sizeof(second));
+
+    if (t == NULL) {
+        DBG_PRINTF("%s", "picohash_create_ex() failed\n");
+        ret = -1;
+    }
+
+    /* Insert each key twice, the second copy while the table grows */
+    for (int pass = 0; ret == 0 && pass < 2; pass++) {
+        for (uint64_t i = 0; ret == 0 && i < PICOHASH_DUPLICATE_TEST_NB; i++) {
+            struct hashtestkey* p = hashtest_item(i);
+
+            if (p == NULL || picohash_insert(t, p) != 0) {
+                DBG_PRINTF("picohash_insert(%"PRId64") failed\n", i);
+                free(p);
+                ret = -1;
+            }
+            else if (pass == 0) {
+                first[i] = p;
+            }
+            else {
+                second[i] = p;
+            }
+        }
+    }
+
+    for (uint64_t i = 0; ret == 0 && i < PICOHASH_DUPLICATE_TEST_NB; i++) {
+        hk.x = i;
+        if (picohash_retrieve(t, &hk) != &second[i]->item) {
+            DBG_PRINTF("picohash_retrieve(%"PRId64") did not return the last item\n", i);
+            ret = -1;
+        }
+    }
+
+    for (uint64_t i = 0; ret == 0 && i < PICOHASH_DUPLICATE_TEST_NB; i++) {
+        picohash_delete_item(t, &second[i]->item, 1);
+        second[i] = NULL;
+        hk.x = i;
+        if (picohash_retrieve(t, &hk) != &first[i]->item) {
+            DBG_PRINTF("picohash_retrieve(%"PRId64") did not return the first item\n", i);
+            ret = -1;
+        }
+    }
+
+    if (t != NULL) {
+        picohash_delete(t, 1);
+    }
+
+    return ret;
+}
+
+/* Test of churn at constant size. Deleted items leave no trace in the table,
+ * so the table does not grow as long as the number of live items does not.
+ */
+#define PICOHASH_CHURN_TEST_NB 200
+#define PICOHASH_CHURN_TEST_STEPS 100000
+
+int picohash_churn_test()
+{
+    int ret = 0;
+    uint64_t present[PICOHASH_CHURN_TEST_NB];
+    uint64_t random_ctx = 0xc4c4c4c4ull;
+    uint64_t next_x = 0;
+    struct hashtestkey hk;
+    picohash_table* t = picohash_create_ex(4 * PICOHASH_CHURN_TEST_NB, hashtest_hash, hashtest_compare, hashtest_key_to_item);
+    size_t nb_slots_initial = (t == NULL) ? 0 : t->nb_slots;
+
+    if (t == NULL) {
+        DBG_PRINTF("%s", "picohash_create_ex() failed\n");
+        ret = -1;
+    }
+
+    for (int i = 0; ret == 0 && i < PICOHASH_CHURN_TEST_NB; i++) {
+        present[i] = next_x++;
+        if (picohash_insert(t, hashtest_item(present[i])) != 0) {
+            DBG_PRINTF("picohash_insert(%"PRId64") failed\n", present[i]);
+            ret = -1;
+        }
+    }
+
+    for (int step = 0; ret == 0 && step < PICOHASH_CHURN_TEST_STEPS; step++) {
+        int rank = (int)picoquic_test_uniform_random(&random_ctx, PICOHASH_CHURN_TEST_NB);
+
+        picohash_item* pi;
+
+        hk.x = present[rank];
+        if ((pi = picohash_retrieve(t, &hk)) == NULL) {
+            DBG_PRINTF("picohash_retrieve(%"PRId64") failed at step %d\n", hk.x, step);
+            ret = -1;
+        }
+        else {
+            picohash_delete_item(t, pi, 1);
+            present[rank] = next_x++;
+            if (picohash_insert(t, hashtest_item(present[rank])) != 0) {
+                DBG_PRINTF("picohash_insert(%"PRId64") failed\n", present[rank]);
+                ret = -1;
+            }
+        }
+    }
+
+    if (ret == 0 && (t->count != PICOHASH_CHURN_TEST_NB || t->nb_slots != nb_slots_initial)) {
+        DBG_PRINTF("picohash count %"PRIst", %"PRIst" slots, expected %"PRIst"\n",
+            t->count, t->nb_slots, nb_slots_initial);
+        ret = -1;
+    }
+
+    if (t != NULL) {
+        picohash_delete(t, 1);
+    }
+
+    return ret;
+}
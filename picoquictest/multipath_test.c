@@ -1837,9 +1837,236 @@ int multipath_tunnel_test()
  * 1) challenge path;
  * 2) if is_ack_needed, min rtt path for ACK
  * 3) affinity_path, if cwin_ok
- * 4) data path, if cwin ok
- * 5) data path with pacing OK
- * 6) path 0, after setting the timers.
+ * 4) path chosen by the path scheduler among the candidates
+ * 5) path 0, after setting the timers, if the scheduler returns -1.
  * 
  * TODO: break that into parts that can be verified!
+ * The path schedulers are verified in path_scheduler_test.
  */
+
+/* Unit test of the path schedulers.
+ * The test creates a connection with two paths, mimicking a wifi path
+ * and a cellular path, sets the path variables, and verifies the
+ * choice of each scheduler for a given list of candidates.
+ */
+static void path_scheduler_test_set(picoquic_path_candidate_t* candidates,
+    int pacing_ok_0, int cwin_ok_0, int pacing_ok_1, int cwin_ok_1)
+{
+    candidates[0].path_id = 0;
+    candidates[0].is_pacing_ok = pacing_ok_0;
+    candidates[0].is_cwin_ok = cwin_ok_0;
+    candidates[1].path_id = 1;
+    candidates[1].is_pacing_ok = pacing_ok_1;
+    candidates[1].is_cwin_ok = cwin_ok_1;
+}
+
+static int path_scheduler_test_one(picoquic_cnx_t* cnx, picoquic_path_scheduler_t const* scheduler,
+    picoquic_path_candidate_t* candidates, int expected, uint64_t current_time)
+{
+    int ret = 0;
+    int path_id = scheduler->select_path(cnx, candidates, 2, current_time);
+
+    if (path_id != expected) {
+        DBG_PRINTF("Scheduler %s selects %d instead of %d", scheduler->path_scheduler_id, path_id, expected);
+        ret = -1;
+    }
+    return ret;
+}
+
+int path_scheduler_test()
+{
+    int ret = 0;
+    uint64_t simulated_time = 0;
+    struct sockaddr_in addr[2];
+    picoquic_path_candidate_t candidates[2];
+    picoquic_cnx_t* cnx = NULL;
+    picoquic_quic_t* quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+        simulated_time, &simulated_time, NULL, NULL, 0);
+
+    for (int i = 0; i < 2; i++) {
+        memset(&addr[i], 0, sizeof(struct sockaddr_in));
+        addr[i].sin_family = AF_INET;
+        addr[i].sin_port = 4433;
+        addr[i].sin_addr.s_addr = htonl(0x0a000002 + (uint32_t)i);
+    }
+
+    if (quic == NULL || (cnx = picoquic_create_cnx(quic, picoquic_null_connection_id, picoquic_null_connection_id,
+        (struct sockaddr*)&addr[0], simulated_time, 0, NULL, NULL, 0)) == NULL) {
+        DBG_PRINTF("%s", "Cannot create the connection");
+        ret = -1;
+    }
+    else if (cnx->path_scheduler != picoquic_default_path_scheduler ||
+        picoquic_create_path(cnx, simulated_time, NULL, (struct sockaddr*)&addr[1], 1) != 1) {
+        DBG_PRINTF("%s", "Cannot create the second path");
+        ret = -1;
+    }
+    else {
+        /* Path 0 is the wifi path, 15 ms and 50 Mbps; path 1 the cellular path, 30 ms and 10 Mbps */
+        cnx->is_multipath_enabled = 1;
+        cnx->path[0]->smoothed_rtt = 15000;
+        cnx->path[0]->bandwidth_estimate = 6250000;
+        cnx->path[0]->cwin = 93750;
+        cnx->path[0]->last_sent_time = 2000;
+        cnx->path[1]->smoothed_rtt = 30000;
+        cnx->path[1]->bandwidth_estimate = 1250000;
+        cnx->path[1]->cwin = 37500;
+        cnx->path[1]->bytes_in_transit = 12000;
+        cnx->path[1]->last_sent_time = 1000;
+    }
+
+    /* Name lookup and selection */
+    if (ret == 0) {
+        char const* names[] = { "default", "minrtt", "wrr", "blest", "redundant" };
+        picoquic_path_scheduler_t const* schedulers[] = {
+            picoquic_default_path_scheduler, picoquic_minrtt_path_scheduler, picoquic_wrr_path_scheduler,
+            picoquic_blest_path_scheduler, picoquic_redundant_path_scheduler };
+
+        for (size_t i = 0; ret == 0 && i < sizeof(names) / sizeof(char const*); i++) {
+            if (picoquic_get_path_scheduler(names[i]) != schedulers[i]) {
+                DBG_PRINTF("Cannot find scheduler %s", names[i]);
+                ret = -1;
+            }
+        }
+        if (ret == 0 && picoquic_get_path_scheduler("unknown") != NULL) {
+            DBG_PRINTF("%s", "Found an unknown scheduler");
+            ret = -1;
+        }
+        if (ret == 0) {
+            picoquic_set_path_scheduler(cnx, picoquic_blest_path_scheduler);
+            if (cnx->path_scheduler != picoquic_blest_path_scheduler) {
+                ret = -1;
+            }
+            picoquic_set_path_scheduler(cnx, NULL);
+            if (cnx->path_scheduler != picoquic_default_path_scheduler) {
+                ret = -1;
+            }
+            picoquic_set_default_path_scheduler(quic, picoquic_wrr_path_scheduler);
+            if (quic->default_path_scheduler != picoquic_wrr_path_scheduler) {
+                ret = -1;
+            }
+            if (ret != 0) {
+                DBG_PRINTF("%s", "Cannot set the path scheduler");
+            }
+        }
+    }
+
+    /* Default: least recently used path with cwin available, else with pacing OK */
+    if (ret == 0) {
+        path_scheduler_test_set(candidates, 1, 1, 1, 1);
+        ret = path_scheduler_test_one(cnx, picoquic_default_path_scheduler, candidates, 1, simulated_time);
+    }
+    if (ret == 0) {
+        path_scheduler_test_set(candidates, 1, 1, 1, 0);
+        ret = path_scheduler_test_one(cnx, picoquic_default_path_scheduler, candidates, 0, simulated_time);
+    }
+    if (ret == 0) {
+        path_scheduler_test_set(candidates, 1, 0, 1, 0);
+        ret = path_scheduler_test_one(cnx, picoquic_default_path_scheduler, candidates, 1, simulated_time);
+    }
+    if (ret == 0) {
+        path_scheduler_test_set(candidates, 0, 1, 0, 1);
+        ret = path_scheduler_test_one(cnx, picoquic_default_path_scheduler, candidates, -1, simulated_time);
+    }
+    /* Min RTT */
+    if (ret == 0) {
+        path_scheduler_test_set(candidates, 1, 1, 1, 1);
+        ret = path_scheduler_test_one(cnx, picoquic_minrtt_path_scheduler, candidates, 0, simulated_time);
+    }
+    if (ret == 0) {
+        path_scheduler_test_set(candidates, 1, 0, 1, 1);
+        ret = path_scheduler_test_one(cnx, picoquic_minrtt_path_scheduler, candidates, 1, simulated_time);
+    }
+    /* Weighted round robin: path 0 has 5 times the bandwidth of path 1 */
+    if (ret == 0) {
+        int nb_selected[2] = { 0, 0 };
+
+        path_scheduler_test_set(candidates, 1, 1, 1, 1);
+        for (int i = 0; ret == 0 && i < 600; i++) {
+            int path_id = picoquic_wrr_path_scheduler->select_path(cnx, candidates, 2, simulated_time);
+            if (path_id < 0 || path_id > 1) {
+                ret = -1;
+            }
+            else {
+                nb_selected[path_id]++;
+            }
+        }
+        if (ret != 0 || nb_selected[0] < 495 || nb_selected[0] > 505) {
+            DBG_PRINTF("WRR selects path 0 %d times out of 600", nb_selected[0]);
+            ret = -1;
+        }
+    }
+    if (ret == 0) {
+        /* A path that was blocked does not accumulate credit */
+        path_scheduler_test_set(candidates, 1, 1, 0, 1);
+        for (int i = 0; ret == 0 && i < 100; i++) {
+            ret = path_scheduler_test_one(cnx, picoquic_wrr_path_scheduler, candidates, 0, simulated_time);
+        }
+        if (ret == 0) {
+            int nb_selected_1 = 0;
+
+            path_scheduler_test_set(candidates, 1, 1, 1, 1);
+            for (int i = 0; i < 12; i++) {
+                nb_selected_1 += picoquic_wrr_path_scheduler->select_path(cnx, candidates, 2, simulated_time);
+            }
+            if (nb_selected_1 > 3) {
+                DBG_PRINTF("WRR selects the idle path %d times out of 12", nb_selected_1);
+                ret = -1;
+            }
+        }
+    }
+    /* BLEST: use the slow path only if the flow control window allows */
+    if (ret == 0) {
+        path_scheduler_test_set(candidates, 1, 1, 1, 1);
+        ret = path_scheduler_test_one(cnx, picoquic_blest_path_scheduler, candidates, 0, simulated_time);
+    }
+    if (ret == 0) {
+        cnx->maxdata_remote = 1000000;
+        cnx->data_sent = 0;
+        path_scheduler_test_set(candidates, 1, 0, 1, 1);
+        ret = path_scheduler_test_one(cnx, picoquic_blest_path_scheduler, candidates, 1, simulated_time);
+    }
+    if (ret == 0) {
+        /* The fast path would send 187500 bytes during one RTT of the slow path */
+        cnx->data_sent = 1000000 - 200000;
+        path_scheduler_test_set(candidates, 1, 0, 1, 1);
+        ret = path_scheduler_test_one(cnx, picoquic_blest_path_scheduler, candidates, 0, simulated_time);
+    }
+    if (ret == 0) {
+        path_scheduler_test_set(candidates, 0, 1, 1, 1);
+        ret = path_scheduler_test_one(cnx, picoquic_blest_path_scheduler, candidates, -1, simulated_time);
+    }
+    /* Redundant: data of urgent streams is repeated */
+    if (ret == 0) {
+        picoquic_stream_head_t stream;
+
+        memset(&stream, 0, sizeof(stream));
+        stream.stream_priority = quic->default_stream_priority;
+        if (!picoquic_redundant_path_scheduler->is_redundant ||
+            picoquic_is_stream_redundant(cnx, &stream)) {
+            ret = -1;
+        }
+        else {
+            stream.stream_priority = quic->default_stream_priority - 2;
+            if (picoquic_is_stream_redundant(cnx, &stream)) {
+                ret = -1;
+            }
+            picoquic_set_path_scheduler(cnx, picoquic_redundant_path_scheduler);
+            if (!picoquic_is_stream_redundant(cnx, &stream)) {
+                ret = -1;
+            }
+            path_scheduler_test_set(candidates, 1, 1, 1, 1);
+            if (ret == 0) {
+                ret = path_scheduler_test_one(cnx, picoquic_redundant_path_scheduler, candidates, 1, simulated_time);
+            }
+        }
+        if (ret != 0) {
+            DBG_PRINTF("%s", "Redundant scheduler test fails");
+        }
+    }
+
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+
+    return ret;
+}
@@ -339,4 +339,90 @@ int pacing_repeat_test()
         }
     }
     return ret;
-}
\ No newline at end of file
+}
+/* Test of pacing offload. With a 10MB/s rate and 1000 bytes packets,
+ * each packet takes 100us, and the bucket holds 2 packets. With an
+ * offload horizon of 1ms, 10 more packets are authorized ahead of
+ * time, each departing 100us after the previous one. The next
+ * transmission is then authorized 1ms before the bucket refills.
+ * The departure time predicted before each packet is sent, which is
+ * used to end GSO trains, must match the actual departure time.
+ */
+int pacing_offload_test()
+{
+    int ret = 0;
+    uint64_t current_time = 0;
+    uint64_t const horizon = 1000;
+    picoquic_quic_t* quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+        current_time, &current_time, NULL, NULL, 0);
+
+    if (quic == NULL) {
+        ret = -1;
+    }
+
+    for (int offload = 0; ret == 0 && offload < 2; offload++) {
+        picoquic_pacing_t pacing = { 0 };
+        uint64_t next_time = UINT64_MAX;
+        uint64_t departure_time = 0;
+        int nb_authorized = 0;
+        int nb_expected = (offload) ? 12 : 2;
+
+        picoquic_set_pacing_offload(quic, (offload) ? horizon : 0);
+        current_time = 10000;
+        picoquic_pacing_init(&pacing, 0);
+        picoquic_update_pacing_parameters(&pacing, 10000000.0, 2000, 1000, 100000, NULL);
+
+        while (nb_authorized <= nb_expected &&
+            picoquic_is_authorized_by_pacing(&pacing, current_time, &next_time, 0, quic)) {
+            uint64_t expected_departure = current_time;
+
+            if (nb_authorized >= 2) {
+                expected_departure += 100 * (nb_authorized - 1);
+            }
+            if (picoquic_pacing_next_departure_time(&pacing, current_time) != expected_departure) {
+                DBG_PRINTF("Offload %d, packet %d, next departure %" PRIu64 " instead of %" PRIu64,
+                    offload, nb_authorized, picoquic_pacing_next_departure_time(&pacing, current_time), expected_departure);
+                ret = -1;
+                break;
+            }
+            picoquic_update_pacing_data_after_send(&pacing, 1000, 1000, current_time);
+            if (pacing.departure_time != expected_departure || pacing.departure_time < departure_time ||
+                pacing.departure_time > current_time + horizon) {
+                DBG_PRINTF("Offload %d, packet %d, departure %" PRIu64 " instead of %" PRIu64,
+                    offload, nb_authorized, pacing.departure_time, expected_departure);
+                ret = -1;
+                break;
+            }
+            departure_time = pacing.departure_time;
+            nb_authorized++;
+        }
+
+        if (ret == 0 && nb_authorized != nb_expected) {
+            DBG_PRINTF("Offload %d, %d packets authorized instead of %d", offload, nb_authorized, nb_expected);
+            ret = -1;
+        }
+        else if (ret == 0 && next_time != current_time + 101) {
+            DBG_PRINTF("Offload %d, next time %" PRIu64 " instead of %" PRIu64, offload, next_time, current_time + 101);
+            ret = -1;
+        }
+        else if (ret == 0) {
+            /* At the next time, one more packet is authorized */
+            current_time = next_time;
+            next_time = UINT64_MAX;
+            if (!picoquic_is_authorized_by_pacing(&pacing, current_time, &next_time, 0, quic)) {
+                DBG_PRINTF("Offload %d, packet not authorized at next time", offload);
+                ret = -1;
+            }
+        }
+    }
+
+    if (ret == 0 && picoquic_get_train_departure_time(quic) != 0) {
+        ret = -1;
+    }
+
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+
+    return ret;
+}
@@ -44,9 +44,20 @@ int util_memcmp_test();
 int util_threading_test();
 int picohash_test();
 int picohash_embedded_test();
+int picohash_grow_test();
+int picohash_duplicate_test();
+int picohash_churn_test();
+int crypto_pool_test();
+int path_cache_test();
 int picolog_basic_test();
 int bytestream_test();
 int create_cnx_test();
+int incoming_batch_test();
+int wake_wheel_test();
+int packet_pool_test();
+int packet_pool_wait_test();
+int sent_ring_test();
+int cnx_hibernation_test();
 int create_quic_test();
 int parseheadertest();
 int incoming_initial_test();
@@ -55,6 +66,11 @@ int pn2pn64test();
 int intformattest();
 int sacktest();
 int StreamZeroFrameTest();
+int stream_ring_test();
+int stream_ring_sparse_test();
+int stream_views_test();
+int rwnd_tuning_test();
+int path_scheduler_test();
 int sendacktest();
 int sendack_loop_test();
 int ackfrq_basic_test();
@@ -99,6 +115,8 @@ int tls_api_retry_test();
 int tls_api_retry_large_test();
 int ackrange_test();
 int ack_of_ack_test();
+int ack_sack_array_test();
+int ack_reorder_bounded_test();
 int ack_disorder_test();
 int ack_horizon_test();
 int tls_api_two_connections_test();
@@ -139,6 +157,8 @@ int mtu_drop_newreno_test();
 int spurious_retransmit_test();
 int pn_ctr_test();
 int cleartext_pn_enc_test();
+int pn_enc_batch_test();
+int pn_dec_batch_test();
 int pn_enc_1rtt_test();
 int tls_zero_share_test();
 int transport_param_log_test();
@@ -177,6 +197,7 @@ int parse_frame_test();
 int frames_repeat_test();
 int frames_ackack_error_test();
 int frames_format_test();
+int frame_fast_parse_test();
 int stress_test();
 int cnx_stress_unit_test();
 int cnx_stress_do_test(uint64_t duration, int nb_clients, int do_report);
@@ -190,6 +211,13 @@ int sockloop_migration_test();
 int sockloop_nat_test();
 int sockloop_thread_test();
 int sockloop_thread_name_test();
+int sockloop_batch_recv_test();
+int sockloop_uring_test();
+int sockloop_uring_backend_test();
+int sockloop_batch_send_test();
+int sockloop_txtime_test();
+int sockloop_select_test();
+int shard_steering_test();
 int splay_test();
 int TlsStreamFrameTest();
 int draft17_vector_test();
@@ -240,6 +268,8 @@ int qlog_trace_auto_test();
 int qlog_trace_only_test();
 int qlog_trace_ecn_test();
 int perflog_test();
+int crypto_workers_test();
+int key_rotation_train_test();
 int rebinding_stress_test();
 int many_short_loss_test();
 int random_padding_test();
@@ -331,6 +361,7 @@ int optimistic_ack_test();
 int optimistic_hole_test();
 int document_addresses_test();
 int socket_ecn_test();
+int socket_sendmmsg_test();
 int null_sni_test();
 int preferred_address_test();
 int preferred_address_dis_mig_test();
@@ -346,11 +377,13 @@ int bad_coalesce_test();
 int bad_cnxid_test();
 int stream_splay_test();
 int stream_output_test();
+int stream_scheduler_test();
 int stream_rank_test();
 int provide_stream_buffer_test();
 int not_before_cnxid_test();
 int send_stream_blocked_test();
 int stream_ack_test();
+int stream_zero_copy_test();
 int queue_network_input_test();
 int fastcc_test();
 int fastcc_jitter_test();
@@ -408,6 +441,7 @@ int cwin_max_test();
 int initial_race_test();
 int pacing_test();
 int pacing_repeat_test();
+int pacing_offload_test();
 int chacha20_test();
 int cnx_limit_test();
 int cert_verify_bad_cert_test();
@@ -792,3 +792,169 @@ int ack_horizon_test()
     int ret = ack_disorder_test_one(ACK_HORIZON_LOG, 1000000, 196.0);
     return ret;
 }
+
+/* Test the management of the range array: insertion in any order,
+ * navigation in both directions, deletion at the low end, and dropping
+ * of the lowest ranges when the number of ranges is bounded.
+ */
+static int ack_sack_array_check_order(picoquic_sack_list_t* sack_list, size_t nb_expected)
+{
+    int ret = 0;
+    size_t nb_ranges = 0;
+    picoquic_sack_item_t* sack = picoquic_sack_first_item(sack_list);
+    picoquic_sack_item_t* last = NULL;
+
+    while (ret == 0 && sack != NULL) {
+        if (last != NULL && (last->end_of_sack_range + 1 >= sack->start_of_sack_range ||
+            picoquic_sack_previous_item(sack) != last)) {
+            ret = -1;
+        }
+        last = sack;
+        sack = picoquic_sack_next_item(sack);
+        nb_ranges++;
+    }
+    if (ret == 0 && (nb_ranges != nb_expected || nb_ranges != picoquic_sack_list_size(sack_list) ||
+        last != picoquic_sack_last_item(sack_list) || check_ack_ranges(sack_list) != 0)) {
+        ret = -1;
+    }
+    return ret;
+}
+
+int ack_sack_array_test()
+{
+    int ret = 0;
+    picoquic_sack_list_t sack0;
+
+    picoquic_sack_list_init(&sack0);
+
+    /* Insert 200 isolated packets in decreasing order, then fill the holes */
+    for (uint64_t pn = 400; ret == 0 && pn > 0; pn -= 2) {
+        ret = picoquic_update_sack_list(&sack0, pn - 2, pn - 2, 0);
+    }
+    if (ret == 0) {
+        ret = ack_sack_array_check_order(&sack0, 200);
+    }
+    for (uint64_t pn = 1; ret == 0 && pn < 400; pn += 6) {
+        ret = picoquic_update_sack_list(&sack0, pn, pn, 0);
+    }
+    if (ret == 0) {
+        ret = ack_sack_array_check_order(&sack0, 133);
+    }
+    for (uint64_t pn = 1; ret == 0 && pn < 400; pn += 2) {
+        (void)picoquic_update_sack_list(&sack0, pn, pn, 0);
+    }
+    if (ret == 0 && (ack_sack_array_check_order(&sack0, 1) != 0 ||
+        picoquic_sack_list_first(&sack0) != 0 || picoquic_sack_list_last(&sack0) != 399)) {
+        ret = -1;
+    }
+
+    /* Delete ranges at the low end, then add ranges below them */
+    if (ret == 0) {
+        picoquic_sack_list_free(&sack0);
+        for (uint64_t pn = 0; ret == 0 && pn < 100; pn += 4) {
+            ret = picoquic_update_sack_list(&sack0, pn, pn + 1, 0);
+        }
+        for (uint64_t pn = 0; ret == 0 && pn < 40; pn += 4) {
+            (void)picoquic_process_ack_of_ack_range(&sack0, NULL, pn, pn + 1);
+        }
+        if (ret == 0 && (ack_sack_array_check_order(&sack0, 15) != 0 || picoquic_sack_list_first(&sack0) != 40)) {
+            ret = -1;
+        }
+        for (uint64_t pn = 36; ret == 0 && pn > 0; pn -= 4) {
+            ret = picoquic_update_sack_list(&sack0, pn - 1, pn - 1, 0);
+        }
+        if (ret == 0 && (ack_sack_array_check_order(&sack0, 24) != 0 || picoquic_sack_list_first(&sack0) != 3)) {
+            ret = -1;
+        }
+    }
+
+    /* Bounded list: the lowest ranges are dropped below the eviction floor, the horizon does not move */
+    if (ret == 0) {
+        picoquic_sack_list_free(&sack0);
+        sack0.max_ranges = 16;
+        for (uint64_t pn = 0; ret == 0 && pn < 120; pn += 3) {
+            ret = picoquic_update_sack_list(&sack0, pn, pn + 1, 0);
+        }
+        if (ret == 0 && (ack_sack_array_check_order(&sack0, 16) != 0 ||
+            picoquic_sack_list_first(&sack0) != 72 || sack0.eviction_floor != 71 || sack0.ack_horizon != 0)) {
+            ret = -1;
+        }
+    }
+
+    picoquic_sack_list_free(&sack0);
+
+    return ret;
+}
+
+/* Test reordering beyond the bound on the number of ranges of an ACK context.
+ * A late packet above the eviction floor is accepted and acknowledged. The
+ * horizon is not used when no horizon delay is set. Packets below the floor
+ * are treated as duplicates, because the list no longer knows about them.
+ */
+int ack_reorder_bounded_test()
+{
+    int ret = 0;
+    picoquic_cnx_t* cnx = NULL;
+    picoquic_quic_t* quic = NULL;
+    picoquic_packet_context_enum pc = picoquic_packet_context_application;
+    picoquic_sack_list_t* sack_list = NULL;
+    uint64_t nb_isolated = PICOQUIC_SACK_RANGES_MAX_ACK + 16;
+    uint64_t current_time = 0;
+
+    if (picoquic_test_set_minimal_cnx(&quic, &cnx) != 0 ||
+        picoquic_create_local_cnxid(cnx, 0, NULL, 0) == NULL) {
+        ret = -1;
+    }
+    else {
+        sack_list = &cnx->ack_ctx[pc].sack_list;
+    }
+
+    /* Receive only the odd packet numbers: each packet is a new range */
+    for (uint64_t i = 0; ret == 0 && i < nb_isolated; i++) {
+        if (picoquic_record_pn_received(cnx, pc, cnx->first_local_cnxid_list->local_cnxid_first,
+            2 * i + 1, current_time) != 0) {
+            ret = -1;
+        }
+    }
+    if (ret == 0 && (picoquic_sack_list_size(sack_list) != PICOQUIC_SACK_RANGES_MAX_ACK ||
+        sack_list->eviction_floor != 32 || sack_list->ack_horizon != 0)) {
+        DBG_PRINTF("Unexpected bounded list, %zu ranges, floor %" PRIu64 "\n",
+            picoquic_sack_list_size(sack_list), sack_list->eviction_floor);
+        ret = -1;
+    }
+
+    /* A late packet above the floor is accepted and fills a gap */
+    if (ret == 0 && (picoquic_is_pn_already_received(cnx, pc, cnx->first_local_cnxid_list->local_cnxid_first, 100) != 0 ||
+        picoquic_record_pn_received(cnx, pc, cnx->first_local_cnxid_list->local_cnxid_first, 100, current_time) != 0 ||
+        picoquic_is_pn_already_received(cnx, pc, cnx->first_local_cnxid_list->local_cnxid_first, 100) == 0 ||
+        picoquic_sack_list_size(sack_list) != PICOQUIC_SACK_RANGES_MAX_ACK - 1)) {
+        DBG_PRINTF("%s", "Late packet above the floor not acknowledged\n");
+        ret = -1;
+    }
+
+    /* Without a horizon delay, the horizon does not hide packets */
+    if (ret == 0) {
+        sack_list->ack_horizon = 200;
+        if (picoquic_is_pn_already_received(cnx, pc, cnx->first_local_cnxid_list->local_cnxid_first, 150) != 0) {
+            DBG_PRINTF("%s", "Horizon used without horizon delay\n");
+            ret = -1;
+        }
+    }
+
+    /* Packets below the floor are treated as duplicates */
+    for (uint64_t pn = 0; ret == 0 && pn < 32; pn++) {
+        if (picoquic_is_pn_already_received(cnx, pc, cnx->first_local_cnxid_list->local_cnxid_first, pn) == 0) {
+            DBG_PRINTF("Packet %" PRIu64 " below the floor not treated as duplicate\n", pn);
+            ret = -1;
+        }
+    }
+
+    if (cnx != NULL) {
+        picoquic_delete_cnx(cnx);
+    }
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+
+    return ret;
+}
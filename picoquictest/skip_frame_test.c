@@ -2906,8 +2906,11 @@ static size_t dataqueue_prepare_packet(
     uint8_t* bytes = packet->bytes;
     uint8_t* bytes_max = bytes + sizeof(packet->bytes);
     size_t copied_index;
+    /* Keep the link to the packet pool slab, if any */
+    picoquic_packet_slab_t* slab = packet->slab;
 
     memset(packet, 0, sizeof(picoquic_packet_t));
+    packet->slab = slab;
     packet->offset = 12;
     packet->data_repeat_frame = 17;
     packet->data_repeat_index = 17;
@@ -3791,3 +3794,347 @@ int stream_ack_test()
 
     return ret;
 }
+
+/* Test of the zero copy send API. Queue application buffers by reference,
+ * mixed with copied data, format the stream frames, and verify that the
+ * release callbacks are only called once all the data up to the end of
+ * each buffer is acknowledged, or when the connection is deleted.
+ */
+#define STREAM_ZERO_COPY_NB_BUFFERS 4
+
+typedef struct st_stream_zero_copy_release_t {
+    int nb_acked;
+    int nb_abandoned;
+} stream_zero_copy_release_t;
+
+static void stream_zero_copy_release(void* release_ctx, int is_acknowledged)
+{
+    stream_zero_copy_release_t* release = (stream_zero_copy_release_t*)release_ctx;
+
+    if (is_acknowledged) {
+        release->nb_acked++;
+    }
+    else {
+        release->nb_abandoned++;
+    }
+}
+
+static int stream_zero_copy_check(stream_zero_copy_release_t* release, int nb_acked, int nb_abandoned, int step)
+{
+    int ret = 0;
+
+    for (int i = 0; i < STREAM_ZERO_COPY_NB_BUFFERS; i++) {
+        int expect_acked = (i < nb_acked) ? 1 : 0;
+        int expect_abandoned = (i >= STREAM_ZERO_COPY_NB_BUFFERS - nb_abandoned) ? 1 : 0;
+
+        if (release[i].nb_acked != expect_acked || release[i].nb_abandoned != expect_abandoned) {
+            DBG_PRINTF("Step %d, buffer %d, acked %d, abandoned %d", step, i,
+                release[i].nb_acked, release[i].nb_abandoned);
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+int stream_zero_copy_test()
+{
+    int ret = 0;
+    uint64_t simulated_time = 0;
+    picoquic_cnx_t* cnx = NULL;
+    picoquic_stream_head_t* stream = NULL;
+    struct sockaddr_storage addr;
+    uint8_t data[4000];
+    uint8_t received[4000];
+    uint8_t frames[16][256];
+    size_t frame_length[16];
+    size_t nb_frames = 0;
+    size_t received_length = 0;
+    stream_zero_copy_release_t release[STREAM_ZERO_COPY_NB_BUFFERS];
+    picoquic_iovec_t iov[3];
+    picoquic_quic_t* quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL,
+        NULL, NULL, NULL, NULL, simulated_time,
+        &simulated_time, NULL, NULL, 0);
+
+    memset(release, 0, sizeof(release));
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8_t)(i * 7 + 1);
+    }
+
+    if (quic == NULL) {
+        ret = -1;
+    }
+    else {
+        ret = picoquic_store_text_addr(&addr, "10.0.0.1", 1234);
+        if (ret == 0) {
+            cnx = picoquic_create_cnx(quic, picoquic_null_connection_id,
+                picoquic_null_connection_id, (struct sockaddr*) & addr,
+                simulated_time, 0, "test-sni", "test-alpn", 1);
+            if (cnx == NULL) {
+                ret = -1;
+            }
+        }
+    }
+
+    /* Queue 400 bytes by reference, 300 copied bytes, an iovec of 3 buffers
+     * totalling 500 bytes, then 200 bytes by reference with FIN. Queue
+     * another buffer on a second stream, which will never be sent. */
+    if (ret == 0) {
+        iov[0].base = data + 700;
+        iov[0].len = 100;
+        iov[1].base = data + 800;
+        iov[1].len = 0;
+        iov[2].base = data + 800;
+        iov[2].len = 400;
+        cnx->maxdata_remote = UINT64_MAX;
+        if (picoquic_add_to_stream_by_reference(cnx, 0, data, 400, 0, stream_zero_copy_release, &release[0]) != 0 ||
+            picoquic_add_to_stream(cnx, 0, data + 400, 300, 0) != 0 ||
+            picoquic_add_iovec_to_stream_by_reference(cnx, 0, iov, 3, 0, stream_zero_copy_release, &release[1]) != 0 ||
+            picoquic_add_to_stream_by_reference(cnx, 0, data + 1200, 200, 1, stream_zero_copy_release, &release[2]) != 0 ||
+            picoquic_add_to_stream_by_reference(cnx, 4, data + 1400, 100, 0, stream_zero_copy_release, &release[3]) != 0 ||
+            (stream = picoquic_find_stream(cnx, 0)) == NULL) {
+            DBG_PRINTF("%s", "Cannot queue data");
+            ret = -1;
+        }
+        else {
+            stream->maxdata_remote = UINT64_MAX;
+            if (stream->send_queue_last == NULL || stream->send_queue_last->bytes != data + 1200 ||
+                stream->send_queue_last->stream_offset_end != 1400) {
+                DBG_PRINTF("%s", "Unexpected tail of send queue");
+                ret = -1;
+            }
+        }
+    }
+
+    /* Send the data in short frames */
+    while (ret == 0 && !stream->fin_sent) {
+        int more_data = 0;
+        int is_pure_ack = 1;
+        int is_still_active = 0;
+        uint8_t* bytes_next;
+
+        if (nb_frames >= 16) {
+            DBG_PRINTF("%s", "Too many frames");
+            ret = -1;
+            break;
+        }
+        bytes_next = picoquic_format_stream_frame(cnx, stream, frames[nb_frames], frames[nb_frames] + sizeof(frames[nb_frames]),
+            &more_data, &is_pure_ack, &is_still_active, &ret);
+        if (ret != 0 || bytes_next == NULL || bytes_next == frames[nb_frames]) {
+            DBG_PRINTF("Cannot format frame %zu", nb_frames);
+            ret = -1;
+        }
+        else {
+            uint64_t stream_id;
+            uint64_t offset;
+            size_t data_length;
+            int fin;
+            size_t consumed;
+
+            frame_length[nb_frames] = bytes_next - frames[nb_frames];
+            if (picoquic_parse_stream_header(frames[nb_frames], frame_length[nb_frames], &stream_id, &offset,
+                &data_length, &fin, &consumed) != 0 || offset != received_length ||
+                offset + data_length > sizeof(received)) {
+                DBG_PRINTF("Cannot parse frame %zu", nb_frames);
+                ret = -1;
+            }
+            else {
+                memcpy(received + received_length, frames[nb_frames] + consumed, data_length);
+                received_length += data_length;
+                nb_frames++;
+            }
+        }
+    }
+
+    if (ret == 0 && (received_length != 1400 || memcmp(received, data, 1400) != 0 ||
+        stream->send_queue != NULL || stream->send_queue_last != NULL)) {
+        DBG_PRINTF("Received %zu bytes, data does not match", received_length);
+        ret = -1;
+    }
+
+    if (ret == 0) {
+        ret = stream_zero_copy_check(release, 0, 0, 1);
+    }
+
+    /* Acknowledge all frames but the first: nothing is released */
+    for (size_t i = 1; ret == 0 && i < nb_frames; i++) {
+        size_t consumed = 0;
+        ret = picoquic_process_ack_of_stream_frame(cnx, frames[i], frame_length[i], &consumed);
+    }
+
+    if (ret == 0) {
+        ret = stream_zero_copy_check(release, 0, 0, 2);
+    }
+
+    /* Acknowledge the first frame: all three buffers are released */
+    if (ret == 0) {
+        size_t consumed = 0;
+        ret = picoquic_process_ack_of_stream_frame(cnx, frames[0], frame_length[0], &consumed);
+        if (ret == 0) {
+            ret = stream_zero_copy_check(release, 3, 0, 3);
+        }
+    }
+
+    /* Deleting the connection abandons the buffer queued on stream 4 */
+    if (cnx != NULL) {
+        picoquic_delete_cnx(cnx);
+        if (ret == 0) {
+            ret = stream_zero_copy_check(release, 3, 1, 4);
+        }
+    }
+
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+
+    return ret;
+}
+
+/*
+ * Verify that the fast path parsing of varints, STREAM and ACK headers,
+ * used when at least 8 bytes remain after each field, produces the same
+ * results as the byte by byte parsing used near the end of packets.
+ */
+#define FRAME_FAST_PARSE_ROUNDS 4096
+
+static uint64_t frame_fast_parse_random_varint(uint64_t* random_ctx)
+{
+    /* Pick lengths of 1, 2, 4 or 8 bytes with equal probability */
+    const uint64_t v_max[4] = { 0x3F, 0x3FFF, 0x3FFFFFFF, 0x3FFFFFFFFFFFFFFFull };
+    uint64_t r = picoquic_test_random(random_ctx);
+
+    return picoquic_test_random(random_ctx) & v_max[r & 3];
+}
+
+static int frame_fast_parse_stream_one(const uint8_t* buffer, size_t exact_length, size_t padded_length)
+{
+    int ret = 0;
+    uint64_t stream_id[2] = { 0, 0 };
+    uint64_t offset[2] = { 0, 0 };
+    size_t data_length[2] = { 0, 0 };
+    int fin[2] = { 0, 0 };
+    size_t consumed[2] = { 0, 0 };
+    int r[2];
+
+    r[0] = picoquic_parse_stream_header(buffer, exact_length, &stream_id[0], &offset[0], &data_length[0], &fin[0], &consumed[0]);
+    r[1] = picoquic_parse_stream_header(buffer, padded_length, &stream_id[1], &offset[1], &data_length[1], &fin[1], &consumed[1]);
+
+    if (r[0] != 0 || r[1] != 0 || stream_id[0] != stream_id[1] || offset[0] != offset[1] || fin[0] != fin[1] ||
+        consumed[0] != consumed[1] || ((buffer[0] & 2) != 0 && data_length[0] != data_length[1])) {
+        ret = -1;
+    }
+
+    return ret;
+}
+
+static int frame_fast_parse_ack_one(const uint8_t* buffer, size_t exact_length, size_t padded_length, int has_path_id)
+{
+    int ret = 0;
+    uint64_t num_block[2] = { 0, 0 };
+    uint64_t path_id[2] = { 0, 0 };
+    uint64_t largest[2] = { 0, 0 };
+    uint64_t ack_delay[2] = { 0, 0 };
+    size_t consumed[2] = { 0, 0 };
+    int r[2];
+
+    r[0] = picoquic_parse_ack_header(buffer, exact_length, &num_block[0], (has_path_id) ? &path_id[0] : NULL,
+        &largest[0], &ack_delay[0], &consumed[0], 3);
+    r[1] = picoquic_parse_ack_header(buffer, padded_length, &num_block[1], (has_path_id) ? &path_id[1] : NULL,
+        &largest[1], &ack_delay[1], &consumed[1], 3);
+
+    if (r[0] != 0 || r[1] != 0 || num_block[0] != num_block[1] || path_id[0] != path_id[1] ||
+        largest[0] != largest[1] || ack_delay[0] != ack_delay[1] || consumed[0] != consumed[1] ||
+        consumed[0] != exact_length) {
+        ret = -1;
+    }
+
+    return ret;
+}
+
+int frame_fast_parse_test()
+{
+    int ret = 0;
+    uint64_t random_ctx = 0xfa57fa57fa57fa57ull;
+    uint8_t buffer[256];
+
+    memset(buffer, 0xFF, sizeof(buffer));
+
+    for (int i = 0; ret == 0 && i < FRAME_FAST_PARSE_ROUNDS; i++) {
+        /* Varints, decoded at the end of the buffer and with 8 bytes available */
+        uint64_t v = frame_fast_parse_random_varint(&random_ctx);
+        uint64_t decoded[2] = { 0, 0 };
+        uint8_t* bytes_max = picoquic_frames_varint_encode(buffer, buffer + sizeof(buffer), v);
+        const uint8_t* next[2];
+
+        next[0] = picoquic_frames_varint_decode(buffer, bytes_max, &decoded[0]);
+        next[1] = picoquic_frames_varint_decode(buffer, buffer + PICOPARSE_VARINT_MIN, &decoded[1]);
+        if (bytes_max == NULL || next[0] != bytes_max || next[1] != bytes_max || decoded[0] != v || decoded[1] != v ||
+            picoquic_frames_varint_decode(buffer, bytes_max - 1, &decoded[0]) != NULL) {
+            DBG_PRINTF("Varint decoding error, round %d, v = 0x%" PRIx64, i, v);
+            ret = -1;
+        }
+    }
+
+    for (int i = 0; ret == 0 && i < FRAME_FAST_PARSE_ROUNDS; i++) {
+        /* STREAM headers of all types, parsed with and without padding */
+        uint8_t ftype = (uint8_t)(picoquic_frame_type_stream_range_min + (i & 7));
+        uint64_t data_length = picoquic_test_random(&random_ctx) % 64;
+        uint8_t* bytes = buffer;
+
+        *bytes++ = ftype;
+        bytes = picoquic_frames_varint_encode(bytes, buffer + sizeof(buffer), frame_fast_parse_random_varint(&random_ctx));
+        if ((ftype & 4) != 0) {
+            bytes = picoquic_frames_varint_encode(bytes, buffer + sizeof(buffer), frame_fast_parse_random_varint(&random_ctx) >> 2);
+        }
+        if ((ftype & 2) != 0) {
+            bytes = picoquic_frames_varint_encode(bytes, buffer + sizeof(buffer), data_length);
+        }
+        if (bytes == NULL) {
+            ret = -1;
+        }
+        else {
+            size_t exact_length = (bytes - buffer) + (size_t)data_length;
+
+            ret = frame_fast_parse_stream_one(buffer, exact_length, exact_length + 3 * PICOPARSE_VARINT_MIN);
+            if (ret == 0 && (ftype & 2) != 0) {
+                /* Data past the end of the packet must be detected by both paths */
+                uint64_t stream_id;
+                uint64_t offset;
+                size_t parsed_length;
+                int fin;
+                size_t consumed;
+
+                if (picoquic_parse_stream_header(buffer, exact_length - 1, &stream_id, &offset, &parsed_length, &fin, &consumed) == 0) {
+                    ret = -1;
+                }
+            }
+        }
+        if (ret != 0) {
+            DBG_PRINTF("Stream header parsing error, round %d, type 0x%02x", i, ftype);
+        }
+    }
+
+    for (int i = 0; ret == 0 && i < FRAME_FAST_PARSE_ROUNDS; i++) {
+        /* ACK and PATH ACK headers, parsed with and without padding */
+        int has_path_id = i & 1;
+        uint8_t* bytes = picoquic_frames_varint_encode(buffer, buffer + sizeof(buffer),
+            (has_path_id) ? picoquic_frame_type_path_ack : picoquic_frame_type_ack);
+
+        for (int j = 0; bytes != NULL && j < 3 + has_path_id; j++) {
+            bytes = picoquic_frames_varint_encode(bytes, buffer + sizeof(buffer), frame_fast_parse_random_varint(&random_ctx) >> 3);
+        }
+        if (bytes == NULL) {
+            ret = -1;
+        }
+        else {
+            size_t exact_length = bytes - buffer;
+
+            ret = frame_fast_parse_ack_one(buffer, exact_length, exact_length + 4 * PICOPARSE_VARINT_MIN, has_path_id);
+        }
+        if (ret != 0) {
+            DBG_PRINTF("Ack header parsing error, round %d", i);
+        }
+    }
+
+    return ret;
+}
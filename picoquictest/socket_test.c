@@ -240,3 +240,85 @@ int socket_ecn_test()
 
     return ret;
 }
+
+/*
+ * Test that a batch larger than PICOQUIC_SENDMMSG_MAX is sent through
+ * successive calls to picoquic_sendmmsg, without reporting an error for
+ * the messages left over by a partial send.
+ */
+#define SOCKET_SENDMMSG_TEST_NB (PICOQUIC_SENDMMSG_MAX + 8)
+#define SOCKET_SENDMMSG_TEST_LENGTH 100
+
+int socket_sendmmsg_test()
+{
+    int ret = 0;
+    int nb_calls = 0;
+    int nb_sent = 0;
+    int nb_recv = 0;
+    uint8_t buffers[SOCKET_SENDMMSG_TEST_NB][SOCKET_SENDMMSG_TEST_LENGTH];
+    uint8_t buffer[1536];
+    struct sockaddr_storage addr_dest;
+    picoquic_send_msg_t* msgs = (picoquic_send_msg_t*)malloc(sizeof(picoquic_send_msg_t) * SOCKET_SENDMMSG_TEST_NB);
+    SOCKET_TYPE fd_recv = picoquic_open_client_socket(AF_INET);
+    SOCKET_TYPE fd_send = picoquic_open_client_socket(AF_INET);
+
+    if (msgs == NULL || fd_recv == INVALID_SOCKET || fd_send == INVALID_SOCKET ||
+        picoquic_bind_to_port(fd_recv, AF_INET, 0) != 0 ||
+        picoquic_get_local_address(fd_recv, &addr_dest) != 0) {
+        DBG_PRINTF("%s", "Cannot open the test sockets");
+        ret = -1;
+    }
+    else {
+        ((struct sockaddr_in*)&addr_dest)->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        memset(msgs, 0, sizeof(picoquic_send_msg_t) * SOCKET_SENDMMSG_TEST_NB);
+        for (int i = 0; i < SOCKET_SENDMMSG_TEST_NB; i++) {
+            memset(buffers[i], i, SOCKET_SENDMMSG_TEST_LENGTH);
+            msgs[i].bytes = buffers[i];
+            msgs[i].length = SOCKET_SENDMMSG_TEST_LENGTH;
+            picoquic_store_addr(&msgs[i].addr_dest, (struct sockaddr*)&addr_dest);
+        }
+    }
+
+    /* Retry from the first message not sent, as the packet loop does */
+    while (ret == 0 && nb_sent < SOCKET_SENDMMSG_TEST_NB) {
+        int sock_err = 0;
+        int nb_call_sent = picoquic_sendmmsg(fd_send, &msgs[nb_sent], SOCKET_SENDMMSG_TEST_NB - nb_sent, &sock_err);
+
+        nb_calls++;
+        if (nb_call_sent <= 0 || sock_err != 0) {
+            DBG_PRINTF("Sendmmsg call %d returns %d, err %d", nb_calls, nb_call_sent, sock_err);
+            ret = -1;
+        }
+        else {
+            nb_sent += nb_call_sent;
+        }
+    }
+
+    while (ret == 0 && nb_recv < SOCKET_SENDMMSG_TEST_NB) {
+        uint64_t current_time = picoquic_current_time();
+        unsigned char received_ecn;
+        struct sockaddr_storage addr_from;
+        int bytes_recv = picoquic_select(&fd_recv, 1, &addr_from, NULL, NULL, &received_ecn,
+            buffer, sizeof(buffer), 1000000, &current_time);
+
+        if (bytes_recv != SOCKET_SENDMMSG_TEST_LENGTH || buffer[0] != (uint8_t)nb_recv) {
+            DBG_PRINTF("Message %d: received %d bytes, tag %d", nb_recv, bytes_recv, (bytes_recv > 0) ? buffer[0] : -1);
+            ret = -1;
+        }
+        else {
+            nb_recv++;
+        }
+    }
+
+    if (fd_recv != INVALID_SOCKET) {
+        SOCKET_CLOSE(fd_recv);
+    }
+    if (fd_send != INVALID_SOCKET) {
+        SOCKET_CLOSE(fd_send);
+    }
+    if (msgs != NULL) {
+        free(msgs);
+    }
+
+    return ret;
+}
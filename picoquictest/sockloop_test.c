@@ -28,7 +28,11 @@
 #include "picoquictest_internal.h"
 #include "autoqlog.h"
 #include "picoquic_packet_loop.h"
+#include "picoquic_shard.h"
 #include "picosocks.h"
+#ifdef PICOQUIC_WITH_IO_URING
+#include "picoquic_uring.h"
+#endif
 
 
 #ifndef SLEEP
@@ -61,6 +65,11 @@ typedef struct st_sockloop_test_spec_t {
     int double_bind;
     int extra_socket_required;
     int force_migration;
+    int recv_batch_size;
+    int send_batch_size;
+    int do_not_use_epoll;
+    int require_io_uring;
+    uint64_t pacing_offload_horizon;
 } sockloop_test_spec_t;
 
 typedef struct st_sockloop_test_cb_t {
@@ -81,6 +90,7 @@ typedef struct st_sockloop_test_cb_t {
     picoquic_connection_id_t server_cid_before_migration;
     picoquic_connection_id_t client_cid_before_migration;
     picoquic_packet_loop_param_t* param;
+    uint64_t nb_syscalls_saved;
 } sockloop_test_cb_t;
 
 int sockloop_test_received_finished(picoquic_test_tls_api_ctx_t* test_ctx)
@@ -140,6 +150,9 @@ int sockloop_test_cb(picoquic_quic_t* quic, picoquic_packet_loop_cb_enum cb_mode
             if (cb_ctx->test_id > 1) {
                 options->do_time_check = 1;
             }
+            if (cb_ctx->param != NULL && cb_ctx->param->send_batch_size > 0) {
+                options->do_after_send_stats = 1;
+            }
             DBG_PRINTF("%s", "Waiting for packets.\n");
             break;
         }
@@ -209,6 +222,15 @@ int sockloop_test_cb(picoquic_quic_t* quic, picoquic_packet_loop_cb_enum cb_mode
             }
             break;
         case picoquic_packet_loop_after_send:
+            if (cb_ctx->param != NULL && cb_ctx->param->send_batch_size > 0) {
+                packet_loop_after_send_arg_t* send_arg = (packet_loop_after_send_arg_t*)callback_arg;
+                if (send_arg->nb_send_messages < send_arg->nb_send_calls ||
+                    send_arg->nb_syscalls_saved != send_arg->nb_send_messages - send_arg->nb_send_calls) {
+                    ret = -1;
+                    break;
+                }
+                cb_ctx->nb_syscalls_saved += send_arg->nb_syscalls_saved;
+            }
             if (picoquic_get_cnx_state(cnx_client) == picoquic_state_disconnected) {
                 ret = PICOQUIC_NO_ERROR_TERMINATE_PACKET_LOOP;
             }
@@ -488,6 +510,11 @@ int sockloop_test_one(sockloop_test_spec_t *spec)
             param.do_not_use_gso = spec->do_not_use_gso;
             param.simulate_eio = spec->simulate_eio;
             param.extra_socket_required = spec->extra_socket_required;
+            param.recv_batch_size = spec->recv_batch_size;
+            param.send_batch_size = spec->send_batch_size;
+            param.do_not_use_epoll = spec->do_not_use_epoll;
+            param.do_not_use_io_uring = spec->do_not_use_epoll;
+            param.pacing_offload_horizon = spec->pacing_offload_horizon;
 
             loop_cb.force_migration = spec->force_migration;
             loop_cb.param = &param;
@@ -541,6 +568,39 @@ int sockloop_test_one(sockloop_test_spec_t *spec)
             else {
                 ret = picoquic_packet_loop_v2(test_ctx->qserver, &param, sockloop_test_cb, &loop_cb);
             }
+            if (ret == 0 && spec->recv_batch_size > 0) {
+                DBG_PRINTF("Received %" PRIu64 " datagrams in %" PRIu64 " calls",
+                    param.nb_recv_datagrams, param.nb_recv_calls);
+                if (param.nb_recv_calls == 0 || param.nb_recv_datagrams < param.nb_recv_calls) {
+                    ret = -1;
+                }
+            }
+            if (ret == 0 && spec->send_batch_size > 0) {
+                DBG_PRINTF("Sent %" PRIu64 " messages in %" PRIu64 " calls, %" PRIu64 " calls saved",
+                    param.nb_send_messages, param.nb_send_calls, loop_cb.nb_syscalls_saved);
+                if (param.nb_send_calls == 0 || param.nb_send_messages < param.nb_send_calls ||
+                    loop_cb.nb_syscalls_saved != param.nb_send_messages - param.nb_send_calls) {
+                    ret = -1;
+                }
+            }
+            if (ret == 0 && spec->require_io_uring) {
+#ifdef PICOQUIC_WITH_IO_URING
+                /* When the library is built with io_uring, the ring must be usable */
+                if (!param.is_io_uring_used) {
+                    DBG_PRINTF("%s", "The io_uring backend was not used");
+                    ret = -1;
+                }
+#else
+                DBG_PRINTF("%s", "Built without io_uring, the loop uses the default backend");
+#endif
+            }
+            if (ret == 0 && spec->pacing_offload_horizon > 0) {
+                DBG_PRINTF("Sent %" PRIu64 " messages, %" PRIu64 " with departure time, %" PRIu64 " timer wakeups",
+                    param.nb_send_messages, param.nb_txtime_messages, param.nb_timer_wakeups);
+                if (param.nb_txtime_messages > param.nb_send_messages) {
+                    ret = -1;
+                }
+            }
         }
     }
     /* Verify that the scenario worked. */
@@ -683,6 +743,196 @@ int sockloop_thread_test()
     return(sockloop_test_one(&spec));
 }
 
+int sockloop_batch_recv_test()
+{
+    sockloop_test_spec_t spec;
+    sockloop_test_set_spec(&spec, 9);
+    spec.socket_buffer_size = 0xffff;
+    spec.scenario = sockloop_test_scenario_1M;
+    spec.scenario_size = sizeof(sockloop_test_scenario_1M);
+    spec.recv_batch_size = 32;
+
+    return(sockloop_test_one(&spec));
+}
+
+/* Run the 1MB download of sockloop_batch_recv over the io_uring backend,
+ * and verify that the loop used it. Like the other loop tests, this needs
+ * the TLS backend for the handshake. It is run by the io_uring CI
+ * workflow; the backend itself is also covered without TLS by
+ * sockloop_uring_backend_test.
+ */
+int sockloop_uring_test()
+{
+    sockloop_test_spec_t spec;
+    sockloop_test_set_spec(&spec, 13);
+    spec.socket_buffer_size = 0xffff;
+    spec.scenario = sockloop_test_scenario_1M;
+    spec.scenario_size = sizeof(sockloop_test_scenario_1M);
+    spec.recv_batch_size = 32;
+    spec.require_io_uring = 1;
+
+    return(sockloop_test_one(&spec));
+}
+
+/* Exercise the io_uring backend directly over a loopback socket, without
+ * running a connection: idle wait, batch send through the ring, receive,
+ * and wake up through the wake up file descriptor.
+ */
+#define SOCKLOOP_URING_TEST_NB 40
+
+int sockloop_uring_backend_test()
+{
+    int ret = 0;
+#ifdef PICOQUIC_WITH_IO_URING
+    picoquic_socket_ctx_t s_ctx;
+    picoquic_uring_ctx_t* uring = NULL;
+    SOCKET_TYPE fd_send = picoquic_open_client_socket(AF_INET);
+    SOCKET_TYPE fds[SOCKLOOP_URING_TEST_NB];
+    picoquic_send_msg_t* msgs = (picoquic_send_msg_t*)malloc(sizeof(picoquic_send_msg_t) * SOCKLOOP_URING_TEST_NB);
+    picoquic_recv_msg_t recv_msgs[PICOQUIC_RECVMMSG_MAX];
+    int sock_err[SOCKLOOP_URING_TEST_NB];
+    uint8_t buffer[256];
+    struct sockaddr_storage addr_dest;
+    int wake_up_pipe[2] = { -1, -1 };
+    int is_wake_up_event = 0;
+    int nb_recv = 0;
+
+    memset(&s_ctx, 0, sizeof(s_ctx));
+    memset(buffer, 0x5a, sizeof(buffer));
+    s_ctx.af = AF_INET;
+    s_ctx.fd = picoquic_open_client_socket(AF_INET);
+
+    if (msgs == NULL || fd_send == INVALID_SOCKET || s_ctx.fd == INVALID_SOCKET ||
+        picoquic_socket_set_pkt_info(s_ctx.fd, AF_INET) != 0 ||
+        picoquic_bind_to_port(s_ctx.fd, AF_INET, 0) != 0 ||
+        picoquic_get_local_address(s_ctx.fd, &addr_dest) != 0 || pipe(wake_up_pipe) != 0) {
+        DBG_PRINTF("%s", "Cannot open the test sockets");
+        ret = -1;
+    }
+    else {
+        s_ctx.port = ntohs(((struct sockaddr_in*)&addr_dest)->sin_port);
+        ((struct sockaddr_in*)&addr_dest)->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if ((uring = picoquic_uring_create(&s_ctx, 1, wake_up_pipe[0])) == NULL) {
+            DBG_PRINTF("%s", "Cannot create the ring");
+            ret = -1;
+        }
+    }
+
+    /* Nothing to receive, the wait times out */
+    if (ret == 0 && (picoquic_uring_wait(uring, 1, recv_msgs, PICOQUIC_RECVMMSG_MAX, 10000, &is_wake_up_event) != 0 ||
+        is_wake_up_event)) {
+        DBG_PRINTF("%s", "Idle wait does not time out");
+        ret = -1;
+    }
+
+    /* Send a batch through the ring, with a different length per message */
+    if (ret == 0) {
+        int nb_sent;
+
+        memset(msgs, 0, sizeof(picoquic_send_msg_t) * SOCKLOOP_URING_TEST_NB);
+        for (int i = 0; i < SOCKLOOP_URING_TEST_NB; i++) {
+            msgs[i].bytes = buffer;
+            msgs[i].length = 100 + i;
+            picoquic_store_addr(&msgs[i].addr_dest, (struct sockaddr*)&addr_dest);
+            fds[i] = fd_send;
+        }
+        nb_sent = picoquic_uring_send(uring, fds, msgs, SOCKLOOP_URING_TEST_NB, sock_err);
+        for (int i = 0; nb_sent == SOCKLOOP_URING_TEST_NB && i < SOCKLOOP_URING_TEST_NB; i++) {
+            if (sock_err[i] != 0) {
+                nb_sent = i;
+            }
+        }
+        if (nb_sent != SOCKLOOP_URING_TEST_NB) {
+            DBG_PRINTF("Ring sent %d messages instead of %d", nb_sent, SOCKLOOP_URING_TEST_NB);
+            ret = -1;
+        }
+    }
+
+    /* Receive the messages in order, with their destination port */
+    for (int nb_waits = 0; ret == 0 && nb_recv < SOCKLOOP_URING_TEST_NB && nb_waits < 100; nb_waits++) {
+        int nb_msgs = picoquic_uring_wait(uring, 1, recv_msgs, PICOQUIC_RECVMMSG_MAX, 100000, &is_wake_up_event);
+
+        for (int i = 0; ret == 0 && i < nb_msgs; i++, nb_recv++) {
+            if (recv_msgs[i].bytes_recv != (size_t)(100 + nb_recv) ||
+                ((struct sockaddr_in*)&recv_msgs[i].addr_dest)->sin_port != ((struct sockaddr_in*)&addr_dest)->sin_port) {
+                DBG_PRINTF("Message %d, received %zu bytes", nb_recv, recv_msgs[i].bytes_recv);
+                ret = -1;
+            }
+        }
+    }
+    if (ret == 0 && nb_recv != SOCKLOOP_URING_TEST_NB) {
+        DBG_PRINTF("Received %d messages instead of %d", nb_recv, SOCKLOOP_URING_TEST_NB);
+        ret = -1;
+    }
+
+    /* Writing to the wake up pipe ends the wait */
+    if (ret == 0) {
+        if (write(wake_up_pipe[1], "w", 1) != 1 ||
+            picoquic_uring_wait(uring, 1, recv_msgs, PICOQUIC_RECVMMSG_MAX, 1000000, &is_wake_up_event) != 0 ||
+            !is_wake_up_event) {
+            DBG_PRINTF("%s", "Wake up event not received");
+            ret = -1;
+        }
+    }
+
+    if (uring != NULL) {
+        picoquic_uring_delete(uring);
+    }
+    for (int i = 0; i < 2; i++) {
+        if (wake_up_pipe[i] >= 0) {
+            close(wake_up_pipe[i]);
+        }
+    }
+    if (s_ctx.fd != INVALID_SOCKET) {
+        SOCKET_CLOSE(s_ctx.fd);
+    }
+    if (fd_send != INVALID_SOCKET) {
+        SOCKET_CLOSE(fd_send);
+    }
+    if (msgs != NULL) {
+        free(msgs);
+    }
+#endif
+    return ret;
+}
+
+int sockloop_batch_send_test()
+{
+    sockloop_test_spec_t spec;
+    sockloop_test_set_spec(&spec, 10);
+    spec.socket_buffer_size = 0xffff;
+    spec.scenario = sockloop_test_scenario_1M;
+    spec.scenario_size = sizeof(sockloop_test_scenario_1M);
+    spec.send_batch_size = 16;
+
+    return(sockloop_test_one(&spec));
+}
+
+int sockloop_txtime_test()
+{
+    sockloop_test_spec_t spec;
+    sockloop_test_set_spec(&spec, 12);
+    spec.socket_buffer_size = 0xffff;
+    spec.scenario = sockloop_test_scenario_1M;
+    spec.scenario_size = sizeof(sockloop_test_scenario_1M);
+    spec.send_batch_size = 16;
+    spec.pacing_offload_horizon = 2000;
+
+    return(sockloop_test_one(&spec));
+}
+
+int sockloop_select_test()
+{
+    sockloop_test_spec_t spec;
+    sockloop_test_set_spec(&spec, 11);
+    spec.socket_buffer_size = 0xffff;
+    spec.scenario = sockloop_test_scenario_1M;
+    spec.scenario_size = sizeof(sockloop_test_scenario_1M);
+    spec.do_not_use_epoll = 1;
+
+    return(sockloop_test_one(&spec));
+}
+
 int sockloop_thread_name_test()
 {
     sockloop_test_spec_t spec;
@@ -694,4 +944,143 @@ int sockloop_thread_name_test()
     spec.thread_name = "picoquic loop";
 
     return(sockloop_test_one(&spec));
-}
\ No newline at end of file
+}
+/* Verify the steering of packets between shards, without starting
+ * the network threads.
+ */
+#define SHARD_TEST_NB_SHARDS 3
+#define SHARD_TEST_QUEUE_SIZE 4
+
+static picoquic_quic_t* shard_test_create_quic(void* create_quic_ctx, int shard_id)
+{
+    uint64_t current_time = *((uint64_t*)create_quic_ctx);
+#ifdef UNREFERENCED_PARAMETER
+    UNREFERENCED_PARAMETER(shard_id);
+#endif
+    return picoquic_create(8, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, current_time, NULL, NULL, NULL, 0);
+}
+
+int shard_steering_test()
+{
+    int ret = 0;
+#ifndef _WINDOWS
+    uint64_t current_time = 1000000;
+    picoquic_shard_server_param_t param;
+    picoquic_shard_server_t* server = NULL;
+    picoquic_cnx_t* cnx[SHARD_TEST_NB_SHARDS] = { NULL, NULL, NULL };
+    struct sockaddr_in addr_peer;
+    struct sockaddr_in addr_local;
+    uint8_t packet[SHARD_TEST_NB_SHARDS][64];
+    uint8_t long_packet[64];
+    picoquic_shard_stats_t stats;
+
+    memset(&param, 0, sizeof(param));
+    param.nb_shards = SHARD_TEST_NB_SHARDS;
+    param.create_quic_fn = shard_test_create_quic;
+    param.create_quic_ctx = &current_time;
+    param.queue_size = SHARD_TEST_QUEUE_SIZE;
+    memset(&addr_peer, 0, sizeof(addr_peer));
+    addr_peer.sin_family = AF_INET;
+    addr_peer.sin_port = htons(1234);
+    memset(&addr_local, 0, sizeof(addr_local));
+    addr_local.sin_family = AF_INET;
+    addr_local.sin_port = htons(4433);
+
+    if ((server = picoquic_shard_server_create(&param)) == NULL) {
+        DBG_PRINTF("%s", "Cannot create the sharded server");
+        ret = -1;
+    }
+
+    /* Create a connection in each shard, and a short header packet to its CID */
+    for (int i = 0; ret == 0 && i < SHARD_TEST_NB_SHARDS; i++) {
+        cnx[i] = picoquic_create_cnx(picoquic_shard_server_get_quic(server, i),
+            picoquic_null_connection_id, picoquic_null_connection_id,
+            (struct sockaddr*)&addr_peer, current_time, 0, NULL, NULL, 1);
+        memset(packet[i], 0x5a, sizeof(packet[i]));
+        packet[i][0] = 0x41;
+        if (cnx[i] == NULL ||
+            picoquic_format_connection_id(packet[i] + 1, sizeof(packet[i]) - 1, picoquic_get_local_cnxid(cnx[i])) != 8) {
+            ret = -1;
+        }
+    }
+
+    /* Each packet is steered to the shard of its connection, whatever the receiving shard */
+    for (int i = 0; ret == 0 && i < SHARD_TEST_NB_SHARDS; i++) {
+        for (int j = 0; ret == 0 && j < SHARD_TEST_NB_SHARDS; j++) {
+            int target_id = picoquic_shard_server_steer(server, j, packet[i], sizeof(packet[i]));
+            if (target_id != i) {
+                DBG_PRINTF("Packet for shard %d steered to %d by shard %d", i, target_id, j);
+                ret = -1;
+            }
+        }
+    }
+
+    /* Handshake packets are steered the same way, Initial and 0-RTT packets
+     * and unknown server IDs stay local */
+    if (ret == 0) {
+        memset(long_packet, 0x5a, sizeof(long_packet));
+        long_packet[0] = 0xe0;
+        picoquic_frames_uint32_encode(long_packet + 1, long_packet + 5, PICOQUIC_V1_VERSION);
+        long_packet[5] = 8;
+        memcpy(long_packet + 6, packet[2] + 1, 8);
+        if (picoquic_shard_server_steer(server, 0, long_packet, sizeof(long_packet)) != 2) {
+            DBG_PRINTF("%s", "Handshake packet not steered to shard 2");
+            ret = -1;
+        }
+        else {
+            for (int i = 0; ret == 0 && i < 2; i++) {
+                long_packet[0] = (i == 0) ? 0xc0 : 0xd0;
+                if (picoquic_shard_server_steer(server, 0, long_packet, sizeof(long_packet)) != -1) {
+                    DBG_PRINTF("%s packet not processed locally", (i == 0) ? "Initial" : "0-RTT");
+                    ret = -1;
+                }
+            }
+            long_packet[0] = 0xe0;
+            long_packet[7] = 0xff;
+            if (picoquic_shard_server_steer(server, 0, long_packet, sizeof(long_packet)) != -1) {
+                DBG_PRINTF("%s", "Unknown server ID not steered locally");
+                ret = -1;
+            }
+        }
+    }
+
+    /* Fill the queue of shard 2, the last packet is dropped */
+    for (int i = 0; ret == 0 && i <= SHARD_TEST_QUEUE_SIZE; i++) {
+        int forward_ret = picoquic_shard_server_forward(server, 0, 2, packet[2], sizeof(packet[2]),
+            (struct sockaddr*)&addr_peer, (struct sockaddr*)&addr_local, 0, 0);
+        if ((forward_ret == 0) != (i < SHARD_TEST_QUEUE_SIZE)) {
+            DBG_PRINTF("Forward %d returns %d", i, forward_ret);
+            ret = -1;
+        }
+    }
+    if (ret == 0) {
+        picoquic_shard_server_get_stats(server, 0, &stats);
+        if (stats.nb_forwarded != SHARD_TEST_QUEUE_SIZE || stats.nb_dropped != 1) {
+            DBG_PRINTF("Forwarded %" PRIu64 ", dropped %" PRIu64, stats.nb_forwarded, stats.nb_dropped);
+            ret = -1;
+        }
+    }
+
+    /* Drain the queue, after which it accepts packets again */
+    if (ret == 0 && picoquic_shard_server_drain(server, 2, current_time) != SHARD_TEST_QUEUE_SIZE) {
+        DBG_PRINTF("%s", "Cannot drain the queue of shard 2");
+        ret = -1;
+    }
+    if (ret == 0) {
+        picoquic_shard_server_get_stats(server, 2, &stats);
+        if (stats.nb_received_forwarded != SHARD_TEST_QUEUE_SIZE ||
+            picoquic_shard_server_drain(server, 2, current_time) != 0 ||
+            picoquic_shard_server_forward(server, 1, 2, packet[2], sizeof(packet[2]),
+                (struct sockaddr*)&addr_peer, (struct sockaddr*)&addr_local, 0, 0) != 0 ||
+            picoquic_shard_server_drain(server, 2, current_time) != 1) {
+            DBG_PRINTF("%s", "Queue of shard 2 not reusable after drain");
+            ret = -1;
+        }
+    }
+
+    if (server != NULL) {
+        picoquic_shard_server_delete(server);
+    }
+#endif
+    return ret;
+}
@@ -181,24 +181,33 @@ static int StreamZeroFrameOneTest(struct test_case_st* test)
 
             if (ret == 0) {
                 /* Check the content of all the data in the context */
-                picoquic_stream_data_node_t* data = (picoquic_stream_data_node_t*)picosplay_first(&picoquic_first_stream(cnx)->stream_data_tree);
+                picoquic_stream_ring_t* ring = picoquic_first_stream(cnx)->reassembly_ring;
+                picoquic_sack_item_t* range = (ring == NULL) ? NULL : picoquic_sack_first_item(&ring->ranges);
                 size_t data_rank = 0;
 
-                while (data != NULL) {
-                    if (data->bytes == NULL) {
-                        FAIL(test, "%s", "No data bytes");
+                if (ring == NULL) {
+                    FAIL(test, "%s", "No reassembly ring");
+                    ret = -1;
+                }
+
+                while (ret == 0 && range != NULL) {
+                    if (range->start_of_sack_range != data_rank) {
+                        FAIL(test, "range starts at %" PRIu64 " instead of %" PRIst, range->start_of_sack_range, data_rank);
                         ret = -1;
                     }
 
-                    for (size_t i = 0; ret == 0 && i < data->length; i++) {
+                    for (uint64_t offset = range->start_of_sack_range; ret == 0 && offset <= range->end_of_sack_range; offset++) {
+                        size_t length = 1;
+                        const uint8_t* bytes = picoquic_stream_ring_read(ring, offset, &length);
+
                         data_rank++;
-                        if (data->bytes[i] != data_rank) {
-                            FAIL(test, "byte %" PRIst " is %u instead of %" PRIst, i, data->bytes[i], data_rank);
+                        if (*bytes != data_rank) {
+                            FAIL(test, "byte %" PRIu64 " is %u instead of %" PRIst, offset, *bytes, data_rank);
                             ret = -1;
                         }
                     }
 
-                    data = (picoquic_stream_data_node_t*)picosplay_next(&data->stream_data_node);
+                    range = picoquic_sack_next_item(range);
                 }
 
                 if (ret == 0 && data_rank != test->expected_length) {
@@ -228,6 +237,437 @@ int StreamZeroFrameTest()
 }
 
 
+/* Test the reassembly ring: out of order data is held until the gap is
+ * filled, the ring grows and wraps around, and pending data is passed
+ * to the direct receive function if the application sets one.
+ */
+#define STREAM_RING_TEST_FRAME_SIZE 1000
+#define STREAM_RING_TEST_NB_FRAMES 110
+
+typedef struct st_stream_ring_test_ctx_t {
+    uint64_t nb_delivered;
+    int nb_callbacks;
+    int is_corrupted;
+} stream_ring_test_ctx_t;
+
+static uint8_t stream_ring_test_byte(uint64_t offset)
+{
+    return (uint8_t)(offset * 7 + 3);
+}
+
+static int stream_ring_test_check(stream_ring_test_ctx_t* ctx, uint64_t offset, const uint8_t* bytes, size_t length)
+{
+    if (offset != ctx->nb_delivered) {
+        ctx->is_corrupted = 1;
+    }
+    for (size_t i = 0; i < length; i++) {
+        if (bytes[i] != stream_ring_test_byte(offset + i)) {
+            ctx->is_corrupted = 1;
+        }
+    }
+    ctx->nb_delivered += length;
+    ctx->nb_callbacks++;
+
+    return 0;
+}
+
+static int stream_ring_test_callback(picoquic_cnx_t* cnx,
+    uint64_t stream_id, uint8_t* bytes, size_t length,
+    picoquic_call_back_event_t fin_or_event, void* callback_ctx, void* v_stream_ctx)
+{
+    stream_ring_test_ctx_t* ctx = (stream_ring_test_ctx_t*)callback_ctx;
+#ifdef _WINDOWS
+    UNREFERENCED_PARAMETER(cnx);
+    UNREFERENCED_PARAMETER(stream_id);
+    UNREFERENCED_PARAMETER(v_stream_ctx);
+#endif
+    if (fin_or_event == picoquic_callback_stream_data && length > 0) {
+        (void)stream_ring_test_check(ctx, ctx->nb_delivered, bytes, length);
+    }
+    return 0;
+}
+
+static int stream_ring_test_direct_receive(picoquic_cnx_t* cnx,
+    uint64_t stream_id, int fin, const uint8_t* bytes, uint64_t offset, size_t length,
+    void* direct_receive_ctx)
+{
+#ifdef _WINDOWS
+    UNREFERENCED_PARAMETER(cnx);
+    UNREFERENCED_PARAMETER(stream_id);
+    UNREFERENCED_PARAMETER(fin);
+#endif
+    return stream_ring_test_check((stream_ring_test_ctx_t*)direct_receive_ctx, offset, bytes, length);
+}
+
+static int stream_ring_test_segment(picoquic_cnx_t* cnx, uint64_t offset, size_t length)
+{
+    uint8_t frame[16 + STREAM_RING_TEST_FRAME_SIZE];
+    uint8_t* bytes = frame;
+    int ret = 0;
+
+    *bytes++ = picoquic_frame_type_stream_range_min | 6; /* Offset and length present */
+    bytes = picoquic_frames_varint_encode(bytes, frame + sizeof(frame), 0);
+    bytes = picoquic_frames_varint_encode(bytes, frame + sizeof(frame), offset);
+    bytes = picoquic_frames_varint_encode(bytes, frame + sizeof(frame), length);
+    for (size_t i = 0; i < length; i++) {
+        *bytes++ = stream_ring_test_byte(offset + i);
+    }
+
+    if (picoquic_decode_stream_frame(cnx, frame, bytes, NULL, 0) != bytes) {
+        DBG_PRINTF("Cannot decode segment at offset %" PRIu64 "\n", offset);
+        ret = -1;
+    }
+    return ret;
+}
+
+static int stream_ring_test_frame(picoquic_cnx_t* cnx, int rank)
+{
+    return stream_ring_test_segment(cnx, (uint64_t)rank * STREAM_RING_TEST_FRAME_SIZE, STREAM_RING_TEST_FRAME_SIZE);
+}
+
+int stream_ring_test()
+{
+    int ret = 0;
+    picoquic_quic_t* quic = NULL;
+    picoquic_cnx_t* cnx = NULL;
+    picoquic_stream_head_t* stream = NULL;
+    stream_ring_test_ctx_t ctx;
+    struct sockaddr_in saddr;
+    uint64_t current_time = 0;
+
+    memset(&ctx, 0, sizeof(ctx));
+    memset(&saddr, 0, sizeof(struct sockaddr_in));
+    saddr.sin_family = AF_INET;
+    saddr.sin_port = 1000;
+
+    quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL,
+        NULL, NULL, NULL, NULL, current_time,
+        &current_time, NULL, NULL, 0);
+
+    if (quic == NULL || (cnx = picoquic_create_cnx(quic,
+        picoquic_null_connection_id, picoquic_null_connection_id, (struct sockaddr*)&saddr,
+        current_time, 0, "test-sni", "test-alpn", 1)) == NULL) {
+        DBG_PRINTF("%s", "Cannot create connection\n");
+        ret = -1;
+    }
+    else {
+        cnx->client_mode = 0;
+        cnx->maxdata_local = 0x100000;
+        cnx->local_parameters.initial_max_stream_data_bidi_remote = 0x100000;
+        picoquic_set_callback(cnx, stream_ring_test_callback, &ctx);
+
+        /* Lose the first frame, receive the next 39: the ring must grow */
+        for (int i = 1; ret == 0 && i < 40; i++) {
+            ret = stream_ring_test_frame(cnx, i);
+        }
+        if (ret == 0 && ((stream = picoquic_find_stream(cnx, 0)) == NULL ||
+            stream->reassembly_ring == NULL || stream->reassembly_ring->size < 39 * STREAM_RING_TEST_FRAME_SIZE ||
+            ctx.nb_delivered != 0)) {
+            DBG_PRINTF("%s", "Out of order data not held in the ring\n");
+            ret = -1;
+        }
+        /* Filling the gap delivers all the data in one callback for the ring */
+        if (ret == 0 && (ret = stream_ring_test_frame(cnx, 0)) == 0 &&
+            (ctx.nb_delivered != 40 * STREAM_RING_TEST_FRAME_SIZE || ctx.nb_callbacks != 2)) {
+            DBG_PRINTF("Delivered %" PRIu64 " bytes in %d callbacks\n", ctx.nb_delivered, ctx.nb_callbacks);
+            ret = -1;
+        }
+
+        /* Receive the next frames in reverse order: the data wraps around the ring */
+        for (int i = 99; ret == 0 && i >= 40; i--) {
+            ret = stream_ring_test_frame(cnx, i);
+        }
+        if (ret == 0 && ctx.nb_delivered != 100 * STREAM_RING_TEST_FRAME_SIZE) {
+            DBG_PRINTF("Delivered %" PRIu64 " bytes instead of %d\n", ctx.nb_delivered, 100 * STREAM_RING_TEST_FRAME_SIZE);
+            ret = -1;
+        }
+
+        /* Pending data is passed to the direct receive function */
+        for (int i = 101; ret == 0 && i < STREAM_RING_TEST_NB_FRAMES; i++) {
+            ret = stream_ring_test_frame(cnx, i);
+        }
+        if (ret == 0) {
+            ctx.nb_delivered = 101 * STREAM_RING_TEST_FRAME_SIZE;
+            ret = picoquic_mark_direct_receive_stream(cnx, 0, stream_ring_test_direct_receive, &ctx);
+            if (ret == 0 && (stream->reassembly_ring != NULL || ctx.nb_delivered != STREAM_RING_TEST_NB_FRAMES * STREAM_RING_TEST_FRAME_SIZE)) {
+                DBG_PRINTF("%s", "Pending data not passed to direct receive\n");
+                ret = -1;
+            }
+        }
+        if (ret == 0) {
+            ctx.nb_delivered = 100 * STREAM_RING_TEST_FRAME_SIZE;
+            if ((ret = stream_ring_test_frame(cnx, 100)) == 0 && ctx.nb_delivered != 101 * STREAM_RING_TEST_FRAME_SIZE) {
+                DBG_PRINTF("%s", "Missing frame not passed to direct receive\n");
+                ret = -1;
+            }
+        }
+
+        if (ret == 0 && ctx.is_corrupted) {
+            DBG_PRINTF("%s", "Delivered data is corrupted\n");
+            ret = -1;
+        }
+    }
+
+    if (cnx != NULL) {
+        picoquic_delete_cnx(cnx);
+    }
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+
+    return ret;
+}
+
+/* Test the zero copy receive API: data received in a packet is referenced by
+ * the views, pending data is copied when the stream is marked, and packets
+ * are released when the application consumes all the views that refer to them.
+ * The application may also consume the views from the notification, while the
+ * packet is still being decoded.
+ */
+#define STREAM_VIEWS_TEST_FRAME_SIZE 500
+
+typedef struct st_stream_views_test_ctx_t {
+    size_t nb_bytes_available;
+    int is_fin;
+    int nb_notifications;
+    int is_consuming; /* Consume the data from within the notification */
+    size_t nb_bytes_consumed;
+} stream_views_test_ctx_t;
+
+static int stream_views_test_notify(picoquic_cnx_t* cnx,
+    uint64_t stream_id, size_t nb_bytes_available, int is_fin, void* zero_copy_ctx)
+{
+    int ret = 0;
+    stream_views_test_ctx_t* ctx = (stream_views_test_ctx_t*)zero_copy_ctx;
+
+    ctx->nb_bytes_available = nb_bytes_available;
+    ctx->is_fin = is_fin;
+    ctx->nb_notifications++;
+    if (ctx->is_consuming) {
+        ret = picoquic_consume_stream_views(cnx, stream_id, nb_bytes_available);
+        ctx->nb_bytes_consumed += nb_bytes_available;
+    }
+    return ret;
+}
+
+/* Decode a packet carrying stream frames of the specified ranks, as the packet
+ * processing would: the packet is recycled after decoding unless it was retained. */
+static int stream_views_test_packet(picoquic_cnx_t* cnx, uint64_t stream_id, const int* ranks, int nb_ranks, int is_fin,
+    picoquic_stream_data_node_t** retained)
+{
+    int ret = 0;
+    picoquic_stream_data_node_t* packet = picoquic_stream_data_node_alloc(cnx->quic);
+    uint8_t* bytes_max;
+    uint8_t* bytes;
+
+    if (packet == NULL) {
+        return -1;
+    }
+    packet->is_decoding = 1;
+    bytes_max = packet->data + sizeof(packet->data);
+    bytes = packet->data + 20;
+    for (int r = 0; r < nb_ranks && bytes != NULL; r++) {
+        uint64_t offset = (uint64_t)ranks[r] * STREAM_VIEWS_TEST_FRAME_SIZE;
+        size_t length = (ranks[r] < 0) ? 0 : STREAM_VIEWS_TEST_FRAME_SIZE;
+
+        if (ranks[r] < 0) {
+            /* Fin frame at the end of the data */
+            offset = (uint64_t)(-ranks[r]) * STREAM_VIEWS_TEST_FRAME_SIZE;
+        }
+        bytes = picoquic_frames_uint8_encode(bytes, bytes_max,
+            picoquic_frame_type_stream_range_min | 6 | ((is_fin && r == nb_ranks - 1) ? 1 : 0));
+        bytes = picoquic_frames_varint_encode(bytes, bytes_max, stream_id);
+        bytes = picoquic_frames_varint_encode(bytes, bytes_max, offset);
+        bytes = picoquic_frames_varint_encode(bytes, bytes_max, length);
+        for (size_t i = 0; bytes != NULL && i < length; i++) {
+            *bytes++ = stream_ring_test_byte(offset + i);
+        }
+    }
+
+    if (bytes == NULL) {
+        ret = -1;
+    }
+    else {
+        const uint8_t* next = packet->data + 20;
+
+        while (ret == 0 && next < bytes) {
+            if ((next = picoquic_decode_stream_frame(cnx, next, bytes, packet, 0)) == NULL) {
+                ret = -1;
+            }
+        }
+    }
+
+    packet->is_decoding = 0;
+    if (retained != NULL) {
+        *retained = (packet->bytes == NULL) ? NULL : packet;
+    }
+    if (packet->bytes == NULL) {
+        picoquic_stream_data_node_recycle(packet);
+    }
+
+    return ret;
+}
+
+static int stream_views_test_check(picoquic_cnx_t* cnx, uint64_t offset, size_t nb_bytes,
+    picoquic_stream_data_node_t* packet)
+{
+    int ret = 0;
+    picoquic_stream_view_t views[8];
+    size_t nb_views = picoquic_get_stream_views(cnx, 0, views, 8);
+    size_t total = 0;
+
+    for (size_t v = 0; ret == 0 && v < nb_views; v++) {
+        if (views[v].offset != offset + total) {
+            ret = -1;
+        }
+        else if (packet != NULL && views[v].offset >= STREAM_VIEWS_TEST_FRAME_SIZE &&
+            (views[v].bytes < packet->data || views[v].bytes + views[v].length > packet->data + sizeof(packet->data))) {
+            /* Data received after the stream was marked must refer to the packet */
+            ret = -1;
+        }
+        for (size_t i = 0; ret == 0 && i < views[v].length; i++) {
+            if (views[v].bytes[i] != stream_ring_test_byte(views[v].offset + i)) {
+                ret = -1;
+            }
+        }
+        total += views[v].length;
+    }
+    if (ret == 0 && total != nb_bytes) {
+        ret = -1;
+    }
+
+    return ret;
+}
+
+int stream_views_test()
+{
+    int ret = 0;
+    picoquic_quic_t* quic = NULL;
+    picoquic_cnx_t* cnx = NULL;
+    picoquic_stream_head_t* stream = NULL;
+    picoquic_stream_data_node_t* packet = NULL;
+    stream_views_test_ctx_t ctx;
+    struct sockaddr_in saddr;
+    uint64_t current_time = 0;
+    const int first_rank[1] = { 0 };
+    const int two_ranks[2] = { 2, 1 };
+    const int fin_rank[1] = { -3 };
+    const int in_sequence_ranks[2] = { 0, 1 };
+    const int last_ranks[2] = { 2, -3 };
+
+    memset(&ctx, 0, sizeof(ctx));
+    memset(&saddr, 0, sizeof(struct sockaddr_in));
+    saddr.sin_family = AF_INET;
+    saddr.sin_port = 1000;
+
+    quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL,
+        NULL, NULL, NULL, NULL, current_time,
+        &current_time, NULL, NULL, 0);
+
+    if (quic == NULL || (cnx = picoquic_create_cnx(quic,
+        picoquic_null_connection_id, picoquic_null_connection_id, (struct sockaddr*)&saddr,
+        current_time, 0, "test-sni", "test-alpn", 1)) == NULL) {
+        DBG_PRINTF("%s", "Cannot create connection\n");
+        ret = -1;
+    }
+    else {
+        cnx->client_mode = 0;
+        cnx->maxdata_local = 0x100000;
+        cnx->local_parameters.initial_max_stream_data_bidi_remote = 0x100000;
+
+        /* Data received before marking the stream is copied in views */
+        if ((ret = stream_views_test_packet(cnx, 0, first_rank, 1, 0, NULL)) == 0 &&
+            ((stream = picoquic_find_stream(cnx, 0)) == NULL ||
+            (ret = picoquic_mark_zero_copy_receive_stream(cnx, 0, stream_views_test_notify, &ctx)) != 0 ||
+            stream->reassembly_ring != NULL || ctx.nb_notifications != 1 ||
+            ctx.nb_bytes_available != STREAM_VIEWS_TEST_FRAME_SIZE ||
+            stream_views_test_check(cnx, 0, STREAM_VIEWS_TEST_FRAME_SIZE, NULL) != 0)) {
+            DBG_PRINTF("%s", "Pending data not copied in views\n");
+            ret = -1;
+        }
+
+        /* Out of order frames in the same packet are both referenced */
+        if (ret == 0 && ((ret = stream_views_test_packet(cnx, 0, two_ranks, 2, 0, &packet)) != 0 ||
+            packet == NULL || packet->nb_views != 2 || ctx.nb_notifications != 2 ||
+            ctx.nb_bytes_available != 3 * STREAM_VIEWS_TEST_FRAME_SIZE || ctx.is_fin ||
+            stream_views_test_check(cnx, 0, 3 * STREAM_VIEWS_TEST_FRAME_SIZE, packet) != 0)) {
+            DBG_PRINTF("%s", "Packet not referenced by the views\n");
+            ret = -1;
+        }
+
+        /* Consuming part of the data keeps the packet */
+        if (ret == 0 && ((ret = picoquic_consume_stream_views(cnx, 0, 3 * STREAM_VIEWS_TEST_FRAME_SIZE / 2)) != 0 ||
+            packet->nb_views != 2 || stream->consumed_offset != 3 * STREAM_VIEWS_TEST_FRAME_SIZE / 2 ||
+            stream_views_test_check(cnx, 3 * STREAM_VIEWS_TEST_FRAME_SIZE / 2, 3 * STREAM_VIEWS_TEST_FRAME_SIZE / 2, packet) != 0)) {
+            DBG_PRINTF("%s", "Partial consumption failed\n");
+            ret = -1;
+        }
+
+        /* Consuming more than available fails, consuming the rest releases the packet */
+        if (ret == 0) {
+            int nb_nodes_in_pool = quic->nb_data_nodes_in_pool;
+
+            if (picoquic_consume_stream_views(cnx, 0, 3 * STREAM_VIEWS_TEST_FRAME_SIZE) == 0 ||
+                (ret = picoquic_consume_stream_views(cnx, 0, 3 * STREAM_VIEWS_TEST_FRAME_SIZE / 2)) != 0 ||
+                quic->nb_data_nodes_in_pool != nb_nodes_in_pool + 1 || stream->first_view != NULL ||
+                picoquic_get_stream_views(cnx, 0, NULL, 0) != 0) {
+                DBG_PRINTF("%s", "Packet not released\n");
+                ret = -1;
+            }
+        }
+
+        /* The fin is notified, and consuming it completes the stream */
+        if (ret == 0 && ((ret = stream_views_test_packet(cnx, 0, fin_rank, 1, 1, &packet)) != 0 ||
+            packet != NULL || ctx.nb_notifications != 3 || !ctx.is_fin || ctx.nb_bytes_available != 0 ||
+            (ret = picoquic_consume_stream_views(cnx, 0, 0)) != 0 || !stream->fin_signalled)) {
+            DBG_PRINTF("%s", "Fin not processed\n");
+            ret = -1;
+        }
+
+        /* Consuming from the notification releases the views, but the packet stays
+         * available for the next frames until the end of decoding. The closure of
+         * the stream is only processed after the notification returns. */
+        if (ret == 0) {
+            memset(&ctx, 0, sizeof(ctx));
+            ctx.is_consuming = 1;
+            if ((stream = picoquic_create_missing_streams(cnx, 2, 1)) == NULL ||
+                (ret = picoquic_mark_zero_copy_receive_stream(cnx, 2, stream_views_test_notify, &ctx)) != 0) {
+                DBG_PRINTF("%s", "Cannot mark the unidir stream\n");
+                ret = -1;
+            }
+        }
+        if (ret == 0) {
+            int nb_nodes_in_pool = quic->nb_data_nodes_in_pool;
+            int nb_nodes_allocated = quic->nb_data_nodes_allocated;
+
+            if ((ret = stream_views_test_packet(cnx, 2, in_sequence_ranks, 2, 0, &packet)) != 0 ||
+                packet != NULL || ctx.nb_notifications != 2 ||
+                ctx.nb_bytes_consumed != 2 * STREAM_VIEWS_TEST_FRAME_SIZE ||
+                stream->consumed_offset != 2 * STREAM_VIEWS_TEST_FRAME_SIZE || stream->first_view != NULL ||
+                quic->nb_data_nodes_in_pool != nb_nodes_in_pool || quic->nb_data_nodes_allocated != nb_nodes_allocated) {
+                DBG_PRINTF("%s", "Consumption from the notification failed\n");
+                ret = -1;
+            }
+        }
+        if (ret == 0 && ((ret = stream_views_test_packet(cnx, 2, last_ranks, 2, 1, &packet)) != 0 ||
+            packet != NULL || ctx.nb_notifications != 4 || !ctx.is_fin ||
+            ctx.nb_bytes_consumed != 3 * STREAM_VIEWS_TEST_FRAME_SIZE ||
+            picoquic_find_stream(cnx, 2) != stream || !stream->fin_signalled || !stream->is_closed)) {
+            DBG_PRINTF("%s", "Stream not closed after consumption from the notification\n");
+            ret = -1;
+        }
+    }
+
+    if (cnx != NULL) {
+        picoquic_delete_cnx(cnx);
+    }
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+
+    return ret;
+}
+
 /*
 * Testing Arrival of Frame for TLS Stream
 */
@@ -853,6 +1293,176 @@ int stream_output_test()
     return ret;
 }
 
+/* Test the stream scheduler: priority order, FIFO and round robin processing,
+ * urgent actions, and streams waiting for flow control credits.
+ */
+
+static int stream_scheduler_test_add(picoquic_cnx_t* cnx, uint64_t stream_id, uint8_t priority, size_t length)
+{
+    uint8_t data[2500];
+    int ret;
+
+    memset(data, 0x5a, sizeof(data));
+    if ((ret = picoquic_set_stream_priority(cnx, stream_id, priority)) == 0) {
+        ret = picoquic_add_to_stream(cnx, stream_id, data, length, 0);
+    }
+    if (ret != 0) {
+        DBG_PRINTF("Cannot queue %zu bytes on stream %d\n", length, (int)stream_id);
+    }
+    return ret;
+}
+
+static int stream_scheduler_test_check(picoquic_cnx_t* cnx, uint64_t stream_id)
+{
+    picoquic_stream_head_t* stream = picoquic_find_ready_stream(cnx);
+
+    if (stream == NULL) {
+        DBG_PRINTF("Expected stream %d, got NULL\n", (int)stream_id);
+        return -1;
+    }
+    else if (stream->stream_id != stream_id) {
+        DBG_PRINTF("Expected stream %d, got %d\n", (int)stream_id, (int)stream->stream_id);
+        return -1;
+    }
+    return 0;
+}
+
+static int stream_scheduler_test_send(picoquic_cnx_t* cnx, uint64_t stream_id)
+{
+    int ret = stream_scheduler_test_check(cnx, stream_id);
+
+    if (ret == 0) {
+        uint8_t packet[1024];
+        int more_data = 0;
+        int is_pure_ack = 1;
+        int is_still_active = 0;
+        uint8_t* bytes_next = picoquic_format_stream_frame(cnx, picoquic_find_stream(cnx, stream_id),
+            packet, packet + sizeof(packet), &more_data, &is_pure_ack, &is_still_active, &ret);
+
+        if (ret == 0 && (bytes_next == NULL || bytes_next == packet)) {
+            DBG_PRINTF("No data sent on stream %d\n", (int)stream_id);
+            ret = -1;
+        }
+    }
+    return ret;
+}
+
+int stream_scheduler_test()
+{
+    int ret = 0;
+    picoquic_quic_t* quic = NULL;
+    picoquic_cnx_t* cnx = NULL;
+    uint64_t simulated_time = 0;
+    struct sockaddr_in saddr;
+    /* Round robin on priority 2 before FIFO on priority 3 */
+    uint64_t send_order[] = { 12, 16, 20, 12, 16, 20, 12, 16, 20, 0, 4, 8 };
+
+    quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL,
+        NULL, NULL, NULL, NULL, simulated_time,
+        &simulated_time, NULL, NULL, 0);
+
+    memset(&saddr, 0, sizeof(struct sockaddr_in));
+    saddr.sin_family = AF_INET;
+    saddr.sin_port = 1000;
+
+    if (quic == NULL) {
+        DBG_PRINTF("%s", "Cannot create QUIC context\n");
+        ret = -1;
+    }
+    else if ((cnx = picoquic_create_cnx(quic,
+        picoquic_null_connection_id, picoquic_null_connection_id, (struct sockaddr*)&saddr,
+        simulated_time, 0, "test-sni", "test-alpn", 1)) == NULL) {
+        DBG_PRINTF("%s", "Cannot create connection\n");
+        ret = -1;
+    }
+    else {
+        picoquic_set_callback(cnx, stream_output_test_callback, NULL);
+        cnx->maxdata_remote = 0x100000;
+        cnx->remote_parameters.initial_max_stream_data_bidi_remote = 0x10000;
+        cnx->max_stream_id_bidir_remote = 400;
+
+        /* Queue FIFO streams out of order, then round robin streams */
+        ret = stream_scheduler_test_add(cnx, 8, 3, 100);
+        if (ret == 0) {
+            ret = stream_scheduler_test_add(cnx, 4, 3, 100);
+        }
+        if (ret == 0) {
+            ret = stream_scheduler_test_add(cnx, 0, 3, 100);
+        }
+        for (uint64_t stream_id = 12; ret == 0 && stream_id <= 20; stream_id += 4) {
+            ret = stream_scheduler_test_add(cnx, stream_id, 2, 2500);
+        }
+        for (size_t i = 0; ret == 0 && i < sizeof(send_order) / sizeof(uint64_t); i++) {
+            ret = stream_scheduler_test_send(cnx, send_order[i]);
+        }
+        if (ret == 0 && picoquic_find_ready_stream(cnx) != NULL) {
+            DBG_PRINTF("%s", "Unexpected ready stream after sending all data\n");
+            ret = -1;
+        }
+
+        /* A stream blocked by flow control waits for MAX_STREAM_DATA */
+        if (ret == 0 && (ret = picoquic_set_stream_priority(cnx, 24, 2)) == 0) {
+            picoquic_find_stream(cnx, 24)->maxdata_remote = 0;
+            ret = stream_scheduler_test_add(cnx, 24, 2, 100);
+            if (ret == 0 && picoquic_find_ready_stream(cnx) != NULL) {
+                DBG_PRINTF("%s", "Blocked stream is ready\n");
+                ret = -1;
+            }
+            else if (ret == 0 && picoquic_find_stream(cnx, 24)->ready_bucket != NULL) {
+                DBG_PRINTF("%s", "Blocked stream is still queued\n");
+                ret = -1;
+            }
+        }
+        if (ret == 0) {
+            uint8_t frame[] = { picoquic_frame_type_max_stream_data, 24, 0x44, 0 };
+
+            ret = picoquic_decode_frames(cnx, cnx->path[0], frame, sizeof(frame), NULL, picoquic_epoch_1rtt,
+                NULL, NULL, 0, 0, simulated_time);
+            if (ret == 0) {
+                ret = stream_scheduler_test_send(cnx, 24);
+            }
+        }
+
+        /* Urgent actions go before data at the same priority, but not before higher priorities */
+        if (ret == 0) {
+            ret = stream_scheduler_test_add(cnx, 28, 2, 100);
+        }
+        if (ret == 0) {
+            ret = stream_scheduler_test_add(cnx, 32, 2, 100);
+        }
+        if (ret == 0) {
+            ret = stream_scheduler_test_add(cnx, 36, 5, 100);
+        }
+        if (ret == 0 && (ret = picoquic_reset_stream(cnx, 36, 0)) == 0) {
+            ret = stream_scheduler_test_check(cnx, 28);
+        }
+        if (ret == 0 && (ret = picoquic_reset_stream(cnx, 32, 0)) == 0) {
+            ret = stream_scheduler_test_send(cnx, 32);
+        }
+
+        /* Changing the priority moves the stream to another queue */
+        if (ret == 0 && (ret = picoquic_set_stream_priority(cnx, 28, 7)) == 0) {
+            ret = stream_scheduler_test_send(cnx, 36);
+        }
+        if (ret == 0) {
+            ret = stream_scheduler_test_send(cnx, 28);
+        }
+        if (ret == 0 && picoquic_find_ready_stream(cnx) != NULL) {
+            DBG_PRINTF("%s", "Unexpected ready stream at end of test\n");
+            ret = -1;
+        }
+    }
+
+    if (cnx != NULL) {
+        picoquic_delete_cnx(cnx);
+    }
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+
+    return ret;
+}
+
 /* Test the STREAM ID and STREAM RANK macros
  */
 
@@ -1049,4 +1659,265 @@ int provide_stream_buffer_test()
         }
     }
     return ret;
-}
\ No newline at end of file
+}
+
+/* Test the receive window tuning. The window doubles when the application
+ * consumes a full window per RTT, the connections share the memory budget,
+ * data received but not consumed does not open the window, the stream
+ * windows are capped by the connection window, and the windows shrink when
+ * data is read slowly.
+ */
+#define RWND_TUNING_TEST_RTT 10000
+#define RWND_TUNING_TEST_MB 0x100000ull
+
+static int rwnd_tuning_test_stream(picoquic_cnx_t* cnx, picoquic_stream_head_t* stream, uint64_t* current_time,
+    uint64_t delta_t, uint64_t consumed, uint64_t expected_max_data)
+{
+    uint8_t buffer[256];
+    int more_data = 0;
+    int is_pure_ack = 1;
+
+    *current_time += delta_t;
+    stream->consumed_offset = consumed;
+    (void)picoquic_format_required_max_stream_data_frames(cnx, buffer, buffer + sizeof(buffer), &more_data, &is_pure_ack);
+
+    return (stream->maxdata_local == expected_max_data && !is_pure_ack) ? 0 : -1;
+}
+
+int rwnd_tuning_test()
+{
+    int ret = 0;
+    uint64_t current_time = 0;
+    struct sockaddr_in saddr;
+    picoquic_quic_t* quic = NULL;
+    picoquic_cnx_t* cnx[2] = { NULL, NULL };
+    picoquic_stream_head_t* stream = NULL;
+
+    memset(&saddr, 0, sizeof(struct sockaddr_in));
+    saddr.sin_family = AF_INET;
+    saddr.sin_port = 1000;
+
+    quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL,
+        NULL, NULL, NULL, NULL, current_time, &current_time, NULL, NULL, 0);
+    if (quic == NULL) {
+        ret = -1;
+    }
+    else {
+        picoquic_set_receive_window_tuning(quic, 8 * RWND_TUNING_TEST_MB);
+        for (int i = 0; ret == 0 && i < 2; i++) {
+            if ((cnx[i] = picoquic_create_cnx(quic, picoquic_null_connection_id, picoquic_null_connection_id,
+                (struct sockaddr*)&saddr, current_time, 0, "test-sni", "test-alpn", 1)) == NULL) {
+                DBG_PRINTF("%s", "Cannot create connection\n");
+                ret = -1;
+            }
+            else {
+                cnx[i]->path[0]->smoothed_rtt = RWND_TUNING_TEST_RTT;
+                if (picoquic_rwnd_max_data_increase(cnx[i], current_time) != 0 ||
+                    cnx[i]->rwnd.window != RWND_TUNING_TEST_MB) {
+                    DBG_PRINTF("%s", "Unexpected initial window\n");
+                    ret = -1;
+                }
+            }
+        }
+    }
+
+    /* The peers are limited by flow control: the windows double each RTT,
+     * until the sum of the windows reaches the memory budget. */
+    for (int i = 0; ret == 0 && i < 4; i++) {
+        current_time += RWND_TUNING_TEST_RTT;
+        for (int j = 0; j < 2; j++) {
+            cnx[j]->data_received = cnx[j]->maxdata_local;
+            cnx[j]->data_consumed = cnx[j]->maxdata_local;
+            cnx[j]->maxdata_local += picoquic_rwnd_max_data_increase(cnx[j], current_time);
+        }
+    }
+    if (ret == 0 && (cnx[0]->rwnd.window != 4 * RWND_TUNING_TEST_MB ||
+        cnx[1]->rwnd.window != 4 * RWND_TUNING_TEST_MB ||
+        quic->rwnd_committed != 8 * RWND_TUNING_TEST_MB ||
+        cnx[0]->maxdata_local != cnx[0]->data_consumed + cnx[0]->rwnd.window)) {
+        DBG_PRINTF("Unexpected windows after growth: %" PRIu64 ", %" PRIu64 "\n",
+            cnx[0]->rwnd.window, cnx[1]->rwnd.window);
+        ret = -1;
+    }
+
+    /* Data received but not yet consumed does not open the window */
+    if (ret == 0) {
+        uint64_t data_consumed = cnx[0]->data_consumed;
+        /* Use a stream opened by the peer, which is not in the output list */
+        picoquic_stream_head_t* peer_stream = picoquic_create_stream(cnx[0], 3);
+
+        if (peer_stream != NULL) {
+            peer_stream->maxdata_local = 3 * RWND_TUNING_TEST_MB;
+        }
+        if (peer_stream == NULL ||
+            picoquic_flow_control_check_stream_offset(cnx[0], peer_stream, 3 * RWND_TUNING_TEST_MB) != 0 ||
+            cnx[0]->data_consumed != data_consumed ||
+            picoquic_rwnd_max_data_increase(cnx[0], current_time + RWND_TUNING_TEST_RTT) != 0) {
+            DBG_PRINTF("%s", "Window opened by data not consumed\n");
+            ret = -1;
+        }
+        else {
+            /* Discarding the stream counts its data as consumed */
+            picoquic_delete_stream(cnx[0], peer_stream);
+            if (cnx[0]->data_consumed != data_consumed + 3 * RWND_TUNING_TEST_MB) {
+                DBG_PRINTF("%s", "Discarded data not counted as consumed\n");
+                ret = -1;
+            }
+            cnx[0]->data_consumed = data_consumed;
+        }
+    }
+
+    /* The data is read slowly: the window is halved when the next update is needed */
+    if (ret == 0) {
+        uint64_t increase = 0;
+        int nb_rtt = 0;
+
+        while (increase == 0 && nb_rtt < 100) {
+            current_time += RWND_TUNING_TEST_RTT;
+            cnx[0]->data_consumed += RWND_TUNING_TEST_MB / 10;
+            increase = picoquic_rwnd_max_data_increase(cnx[0], current_time);
+            nb_rtt++;
+        }
+        cnx[0]->maxdata_local += increase;
+        if (increase == 0 || cnx[0]->rwnd.window != 2 * RWND_TUNING_TEST_MB ||
+            quic->rwnd_committed != 6 * RWND_TUNING_TEST_MB) {
+            DBG_PRINTF("Unexpected window after slow reads: %" PRIu64 "\n", cnx[0]->rwnd.window);
+            ret = -1;
+        }
+    }
+
+    /* The stream window starts at its initial value, grows with the consumption
+     * rate up to the connection window, and shrinks when the application reads
+     * slowly, but not below the initial value */
+    if (ret == 0) {
+        if ((stream = picoquic_create_stream(cnx[1], 0)) == NULL || stream->maxdata_local != 2 * RWND_TUNING_TEST_MB) {
+            DBG_PRINTF("%s", "Cannot create stream\n");
+            ret = -1;
+        }
+        else if (rwnd_tuning_test_stream(cnx[1], stream, &current_time, RWND_TUNING_TEST_RTT,
+            (3 * RWND_TUNING_TEST_MB) / 2, (7 * RWND_TUNING_TEST_MB) / 2) != 0 ||
+            rwnd_tuning_test_stream(cnx[1], stream, &current_time, RWND_TUNING_TEST_RTT,
+                (7 * RWND_TUNING_TEST_MB) / 2, (15 * RWND_TUNING_TEST_MB) / 2) != 0 ||
+            stream->rwnd.window != 4 * RWND_TUNING_TEST_MB ||
+            rwnd_tuning_test_stream(cnx[1], stream, &current_time, RWND_TUNING_TEST_RTT,
+                (15 * RWND_TUNING_TEST_MB) / 2, (23 * RWND_TUNING_TEST_MB) / 2) != 0 ||
+            stream->rwnd.window != 4 * RWND_TUNING_TEST_MB ||
+            rwnd_tuning_test_stream(cnx[1], stream, &current_time, 10 * RWND_TUNING_TEST_RTT,
+                (19 * RWND_TUNING_TEST_MB) / 2 + RWND_TUNING_TEST_MB / 10,
+                (23 * RWND_TUNING_TEST_MB) / 2 + RWND_TUNING_TEST_MB / 10) != 0 ||
+            stream->rwnd.window != 2 * RWND_TUNING_TEST_MB) {
+            DBG_PRINTF("Unexpected stream window: %" PRIu64 ", max data: %" PRIu64 "\n",
+                stream->rwnd.window, stream->maxdata_local);
+            ret = -1;
+        }
+    }
+
+    /* Deleting a connection releases its window */
+    if (ret == 0) {
+        picoquic_delete_cnx(cnx[1]);
+        if (quic->rwnd_committed != 2 * RWND_TUNING_TEST_MB) {
+            DBG_PRINTF("%s", "Window not released\n");
+            ret = -1;
+        }
+    }
+
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+    return ret;
+}
+
+/* Test sparse segments: a small segment at the edge of the flow control
+ * window must not cause a window sized ring. It is kept in the data tree,
+ * and delivered in order once the data before it is received, or passed
+ * to the direct receive function.
+ */
+#define STREAM_RING_SPARSE_TEST_WINDOW 0x100000
+#define STREAM_RING_SPARSE_TEST_EDGE (STREAM_RING_SPARSE_TEST_WINDOW - 16)
+
+int stream_ring_sparse_test()
+{
+    int ret = 0;
+    picoquic_quic_t* quic = NULL;
+    picoquic_cnx_t* cnx = NULL;
+    picoquic_stream_head_t* stream = NULL;
+    stream_ring_test_ctx_t ctx;
+    struct sockaddr_in saddr;
+    uint64_t current_time = 0;
+
+    memset(&ctx, 0, sizeof(ctx));
+    memset(&saddr, 0, sizeof(struct sockaddr_in));
+    saddr.sin_family = AF_INET;
+    saddr.sin_port = 1000;
+
+    quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL,
+        NULL, NULL, NULL, NULL, current_time,
+        &current_time, NULL, NULL, 0);
+
+    if (quic == NULL || (cnx = picoquic_create_cnx(quic,
+        picoquic_null_connection_id, picoquic_null_connection_id, (struct sockaddr*)&saddr,
+        current_time, 0, "test-sni", "test-alpn", 1)) == NULL) {
+        DBG_PRINTF("%s", "Cannot create connection\n");
+        ret = -1;
+    }
+    else {
+        cnx->client_mode = 0;
+        cnx->maxdata_local = 2 * STREAM_RING_SPARSE_TEST_WINDOW;
+        cnx->local_parameters.initial_max_stream_data_bidi_remote = STREAM_RING_SPARSE_TEST_WINDOW;
+        picoquic_set_callback(cnx, stream_ring_test_callback, &ctx);
+
+        /* One byte at the edge of the window, then a few out of order frames */
+        ret = stream_ring_test_segment(cnx, STREAM_RING_SPARSE_TEST_EDGE, 1);
+        for (int i = 1; ret == 0 && i < 10; i++) {
+            ret = stream_ring_test_frame(cnx, i);
+        }
+        if (ret == 0 && ((stream = picoquic_find_stream(cnx, 0)) == NULL ||
+            stream->reassembly_ring == NULL || stream->reassembly_ring->size > PICOQUIC_STREAM_RING_SIZE_MIN ||
+            picosplay_first(&stream->stream_data_tree) == NULL || ctx.nb_delivered != 0)) {
+            DBG_PRINTF("%s", "Sparse segment not held in the data tree\n");
+            ret = -1;
+        }
+
+        /* Receive the data in order up to the edge: all data is delivered */
+        for (uint64_t offset = 0; ret == 0 && offset < STREAM_RING_SPARSE_TEST_EDGE; offset += STREAM_RING_TEST_FRAME_SIZE) {
+            size_t length = (STREAM_RING_SPARSE_TEST_EDGE - offset < STREAM_RING_TEST_FRAME_SIZE) ?
+                (size_t)(STREAM_RING_SPARSE_TEST_EDGE - offset) : STREAM_RING_TEST_FRAME_SIZE;
+            ret = stream_ring_test_segment(cnx, offset, length);
+        }
+        if (ret == 0 && (ctx.nb_delivered != STREAM_RING_SPARSE_TEST_EDGE + 1 ||
+            picosplay_first(&stream->stream_data_tree) != NULL)) {
+            DBG_PRINTF("Delivered %" PRIu64 " bytes instead of %d\n", ctx.nb_delivered, STREAM_RING_SPARSE_TEST_EDGE + 1);
+            ret = -1;
+        }
+
+        /* A sparse segment pending in the data tree is passed to the direct receive function */
+        if (ret == 0) {
+            cnx->local_parameters.initial_max_stream_data_bidi_remote = 2 * STREAM_RING_SPARSE_TEST_WINDOW;
+            stream->maxdata_local = 2 * STREAM_RING_SPARSE_TEST_WINDOW;
+            ret = stream_ring_test_segment(cnx, 2 * STREAM_RING_SPARSE_TEST_EDGE, 1);
+        }
+        if (ret == 0) {
+            ctx.nb_delivered = 2 * STREAM_RING_SPARSE_TEST_EDGE;
+            ret = picoquic_mark_direct_receive_stream(cnx, 0, stream_ring_test_direct_receive, &ctx);
+            if (ret == 0 && (picosplay_first(&stream->stream_data_tree) != NULL ||
+                ctx.nb_delivered != 2 * STREAM_RING_SPARSE_TEST_EDGE + 1)) {
+                DBG_PRINTF("%s", "Sparse segment not passed to direct receive\n");
+                ret = -1;
+            }
+        }
+
+        if (ret == 0 && ctx.is_corrupted) {
+            DBG_PRINTF("%s", "Delivered data is corrupted\n");
+            ret = -1;
+        }
+    }
+
+    if (cnx != NULL) {
+        picoquic_delete_cnx(cnx);
+    }
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+
+    return ret;
+}
@@ -8807,6 +8807,157 @@ int perflog_test()
 }
 #endif
 
+/* Crypto workers test: transfer data with AEAD offloaded to worker
+ * threads on both sides, and a key rotation in the middle of the transfer.
+ * The send buffer is large enough to build packet trains, so encryption
+ * jobs are dispatched to the workers. Verify that the transfer completes
+ * and that jobs were actually posted.
+ * This test needs the TLS stack for the handshake and the AEAD. The worker
+ * pool itself is tested without TLS in crypto_pool_test.
+ */
+#ifdef _WINDOWS
+int crypto_workers_test()
+{
+    /* Crypto workers are not available on Windows */
+    return 0;
+}
+#else
+int crypto_workers_test()
+{
+    uint64_t simulated_time = 0;
+    uint64_t loss_mask = 0;
+    picoquic_test_tls_api_ctx_t* test_ctx = NULL;
+    picoquic_connection_id_t initial_cid = { {0xc7, 0x90, 0x7c, 0xe5, 0, 0, 0, 0}, 8 };
+    size_t send_buffer_size = 0xFFFF;
+    int ret;
+
+    ret = tls_api_init_ctx_ex2(&test_ctx, PICOQUIC_INTERNAL_TEST_VERSION_1,
+        PICOQUIC_TEST_SNI, PICOQUIC_TEST_ALPN, &simulated_time, NULL, NULL, 0, 0, 0, &initial_cid, 8, 0, send_buffer_size, 0);
+
+    if (ret == 0 && test_ctx == NULL) {
+        ret = -1;
+    }
+
+    if (ret == 0 && (picoquic_set_crypto_workers(test_ctx->qclient, 2) != 0 ||
+        picoquic_set_crypto_workers(test_ctx->qserver, 2) != 0)) {
+        DBG_PRINTF("%s", "Cannot start the crypto workers");
+        ret = -1;
+    }
+
+    if (ret == 0) {
+        ret = tls_api_connection_loop(test_ctx, &loss_mask, 0, &simulated_time);
+    }
+
+    if (ret == 0) {
+        ret = test_api_init_send_recv_scenario(test_ctx, test_scenario_sustained, sizeof(test_scenario_sustained));
+    }
+
+    /* Send part of the data, then rotate the keys once the current epoch is acknowledged */
+    for (int i = 0; ret == 0 && i < 64; i++) {
+        ret = tls_api_data_sending_loop(test_ctx, &loss_mask, &simulated_time, 8);
+        if (ret == 0 && !test_ctx->test_finished &&
+            picoquic_sack_list_last(&test_ctx->cnx_client->ack_ctx[picoquic_packet_context_application].sack_list) >
+            test_ctx->cnx_client->crypto_epoch_sequence &&
+            test_ctx->cnx_client->key_phase_enc == test_ctx->cnx_client->key_phase_dec) {
+            ret = picoquic_start_key_rotation(test_ctx->cnx_client);
+            if (ret != 0) {
+                DBG_PRINTF("%s", "Cannot start key rotation");
+            }
+            break;
+        }
+    }
+
+    if (ret == 0) {
+        ret = tls_api_data_sending_loop(test_ctx, &loss_mask, &simulated_time, 0);
+    }
+
+    if (ret == 0) {
+        ret = tls_api_one_scenario_body_verify(test_ctx, &simulated_time, 0);
+    }
+
+    if (ret == 0) {
+        uint64_t nb_jobs_posted = 0;
+        uint64_t nb_jobs_local = 0;
+
+        picoquic_crypto_pool_get_stats(test_ctx->qserver->crypto_pool, &nb_jobs_posted, &nb_jobs_local);
+        if (nb_jobs_posted == 0) {
+            DBG_PRINTF("No crypto job posted, %" PRIu64 " local jobs", nb_jobs_local);
+            ret = -1;
+        }
+    }
+
+    if (test_ctx != NULL) {
+        tls_api_delete_ctx(test_ctx);
+        test_ctx = NULL;
+    }
+
+    return ret;
+}
+#endif
+
+/* Key rotation in the middle of a packet train. The server rotates its
+ * keys every few packets, from within picoquic_prepare_packet_ex, while
+ * the header protection of the current GSO train is deferred and, with
+ * crypto workers, while its AEAD jobs are still queued. The pending
+ * packets must be completed before the old key is released. Verify that
+ * the client sees several rotations, and decrypts every packet.
+ */
+#define KEY_ROTATION_TRAIN_EPOCH 24
+
+int key_rotation_train_test()
+{
+    uint64_t simulated_time = 0;
+    uint64_t loss_mask = 0;
+    picoquic_test_tls_api_ctx_t* test_ctx = NULL;
+    picoquic_connection_id_t initial_cid = { {0x7e, 0x90, 0x7c, 0xe5, 0, 0, 0, 0}, 8 };
+    size_t send_buffer_size = 0xFFFF;
+    int ret;
+
+    ret = tls_api_init_ctx_ex2(&test_ctx, PICOQUIC_INTERNAL_TEST_VERSION_1,
+        PICOQUIC_TEST_SNI, PICOQUIC_TEST_ALPN, &simulated_time, NULL, NULL, 0, 0, 0, &initial_cid, 8, 0, send_buffer_size, 0);
+
+    if (ret == 0 && test_ctx == NULL) {
+        ret = -1;
+    }
+#ifndef _WINDOWS
+    if (ret == 0 && picoquic_set_crypto_workers(test_ctx->qserver, 2) != 0) {
+        DBG_PRINTF("%s", "Cannot start the crypto workers");
+        ret = -1;
+    }
+#endif
+
+    if (ret == 0) {
+        ret = tls_api_connection_loop(test_ctx, &loss_mask, 0, &simulated_time);
+    }
+
+    if (ret == 0) {
+        picoquic_set_crypto_epoch_length(test_ctx->cnx_server, KEY_ROTATION_TRAIN_EPOCH);
+        ret = test_api_init_send_recv_scenario(test_ctx, test_scenario_sustained, sizeof(test_scenario_sustained));
+    }
+
+    if (ret == 0) {
+        ret = tls_api_data_sending_loop(test_ctx, &loss_mask, &simulated_time, 0);
+    }
+
+    if (ret == 0) {
+        ret = tls_api_one_scenario_body_verify(test_ctx, &simulated_time, 0);
+    }
+
+    if (ret == 0 && (test_ctx->cnx_client->nb_crypto_key_rotations < 2 ||
+        test_ctx->cnx_client->crypto_failure_count != 0)) {
+        DBG_PRINTF("%" PRIu64 " key rotations, %" PRIu64 " decryption failures",
+            test_ctx->cnx_client->nb_crypto_key_rotations, test_ctx->cnx_client->crypto_failure_count);
+        ret = -1;
+    }
+
+    if (test_ctx != NULL) {
+        tls_api_delete_ctx(test_ctx);
+        test_ctx = NULL;
+    }
+
+    return ret;
+}
+
 /*
  * Testing the flow controlled sending scenario, or "direct sending".
  * Data is sent through the "prepare to send" callback.